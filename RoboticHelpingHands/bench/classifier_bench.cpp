@@ -0,0 +1,271 @@
+// Host benchmark of the custom gesture classifier: builds each 20 Hz training recording
+// into a window the way train_gesture_model.py does, runs GestureClassifier::classify()
+// over it and reports a confusion matrix per class and the time per inference. See the
+// [Classifier benchmark] section of notes.txt.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "gesture_classifier.h"
+
+namespace {
+
+const int _FEATURES = GestureClassifier::FRAME_FEATURES;
+
+// Results: every class, then NONE for a window the classifier turned down
+const int _OUTCOMES = GestureClassifier::CLASSES + 1;
+const int _OUTCOME_NONE = GestureClassifier::CLASSES;
+
+// Matrix column heads, CustomGesture order
+const char* const _OUTCOME_NAMES[_OUTCOMES] = {"shake", "tap", "p_down", "p_up", "inward", "outward", "NONE"};
+
+// Multiply-accumulates of one inference, both layers
+const int _MACS = GestureClassifier::INPUTS * GestureClassifier::HIDDEN +
+                  GestureClassifier::HIDDEN * GestureClassifier::CLASSES;
+
+// One recording as the trainer sees it
+struct Recording {
+    int label;                      // index into the label list
+    std::vector<GestureFrame> window;
+};
+
+struct Options {
+    std::vector<std::string> paths;
+    int repeat = 1;
+};
+
+struct Tally {
+    std::vector<std::array<uint32_t, _OUTCOMES>> confusion;    // [label][outcome]
+    std::vector<uint32_t> windows;                             // [label]
+    uint64_t classify_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t runs = 0;
+};
+
+void usage(const char* program) {
+    fprintf(stderr, "usage: %s recording.csv | dir ... [--repeat n]\n", program);
+}
+
+/**
+ * @brief   label of a <label>_<n>.csv recording, split like the trainer does
+ * @returns empty for raw captures and names without an underscore
+ */
+std::string recordingLabel(const std::filesystem::path& path) {
+    if (path.extension() != ".csv") return "";
+    std::string name = path.stem().string();
+
+    size_t underscore = name.rfind('_');
+    if (underscore == std::string::npos || underscore == 0) return "";
+    if (name.compare(underscore, std::string::npos, "_raw") == 0) return "";
+    return name.substr(0, underscore);
+}
+
+/**
+ * @brief   index of a label, the gesture classes first in CustomGesture order
+ * @returns index into labels
+ */
+int labelIndex(std::vector<std::string>& labels, const std::string& label) {
+    auto it = std::find(labels.begin(), labels.end(), label);
+    if (it != labels.end()) return (int)(it - labels.begin());
+    labels.push_back(label);
+    return (int)labels.size() - 1;
+}
+
+/**
+ * @brief   parses one CSV row of whole numbers, as int() does in the trainer
+ * @returns false for the header or a corrupted line
+ */
+bool parseRow(const std::string& line, int* values) {
+    const char* cursor = line.c_str();
+    for (int i = 0; i < _FEATURES; i++) {
+        while (*cursor == ' ') cursor++;
+        char* end;
+        long value = strtol(cursor, &end, 10);
+        if (end == cursor) return false;
+        while (*end == ' ' || *end == '\r') end++;
+        if (*end != ',' && !(*end == '\0' && i == _FEATURES - 1)) return false;
+
+        values[i] = (int)std::min(255L, std::max(0L, value));
+        cursor = *end == ',' ? end + 1 : end;
+    }
+    return true;
+}
+
+/**
+ * @brief   loads the first window of a recording; a short one holds its last frame,
+ *          like the live window would
+ * @returns false if the file has no rows
+ */
+bool loadRecording(const std::filesystem::path& path, int label, Recording& recording) {
+    std::ifstream file(path);
+    std::string line;
+    recording.label = label;
+    recording.window.clear();
+
+    while (std::getline(file, line) && (int)recording.window.size() < GestureClassifier::WINDOW_FRAMES) {
+        int values[_FEATURES];
+        if (!parseRow(line, values)) continue;
+
+        GestureFrame frame = {(uint8_t)values[0], (uint8_t)values[1], (uint8_t)values[2],
+                              (uint8_t)values[3], (uint8_t)values[4]};
+        recording.window.push_back(frame);
+    }
+    if (recording.window.empty()) return false;
+
+    while ((int)recording.window.size() < GestureClassifier::WINDOW_FRAMES) {
+        recording.window.push_back(recording.window.back());
+    }
+    return true;
+}
+
+/**
+ * @brief   collects the recordings under every path given
+ * @returns none, adds to recordings and labels
+ */
+void loadRecordings(const Options& options, std::vector<std::string>& labels, std::vector<Recording>& recordings) {
+    std::vector<std::filesystem::path> files;
+    for (const std::string& path : options.paths) {
+        if (std::filesystem::is_directory(path)) {
+            for (const auto& entry : std::filesystem::directory_iterator(path)) {
+                if (entry.is_regular_file()) files.push_back(entry.path());
+            }
+        } else {
+            files.push_back(path);
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const std::filesystem::path& file : files) {
+        std::string label = recordingLabel(file);
+        if (label.empty()) continue;
+
+        Recording recording;
+        if (loadRecording(file, labelIndex(labels, label), recording)) {
+            recordings.push_back(recording);
+        } else {
+            fprintf(stderr, "skipping %s: no rows\n", file.string().c_str());
+        }
+    }
+}
+
+/**
+ * @brief   classifies one window like ClassifierTask, a frame at a time from reset()
+ * @returns none, adds to tally
+ */
+void classifyRecording(GestureClassifier& classifier, const Recording& recording, int repeat, Tally& tally) {
+    classifier.reset();
+    for (const GestureFrame& frame : recording.window) classifier.push(frame);
+
+    GestureClassifier::Result result = {-1, 0};
+    for (int r = 0; r < repeat; r++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        result = classifier.classify();
+        uint64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        tally.classify_ns += elapsed_ns;
+        tally.max_ns = std::max(tally.max_ns, elapsed_ns);
+        tally.runs++;
+    }
+
+    tally.windows[recording.label]++;
+    tally.confusion[recording.label][result.gesture < 0 ? _OUTCOME_NONE : result.gesture]++;
+}
+
+double percent(uint32_t part, uint32_t whole) {
+    return whole > 0 ? 100.0 * part / whole : 0.0;
+}
+
+void printConfusion(const Tally& tally, const std::vector<std::string>& labels) {
+    printf("\n%-14s %5s", "class", "n");
+    for (const char* outcome : _OUTCOME_NAMES) printf(" %7s", outcome);
+    printf(" %8s\n", "correct");
+
+    for (size_t label = 0; label < labels.size(); label++) {
+        if (tally.windows[label] == 0) continue;
+
+        printf("%-14s %5u", labels[label].c_str(), tally.windows[label]);
+        for (uint32_t count : tally.confusion[label]) printf(" %7u", count);
+
+        int expected = label < (size_t)GestureClassifier::CLASSES ? (int)label : _OUTCOME_NONE;
+        printf(" %7.1f%%\n", percent(tally.confusion[label][expected], tally.windows[label]));
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            options.repeat = std::max(1, atoi(argv[++i]));
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            options.paths.push_back(argv[i]);
+        }
+    }
+    if (options.paths.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Gesture classes keep their CustomGesture index, anything else is expected to stay NONE
+    std::vector<std::string> labels;
+    for (int c = 0; c < GestureClassifier::CLASSES; c++) labels.push_back(GestureClassifier::getLabel(c));
+
+    std::vector<Recording> recordings;
+    loadRecordings(options, labels, recordings);
+    if (recordings.empty()) {
+        fprintf(stderr, "no <label>_<n>.csv recordings found\n");
+        return 1;
+    }
+
+    printf("%zu recordings, %d frames a window, %d MACs an inference\n", recordings.size(),
+           GestureClassifier::WINDOW_FRAMES, _MACS);
+    if (!GestureClassifier::isModelTrained()) {
+        printf("gesture_model_data.h is the untrained placeholder: classify() returns NONE without running the model,\n"
+               "run serial_listening/train_gesture_model.py on these recordings and rebuild\n");
+    }
+
+    Tally tally;
+    tally.confusion.resize(labels.size(), std::array<uint32_t, _OUTCOMES>{});
+    tally.windows.resize(labels.size(), 0);
+
+    GestureClassifier classifier;
+    for (const Recording& recording : recordings) classifyRecording(classifier, recording, options.repeat, tally);
+
+    printConfusion(tally, labels);
+
+    uint32_t gestures = 0;
+    uint32_t correct = 0;
+    uint32_t others = 0;
+    uint32_t false_triggers = 0;
+    for (size_t label = 0; label < labels.size(); label++) {
+        if (label < (size_t)GestureClassifier::CLASSES) {
+            gestures += tally.windows[label];
+            correct += tally.confusion[label][label];
+        } else {
+            others += tally.windows[label];
+            false_triggers += tally.windows[label] - tally.confusion[label][_OUTCOME_NONE];
+        }
+    }
+
+    printf("\naccuracy: %u/%u gesture windows (%.1f%%)", correct, gestures, percent(correct, gestures));
+    if (others > 0) {
+        printf(", false triggers: %u/%u other windows (%.1f%%)", false_triggers, others,
+               percent(false_triggers, others));
+    }
+    printf("\nclassify(): %.2f us mean, %.2f us max over %llu runs, %.2f ns per MAC\n",
+           tally.classify_ns / 1000.0 / tally.runs, tally.max_ns / 1000.0, (unsigned long long)tally.runs,
+           (double)tally.classify_ns / tally.runs / _MACS);
+    return 0;
+}
@@ -0,0 +1,666 @@
+// Host benchmark of the APDS-9960 gesture decoder: feeds recorded or generated FIFO
+// traces through processGestureData()/decodeGesture() in bulk on every core and reports
+// ns per decode, a confusion matrix per class, the false trigger rate and how much
+// sooner early commits decide, optionally over a sweep of the decoder thresholds. See the [Decoder benchmark] section of notes.txt.
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <SparkFun_APDS9960.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "sim_script.h"
+
+namespace {
+
+// Dataset period of the firmware's sensor setup: 10 pulses per diode plus GWTIME 2.8 ms
+const uint32_t _DATASET_US = 4200;
+
+// Gesture mode entry and exit as gesture_grip_sensors.cpp sets them, GEXPERS 1
+const uint8_t _ENTER_THRESHOLD = 60;
+const uint8_t _EXIT_THRESHOLD = 50;
+
+// Datasets further apart than this in a recording belong to different gestures
+const uint64_t _WINDOW_GAP_US = 50000;
+
+// Windows handed to a worker at a time
+const size_t _CHUNK_WINDOWS = 64;
+
+const char* const _DIRECTIONS[] = {"NONE", "LEFT", "RIGHT", "UP", "DOWN", "NEAR", "FAR"};
+const int _DIRECTION_COUNT = 7;
+
+// Synthetic classes and what the decoder should make of them
+struct SyntheticClass {
+    const char* label;
+    int expected;
+};
+
+const SyntheticClass _SYNTHETIC[] = {
+    {"swipe_up", DIR_UP},
+    {"swipe_down", DIR_DOWN},
+    {"swipe_left", DIR_LEFT},
+    {"swipe_right", DIR_RIGHT},
+    {"near", DIR_NEAR},
+    {"far", DIR_FAR},
+    {"noise", DIR_NONE},
+};
+
+// One gesture mode window, cut into the batches pollGesture() would read
+struct Window {
+    int label;
+    std::vector<uint8_t> udlr;          // datasets, U/D/L/R each
+    std::vector<uint32_t> batches;      // first dataset of each batch
+    std::vector<uint32_t> polls_us;     // when each batch is read, from the first dataset
+};
+
+// Decoder thresholds that can be swept
+struct SweepParam {
+    const char* name;
+    uint8_t gesture_decode_params::*field;
+};
+
+const SweepParam _SWEEP_PARAMS[] = {
+    {"threshold_out", &gesture_decode_params::threshold_out},
+    {"sensitivity_1", &gesture_decode_params::sensitivity_1},
+    {"sensitivity_2", &gesture_decode_params::sensitivity_2},
+    {"near_batches", &gesture_decode_params::near_batches},
+    {"far_batches", &gesture_decode_params::far_batches},
+    {"commit_margin", &gesture_decode_params::commit_margin},
+};
+
+struct SweepRange {
+    const SweepParam* param;
+    int from;
+    int to;
+    int step;
+};
+
+// Results of one parameter set
+struct Tally {
+    std::vector<std::array<uint32_t, _DIRECTION_COUNT>> confusion;    // [label][decoded]
+    uint64_t decode_ns;
+    uint64_t decodes;
+    uint64_t batches;
+    uint32_t commits;           // windows with an early commit
+    uint32_t commits_correct;   // of those, committed the expected direction
+    uint32_t commits_expected;  // of those, from a class with an expected direction
+    uint32_t retractions;       // commit differs from the full decode
+    uint64_t commit_total_us;   // first dataset to commit, committed windows
+    uint64_t final_total_us;    // first dataset to the full decode, same windows
+    uint32_t ahead_max_us;
+};
+
+struct Options {
+    std::vector<std::string> paths;
+    std::string sensor = "left";
+    int synthetic = 0;
+    uint32_t seed = 1;
+    uint32_t batch_ms = FIFO_PAUSE_TIME;
+    int repeat = 1;
+    int jobs = 0;
+    const char* csv = NULL;
+    std::vector<SweepRange> sweeps;
+    std::map<std::string, int> expect;
+};
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [recording_raw.csv | dir ...] [--synthetic n] [--seed n]\n"
+            "          [--sensor left|right|both] [--batch-ms n] [--repeat n] [--jobs n]\n"
+            "          [--expect label=NONE|LEFT|RIGHT|UP|DOWN|NEAR|FAR] [--sweep name=from:to[:step]]\n"
+            "          [--csv results.csv]\n"
+            "sweepable: threshold_out sensitivity_1 sensitivity_2 near_batches far_batches commit_margin\n",
+            program);
+}
+
+int parseDirection(const std::string& name) {
+    for (int i = 0; i < _DIRECTION_COUNT; i++) {
+        if (name == _DIRECTIONS[i]) return i;
+    }
+    return -1;
+}
+
+bool parseSweep(const char* text, SweepRange& range) {
+    const char* equals = strchr(text, '=');
+    if (equals == NULL) return false;
+
+    std::string name(text, equals - text);
+    range.param = NULL;
+    for (const SweepParam& param : _SWEEP_PARAMS) {
+        if (name == param.name) range.param = &param;
+    }
+    range.step = 1;
+    int fields = sscanf(equals + 1, "%d:%d:%d", &range.from, &range.to, &range.step);
+    return range.param != NULL && fields >= 2 && range.step > 0 &&
+           range.from >= 0 && range.to <= 255 && range.from <= range.to;
+}
+
+/**
+ * @brief   cuts datasets into batches of batch_us, as the firmware reads the FIFO
+ * @param[in]   window: window to fill, its udlr already set
+ * @param[in]   times_us: timestamp of each dataset
+ * @param[in]   batch_us: time between FIFO reads
+ * @returns none
+ */
+void splitBatches(Window& window, const std::vector<uint64_t>& times_us, uint64_t batch_us) {
+    window.batches.clear();
+    window.polls_us.clear();
+    uint64_t batch_end_us = 0;
+    for (size_t i = 0; i < times_us.size(); i++) {
+        if (i == 0 || times_us[i] >= batch_end_us) {
+            window.batches.push_back((uint32_t)i);
+            batch_end_us = (i == 0 ? times_us[i] : batch_end_us) + batch_us;
+            while (times_us[i] >= batch_end_us) batch_end_us += batch_us;
+            window.polls_us.push_back((uint32_t)(batch_end_us - times_us[0]));
+        }
+    }
+}
+
+/**
+ * @brief   label of a <label>_<n>_raw.csv recording
+ * @returns empty if the name does not follow serial_csv_logger.py
+ */
+std::string recordingLabel(const std::filesystem::path& path) {
+    std::string name = path.filename().string();
+    const std::string suffix = "_raw.csv";
+    if (name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return "";
+    }
+    name.erase(name.size() - suffix.size());
+
+    size_t underscore = name.rfind('_');
+    if (underscore == std::string::npos || underscore == 0 || underscore + 1 == name.size()) return "";
+    for (size_t i = underscore + 1; i < name.size(); i++) {
+        if (name[i] < '0' || name[i] > '9') return "";
+    }
+    return name.substr(0, underscore);
+}
+
+int labelIndex(std::vector<std::string>& labels, const std::string& label) {
+    auto it = std::find(labels.begin(), labels.end(), label);
+    if (it != labels.end()) return (int)(it - labels.begin());
+    labels.push_back(label);
+    return (int)labels.size() - 1;
+}
+
+/**
+ * @brief   loads the gesture windows of one raw recording
+ * @returns false if the file could not be read
+ */
+bool loadRecording(const std::filesystem::path& path, const std::string& label, const Options& options,
+                   std::vector<std::string>& labels, std::vector<Window>& windows) {
+    std::vector<std::string> sensors;
+    if (options.sensor == "both") sensors = {"left", "right"};
+    else sensors = {options.sensor};
+
+    bool loaded = false;
+    for (const std::string& sensor : sensors) {
+        std::vector<std::pair<uint64_t, SimHandSample>> samples;
+        if (!SimScript::loadReplay(path.string(), sensor, samples)) continue;
+        loaded = true;
+
+        // The sensor only queues datasets in gesture mode, a gap is the end of a window
+        Window window;
+        std::vector<uint64_t> times_us;
+        auto flush = [&]() {
+            if (times_us.empty()) return;
+            window.label = labelIndex(labels, label);
+            splitBatches(window, times_us, options.batch_ms * 1000ULL);
+            windows.push_back(window);
+            window.udlr.clear();
+            times_us.clear();
+        };
+        for (const auto& entry : samples) {
+            if (!times_us.empty() && entry.first - times_us.back() > _WINDOW_GAP_US) flush();
+            window.udlr.insert(window.udlr.end(), entry.second.udlr, entry.second.udlr + 4);
+            times_us.push_back(entry.first);
+        }
+        flush();
+    }
+    return loaded;
+}
+
+uint8_t clampCount(double value) {
+    if (value <= 0) return 0;
+    if (value >= 255) return 255;
+    return (uint8_t)lround(value);
+}
+
+/**
+ * @brief   generates one window of a synthetic class
+ *
+ * Swipes, near and far come from the simulation's hand model with the speed, hand
+ * distance, per diode offset and noise jittered; noise is a short flicker around the
+ * entry threshold with no hand motion in it. Gesture mode is gated like the sensor does.
+ */
+Window generateWindow(int synthetic_class, std::mt19937& rng, uint64_t batch_us) {
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    auto between = [&](double low, double high) { return low + (high - low) * unit(rng); };
+
+    double scale = between(0.5, 1.2);
+    double sigma = between(0.0, 6.0);
+    double offsets[4];
+    for (double& offset : offsets) offset = between(0.0, 10.0);
+    std::normal_distribution<double> noise(0.0, 1.0);
+
+    SimHandTrack track;
+    uint64_t end_us;
+    switch (synthetic_class) {
+        case 0: case 1: case 2: case 3:
+            end_us = track.addMotion((SimHandTrack::Motion)(SimHandTrack::MOTION_SWIPE_UP + synthetic_class), 0,
+                                     (uint64_t)between(150000, 600000));
+            break;
+        case 4:
+            end_us = track.addMotion(SimHandTrack::MOTION_NEAR, 0, (uint64_t)between(600000, 1500000));
+            break;
+        case 5:
+            end_us = track.addMotion(SimHandTrack::MOTION_FAR, 0, (uint64_t)between(300000, 900000));
+            break;
+        default:
+            end_us = (uint64_t)between(40000, 200000);
+            scale = 0;
+            sigma = between(5.0, 15.0);
+            for (double& offset : offsets) offset = between(40.0, 75.0);
+            break;
+    }
+
+    Window window;
+    window.label = synthetic_class;
+    std::vector<uint64_t> times_us;
+    bool in_gesture = false;
+    for (uint64_t t_us = 0; t_us < end_us + _WINDOW_GAP_US; t_us += _DATASET_US) {
+        SimHandSample sample = track.sample(t_us);
+        uint8_t udlr[4];
+        for (int i = 0; i < 4; i++) {
+            bool flicker = t_us < end_us || scale > 0;
+            udlr[i] = clampCount(sample.udlr[i] * scale + (flicker ? offsets[i] + sigma * noise(rng) : 0));
+        }
+
+        uint8_t peak = *std::max_element(udlr, udlr + 4);
+        if (!in_gesture) {
+            if (peak < _ENTER_THRESHOLD) continue;
+            if (!times_us.empty()) break;
+            in_gesture = true;
+        }
+        window.udlr.insert(window.udlr.end(), udlr, udlr + 4);
+        times_us.push_back(t_us);
+        if (peak < _EXIT_THRESHOLD) in_gesture = false;
+    }
+
+    splitBatches(window, times_us, batch_us);
+    return window;
+}
+
+/**
+ * @brief   decodes every window once per repeat with one parameter set
+ *
+ * The full decode is timed like the firmware gets it: one poll after the read that
+ * drained the last batch, when GVALID has dropped. An early commit counts from the
+ * read of the batch that made it.
+ *
+ * @returns none, adds to tally
+ */
+void decodeWindows(SparkFun_APDS9960& apds, const std::vector<Window>& windows, const std::vector<int>& expected,
+                   size_t first, size_t last, int repeat, uint32_t batch_us, Tally& tally) {
+    for (size_t w = first; w < last; w++) {
+        const Window& window = windows[w];
+        int motion = DIR_NONE;
+        int commit = DIR_NONE;
+        size_t commit_batch = 0;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeat; r++) {
+            commit = DIR_NONE;
+            for (size_t b = 0; b < window.batches.size(); b++) {
+                uint32_t begin = window.batches[b];
+                uint32_t end = b + 1 < window.batches.size() ? window.batches[b + 1] : window.udlr.size() / 4;
+                apds.feedGestureData(&window.udlr[begin * 4], end - begin);
+
+                int early = apds.takeGestureCommit();
+                if (early != DIR_NONE && commit == DIR_NONE) {
+                    commit = early;
+                    commit_batch = b;
+                }
+            }
+            motion = apds.endGesture();
+        }
+        tally.decode_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        tally.decodes += repeat;
+        tally.batches += (uint64_t)repeat * window.batches.size();
+        if (motion < 0 || motion >= _DIRECTION_COUNT) motion = DIR_NONE;
+        tally.confusion[window.label][motion]++;
+
+        if (commit == DIR_NONE) continue;
+        uint32_t commit_us = window.polls_us[commit_batch];
+        uint32_t final_us = window.polls_us.back() + batch_us;
+        tally.commits++;
+        if (expected[window.label] >= 0) {
+            tally.commits_expected++;
+            if (commit == expected[window.label]) tally.commits_correct++;
+        }
+        if (commit != motion) tally.retractions++;
+        tally.commit_total_us += commit_us;
+        tally.final_total_us += final_us;
+        tally.ahead_max_us = std::max(tally.ahead_max_us, final_us - commit_us);
+    }
+}
+
+std::vector<gesture_decode_params> expandSweeps(const gesture_decode_params& defaults,
+                                                const std::vector<SweepRange>& sweeps) {
+    std::vector<gesture_decode_params> sets = {defaults};
+    for (const SweepRange& range : sweeps) {
+        std::vector<gesture_decode_params> expanded;
+        for (const gesture_decode_params& set : sets) {
+            for (int value = range.from; value <= range.to; value += range.step) {
+                gesture_decode_params params = set;
+                params.*(range.param->field) = (uint8_t)value;
+                expanded.push_back(params);
+            }
+        }
+        sets.swap(expanded);
+    }
+    return sets;
+}
+
+struct Score {
+    uint32_t correct;
+    uint32_t expected;
+    uint32_t false_triggers;
+    uint32_t idle;
+};
+
+Score score(const Tally& tally, const std::vector<int>& expected) {
+    Score result = {};
+    for (size_t label = 0; label < expected.size(); label++) {
+        if (expected[label] < 0) continue;
+
+        uint32_t total = 0;
+        for (uint32_t count : tally.confusion[label]) total += count;
+        result.expected += total;
+        result.correct += tally.confusion[label][expected[label]];
+        if (expected[label] == DIR_NONE) {
+            result.idle += total;
+            result.false_triggers += total - tally.confusion[label][DIR_NONE];
+        }
+    }
+    return result;
+}
+
+double percent(uint32_t part, uint32_t whole) {
+    return whole > 0 ? 100.0 * part / whole : 0.0;
+}
+
+double averageMs(uint64_t total_us, uint32_t count) {
+    return count > 0 ? total_us / 1000.0 / count : 0.0;
+}
+
+void printParams(const gesture_decode_params& params) {
+    printf("threshold_out=%u sensitivity_1=%u sensitivity_2=%u near_batches=%u far_batches=%u commit_margin=%u\n",
+           params.threshold_out, params.sensitivity_1, params.sensitivity_2, params.near_batches,
+           params.far_batches, params.commit_margin);
+}
+
+void printConfusion(const Tally& tally, const std::vector<std::string>& labels, const std::vector<int>& expected) {
+    printf("\n%-16s %6s", "class", "n");
+    for (const char* direction : _DIRECTIONS) printf(" %6s", direction);
+    printf("  %-6s %7s\n", "expect", "correct");
+
+    for (size_t label = 0; label < labels.size(); label++) {
+        uint32_t total = 0;
+        for (uint32_t count : tally.confusion[label]) total += count;
+        printf("%-16s %6u", labels[label].c_str(), total);
+        for (uint32_t count : tally.confusion[label]) printf(" %6u", count);
+        if (expected[label] >= 0) {
+            printf("  %-6s %6.1f%%\n", _DIRECTIONS[expected[label]],
+                   percent(tally.confusion[label][expected[label]], total));
+        } else {
+            printf("  %-6s %7s\n", "-", "-");
+        }
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--synthetic") == 0 && has_value) {
+            options.synthetic = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            options.seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--sensor") == 0 && has_value) {
+            options.sensor = argv[++i];
+        } else if (strcmp(argv[i], "--batch-ms") == 0 && has_value) {
+            options.batch_ms = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repeat") == 0 && has_value) {
+            options.repeat = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--jobs") == 0 && has_value) {
+            options.jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--csv") == 0 && has_value) {
+            options.csv = argv[++i];
+        } else if (strcmp(argv[i], "--sweep") == 0 && has_value) {
+            SweepRange range;
+            if (!parseSweep(argv[++i], range)) {
+                fprintf(stderr, "bench: bad sweep '%s'\n", argv[i]);
+                return 1;
+            }
+            options.sweeps.push_back(range);
+        } else if (strcmp(argv[i], "--expect") == 0 && has_value) {
+            const char* text = argv[++i];
+            const char* equals = strchr(text, '=');
+            int direction = equals != NULL ? parseDirection(equals + 1) : -1;
+            if (direction < 0) {
+                fprintf(stderr, "bench: bad expectation '%s'\n", text);
+                return 1;
+            }
+            options.expect[std::string(text, equals - text)] = direction;
+        } else if (argv[i][0] != '-') {
+            options.paths.push_back(argv[i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if ((options.paths.empty() && options.synthetic <= 0) || options.batch_ms == 0 ||
+        (options.sensor != "left" && options.sensor != "right" && options.sensor != "both")) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Corpus: synthetic classes first so their labels keep their order
+    std::vector<std::string> labels;
+    std::vector<Window> windows;
+    if (options.synthetic > 0) {
+        std::mt19937 rng(options.seed);
+        for (size_t c = 0; c < sizeof(_SYNTHETIC) / sizeof(_SYNTHETIC[0]); c++) {
+            labelIndex(labels, _SYNTHETIC[c].label);
+            if (options.expect.count(_SYNTHETIC[c].label) == 0) {
+                options.expect[_SYNTHETIC[c].label] = _SYNTHETIC[c].expected;
+            }
+            for (int n = 0; n < options.synthetic; n++) {
+                Window window = generateWindow((int)c, rng, options.batch_ms * 1000ULL);
+                if (!window.batches.empty()) windows.push_back(window);
+            }
+        }
+    }
+
+    std::vector<std::filesystem::path> files;
+    for (const std::string& path : options.paths) {
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error)) {
+            for (const auto& entry : std::filesystem::directory_iterator(path, error)) {
+                if (!recordingLabel(entry.path()).empty()) files.push_back(entry.path());
+            }
+        } else if (!recordingLabel(path).empty()) {
+            files.push_back(path);
+        } else {
+            fprintf(stderr, "bench: %s is not a <label>_<n>_raw.csv recording\n", path.c_str());
+            return 1;
+        }
+    }
+    std::sort(files.begin(), files.end());
+    for (const std::filesystem::path& file : files) {
+        if (!loadRecording(file, recordingLabel(file), options, labels, windows)) {
+            fprintf(stderr, "bench: no %s datasets in %s\n", options.sensor.c_str(), file.string().c_str());
+        }
+    }
+    if (windows.empty()) {
+        fprintf(stderr, "bench: no gesture windows to decode\n");
+        return 1;
+    }
+
+    std::vector<int> expected(labels.size(), -1);
+    for (size_t label = 0; label < labels.size(); label++) {
+        auto it = options.expect.find(labels[label]);
+        if (it != options.expect.end()) expected[label] = it->second;
+    }
+
+    SparkFun_APDS9960 reference;
+    std::vector<gesture_decode_params> sets = expandSweeps(reference.getGestureDecodeParams(), options.sweeps);
+
+    int jobs = options.jobs > 0 ? options.jobs : (int)std::max(1u, std::thread::hardware_concurrency());
+    printf("bench: %zu windows, %zu classes, %zu parameter set%s, %d thread%s\n", windows.size(), labels.size(),
+           sets.size(), sets.size() == 1 ? "" : "s", jobs, jobs == 1 ? "" : "s");
+
+    // Work is (parameter set, chunk of windows); every worker has its own decoder and tallies
+    size_t chunks = (windows.size() + _CHUNK_WINDOWS - 1) / _CHUNK_WINDOWS;
+    size_t work_items = sets.size() * chunks;
+    std::atomic<size_t> next_item(0);
+
+    Tally empty = {};
+    empty.confusion.assign(labels.size(), {});
+    std::vector<std::vector<Tally>> worker_tallies(jobs, std::vector<Tally>(sets.size(), empty));
+
+    std::chrono::steady_clock::time_point wall_start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int j = 0; j < jobs; j++) {
+        workers.emplace_back([&, j]() {
+            SparkFun_APDS9960 apds;
+            size_t item;
+            while ((item = next_item++) < work_items) {
+                size_t set = item / chunks;
+                size_t first = (item % chunks) * _CHUNK_WINDOWS;
+                size_t last = std::min(first + _CHUNK_WINDOWS, windows.size());
+                apds.setGestureDecodeParams(sets[set]);
+                decodeWindows(apds, windows, expected, first, last, options.repeat, options.batch_ms * 1000,
+                              worker_tallies[j][set]);
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    std::vector<Tally> tallies(sets.size(), empty);
+    uint64_t total_decodes = 0;
+    for (const std::vector<Tally>& worker : worker_tallies) {
+        for (size_t set = 0; set < sets.size(); set++) {
+            Tally& tally = tallies[set];
+            tally.decode_ns += worker[set].decode_ns;
+            tally.decodes += worker[set].decodes;
+            tally.batches += worker[set].batches;
+            tally.commits += worker[set].commits;
+            tally.commits_correct += worker[set].commits_correct;
+            tally.commits_expected += worker[set].commits_expected;
+            tally.retractions += worker[set].retractions;
+            tally.commit_total_us += worker[set].commit_total_us;
+            tally.final_total_us += worker[set].final_total_us;
+            tally.ahead_max_us = std::max(tally.ahead_max_us, worker[set].ahead_max_us);
+            for (size_t label = 0; label < labels.size(); label++) {
+                for (int d = 0; d < _DIRECTION_COUNT; d++) tally.confusion[label][d] += worker[set].confusion[label][d];
+            }
+            total_decodes += worker[set].decodes;
+        }
+    }
+
+    FILE* csv = NULL;
+    if (options.csv != NULL) {
+        csv = fopen(options.csv, "w");
+        if (csv == NULL) {
+            fprintf(stderr, "bench: cannot create %s\n", options.csv);
+            return 1;
+        }
+        fprintf(csv, "threshold_out,sensitivity_1,sensitivity_2,near_batches,far_batches,commit_margin,"
+                     "accuracy,false_trigger_rate,ns_per_decode,ns_per_batch,"
+                     "commit_rate,commit_precision,retraction_rate,ms_ahead\n");
+    }
+
+    size_t best = 0;
+    std::vector<Score> scores;
+    for (size_t set = 0; set < sets.size(); set++) {
+        scores.push_back(score(tallies[set], expected));
+        const Score& current = scores.back();
+        const Score& leader = scores[best];
+        // Most correct, then fewest false triggers
+        if (current.correct > leader.correct ||
+            (current.correct == leader.correct && current.false_triggers < leader.false_triggers)) {
+            best = set;
+        }
+    }
+
+    if (sets.size() > 1) {
+        printf("\n%5s %5s %5s %5s %5s %6s %9s %9s %10s %8s %8s %9s\n", "thr", "sens1", "sens2", "near", "far",
+               "margin", "accuracy", "false", "ns/decode", "commits", "retract", "ahead ms");
+    }
+    for (size_t set = 0; set < sets.size(); set++) {
+        const gesture_decode_params& params = sets[set];
+        const Tally& tally = tallies[set];
+        const Score& result = scores[set];
+        double ns_decode = tally.decodes > 0 ? (double)tally.decode_ns / tally.decodes : 0;
+        double ns_batch = tally.batches > 0 ? (double)tally.decode_ns / tally.batches : 0;
+        double ahead_ms = averageMs(tally.final_total_us - tally.commit_total_us, tally.commits);
+
+        if (sets.size() > 1) {
+            printf("%5u %5u %5u %5u %5u %6u %8.1f%% %8.1f%% %10.0f %7.1f%% %7.1f%% %9.1f%s\n", params.threshold_out,
+                   params.sensitivity_1, params.sensitivity_2, params.near_batches, params.far_batches,
+                   params.commit_margin, percent(result.correct, result.expected),
+                   percent(result.false_triggers, result.idle), ns_decode, percent(tally.commits, windows.size()),
+                   percent(tally.retractions, tally.commits), ahead_ms, set == best ? "  *" : "");
+        }
+        if (csv != NULL) {
+            fprintf(csv, "%u,%u,%u,%u,%u,%u,%.4f,%.4f,%.1f,%.1f,%.4f,%.4f,%.4f,%.1f\n", params.threshold_out,
+                    params.sensitivity_1, params.sensitivity_2, params.near_batches, params.far_batches,
+                    params.commit_margin, percent(result.correct, result.expected) / 100,
+                    percent(result.false_triggers, result.idle) / 100, ns_decode, ns_batch,
+                    percent(tally.commits, windows.size()) / 100,
+                    percent(tally.commits_correct, tally.commits_expected) / 100,
+                    percent(tally.retractions, tally.commits) / 100, ahead_ms);
+        }
+    }
+    if (csv != NULL) fclose(csv);
+
+    // Details of the only or the best set
+    const Tally& tally = tallies[best];
+    const Score& result = scores[best];
+    printf("\n%s", sets.size() > 1 ? "best: " : "");
+    printParams(sets[best]);
+    printConfusion(tally, labels, expected);
+    printf("\naccuracy %.1f%% (%u/%u), false triggers %.1f%% (%u/%u NONE windows)\n",
+           percent(result.correct, result.expected), result.correct, result.expected,
+           percent(result.false_triggers, result.idle), result.false_triggers, result.idle);
+    printf("early commits %u/%zu windows, %.1f%% the expected direction, %.1f%% retracted by the full decode\n",
+           tally.commits, windows.size(), percent(tally.commits_correct, tally.commits_expected),
+           percent(tally.retractions, tally.commits));
+    printf("commit %.1f ms after the first dataset vs %.1f ms for the full decode, %.1f ms sooner (max %.1f)\n",
+           averageMs(tally.commit_total_us, tally.commits), averageMs(tally.final_total_us, tally.commits),
+           averageMs(tally.final_total_us - tally.commit_total_us, tally.commits), tally.ahead_max_us / 1000.0);
+    printf("decode %.0f ns/gesture, %.0f ns/batch, %.2f M decodes/s over %d thread%s\n",
+           tally.decodes > 0 ? (double)tally.decode_ns / tally.decodes : 0.0,
+           tally.batches > 0 ? (double)tally.decode_ns / tally.batches : 0.0,
+           wall_s > 0 ? total_decodes / wall_s / 1e6 : 0.0, jobs, jobs == 1 ? "" : "s");
+    return 0;
+}
@@ -0,0 +1,165 @@
+// Host benchmark of the servo easing: times one motion step of the original moveTask
+// easing (strcmp on the easing name, then a double sin/cos) against ServoEasing::apply()
+// (Q15 table lookup and interpolation), and checks every table against the exact curve.
+// See the [Easing benchmark] section of notes.txt.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "servo_easing.h"
+
+namespace {
+
+const double _PI = 3.14159265358979323846;
+
+// A 180 degree move at 10 steps per degree, the longest moveTask ever made
+const int _STEPS_PER_MOVE = 1800;
+const int _DISTANCE_DECIDEGREES = 1800;
+const int _DEFAULT_MOVES = 20000;
+
+// Blend the planner gives a trapezoid, a quarter of the move accelerating
+const uint8_t _BLEND = 64;
+
+struct Curve {
+    const char* name;       // as moveTask was called with it, NULL if it had no such curve
+    EasingType type;
+};
+
+const Curve _CURVES[] = {
+    {"linear", EASE_LINEAR},
+    {"sin", EASE_SIN},
+    {"cos", EASE_COS},
+    {NULL, EASE_SMOOTHSTEP},
+    {NULL, EASE_CUBIC},
+    {NULL, EASE_TRAPEZOID},
+};
+
+const char* const _LABELS[] = {"linear", "sin", "cos", "smoothstep", "cubic", "trapezoid"};
+
+/**
+ * @brief   exact curve the tables stand for
+ * @returns eased progress 0..1
+ */
+double exactCurve(EasingType type, double t) {
+    switch (type) {
+        case EASE_SIN:        return sin(t * _PI / 2);
+        case EASE_COS:        return 1.0 - cos(t * _PI / 2);
+        case EASE_SMOOTHSTEP: return t * t * (3.0 - 2.0 * t);
+        case EASE_CUBIC:      return t < 0.5 ? 4.0 * t * t * t : 1.0 - 4.0 * (1.0 - t) * (1.0 - t) * (1.0 - t);
+        case EASE_TRAPEZOID: {
+            double accel = _BLEND / 256.0;
+            double peak = 1.0 / (1.0 - accel);
+            if (t < accel) return peak * t * t / (2.0 * accel);
+            if (t <= 1.0 - accel) return peak * (t - accel / 2.0);
+            return 1.0 - peak * (1.0 - t) * (1.0 - t) / (2.0 * accel);
+        }
+        case EASE_LINEAR:
+        default:              return t;
+    }
+}
+
+/**
+ * @brief   one step of the original ServoController::moveTask easing
+ * @returns position offset in tenths of a degree
+ */
+int oldStep(const char* easing_type, int step, int total_steps, int distance) {
+    float progress = (float)step / total_steps;
+    float eased_progress = progress;
+
+    if (strcmp(easing_type, "sin") == 0) {
+        eased_progress = sin(progress * _PI / 2);
+    } else if (strcmp(easing_type, "cos") == 0) {
+        eased_progress = 1.0 - cos(progress * _PI / 2);
+    }
+    return (int)(eased_progress * distance);
+}
+
+/**
+ * @brief   one step of ServoMotionEngine::stepJoint()
+ * @returns position offset in tenths of a degree
+ */
+int newStep(EasingType type, int step, int total_steps, int distance) {
+    int32_t progress = (int32_t)(((uint32_t)step << 15) / total_steps);
+    int32_t eased_progress = ServoEasing::apply(type, progress, _BLEND);
+    return (int)((distance * eased_progress) / ServoEasing::ONE);
+}
+
+}
+
+int main(int argc, char** argv) {
+    int moves = _DEFAULT_MOVES;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--moves") == 0 && i + 1 < argc) {
+            moves = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--moves n]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (moves <= 0) moves = 1;
+
+    // Every result feeds the sink, and the name goes through memory like the task's copy, so neither is folded away
+    volatile long sink = 0;
+    uint64_t steps = (uint64_t)moves * (_STEPS_PER_MOVE + 1);
+
+    printf("%d moves of %d steps per curve, %.0f degrees each\n\n", moves, _STEPS_PER_MOVE,
+           _DISTANCE_DECIDEGREES / 10.0);
+    printf("%-11s %10s %10s %8s %14s %12s\n", "curve", "old ns", "new ns", "speedup", "max error", "max err deg");
+
+    for (size_t c = 0; c < sizeof(_CURVES) / sizeof(_CURVES[0]); c++) {
+        const Curve& curve = _CURVES[c];
+
+        double old_ns = 0;
+        if (curve.name != NULL) {
+            char easing[10];
+            strncpy(easing, curve.name, sizeof(easing) - 1);
+            easing[sizeof(easing) - 1] = '\0';
+            const char* volatile name = easing;
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int m = 0; m < moves; m++) {
+                long total = 0;
+                for (int step = 0; step <= _STEPS_PER_MOVE; step++) {
+                    total += oldStep(name, step, _STEPS_PER_MOVE, _DISTANCE_DECIDEGREES);
+                }
+                sink = sink + total;
+            }
+            old_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count() / steps;
+        }
+
+        volatile EasingType type = curve.type;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int m = 0; m < moves; m++) {
+            long total = 0;
+            for (int step = 0; step <= _STEPS_PER_MOVE; step++) {
+                total += newStep(type, step, _STEPS_PER_MOVE, _DISTANCE_DECIDEGREES);
+            }
+            sink = sink + total;
+        }
+        double new_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count() / steps;
+
+        // Every Q15 progress value against the exact curve
+        double max_error = 0;
+        for (int32_t progress = 0; progress <= ServoEasing::ONE; progress++) {
+            double eased = (double)ServoEasing::apply(curve.type, progress, _BLEND) / ServoEasing::ONE;
+            double error = fabs(eased - exactCurve(curve.type, (double)progress / ServoEasing::ONE));
+            if (error > max_error) max_error = error;
+        }
+
+        if (curve.name != NULL) {
+            printf("%-11s %10.2f %10.2f %7.1fx %14.2e %12.3f\n", _LABELS[c], old_ns, new_ns,
+                   new_ns > 0 ? old_ns / new_ns : 0.0, max_error, max_error * 180.0);
+        } else {
+            printf("%-11s %10s %10.2f %8s %14.2e %12.3f\n", _LABELS[c], "-", new_ns, "-",
+                   max_error, max_error * 180.0);
+        }
+    }
+
+    printf("\nold: moveTask's strcmp and double sin/cos per step, only linear/sin/cos existed\n");
+    printf("new: ServoEasing::apply() as stepJoint() calls it, trapezoid blend %u/256\n", _BLEND);
+    return sink == 42 ? 2 : 0;
+}
@@ -0,0 +1,215 @@
+// Host stress test of the lock-free frame ring: one producer thread publishes numbered
+// frames in FIFO sized bursts while reader threads consume them, one with read(), one copying slowly
+// in place between acquire() and release() so the producer laps it mid-copy, and one that
+// stalls now and then to be overrun. Every frame a reader keeps must be intact and newer
+// than the last, and frames read plus overruns must add up to frames published. See the
+// [Frame ring stress test] section of notes.txt.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "frame_ring.h"
+#include "gesture_frame.h"
+
+namespace {
+
+const uint32_t _DEFAULT_FRAMES = 5000000;
+const int _DEFAULT_READERS = 3;
+
+// Frames published back to back before the producer yields, a full FIFO read
+const int _DEFAULT_BURST = 32;
+
+// Spread over the frame so a torn copy cannot look whole
+const uint32_t _GOLDEN = 0x9E3779B9;
+
+enum ReaderKind {
+    READER_COPY = 0,        // read(), like the fusion and classifier tasks
+    READER_IN_PLACE,        // acquire(), a slow copy, release()
+    READER_STALLING,        // read(), sleeping every so often
+    READER_KINDS
+};
+
+const char* const _KIND_NAMES[READER_KINDS] = {"copy", "in place", "stalling"};
+
+/**
+ * @brief   frame as large as a cache line, every word derived from its number
+ */
+struct WideFrame {
+    uint32_t index;
+    uint32_t check[15];
+};
+
+void encode(uint32_t index, WideFrame& frame) {
+    frame.index = index;
+    for (int k = 0; k < 15; k++) frame.check[k] = index ^ ((uint32_t)(k + 1) * _GOLDEN);
+}
+
+bool decode(const WideFrame& frame, uint32_t& index) {
+    index = frame.index;
+    for (int k = 0; k < 15; k++) {
+        if (frame.check[k] != (index ^ ((uint32_t)(k + 1) * _GOLDEN))) return false;
+    }
+    return true;
+}
+
+// The ring the acquisition tasks publish on, number in the timestamp, its hash in the rest
+void encode(uint32_t index, SensorFrame& frame) {
+    uint32_t hash = index * _GOLDEN;
+    frame.timestamp_us = index;
+    frame.sensor = (uint8_t)(hash >> 24);
+    memcpy(frame.udlr, &hash, 4);
+}
+
+bool decode(const SensorFrame& frame, uint32_t& index) {
+    index = frame.timestamp_us;
+    uint32_t hash = index * _GOLDEN;
+    return frame.sensor == (uint8_t)(hash >> 24) && memcmp(frame.udlr, &hash, 4) == 0;
+}
+
+struct ReaderResult {
+    int kind;
+    uint64_t read;          // intact frames kept
+    uint64_t overruns;      // cursor.overruns at the end
+    uint64_t torn;          // in place copies that were torn and that release() caught
+    uint64_t errors;        // torn frames kept, or numbers out of order
+    uint32_t next;          // cursor at the end
+};
+
+/**
+ * @brief   copies a frame a word at a time with a pause between, so the producer can lap the copy
+ * @returns none
+ */
+template <typename T>
+void slowCopy(const T* slot, T& frame) {
+    const volatile uint8_t* from = (const volatile uint8_t*)slot;
+    uint8_t* to = (uint8_t*)&frame;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        to[i] = from[i];
+        if ((i & 3) == 3) std::this_thread::yield();
+    }
+}
+
+template <typename T, size_t N>
+void readFrames(const FrameRing<T, N>& ring, typename FrameRing<T, N>::Cursor cursor,
+                const std::atomic<bool>& done, ReaderResult& result) {
+    bool have_last = false;
+    uint32_t last = 0;
+
+    // Caught up after the producer finished means every frame has been seen or counted
+    for (;;) {
+        bool finished = done.load(std::memory_order_acquire);
+
+        T frame;
+        bool got = false;
+        if (result.kind == READER_IN_PLACE) {
+            const T* slot = ring.acquire(cursor);
+            if (slot != nullptr) {
+                slowCopy(slot, frame);
+                uint32_t index;
+                bool whole = decode(frame, index);
+                got = ring.release(cursor);
+                if (!got && !whole) result.torn++;
+            }
+        } else {
+            got = ring.read(cursor, frame);
+            if (result.kind == READER_STALLING && got && (result.read & 1023) == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+
+        if (got) {
+            uint32_t index;
+            if (!decode(frame, index) || (have_last && (int32_t)(index - last) <= 0)) result.errors++;
+            last = index;
+            have_last = true;
+            result.read++;
+        } else if (ring.acquire(cursor) == nullptr) {
+            if (finished) break;
+            std::this_thread::yield();
+        }
+    }
+    result.overruns = cursor.overruns;
+    result.next = cursor.next;
+}
+
+/**
+ * @brief   runs one producer and the readers over a ring
+ * @returns true if every reader kept only intact frames in order and accounted for every frame
+ */
+template <typename T, size_t N>
+bool stress(const char* name, uint32_t frames, int readers, int burst) {
+    static FrameRing<T, N> ring;
+    std::atomic<bool> done(false);
+    std::vector<ReaderResult> results(readers);
+    std::vector<std::thread> threads;
+
+    // Cursors before the first frame, so every reader has to account for all of them
+    for (int r = 0; r < readers; r++) {
+        results[r] = ReaderResult{r % READER_KINDS, 0, 0, 0, 0, 0};
+        threads.emplace_back(readFrames<T, N>, std::cref(ring), ring.attach(), std::cref(done), std::ref(results[r]));
+    }
+
+    uint32_t first = ring.getPublished();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frames; i++) {
+        T frame;
+        encode(first + i, frame);
+        ring.publish(frame);
+
+        // Lets the readers in on a single core too; with more cores they run alongside regardless
+        if (burst > 0 && (i + 1) % burst == 0) std::this_thread::yield();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    done.store(true, std::memory_order_release);
+    for (std::thread& thread : threads) thread.join();
+
+    printf("\n%s: %u frames, %zu B each, %zu slots, %.1f M frames/s published\n",
+           name, frames, sizeof(T), N, seconds > 0 ? frames / seconds / 1e6 : 0.0);
+    printf("%-8s %-9s %12s %12s %10s %7s %s\n", "reader", "kind", "read", "overruns", "torn", "errors", "accounted");
+
+    bool ok = true;
+    for (int r = 0; r < readers; r++) {
+        const ReaderResult& result = results[r];
+        bool accounted = result.read + result.overruns == frames && result.next == first + frames;
+        ok = ok && accounted && result.errors == 0;
+        printf("%-8d %-9s %12llu %12llu %10llu %7llu %s\n", r, _KIND_NAMES[result.kind],
+               (unsigned long long)result.read, (unsigned long long)result.overruns,
+               (unsigned long long)result.torn, (unsigned long long)result.errors, accounted ? "yes" : "NO");
+    }
+    return ok;
+}
+
+}
+
+int main(int argc, char** argv) {
+    uint32_t frames = _DEFAULT_FRAMES;
+    int readers = _DEFAULT_READERS;
+    int burst = _DEFAULT_BURST;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--readers") == 0 && i + 1 < argc) {
+            readers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--burst") == 0 && i + 1 < argc) {
+            burst = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--frames n] [--readers n] [--burst n]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames == 0) frames = 1;
+    if (readers < 1) readers = 1;
+
+    printf("1 producer, %d readers, bursts of %d, %u hardware threads\n", readers, burst,
+           std::thread::hardware_concurrency());
+
+    bool ok = stress<SensorFrame, 128>("SensorFrame ring as the acquisition tasks use it", frames, readers, burst);
+    ok = stress<WideFrame, 16>("Cache line frames on a small ring", frames, readers, burst) && ok;
+
+    printf("\n%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,539 @@
+// Host benchmark of the two-sensor gesture fusion: generates or loads dual traces, reads
+// each sensor's FIFO on its own period and skew the way the per-bus tasks do, dates the
+// datasets back from their read, and runs GestureFusion over them like the fusion task.
+// Reports a confusion matrix per scenario and ns per dataset. See the [Fusion benchmark]
+// section of notes.txt.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "gesture_fusion.h"
+#include "sim_script.h"
+
+namespace {
+
+// Dataset period of the firmware's sensor setup: 10 pulses per diode plus GWTIME 2.8 ms
+const uint32_t _DATASET_US = 4200;
+
+// FIFO_PAUSE_TIME plus the bus time of a read, what the acquire report measures in the sim
+const uint32_t _READ_PERIOD_US = 33000;
+
+// The fusion task's period
+const uint32_t _FUSION_PERIOD_US = 20000;
+
+// Gesture mode entry and exit as gesture_grip_sensors.cpp sets them, GEXPERS 1
+const uint8_t _ENTER_THRESHOLD = 60;
+const uint8_t _EXIT_THRESHOLD = 50;
+
+// Time left after a trace for pending passes to wait out the sweep window
+const uint64_t _DRAIN_US = 2000000;
+
+// Results: every fused event, NONE for a trace that gave nothing
+const int _OUTCOMES = GestureFusion::FUSED_EVENT_COUNT + 1;
+const int _OUTCOME_NONE = GestureFusion::FUSED_EVENT_COUNT;
+
+const char* const _OUTCOME_NAMES[_OUTCOMES] = {"SWEEP_R", "SWEEP_L", "HOLD", "NEAR", "FAR", "NONE"};
+
+// Synthetic scenarios and what the fusion should make of them
+struct Scenario {
+    const char* label;
+    int expected;
+};
+
+const Scenario _SCENARIOS[] = {
+    {"sweep_to_right", GestureFusion::FUSED_SWEEP_TO_RIGHT},
+    {"sweep_to_left", GestureFusion::FUSED_SWEEP_TO_LEFT},
+    {"two_hand_hold", GestureFusion::FUSED_TWO_HAND_HOLD},
+    {"near_swipe", GestureFusion::FUSED_NEAR_SWIPE},
+    {"far_swipe", GestureFusion::FUSED_FAR_SWIPE},
+    {"noise", _OUTCOME_NONE},
+};
+const int _SCENARIO_COUNT = sizeof(_SCENARIOS) / sizeof(_SCENARIOS[0]);
+
+// One sensor's dataset with the time it was sampled
+struct Dataset {
+    uint64_t sampled_us;
+    uint8_t udlr[4];
+};
+
+// One trace: both sensors, each dataset as published on its ring
+struct Trace {
+    int label;
+    int direction;                  // swipes: GestureFusion::Direction expected, SWIPE_NONE otherwise
+    std::vector<SensorFrame> frames;
+    std::vector<uint64_t> published_us;    // read that put each frame on its ring
+    uint64_t end_us;
+};
+
+struct Options {
+    std::vector<std::string> paths;
+    int synthetic = 0;
+    uint32_t seed = 1;
+    uint32_t read_us = _READ_PERIOD_US;
+    int32_t skew_us = -1;           // right bus read phase behind the left one, random if negative
+    int repeat = 1;
+    std::map<std::string, int> expect;
+};
+
+struct Tally {
+    std::vector<std::array<uint32_t, _OUTCOMES>> confusion;    // [label][outcome]
+    std::vector<uint32_t> traces;                              // [label]
+    std::vector<uint32_t> correct;                             // [label], exactly the expected result
+    uint32_t wrong_direction;       // swipes recognised with another direction
+    uint64_t datasets;
+    uint64_t fuse_ns;
+    uint32_t dropped;
+};
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [recording_raw.csv | dir ...] [--synthetic n] [--seed n]\n"
+            "          [--read-ms n] [--skew-ms n] [--repeat n]\n"
+            "          [--expect label=SWEEP_R|SWEEP_L|HOLD|NEAR|FAR|NONE]\n",
+            program);
+}
+
+int parseOutcome(const std::string& name) {
+    for (int i = 0; i < _OUTCOMES; i++) {
+        if (name == _OUTCOME_NAMES[i]) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief   label of a <label>_<n>_raw.csv recording
+ * @returns empty if the name does not follow serial_csv_logger.py
+ */
+std::string recordingLabel(const std::filesystem::path& path) {
+    std::string name = path.filename().string();
+    const std::string suffix = "_raw.csv";
+    if (name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return "";
+    }
+    name.erase(name.size() - suffix.size());
+
+    size_t underscore = name.rfind('_');
+    if (underscore == std::string::npos || underscore == 0 || underscore + 1 == name.size()) return "";
+    for (size_t i = underscore + 1; i < name.size(); i++) {
+        if (name[i] < '0' || name[i] > '9') return "";
+    }
+    return name.substr(0, underscore);
+}
+
+int labelIndex(std::vector<std::string>& labels, const std::string& label) {
+    auto it = std::find(labels.begin(), labels.end(), label);
+    if (it != labels.end()) return (int)(it - labels.begin());
+    labels.push_back(label);
+    return (int)labels.size() - 1;
+}
+
+uint8_t clampCount(double value) {
+    if (value <= 0) return 0;
+    if (value >= 255) return 255;
+    return (uint8_t)lround(value);
+}
+
+/**
+ * @brief   reads one sensor's datasets into its ring the way its acquisition task does
+ *
+ * Every read_us, starting at phase_us, the datasets sampled since the last read are
+ * published together, each stamped with the read time less a dataset period per
+ * dataset behind it, as onGestureSample() dates them.
+ *
+ * @returns none, adds to trace
+ */
+void publish(const std::vector<Dataset>& datasets, uint8_t sensor, uint32_t read_us, uint32_t phase_us, Trace& trace) {
+    size_t next = 0;
+    for (uint64_t read_at = phase_us; next < datasets.size(); read_at += read_us) {
+        size_t end = next;
+        while (end < datasets.size() && datasets[end].sampled_us <= read_at) end++;
+        for (size_t i = next; i < end; i++) {
+            SensorFrame frame;
+            frame.timestamp_us = (uint32_t)(read_at - (end - 1 - i) * _DATASET_US);
+            frame.sensor = sensor;
+            memcpy(frame.udlr, datasets[i].udlr, 4);
+            trace.frames.push_back(frame);
+            trace.published_us.push_back(read_at);
+        }
+        next = end;
+    }
+}
+
+/**
+ * @brief   orders a trace's frames by the read that published them
+ * @returns none
+ */
+void sortByRead(Trace& trace) {
+    std::vector<size_t> order(trace.frames.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return trace.published_us[a] < trace.published_us[b]; });
+
+    std::vector<SensorFrame> frames;
+    std::vector<uint64_t> published_us;
+    for (size_t i : order) {
+        frames.push_back(trace.frames[i]);
+        published_us.push_back(trace.published_us[i]);
+    }
+    trace.frames.swap(frames);
+    trace.published_us.swap(published_us);
+}
+
+/**
+ * @brief   samples one sensor's hand, gated by gesture mode like the sensor does
+ * @returns datasets the sensor would have queued
+ */
+std::vector<Dataset> sampleTrack(const SimHandTrack& track, uint64_t end_us, double scale, double sigma,
+                                 const double* offsets, uint32_t phase_us, std::mt19937& rng) {
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::vector<Dataset> datasets;
+    bool in_gesture = false;
+    for (uint64_t t_us = phase_us; t_us < end_us; t_us += _DATASET_US) {
+        SimHandSample sample = track.sample(t_us);
+        Dataset dataset;
+        dataset.sampled_us = t_us;
+        for (int i = 0; i < 4; i++) {
+            dataset.udlr[i] = clampCount(sample.udlr[i] * scale + offsets[i] + sigma * noise(rng));
+        }
+
+        uint8_t peak = *std::max_element(dataset.udlr, dataset.udlr + 4);
+        if (!in_gesture) {
+            if (peak < _ENTER_THRESHOLD) continue;
+            in_gesture = true;
+        }
+        datasets.push_back(dataset);
+        if (peak < _EXIT_THRESHOLD) in_gesture = false;
+    }
+    return datasets;
+}
+
+/**
+ * @brief   generates one trace of a synthetic scenario
+ *
+ * Hands come from the simulation's model with speed, height, per diode offset, noise
+ * and the gap between the hands jittered. Near swipes keep the hand close enough to
+ * clip the photodiodes, far ones stay well clear; noise is a flicker around the entry
+ * threshold on one sensor.
+ */
+Trace generateTrace(int scenario, std::mt19937& rng, const Options& options) {
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    auto between = [&](double low, double high) { return low + (high - low) * unit(rng); };
+
+    SimHandTrack tracks[2];
+    uint64_t end_us = 0;
+    double scale[2] = {1.0, 1.0};
+    Trace trace;
+    trace.label = scenario;
+    trace.direction = GestureFusion::SWIPE_NONE;
+
+    const SimHandTrack::Motion swipes[] = {SimHandTrack::MOTION_SWIPE_UP, SimHandTrack::MOTION_SWIPE_DOWN,
+                                           SimHandTrack::MOTION_SWIPE_LEFT, SimHandTrack::MOTION_SWIPE_RIGHT};
+    const int swipe_directions[] = {GestureFusion::SWIPE_UP, GestureFusion::SWIPE_DOWN,
+                                    GestureFusion::SWIPE_LEFT, GestureFusion::SWIPE_RIGHT};
+
+    switch (scenario) {
+        case 0: case 1: {
+            // Across the sensors: the second hand comes in while or after the first one leaves
+            int first = scenario == 0 ? 0 : 1;
+            SimHandTrack::Motion motion = scenario == 0 ? SimHandTrack::MOTION_SWIPE_RIGHT : SimHandTrack::MOTION_SWIPE_LEFT;
+            uint64_t duration_us = (uint64_t)between(200000, 450000);
+            uint64_t gap_us = (uint64_t)between(100000, 450000);
+            int peak = (int)between(150, 230);
+            tracks[first].addMotion(motion, 0, duration_us, peak);
+            end_us = tracks[1 - first].addMotion(motion, gap_us, (uint64_t)(duration_us * between(0.8, 1.2)), peak);
+            break;
+        }
+        case 2: {
+            uint64_t lag_us = (uint64_t)between(0, 250000);
+            uint64_t hold_us = (uint64_t)between(700000, 1500000);
+            int first = unit(rng) < 0.5 ? 0 : 1;
+            tracks[first].addMotion(SimHandTrack::MOTION_NEAR, 0, hold_us, (int)between(120, 230));
+            end_us = tracks[1 - first].addMotion(SimHandTrack::MOTION_NEAR, lag_us, hold_us, (int)between(120, 230));
+            break;
+        }
+        case 3: case 4: {
+            int sensor = unit(rng) < 0.5 ? 0 : 1;
+            int swipe = (int)(unit(rng) * 4) % 4;
+            int peak = scenario == 3 ? (int)between(240, 320) : (int)between(110, 190);
+            end_us = tracks[sensor].addMotion(swipes[swipe], 0, (uint64_t)between(150000, 600000), peak);
+            trace.direction = swipe_directions[swipe];
+            break;
+        }
+        default:
+            end_us = (uint64_t)between(40000, 200000);
+            scale[0] = 0;
+            scale[1] = 0;
+            break;
+    }
+
+    // Each sensor on its own dataset phase and read phase
+    uint32_t left_read_phase = (uint32_t)between(0, options.read_us);
+    uint32_t right_read_phase = options.skew_us >= 0 ? left_read_phase + options.skew_us
+                                                     : (uint32_t)between(0, options.read_us);
+    uint32_t read_phase[2] = {left_read_phase, right_read_phase};
+    int noisy = unit(rng) < 0.5 ? 0 : 1;
+    for (int s = 0; s < 2; s++) {
+        double sigma = between(0.0, 6.0);
+        double offsets[4];
+        for (double& offset : offsets) offset = between(0.0, 10.0);
+        if (scenario == _SCENARIO_COUNT - 1 && s == noisy) {
+            sigma = between(5.0, 15.0);
+            for (double& offset : offsets) offset = between(40.0, 75.0);
+        }
+
+        std::vector<Dataset> datasets = sampleTrack(tracks[s], end_us, scale[s], sigma, offsets,
+                                                    (uint32_t)between(0, _DATASET_US), rng);
+        publish(datasets, (uint8_t)s, options.read_us, read_phase[s], trace);
+    }
+    sortByRead(trace);
+    trace.end_us = end_us;
+    return trace;
+}
+
+/**
+ * @brief   loads a raw recording with both sensors as one trace
+ *
+ * The logger's timestamps are when each dataset was read off the bus, both sensors on
+ * the same micros() clock; they are taken as the sample times and read again here at
+ * the bench's period, so --read-ms and --skew-ms apply to recordings too.
+ *
+ * @returns false if neither sensor has datasets in it
+ */
+bool loadRecording(const std::filesystem::path& path, int label, const Options& options, Trace& trace) {
+    const char* const sensors[] = {"left", "right"};
+    trace.label = label;
+    trace.direction = GestureFusion::SWIPE_NONE;
+    trace.end_us = 0;
+
+    std::vector<std::pair<uint64_t, SimHandSample>> samples[2];
+    uint32_t first_us[2] = {};
+    bool found[2];
+    for (int s = 0; s < 2; s++) found[s] = SimScript::loadReplay(path.string(), sensors[s], samples[s], &first_us[s]);
+    if (!found[0] && !found[1]) return false;
+
+    // Both sensors from the earlier of their first datasets
+    uint32_t origin_us = !found[1] || (found[0] && (int32_t)(first_us[1] - first_us[0]) > 0) ? first_us[0] : first_us[1];
+    for (int s = 0; s < 2; s++) {
+        if (!found[s]) continue;
+
+        uint64_t shift_us = (uint32_t)(first_us[s] - origin_us);
+        std::vector<Dataset> datasets;
+        for (const auto& entry : samples[s]) {
+            Dataset dataset;
+            dataset.sampled_us = entry.first + shift_us;
+            memcpy(dataset.udlr, entry.second.udlr, 4);
+            datasets.push_back(dataset);
+            trace.end_us = std::max(trace.end_us, dataset.sampled_us);
+        }
+        uint32_t phase = options.skew_us >= 0 && s == 1 ? options.skew_us : 0;
+        publish(datasets, (uint8_t)s, options.read_us, phase, trace);
+    }
+    sortByRead(trace);
+    return true;
+}
+
+/**
+ * @brief   runs the fusion over one trace like the fusion task: every period, the frames
+ *          published since the last one, then update() and take()
+ *
+ * A trace is correct when it gives exactly the expected result, and a swipe also its
+ * direction; NONE expects nothing at all.
+ *
+ * @returns none, adds to tally
+ */
+void fuseTrace(GestureFusion& fusion, const Trace& trace, int expected, Tally& tally) {
+    fusion.reset();
+    std::vector<GestureFusion::Result> results;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t next = 0;
+    for (uint64_t now_us = _FUSION_PERIOD_US; ; now_us += _FUSION_PERIOD_US) {
+        while (next < trace.frames.size() && trace.published_us[next] <= now_us) {
+            fusion.push(trace.frames[next++]);
+        }
+        fusion.update((uint32_t)now_us);
+
+        GestureFusion::Result result;
+        while (fusion.take(result)) results.push_back(result);
+        if (next == trace.frames.size() && (fusion.isIdle() || now_us > trace.end_us + _DRAIN_US)) break;
+    }
+    tally.fuse_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    tally.datasets += trace.frames.size();
+    tally.dropped += fusion.getDropped();
+
+    tally.traces[trace.label]++;
+    if (results.empty()) tally.confusion[trace.label][_OUTCOME_NONE]++;
+    for (const GestureFusion::Result& result : results) tally.confusion[trace.label][result.event]++;
+
+    if (expected < 0) return;
+    if (expected == _OUTCOME_NONE) {
+        if (results.empty()) tally.correct[trace.label]++;
+        return;
+    }
+    if (results.size() != 1 || results[0].event != expected) return;
+    if (trace.direction != GestureFusion::SWIPE_NONE && results[0].direction != trace.direction) {
+        tally.wrong_direction++;
+        return;
+    }
+    tally.correct[trace.label]++;
+}
+
+double percent(uint32_t part, uint32_t whole) {
+    return whole > 0 ? 100.0 * part / whole : 0.0;
+}
+
+void printConfusion(const Tally& tally, const std::vector<std::string>& labels, const std::vector<int>& expected) {
+    printf("\n%-16s %6s", "class", "n");
+    for (const char* outcome : _OUTCOME_NAMES) printf(" %7s", outcome);
+    printf("  %-7s %7s\n", "expect", "correct");
+
+    for (size_t label = 0; label < labels.size(); label++) {
+        printf("%-16s %6u", labels[label].c_str(), tally.traces[label]);
+        for (uint32_t count : tally.confusion[label]) printf(" %7u", count);
+        if (expected[label] >= 0) {
+            printf("  %-7s %6.1f%%\n", _OUTCOME_NAMES[expected[label]],
+                   percent(tally.correct[label], tally.traces[label]));
+        } else {
+            printf("  %-7s %7s\n", "-", "-");
+        }
+    }
+}
+
+void printParams(const GestureFusion::Params& params) {
+    printf("end_gap=%u ms pass=%u..%u ms sweep=%u..%u ms hold=%u ms near_level=%u hold_level=%u "
+           "swipe_delta=%u still_band=%u\n",
+           params.end_gap_us / 1000, params.pass_min_us / 1000, params.pass_max_us / 1000,
+           params.sweep_min_us / 1000, params.sweep_max_us / 1000, params.hold_us / 1000,
+           params.near_level, params.hold_level, params.swipe_delta, params.still_band);
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--synthetic") == 0 && has_value) {
+            options.synthetic = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            options.seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--read-ms") == 0 && has_value) {
+            options.read_us = (uint32_t)(atof(argv[++i]) * 1000);
+        } else if (strcmp(argv[i], "--skew-ms") == 0 && has_value) {
+            options.skew_us = (int32_t)(atof(argv[++i]) * 1000);
+        } else if (strcmp(argv[i], "--repeat") == 0 && has_value) {
+            options.repeat = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--expect") == 0 && has_value) {
+            const char* text = argv[++i];
+            const char* equals = strchr(text, '=');
+            int outcome = equals != NULL ? parseOutcome(equals + 1) : -1;
+            if (outcome < 0) {
+                fprintf(stderr, "bench: bad expectation '%s'\n", text);
+                return 1;
+            }
+            options.expect[std::string(text, equals - text)] = outcome;
+        } else if (argv[i][0] != '-') {
+            options.paths.push_back(argv[i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if ((options.paths.empty() && options.synthetic <= 0) || options.read_us == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Corpus: synthetic scenarios first so their labels keep their order
+    std::vector<std::string> labels;
+    std::vector<Trace> traces;
+    if (options.synthetic > 0) {
+        std::mt19937 rng(options.seed);
+        for (int c = 0; c < _SCENARIO_COUNT; c++) {
+            labelIndex(labels, _SCENARIOS[c].label);
+            if (options.expect.count(_SCENARIOS[c].label) == 0) {
+                options.expect[_SCENARIOS[c].label] = _SCENARIOS[c].expected;
+            }
+            for (int n = 0; n < options.synthetic; n++) traces.push_back(generateTrace(c, rng, options));
+        }
+    }
+
+    std::vector<std::filesystem::path> files;
+    for (const std::string& path : options.paths) {
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error)) {
+            for (const auto& entry : std::filesystem::directory_iterator(path, error)) {
+                if (!recordingLabel(entry.path()).empty()) files.push_back(entry.path());
+            }
+        } else if (!recordingLabel(path).empty()) {
+            files.push_back(path);
+        } else {
+            fprintf(stderr, "bench: %s is not a <label>_<n>_raw.csv recording\n", path.c_str());
+            return 1;
+        }
+    }
+    std::sort(files.begin(), files.end());
+    for (const std::filesystem::path& file : files) {
+        Trace trace;
+        if (!loadRecording(file, labelIndex(labels, recordingLabel(file)), options, trace)) {
+            fprintf(stderr, "bench: no datasets in %s\n", file.string().c_str());
+            continue;
+        }
+        traces.push_back(trace);
+    }
+    if (traces.empty()) {
+        fprintf(stderr, "bench: nothing to fuse\n");
+        return 1;
+    }
+
+    std::vector<int> expected(labels.size(), -1);
+    for (size_t label = 0; label < labels.size(); label++) {
+        auto it = options.expect.find(labels[label]);
+        if (it != options.expect.end()) expected[label] = it->second;
+    }
+
+    Tally tally = {};
+    tally.confusion.assign(labels.size(), std::array<uint32_t, _OUTCOMES>{});
+    tally.traces.assign(labels.size(), 0);
+    tally.correct.assign(labels.size(), 0);
+
+    // Repeats only add timing, every pass gives the same results
+    GestureFusion fusion;
+    Tally repeats = tally;
+    for (int r = 0; r < options.repeat; r++) {
+        for (const Trace& trace : traces) fuseTrace(fusion, trace, expected[trace.label], r == 0 ? tally : repeats);
+    }
+    tally.fuse_ns += repeats.fuse_ns;
+    tally.datasets += repeats.datasets;
+
+    uint32_t correct = 0;
+    uint32_t scored = 0;
+    for (size_t label = 0; label < labels.size(); label++) {
+        if (expected[label] < 0) continue;
+        correct += tally.correct[label];
+        scored += tally.traces[label];
+    }
+
+    printf("%zu traces, %llu datasets, FIFO read every %.1f ms, ", traces.size(),
+           (unsigned long long)(tally.datasets / options.repeat), options.read_us / 1000.0);
+    if (options.skew_us >= 0) printf("right bus %.1f ms behind\n", options.skew_us / 1000.0);
+    else printf("bus phases random\n");
+    printParams(fusion.getParams());
+    printConfusion(tally, labels, expected);
+    printf("\naccuracy %.1f%% (%u/%u), %u swipes with the wrong direction, %u results dropped\n",
+           percent(correct, scored), correct, scored, tally.wrong_direction, tally.dropped);
+    printf("fusion: %.1f ns per dataset, push and update every %u ms included\n",
+           tally.datasets > 0 ? (double)tally.fuse_ns / tally.datasets : 0.0, _FUSION_PERIOD_US / 1000);
+    return 0;
+}
@@ -0,0 +1,276 @@
+// Host benchmark of the gesture template matcher: streams recorded gestures through the
+// C++ TemplateRecognizer the way the left acquisition task does and reports DTW cells per
+// step, the time per FIFO dataset and per DTW step, and a confusion matrix per class.
+// See the [Template benchmark] section of notes.txt.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "gesture_templates.h"
+#include "gesture_templates_data.h"
+#include "sim_script.h"
+
+namespace {
+
+// Datasets further apart than this in a raw recording belong to different gestures
+const uint64_t _WINDOW_GAP_US = 50000;
+
+// Results: every class, then NONE for a gesture nothing matched
+const int _OUTCOMES = GestureClassifier::CLASSES + 1;
+const int _OUTCOME_NONE = GestureClassifier::CLASSES;
+
+// Matrix column heads, CustomGesture order
+const char* const _OUTCOME_NAMES[_OUTCOMES] = {"shake", "tap", "p_down", "p_up", "inward", "outward", "NONE"};
+
+// One recording as a stream of left sensor datasets, ended at every gap
+struct Recording {
+    int label;                              // index into the label list
+    std::vector<std::array<uint8_t, 4>> datasets;
+    std::vector<bool> ends;                 // [dataset], the gesture window ends after it
+};
+
+struct Options {
+    std::vector<std::string> paths;
+    int repeat = 1;
+};
+
+struct Tally {
+    std::vector<std::array<uint32_t, _OUTCOMES>> confusion;    // [label][outcome]
+    std::vector<uint32_t> recordings;                          // [label]
+    uint32_t extra = 0;             // matches after a recording's first
+    uint64_t datasets = 0;
+    uint64_t stream_ns = 0;
+};
+
+void usage(const char* program) {
+    fprintf(stderr, "usage: %s recording.csv | recording_raw.csv | dir ... [--repeat n]\n", program);
+}
+
+/**
+ * @brief   label of a <label>_<n>.csv or <label>_<n>_raw.csv recording
+ * @returns empty if the name does not follow serial_csv_logger.py
+ */
+std::string recordingLabel(const std::filesystem::path& path, bool& raw) {
+    if (path.extension() != ".csv") return "";
+    std::string name = path.stem().string();
+
+    const std::string suffix = "_raw";
+    raw = name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    if (raw) name.erase(name.size() - suffix.size());
+
+    size_t underscore = name.rfind('_');
+    if (underscore == std::string::npos || underscore == 0) return "";
+    return name.substr(0, underscore);
+}
+
+int labelIndex(std::vector<std::string>& labels, const std::string& label) {
+    auto it = std::find(labels.begin(), labels.end(), label);
+    if (it != labels.end()) return (int)(it - labels.begin());
+    labels.push_back(label);
+    return (int)labels.size() - 1;
+}
+
+/**
+ * @brief   loads the left sensor of a recording as FIFO datasets
+ *
+ * Raw recordings are the datasets as read, a 50 ms gap ends a gesture window. A 20 Hz
+ * training row stands for GESTURE_TEMPLATE_DECIMATION datasets, so it is pushed that many
+ * times and steps the DTW once, as export_gesture_templates.py scores it; rows without
+ * FIFO data are left out like its trace().
+ *
+ * @returns false if there is nothing from the left sensor
+ */
+bool loadRecording(const std::filesystem::path& path, int label, bool raw, Recording& recording) {
+    std::vector<std::pair<uint64_t, SimHandSample>> samples;
+    if (!SimScript::loadReplay(path.string(), "left", samples)) return false;
+
+    recording.label = label;
+    uint64_t last_us = 0;
+    for (const auto& entry : samples) {
+        const uint8_t* udlr = entry.second.udlr;
+        std::array<uint8_t, 4> dataset = {udlr[0], udlr[1], udlr[2], udlr[3]};
+
+        if (raw) {
+            if (!recording.datasets.empty() && entry.first - last_us > _WINDOW_GAP_US) recording.ends.back() = true;
+            recording.datasets.push_back(dataset);
+            recording.ends.push_back(false);
+            last_us = entry.first;
+            continue;
+        }
+
+        if (udlr[0] + udlr[1] + udlr[2] + udlr[3] == 0) continue;
+        for (int i = 0; i < GESTURE_TEMPLATE_DECIMATION; i++) {
+            recording.datasets.push_back(dataset);
+            recording.ends.push_back(false);
+        }
+    }
+    if (recording.datasets.empty()) return false;
+
+    recording.ends.back() = true;
+    return true;
+}
+
+void loadRecordings(const Options& options, std::vector<std::string>& labels, std::vector<Recording>& recordings) {
+    std::vector<std::filesystem::path> files;
+    for (const std::string& path : options.paths) {
+        if (std::filesystem::is_directory(path)) {
+            for (const auto& entry : std::filesystem::directory_iterator(path)) {
+                if (entry.is_regular_file()) files.push_back(entry.path());
+            }
+        } else {
+            files.push_back(path);
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const std::filesystem::path& file : files) {
+        bool raw = false;
+        std::string label = recordingLabel(file, raw);
+        if (label.empty()) continue;
+
+        Recording recording;
+        if (loadRecording(file, labelIndex(labels, label), raw, recording)) {
+            recordings.push_back(recording);
+        } else {
+            fprintf(stderr, "skipping %s: no left sensor data\n", file.string().c_str());
+        }
+    }
+}
+
+/**
+ * @brief   streams one recording like the left acquisition task: push() per dataset,
+ *          finish() when the gesture window ends
+ *
+ * The first match is the recording's result, any after it are counted as extra.
+ *
+ * @returns none, adds to tally
+ */
+void matchRecording(TemplateRecognizer& recognizer, const Recording& recording, int repeat, Tally& tally) {
+    int result = _OUTCOME_NONE;
+    uint32_t matches = 0;
+
+    for (int r = 0; r < repeat; r++) {
+        std::vector<int> found;
+        recognizer.reset();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < recording.datasets.size(); i++) {
+            if (recognizer.push(recording.datasets[i].data())) found.push_back(recognizer.getMatch().gesture);
+            if (recording.ends[i] && recognizer.finish()) found.push_back(recognizer.getMatch().gesture);
+        }
+        tally.stream_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        tally.datasets += recording.datasets.size();
+
+        if (r == 0) {
+            if (!found.empty()) result = found[0];
+            matches = (uint32_t)found.size();
+        }
+    }
+
+    tally.recordings[recording.label]++;
+    tally.confusion[recording.label][result]++;
+    if (matches > 1) tally.extra += matches - 1;
+}
+
+double percent(uint32_t part, uint32_t whole) {
+    return whole > 0 ? 100.0 * part / whole : 0.0;
+}
+
+void printConfusion(const Tally& tally, const std::vector<std::string>& labels) {
+    printf("\n%-14s %5s", "class", "n");
+    for (const char* outcome : _OUTCOME_NAMES) printf(" %7s", outcome);
+    printf(" %8s\n", "correct");
+
+    for (size_t label = 0; label < labels.size(); label++) {
+        if (tally.recordings[label] == 0) continue;
+
+        printf("%-14s %5u", labels[label].c_str(), tally.recordings[label]);
+        for (uint32_t count : tally.confusion[label]) printf(" %7u", count);
+
+        int expected = label < (size_t)GestureClassifier::CLASSES ? (int)label : _OUTCOME_NONE;
+        printf(" %7.1f%%\n", percent(tally.confusion[label][expected], tally.recordings[label]));
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            options.repeat = std::max(1, atoi(argv[++i]));
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            options.paths.push_back(argv[i]);
+        }
+    }
+    if (options.paths.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Gesture classes keep their CustomGesture index, anything else is expected to match nothing
+    std::vector<std::string> labels;
+    for (int c = 0; c < GestureClassifier::CLASSES; c++) labels.push_back(GestureClassifier::getLabel(c));
+
+    std::vector<Recording> recordings;
+    loadRecordings(options, labels, recordings);
+    if (recordings.empty()) {
+        fprintf(stderr, "no <label>_<n>.csv or <label>_<n>_raw.csv recordings found\n");
+        return 1;
+    }
+
+    int cells = TemplateRecognizer::getCellsPerStep();
+    printf("%zu recordings, %d templates, %d DTW cells per step, a step every %d datasets, band %d\n",
+           recordings.size(), GESTURE_TEMPLATE_COUNT, cells, GESTURE_TEMPLATE_DECIMATION, GESTURE_TEMPLATE_BAND);
+    if (!TemplateRecognizer::hasTemplates()) {
+        printf("gesture_templates_data.h has no templates: push() returns at once and nothing matches,\n"
+               "run serial_listening/export_gesture_templates.py on the recordings and rebuild\n");
+    }
+
+    Tally tally;
+    tally.confusion.resize(labels.size(), std::array<uint32_t, _OUTCOMES>{});
+    tally.recordings.resize(labels.size(), 0);
+
+    TemplateRecognizer recognizer;
+    for (const Recording& recording : recordings) matchRecording(recognizer, recording, options.repeat, tally);
+
+    printConfusion(tally, labels);
+
+    uint32_t gestures = 0;
+    uint32_t correct = 0;
+    uint32_t others = 0;
+    uint32_t false_matches = 0;
+    for (size_t label = 0; label < labels.size(); label++) {
+        if (label < (size_t)GestureClassifier::CLASSES) {
+            gestures += tally.recordings[label];
+            correct += tally.confusion[label][label];
+        } else {
+            others += tally.recordings[label];
+            false_matches += tally.recordings[label] - tally.confusion[label][_OUTCOME_NONE];
+        }
+    }
+
+    printf("\naccuracy: %u/%u gesture recordings (%.1f%%)", correct, gestures, percent(correct, gestures));
+    if (others > 0) {
+        printf(", false matches: %u/%u other recordings (%.1f%%)", false_matches, others,
+               percent(false_matches, others));
+    }
+    printf(", %u extra matches\n", tally.extra);
+
+    double ns_per_dataset = tally.datasets > 0 ? (double)tally.stream_ns / tally.datasets : 0.0;
+    double ns_per_step = ns_per_dataset * GESTURE_TEMPLATE_DECIMATION;
+    printf("push(): %.1f ns per dataset, %.1f ns per DTW step, %.2f ns per cell over %llu datasets\n",
+           ns_per_dataset, ns_per_step, cells > 0 ? ns_per_step / cells : 0.0,
+           (unsigned long long)tally.datasets);
+    return 0;
+}
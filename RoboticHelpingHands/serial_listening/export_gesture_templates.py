@@ -0,0 +1,249 @@
+import argparse
+import os
+import sys
+import time
+
+import numpy as np
+
+from train_gesture_model import LABELS, DEFAULT_DATA_DIR, load_recordings, split
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_HEADER = os.path.join(HERE, '..', 'src', 'gesture_templates_data.h')
+
+# must match TemplateRecognizer in src/gesture_templates.h
+MAX_TEMPLATES = 18
+MAX_LENGTH = 32
+INFINITE = 0xFFFF
+SIGNAL_FLOOR = 10 # per dataset and channel
+
+
+def to_feature(u, d, l, r, datasets=1):
+    """same integer ratios as TemplateRecognizer::toFeature(), C division truncates toward zero"""
+    def ratio(a, b):
+        if a + b < 2 * SIGNAL_FLOOR * datasets:
+            return 0
+        q = abs(a - b) * 64 // (a + b)
+        return q if a >= b else -q
+    return (ratio(u, d), ratio(l, r))
+
+
+def trace(window):
+    """feature sequence of a recording, only rows where the FIFO had data"""
+    return [to_feature(*row[1:5]) for row in window.tolist() if sum(row[1:5]) > 0]
+
+
+def resample(features, length):
+    if len(features) <= length:
+        return list(features)
+    picks = np.rint(np.linspace(0, len(features) - 1, length)).astype(int)
+    return [features[i] for i in picks]
+
+
+class Recognizer:
+    """line for line port of TemplateRecognizer::step()/report()/finish() with decimation 1"""
+
+    def __init__(self, templates, band):
+        self.templates = templates # list of (class, features, threshold)
+        self.band = band
+        self.step_count = 0
+        self.reset()
+
+    def reset(self):
+        self.distance = [[INFINITE] * (len(t[1]) + 1) for t in self.templates]
+        self.start = [[0] * (len(t[1]) + 1) for t in self.templates]
+        self.best = [INFINITE] * len(self.templates)
+        self.best_end = [0] * len(self.templates)
+
+    def step(self, x):
+        step = self.step_count & 0xFFFF
+        confirmed = [False] * len(self.templates)
+        for k, (_, pattern, threshold) in enumerate(self.templates):
+            dist, start = self.distance[k], self.start[k]
+            diagonal, diagonal_start = 0, step
+            left, left_start = 0, step
+            for j in range(1, len(pattern) + 1):
+                up, up_start = dist[j], start[j]
+                best, best_start = diagonal, diagonal_start
+                if up < best:
+                    best, best_start = up, up_start
+                if left < best:
+                    best, best_start = left, left_start
+
+                distance = INFINITE
+                if best != INFINITE:
+                    cost = abs(x[0] - pattern[j - 1][0]) + abs(x[1] - pattern[j - 1][1])
+                    distance = min(best + cost, INFINITE)
+                    span = ((step - best_start) & 0xFFFF) + 1
+                    if abs(span - j) > self.band:
+                        distance = INFINITE
+
+                diagonal, diagonal_start = up, up_start
+                dist[j], start[j] = distance, best_start
+                left, left_start = distance, best_start
+
+            if self.best[k] != INFINITE:
+                confirmed[k] = True
+                for j in range(1, len(pattern) + 1):
+                    delta = (start[j] - self.best_end[k]) & 0xFFFF
+                    overlaps = delta == 0 or delta >= 0x8000
+                    if dist[j] < self.best[k] and overlaps:
+                        confirmed[k] = False
+                        break
+
+            end_distance = dist[len(pattern)]
+            if end_distance <= threshold and end_distance < self.best[k]:
+                self.best[k] = end_distance
+                self.best_end[k] = step
+
+        self.step_count += 1
+        return self.report(confirmed) if any(confirmed) else None
+
+    def report(self, confirmed=None):
+        best = -1
+        for k, (_, pattern, _) in enumerate(self.templates):
+            if self.best[k] == INFINITE or (confirmed is not None and not confirmed[k]):
+                continue
+            if best < 0 or self.best[k] * len(self.templates[best][1]) < self.best[best] * len(pattern):
+                best = k
+        if best < 0:
+            return None
+        match = (self.templates[best][0], self.best[best] // len(self.templates[best][1]))
+        self.reset()
+        return match
+
+    def finish(self):
+        match = self.report()
+        self.reset()
+        return match
+
+    def run(self, features):
+        """first match in a recording, as the firmware would report it at gesture end"""
+        self.reset()
+        for x in features:
+            match = self.step(x)
+            if match is not None:
+                self.reset()
+                return match
+        return self.finish()
+
+
+def pair_distance(template, features, band):
+    """best warping distance per template step of one template against one recording"""
+    match = Recognizer([(0, template, INFINITE - 1)], band).run(features)
+    return INFINITE if match is None else match[1]
+
+
+def choose_templates(train, per_class, band):
+    """medoids: the recordings closest to the rest of their class"""
+    chosen = []
+    for label in range(len(LABELS)):
+        traces = [resample(trace(w), MAX_LENGTH) for l, w in train if l == label]
+        traces = [t for t in traces if len(t) >= 3]
+        if not traces:
+            print(f'  {LABELS[label]}: no usable recordings, skipped')
+            continue
+        totals = [sum(pair_distance(a, b, band) for b in traces if b is not a) for a in traces]
+        for i in np.argsort(totals)[:per_class]:
+            chosen.append((label, traces[i]))
+    return chosen[:MAX_TEMPLATES]
+
+
+def choose_thresholds(templates, train, band):
+    """per template: between its own class's spread and the nearest other class"""
+    out = []
+    for label, pattern in templates:
+        own, other = [], []
+        for l, window in train:
+            features = trace(window)
+            if len(features) == 0:
+                continue
+            (own if l == label else other).append(pair_distance(pattern, features, band))
+        own_p90 = np.percentile(own, 90) if own else 0
+        other_p10 = np.percentile(other, 10) if other else INFINITE
+        per_step = (own_p90 + other_p10) / 2 if other_p10 > own_p90 else own_p90
+        out.append((label, pattern, int(min(per_step * len(pattern), INFINITE - 1))))
+    return out
+
+
+def evaluate(name, recognizer, recordings):
+    labels, predicted = [], []
+    steps, elapsed = 0, 0.0
+    for label, window in recordings:
+        features = trace(window)
+        start = time.perf_counter()
+        match = recognizer.run(features)
+        elapsed += time.perf_counter() - start
+        steps += max(len(features), 1)
+        labels.append(label)
+        predicted.append(-1 if match is None else match[0])
+
+    labels, predicted = np.array(labels), np.array(predicted)
+    correct = (labels == predicted).sum()
+    print(f'{name}: {correct}/{len(labels)} correct ({100.0 * correct / max(len(labels), 1):.1f}%), '
+          f'{(predicted == -1).sum()} rejected, {1e6 * elapsed / max(steps, 1):.0f} us per step in Python')
+    print('  confusion (rows = recorded, cols = matched, last col = rejected)')
+    for i, label in enumerate(LABELS):
+        row = [int(((labels == i) & (predicted == j)).sum()) for j in range(len(LABELS))]
+        row.append(int(((labels == i) & (predicted == -1)).sum()))
+        print(f'  {label:>14} ' + ' '.join(f'{v:3d}' for v in row))
+
+
+def write_header(path, templates, decimation, band, summary):
+    count = len(templates)
+    with open(path, 'w') as file:
+        file.write('#ifndef GESTURE_TEMPLATES_DATA_H\n#define GESTURE_TEMPLATES_DATA_H\n\n')
+        file.write('// Generated by serial_listening/export_gesture_templates.py, do not edit by hand.\n')
+        file.write(f'// {summary}\n\n')
+        file.write('#include <stdint.h>\n\n')
+        file.write(f'#define GESTURE_TEMPLATE_COUNT {count}\n')
+        file.write(f'#define GESTURE_TEMPLATE_DECIMATION {decimation}    // FIFO datasets per template step\n')
+        file.write(f'#define GESTURE_TEMPLATE_BAND {band}           // steps a path may lead or lag the template\n\n')
+        file.write(f'static const uint8_t GESTURE_TEMPLATE_CLASS[{count}] = {{'
+                   + ', '.join(str(l) for l, _, _ in templates) + '};\n')
+        file.write(f'static const uint8_t GESTURE_TEMPLATE_LENGTH[{count}] = {{'
+                   + ', '.join(str(len(p)) for _, p, _ in templates) + '};\n')
+        file.write(f'static const uint16_t GESTURE_TEMPLATE_THRESHOLD[{count}] = {{'
+                   + ', '.join(str(t) for _, _, t in templates) + '};\n')
+        file.write(f'static const int8_t GESTURE_TEMPLATE_FEATURES[{count}][{MAX_LENGTH}][2] = {{\n')
+        for label, pattern, _ in templates:
+            padded = list(pattern) + [(0, 0)] * (MAX_LENGTH - len(pattern))
+            file.write(f'    {{ // {LABELS[label]}\n        '
+                       + ', '.join(f'{{{ud}, {lr}}}' for ud, lr in padded) + '\n    },\n')
+        file.write('};\n\n#endif\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='exports DTW gesture templates from recorded CSVs')
+    parser.add_argument('--data', default=DEFAULT_DATA_DIR, help='folder of <label>_<n>.csv recordings')
+    parser.add_argument('--out', default=DEFAULT_HEADER, help='generated templates header')
+    parser.add_argument('--per-class', type=int, default=3, help='templates kept per gesture')
+    parser.add_argument('--band', type=int, default=6, help='steps a path may lead or lag the template')
+    parser.add_argument('--decimation', type=int, default=15,
+                        help='live FIFO datasets per recorded row; about 15 at the default GWTIME_2_8MS, '
+                             '1 if the recordings are at the native FIFO rate')
+    parser.add_argument('--test-every', type=int, default=5, help='hold out every Nth recording per class')
+    parser.add_argument('--dry-run', action='store_true', help='evaluate only, leave the header alone')
+    args = parser.parse_args()
+
+    recordings = load_recordings(args.data)
+    if len(recordings) == 0:
+        print(f'--- No recordings found in {args.data} ---')
+        sys.exit(1)
+
+    train, test = split(recordings, args.test_every)
+    templates = choose_thresholds(choose_templates(train, args.per_class, args.band), train, args.band)
+    recognizer = Recognizer(templates, args.band)
+
+    evaluate('train', recognizer, train)
+    evaluate('test', recognizer, test)
+    print(f'{len(templates)} templates, {sum(len(p) for _, p, _ in templates)} DTW cells per step, '
+          f'{len(templates) * (MAX_LENGTH + 1) * 4} B of columns')
+
+    if not args.dry_run:
+        summary = f'{len(train)} train / {len(test)} test recordings, {args.per_class} per class'
+        write_header(args.out, templates, args.decimation, args.band, summary)
+        print(f'--- Wrote {args.out} ---')
+
+
+if __name__ == '__main__':
+    main()
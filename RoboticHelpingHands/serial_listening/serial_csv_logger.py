@@ -1,68 +1,240 @@
-import serial
-import time
-import sys
+import argparse
 import csv
+import glob
+import os
+import struct
+import sys
+import time
 
-SERIAL_PORT = 'COM3'
-BAUD_RATE = 115200
-
-raw_data_filename = ""
-raw_data = []
-reading_raw_data = False
-count = 1
- 
-try:
-    ser = serial.Serial(SERIAL_PORT, BAUD_RATE, timeout=0.01)
-    print(f'--- Python connected to {SERIAL_PORT} at {BAUD_RATE} baud ---')
-    time.sleep(2)
-except serial.SerialException as e:
-    print(f'--- Error opening serial port: {e} ---')
-    sys.exit(1)
-
-try:  
-    while True:
-        # reads all available data immediately without blocking (prior attempt)
-        if ser.in_waiting > 0:
-            try:
-                line = ser.readline().decode().strip()
-                
-                if line:
-                    print(line)
-                    
-                    if not reading_raw_data:
-                        if "Now recording gesture" in line: # initializes gesture .csv file name
-                            raw_data_filename = line[line.index('[') + 1: line.index(']')] + f'_{count}.csv'
-                        if "proximity" in line: # prepares to record data from serial
-                            raw_data.append(line.split(','))
-                            reading_raw_data = True
-                        if "Press ~ to " in line: # toggles recording from python input
-                            user_input = input()
-                            ser.write(user_input.encode())
-                            ser.flush()                           
+import serial
+
+# must match CaptureStream in src/capture_stream.h
+SYNC = b'\xa5\x5a'
+HEADER = struct.Struct('<BBHIB') # type, sensor, sequence, timestamp us, payload length
+FRAME_LOG, FRAME_SESSION_START, FRAME_FIFO, FRAME_SESSION_END = range(4)
+FLAG_FIFO_FULL = 0x01
+FIFO_HEADER = struct.Struct('<BBH') # proximity, flags, dataset period us
+SENSOR_NAMES = ['left', 'right']
+
+ROW_US = 50000 # training CSV rows, 20 Hz like the old text capture and the classifier window
+TRAINING_SENSOR = 0 # custom gestures are read from the left hand
+
+
+def make_crc_table():
+    table = []
+    for byte in range(256):
+        crc = byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        table.append(crc & 0xFFFF)
+    return table
+
+
+CRC_TABLE = make_crc_table()
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, same as CaptureStream::crc16()"""
+    crc = 0xFFFF
+    for byte in data:
+        crc = ((crc << 8) & 0xFFFF) ^ CRC_TABLE[(crc >> 8) ^ byte]
+    return crc
+
+
+class FrameParser:
+    """splits the byte stream into frames, resyncing on the sync word after noise or a bad CRC"""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.crc_errors = 0
+        self.skipped_bytes = 0
+
+    def feed(self, data):
+        self.buffer += data
+        frames = []
+        position = 0
+        while True:
+            start = self.buffer.find(SYNC, position)
+            if start < 0:
+                # keeps a trailing 0xA5 in case the 0x5A is still on the wire
+                keep = 1 if self.buffer.endswith(SYNC[:1]) else 0
+                self.skipped_bytes += len(self.buffer) - position - keep
+                position = len(self.buffer) - keep
+                break
+            self.skipped_bytes += start - position
+            if len(self.buffer) < start + 2 + HEADER.size:
+                position = start
+                break
+
+            frame_type, sensor, sequence, timestamp, length = HEADER.unpack_from(self.buffer, start + 2)
+            end = start + 2 + HEADER.size + length
+            if len(self.buffer) < end + 2:
+                position = start
+                break
+
+            body = bytes(self.buffer[start + 2:end])
+            if crc16(body) != self.buffer[end] | (self.buffer[end + 1] << 8):
+                self.crc_errors += 1
+                position = start + 1 # a sync word inside a corrupted frame is still worth trying
+                continue
+
+            frames.append((frame_type, sensor, sequence, timestamp, body[HEADER.size:]))
+            position = end + 2
+        del self.buffer[:position]
+        return frames
+
+
+class Session:
+    def __init__(self, label, timestamp):
+        self.label = label
+        self.start_us = timestamp
+        self.end_us = timestamp
+        self.frames = [] # (sensor, sequence, timestamp, proximity, flags, [(timestamp, dataset)])
+        self.missing = 0
+        self.device_sent = 0
+        self.device_dropped = 0
+
+    def add_fifo(self, sensor, sequence, timestamp, payload):
+        proximity, flags, period = FIFO_HEADER.unpack_from(payload)
+        data = payload[FIFO_HEADER.size:]
+        count = len(data) // 4
+        # the newest dataset was read at the frame time, each earlier one a period before it
+        datasets = [(timestamp - (count - 1 - i) * period, tuple(data[4 * i:4 * i + 4])) for i in range(count)]
+        self.frames.append((sensor, sequence, timestamp, proximity, flags, datasets))
+
+    def training_rows(self, sensor):
+        """20 Hz rows as the old capture printed them: newest proximity, first dataset in the row or zeros"""
+        count = max(1, round(((self.end_us - self.start_us) & 0xFFFFFFFF) / ROW_US))
+        rows = [None] * count
+        has_dataset = [False] * count
+
+        def row_of(timestamp):
+            elapsed = (timestamp - self.start_us) & 0xFFFFFFFF
+            return min(elapsed // ROW_US, count - 1) if elapsed < 0x80000000 else 0
+
+        for frame_sensor, _, timestamp, proximity, _, datasets in self.frames:
+            if frame_sensor != sensor:
+                continue
+            for dataset_time, dataset in datasets:
+                row = row_of(dataset_time)
+                if not has_dataset[row]:
+                    rows[row] = [proximity] + list(dataset)
+                    has_dataset[row] = True
+            row = row_of(timestamp)
+            if rows[row] is None:
+                rows[row] = [proximity, 0, 0, 0, 0]
+            rows[row][0] = proximity
+        last = [0, 0, 0, 0, 0]
+        for i in range(count):
+            if rows[i] is None:
+                rows[i] = [last[0], 0, 0, 0, 0]
+            last = rows[i]
+        return rows
+
+    def write(self, out_dir, number):
+        base = os.path.join(out_dir, f'{self.label}_{number}')
+        with open(base + '.csv', mode='w', newline='') as file:
+            writer = csv.writer(file)
+            writer.writerow(['proximity', 'up', 'down', 'left', 'right'])
+            writer.writerows(self.training_rows(TRAINING_SENSOR))
+
+        # every FIFO dataset of both sensors; the _raw suffix keeps the trainers off it
+        with open(base + '_raw.csv', mode='w', newline='') as file:
+            writer = csv.writer(file)
+            writer.writerow(['sensor', 'sequence', 'timestamp_us', 'proximity', 'fifo_full',
+                             'up', 'down', 'left', 'right'])
+            for sensor, sequence, timestamp, proximity, flags, datasets in self.frames:
+                full = 1 if flags & FLAG_FIFO_FULL else 0
+                for dataset_time, dataset in datasets or [(timestamp, ('', '', '', ''))]:
+                    writer.writerow([sensor, sequence, dataset_time & 0xFFFFFFFF, proximity, full] + list(dataset))
+        return base + '.csv'
+
+    def summary(self, parser):
+        seconds = max(((self.end_us - self.start_us) & 0xFFFFFFFF) / 1e6, 1e-6)
+        parts = []
+        for sensor, name in enumerate(SENSOR_NAMES):
+            frames = [f for f in self.frames if f[0] == sensor]
+            datasets = sum(len(f[5]) for f in frames)
+            full = sum(1 for f in frames if f[4] & FLAG_FIFO_FULL)
+            parts.append(f'{name}: {len(frames)} frames, {datasets} datasets ({datasets / seconds:.0f}/s), '
+                         f'{full} FIFO full')
+        parts.append(f'{self.missing} frames missing, device dropped {self.device_dropped} of '
+                     f'{self.device_sent + self.device_dropped}, {parser.crc_errors} CRC errors so far')
+        return '\n  '.join(parts)
+
+
+def next_number(out_dir, label):
+    taken = [0]
+    for path in glob.glob(os.path.join(out_dir, f'{label}_*.csv')):
+        number = os.path.basename(path)[len(label) + 1:-4]
+        if number.isdigit():
+            taken.append(int(number))
+    return max(taken) + 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description='records binary training captures from main.cpp.FORTRAINING')
+    parser.add_argument('--port', default='COM3', help='serial port of the ESP32')
+    parser.add_argument('--baud', type=int, default=921600, help='must match BAUD_RATE in the sketch')
+    parser.add_argument('--out', default='.', help='folder the <label>_<n>.csv sessions are written to')
+    args = parser.parse_args()
+
+    try:
+        ser = serial.Serial(args.port, args.baud, timeout=0.01)
+        print(f'--- Python connected to {args.port} at {args.baud} baud ---')
+        time.sleep(2)
+    except serial.SerialException as e:
+        print(f'--- Error opening serial port: {e} ---')
+        sys.exit(1)
+
+    frames = FrameParser()
+    session = None
+    expected = None
+
+    try:
+        while True:
+            # reads whatever is waiting in one go, the parser keeps partial frames
+            data = ser.read(max(1, ser.in_waiting))
+            for frame_type, sensor, sequence, timestamp, payload in frames.feed(data):
+                if expected is not None and sequence != expected:
+                    missing = (sequence - expected) & 0xFFFF
+                    if session is not None:
+                        session.missing += missing
                     else:
-                        if "Finished current recording." in line: # creates and write on gesture .csv
-                            with open(raw_data_filename, mode='w', newline='') as file:
-                                writer = csv.writer(file)
-                                writer.writerows(raw_data)
-                            
-                            raw_data_filename = ""
-                            raw_data.clear()
-                            reading_raw_data = False
-                            count += 1
-                        else: # adds list data to list raw_data
-                            raw_data.append(line.split(','))
-                            
-            except UnicodeDecodeError:
-                # skips invalid characters
-                pass
-    
-        time.sleep(0.001) # prevents CPU spinning?
-
-except KeyboardInterrupt:
-    print('--- Exited ---')
-except serial.SerialException as e:
-    print(f"Serial error: {e}")
-finally:
-    if ser.is_open:
-        ser.close()
-        print("Serial port closed.")
\ No newline at end of file
+                        print(f'--- {missing} frames missing ---')
+                expected = (sequence + 1) & 0xFFFF
+
+                if frame_type == FRAME_LOG:
+                    line = payload.decode(errors='replace')
+                    print(line)
+                    if "Press ~ to " in line: # toggles recording from python input
+                        user_input = input()
+                        ser.write(user_input.encode())
+                        ser.flush()
+
+                elif frame_type == FRAME_SESSION_START:
+                    session = Session(payload.decode(errors='replace'), timestamp)
+
+                elif frame_type == FRAME_FIFO and session is not None:
+                    session.add_fifo(sensor, sequence, timestamp, payload)
+                    session.end_us = timestamp
+
+                elif frame_type == FRAME_SESSION_END and session is not None:
+                    session.end_us = timestamp
+                    session.device_sent, session.device_dropped = struct.unpack('<II', payload[:8])
+                    path = session.write(args.out, next_number(args.out, session.label))
+                    print(f'--- Wrote {path} ---\n  {session.summary(frames)}')
+                    session = None
+
+    except KeyboardInterrupt:
+        print('--- Exited ---')
+    except serial.SerialException as e:
+        print(f"Serial error: {e}")
+    finally:
+        if ser.is_open:
+            ser.close()
+            print("Serial port closed.")
+
+
+if __name__ == '__main__':
+    main()
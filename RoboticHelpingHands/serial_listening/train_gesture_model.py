@@ -0,0 +1,255 @@
+import argparse
+import csv
+import glob
+import os
+import sys
+
+import numpy as np
+
+# must match CustomGesture in src/gesture_classifier.h
+LABELS = ['double_shake', 'double_tap', 'palm_down', 'palm_up', 'swipe_inward', 'swipe_outward']
+
+WINDOW_FRAMES = 40 # 2 s at 20 Hz, same as main.cpp.FORTRAINING
+FRAME_FEATURES = 5 # proximity,up,down,left,right
+INPUTS = WINDOW_FRAMES * FRAME_FEATURES
+HIDDEN = 32
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_DATA_DIR = os.path.join(HERE, '..', 'data')
+DEFAULT_HEADER = os.path.join(HERE, '..', 'src', 'gesture_model_data.h')
+
+
+def load_recordings(data_dir):
+    """reads <label>_<n>.csv files written by serial_csv_logger.py"""
+    recordings = []
+    for path in sorted(glob.glob(os.path.join(data_dir, '*.csv'))):
+        name = os.path.basename(path)[:-4]
+        label, _, number = name.rpartition('_')
+        if label not in LABELS:
+            continue
+
+        rows = []
+        with open(path, newline='') as file:
+            for row in csv.reader(file):
+                try:
+                    rows.append([int(v) for v in row[:FRAME_FEATURES]])
+                except ValueError:
+                    pass # header or a corrupted line
+
+        if len(rows) == 0:
+            continue
+        window = np.zeros((WINDOW_FRAMES, FRAME_FEATURES), dtype=np.int64)
+        rows = np.clip(np.array(rows[:WINDOW_FRAMES], dtype=np.int64), 0, 255)
+        window[:len(rows)] = rows
+        if len(rows) < WINDOW_FRAMES: # holds the last frame like the live window would
+            window[len(rows):] = rows[-1]
+        recordings.append((LABELS.index(label), int(number) if number.isdigit() else 0, window))
+    return recordings
+
+
+def split(recordings, test_every):
+    """every Nth recording of each class is held out, so no take is in both sets"""
+    train, test = [], []
+    seen = [0] * len(LABELS)
+    for label, _, window in recordings:
+        seen[label] += 1
+        (test if seen[label] % test_every == 0 else train).append((label, window))
+    return train, test
+
+
+def augment(windows, labels, copies, rng):
+    """time shifts and gain changes, the live window slides over the gesture"""
+    out_x, out_y = [windows], [labels]
+    for _ in range(copies):
+        shifted = np.empty_like(windows)
+        for i, window in enumerate(windows):
+            shift = rng.integers(-8, 9)
+            rolled = np.roll(window, shift, axis=0)
+            if shift > 0:
+                rolled[:shift] = window[0]
+            elif shift < 0:
+                rolled[shift:] = window[-1]
+            shifted[i] = rolled
+        gain = rng.uniform(0.8, 1.2, size=(len(windows), 1, FRAME_FEATURES))
+        out_x.append(np.clip(np.rint(shifted * gain), 0, 255).astype(np.int64))
+        out_y.append(labels)
+    return np.concatenate(out_x), np.concatenate(out_y)
+
+
+def train_float(x, y, epochs, rng):
+    """one hidden layer MLP, softmax cross entropy, plain numpy Adam"""
+    x = x.reshape(len(x), INPUTS) / 255.0
+    classes = len(LABELS)
+    params = {
+        'w1': rng.normal(0, np.sqrt(2.0 / INPUTS), (HIDDEN, INPUTS)),
+        'b1': np.zeros(HIDDEN),
+        'w2': rng.normal(0, np.sqrt(2.0 / HIDDEN), (classes, HIDDEN)),
+        'b2': np.zeros(classes),
+    }
+    moments = {k: (np.zeros_like(v), np.zeros_like(v)) for k, v in params.items()}
+    onehot = np.eye(classes)[y]
+    rate, decay, batch = 0.01, 1e-4, 32
+
+    step = 0
+    for epoch in range(epochs):
+        order = rng.permutation(len(x))
+        for start in range(0, len(x), batch):
+            idx = order[start:start + batch]
+            xb, yb = x[idx], onehot[idx]
+
+            pre = xb @ params['w1'].T + params['b1']
+            hidden = np.maximum(pre, 0)
+            logits = hidden @ params['w2'].T + params['b2']
+            logits -= logits.max(axis=1, keepdims=True)
+            prob = np.exp(logits)
+            prob /= prob.sum(axis=1, keepdims=True)
+
+            grad_logits = (prob - yb) / len(idx)
+            grad_hidden = (grad_logits @ params['w2']) * (pre > 0)
+            grads = {
+                'w2': grad_logits.T @ hidden + decay * params['w2'],
+                'b2': grad_logits.sum(axis=0),
+                'w1': grad_hidden.T @ xb + decay * params['w1'],
+                'b1': grad_hidden.sum(axis=0),
+            }
+
+            step += 1
+            for k in params:
+                m, v = moments[k]
+                m[:] = 0.9 * m + 0.1 * grads[k]
+                v[:] = 0.999 * v + 0.001 * grads[k] ** 2
+                m_hat = m / (1 - 0.9 ** step)
+                v_hat = v / (1 - 0.999 ** step)
+                params[k] -= rate * m_hat / (np.sqrt(v_hat) + 1e-8)
+    return params
+
+
+def quantise(params, calibration_x):
+    """int8 weights, int32 biases, uint8 hidden activations with a fixed point rescale"""
+    s_w1 = np.abs(params['w1']).max() / 127.0
+    s_acc1 = s_w1 / 255.0 # inputs stay raw uint8, x = v / 255
+    w1 = np.clip(np.rint(params['w1'] / s_w1), -127, 127).astype(np.int64)
+    b1 = np.rint(params['b1'] / s_acc1).astype(np.int64)
+
+    # hidden scale from the largest activation seen on the training set
+    acc = calibration_x.reshape(len(calibration_x), INPUTS) @ w1.T + b1
+    s_h = max(float(acc.max()) * s_acc1, 1e-6) / 255.0
+
+    # acc * multiplier >> shift == acc * s_acc1 / s_h, multiplier kept in [2^30, 2^31)
+    ratio = s_acc1 / s_h
+    shift = 1
+    while ratio * (1 << shift) < (1 << 30):
+        shift += 1
+    multiplier = min(int(round(ratio * (1 << shift))), (1 << 31) - 1)
+
+    s_w2 = np.abs(params['w2']).max() / 127.0
+    w2 = np.clip(np.rint(params['w2'] / s_w2), -127, 127).astype(np.int64)
+    b2 = np.rint(params['b2'] / (s_w2 * s_h)).astype(np.int64)
+
+    return {
+        'w1': w1, 'b1': b1, 'multiplier': multiplier, 'shift': shift,
+        'w2': w2, 'b2': b2, 'output_scale': s_w2 * s_h,
+    }
+
+
+def run_quantised(model, windows):
+    """same integer arithmetic as GestureClassifier::classify()"""
+    x = windows.reshape(len(windows), INPUTS).astype(np.int64)
+    acc = x @ model['w1'].T + model['b1']
+    scaled = (acc * model['multiplier'] + (1 << (model['shift'] - 1))) >> model['shift']
+    hidden = np.clip(scaled, 0, 255)
+    logits = hidden @ model['w2'].T + model['b2']
+
+    best = logits.argmax(axis=1)
+    relative = (logits - logits.max(axis=1, keepdims=True)).astype(np.float32) * np.float32(model['output_scale'])
+    confidence = np.floor(100.0 / np.exp(relative).sum(axis=1) + 0.5).astype(np.int64)
+    return best, confidence
+
+
+def report(name, labels, predicted, accepted):
+    correct = (predicted == labels) & accepted
+    print(f'{name}: {correct.sum()}/{len(labels)} correct ({100.0 * correct.mean():.1f}%), '
+          f'{(~accepted).sum()} rejected')
+    print('  confusion (rows = recorded, cols = predicted, last col = rejected)')
+    for i, label in enumerate(LABELS):
+        row = [int(((labels == i) & (predicted == j) & accepted).sum()) for j in range(len(LABELS))]
+        row.append(int(((labels == i) & ~accepted).sum()))
+        print(f'  {label:>14} ' + ' '.join(f'{v:3d}' for v in row))
+
+
+def c_array(values, per_line=16):
+    values = [str(int(v)) for v in np.asarray(values).ravel()]
+    lines = [', '.join(values[i:i + per_line]) for i in range(0, len(values), per_line)]
+    return '\n    ' + ',\n    '.join(lines) + '\n'
+
+
+def write_header(path, model, min_proximity, min_confidence, summary):
+    with open(path, 'w') as file:
+        file.write('#ifndef GESTURE_MODEL_DATA_H\n#define GESTURE_MODEL_DATA_H\n\n')
+        file.write('// Generated by serial_listening/train_gesture_model.py, do not edit by hand.\n')
+        file.write(f'// {summary}\n\n')
+        file.write('#include <stdint.h>\n\n#define GESTURE_MODEL_TRAINED 1\n\n')
+        file.write(f'static const int8_t GESTURE_MODEL_W1[{HIDDEN}][{INPUTS}] = {{{c_array(model["w1"])}}};\n')
+        file.write(f'static const int32_t GESTURE_MODEL_B1[{HIDDEN}] = {{{c_array(model["b1"])}}};\n')
+        file.write(f'static const int32_t GESTURE_MODEL_M1_MULTIPLIER = {model["multiplier"]};\n')
+        file.write(f'static const int GESTURE_MODEL_M1_SHIFT = {model["shift"]};\n')
+        file.write(f'static const int8_t GESTURE_MODEL_W2[{len(LABELS)}][{HIDDEN}] = {{{c_array(model["w2"])}}};\n')
+        file.write(f'static const int32_t GESTURE_MODEL_B2[{len(LABELS)}] = {{{c_array(model["b2"])}}};\n')
+        file.write(f'static const float GESTURE_MODEL_OUTPUT_SCALE = {model["output_scale"]:.9g}f;\n')
+        file.write(f'static const uint8_t GESTURE_MODEL_MIN_PROXIMITY = {min_proximity};\n')
+        file.write(f'static const uint8_t GESTURE_MODEL_MIN_CONFIDENCE = {min_confidence};\n\n')
+        file.write('#endif\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='trains the on-device gesture classifier from recorded CSVs')
+    parser.add_argument('--data', default=DEFAULT_DATA_DIR, help='folder of <label>_<n>.csv recordings')
+    parser.add_argument('--out', default=DEFAULT_HEADER, help='generated weights header')
+    parser.add_argument('--epochs', type=int, default=150)
+    parser.add_argument('--augment', type=int, default=8, help='shifted/scaled copies per training window')
+    parser.add_argument('--test-every', type=int, default=5, help='hold out every Nth recording per class')
+    parser.add_argument('--min-confidence', type=int, default=80, help='percent, below this nothing fires')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--dry-run', action='store_true', help='evaluate only, leave the header alone')
+    args = parser.parse_args()
+
+    recordings = load_recordings(args.data)
+    if len(recordings) == 0:
+        print(f'--- No recordings found in {args.data} ---')
+        sys.exit(1)
+
+    counts = [sum(1 for r in recordings if r[0] == i) for i in range(len(LABELS))]
+    print('recordings: ' + ', '.join(f'{l}={c}' for l, c in zip(LABELS, counts)))
+
+    train, test = split(recordings, args.test_every)
+    rng = np.random.default_rng(args.seed)
+    train_x = np.array([w for _, w in train])
+    train_y = np.array([l for l, _ in train])
+    aug_x, aug_y = augment(train_x, train_y, args.augment, rng)
+
+    params = train_float(aug_x, aug_y, args.epochs, rng)
+    model = quantise(params, aug_x)
+
+    # a real gesture brings the hand in, half the weakest training peak keeps them all
+    peaks = train_x[:, :, 0].max(axis=1)
+    min_proximity = int(max(1, np.percentile(peaks, 2) // 2))
+
+    for name, windows, labels in (('train', train_x, train_y),
+                                  ('test', np.array([w for _, w in test]), np.array([l for l, _ in test]))):
+        if len(windows) == 0:
+            continue
+        predicted, confidence = run_quantised(model, windows)
+        accepted = (confidence >= args.min_confidence) & (windows[:, :, 0].max(axis=1) >= min_proximity)
+        report(name, labels, predicted, accepted)
+
+    macs = HIDDEN * INPUTS + len(LABELS) * HIDDEN
+    print(f'{macs} MACs and {macs} B of int8 weights per window, min proximity {min_proximity}')
+
+    if not args.dry_run:
+        summary = f'{len(train)} train / {len(test)} test recordings, seed {args.seed}'
+        write_header(args.out, model, min_proximity, args.min_confidence, summary)
+        print(f'--- Wrote {args.out} ---')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,174 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// Host stand-in for the Arduino-ESP32 core. Time is the simulation's virtual clock,
+// Serial prints to stdout and reads what the sim script types
+
+#ifndef ARDUINO_ARCH_ESP32
+#define ARDUINO_ARCH_ESP32 1
+#endif
+#ifndef ESP32
+#define ESP32 1
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+
+using std::abs;
+using std::max;
+using std::min;
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define PROGMEM
+#define F(string_literal) (string_literal)
+
+#define PI          3.1415926535897932384626433832795
+#define HALF_PI     1.5707963267948966192313216916398
+#define TWO_PI      6.283185307179586476925286766559
+#define DEG_TO_RAD  0.017453292519943295769236907684886
+#define RAD_TO_DEG  57.295779513082320876798154814105
+
+#define LOW             0x0
+#define HIGH            0x1
+
+#define INPUT           0x01
+#define OUTPUT          0x03
+#define PULLUP          0x04
+#define INPUT_PULLUP    0x05
+#define PULLDOWN        0x08
+#define INPUT_PULLDOWN  0x09
+
+#define RISING          0x01
+#define FALLING         0x02
+#define CHANGE          0x03
+#define ONLOW           0x04
+#define ONHIGH          0x05
+#define ONLOW_WE        0x0C
+#define ONHIGH_WE       0x0D
+
+#define digitalPinToInterrupt(pin)  (pin)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+template<class T, class L, class H>
+auto constrain(T value, L low, H high) -> decltype(value + low) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+long map(long value, long in_min, long in_max, long out_min, long out_max);
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+double ledcSetup(uint8_t channel, double frequency, uint8_t resolution_bits);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcDetachPin(uint8_t pin);
+void ledcWrite(uint8_t channel, uint32_t duty);
+uint32_t ledcRead(uint8_t channel);
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str) { return str == NULL ? 0 : write((const uint8_t*)str, strlen(str)); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    size_t print(const char* str) { return write(str); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int value, int base = 10) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = 10) { return print((unsigned long)value, base); }
+    size_t print(long value, int base = 10);
+    size_t print(unsigned long value, int base = 10);
+    size_t print(double value, int digits = 2);
+
+    size_t println() { return write("\r\n"); }
+    template<class T>
+    size_t println(T value) { size_t n = print(value); return n + println(); }
+    template<class T>
+    size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+    void setTimeout(unsigned long timeout_ms) { _timeoutMs = timeout_ms; }
+
+protected:
+    unsigned long _timeoutMs = 1000;
+};
+
+/**
+ * @brief   UART 0: writes go to stdout a line at a time with the virtual time in front,
+ *          input comes from the sim script's type commands
+ */
+class HardwareSerial : public Stream {
+public:
+    typedef std::function<void(void)> OnReceiveCb;
+
+    void begin(unsigned long baud, uint32_t config = 0, int8_t rx_pin = -1, int8_t tx_pin = -1) {}
+    void end() {}
+    void onReceive(OnReceiveCb function, bool only_on_timeout = false);
+    void setRxBufferSize(size_t size) {}
+    void setTxBufferSize(size_t size) {}
+    size_t availableForWrite() { return 128; }
+    operator bool() const { return true; }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(uint8_t* buffer, size_t length);
+    void flush() override;
+};
+
+extern HardwareSerial Serial;
+
+/**
+ * @brief   chip info; the cycle counter runs at 240 MHz over virtual time plus the
+ *          calling task's host CPU time, so it times simulated waits and real code alike
+ */
+class EspClass {
+public:
+    uint32_t getCycleCount();
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint32_t getHeapSize() { return 327680; }
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    void restart();
+};
+
+extern EspClass ESP;
+
+#endif
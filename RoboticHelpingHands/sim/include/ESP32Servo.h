@@ -0,0 +1,38 @@
+#ifndef SIM_ESP32SERVO_H
+#define SIM_ESP32SERVO_H
+
+#include <Arduino.h>
+
+/**
+ * @brief   LEDC timer bookkeeping of the ESP32Servo library, nothing to allocate on a host
+ */
+class ESP32PWM {
+public:
+    static void allocateTimer(int timer) {}
+};
+
+/**
+ * @brief   servo output whose pulses are logged by the sim instead of driven on a pin
+ */
+class Servo {
+public:
+    Servo();
+
+    int attach(int pin, int min_us = 544, int max_us = 2400);
+    void detach();
+    bool attached() const { return _pin >= 0; }
+    void setPeriodHertz(int hertz) { _periodHz = hertz; }
+    void write(int value);
+    void writeMicroseconds(int pulse_us);
+    int read() const;
+    int readMicroseconds() const { return _pulseUs; }
+
+private:
+    int _pin;
+    int _minUs;
+    int _maxUs;
+    int _pulseUs;
+    int _periodHz;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief   NVS namespace kept in memory, saved to the sim's --nvs file if one is given
+ */
+class Preferences {
+public:
+    Preferences();
+
+    bool begin(const char* name, bool read_only = false, const char* partition = NULL);
+    void end();
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+    size_t putBytes(const char* key, const void* value, size_t length);
+    size_t getBytes(const char* key, void* buffer, size_t length);
+    size_t getBytesLength(const char* key);
+    size_t putUInt(const char* key, uint32_t value);
+    uint32_t getUInt(const char* key, uint32_t default_value = 0);
+
+private:
+    const char* _name;
+    bool _readOnly;
+};
+
+#endif
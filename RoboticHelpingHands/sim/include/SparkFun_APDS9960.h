@@ -0,0 +1,2 @@
+// The firmware's patched driver, the same file that replaces the library's header on the ESP32
+#include "../../SparkFun_APDS9960.hCUSTOM"
@@ -0,0 +1,63 @@
+#ifndef SIM_WIRE_H
+#define SIM_WIRE_H
+
+#include <Arduino.h>
+
+#define I2C_BUFFER_LENGTH 128
+
+/**
+ * @brief   I2C controller talking to the sim devices attached to its bus number
+ *
+ * Every transaction blocks the calling task for as long as its bytes take at the
+ * bus clock, as the ESP-IDF driver does while the hardware shifts them out.
+ */
+class TwoWire : public Stream {
+public:
+    TwoWire(uint8_t bus_num);
+
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+    bool end();
+    bool setClock(uint32_t frequency);
+    uint32_t getClock() const { return _frequency; }
+    void setTimeOut(uint16_t timeout_ms) { _timeoutMs = timeout_ms; }
+    void setTimeout(uint16_t timeout_ms) { _timeoutMs = timeout_ms; }
+
+    void beginTransmission(uint16_t address);
+    void beginTransmission(uint8_t address) { beginTransmission((uint16_t)address); }
+    void beginTransmission(int address) { beginTransmission((uint16_t)address); }
+    uint8_t endTransmission(bool send_stop = true);
+
+    size_t requestFrom(uint16_t address, size_t size, bool send_stop = true);
+    uint8_t requestFrom(int address, int size) { return requestFrom((uint16_t)address, (size_t)size, true); }
+
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override;
+
+private:
+    uint8_t _busNum;
+    uint32_t _frequency;
+    uint16_t _address;
+    bool _transmitting;
+    uint8_t _txBuffer[I2C_BUFFER_LENGTH];
+    size_t _txLength;
+    uint8_t _rxBuffer[I2C_BUFFER_LENGTH];
+    size_t _rxLength;
+    size_t _rxIndex;
+
+    /**
+     * @brief   blocks the calling task for the bus time of a transfer
+     * @param[in]   bytes: data bytes after the address byte
+     * @returns none
+     */
+    void waitBusTime(size_t bytes);
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef SIM_ESP_PM_H
+#define SIM_ESP_PM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Like a framework built without CONFIG_PM_ENABLE: every call reports ESP_ERR_NOT_SUPPORTED
+
+typedef enum {
+    ESP_PM_CPU_FREQ_MAX = 0,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP
+} esp_pm_lock_type_t;
+
+struct esp_pm_lock;
+typedef esp_pm_lock* esp_pm_lock_handle_t;
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_esp32_t;
+
+esp_err_t esp_pm_configure(const void* config);
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char* name, esp_pm_lock_handle_t* handle);
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+// Host stand-in for the ESP-IDF FreeRTOS headers, backed by sim_kernel
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;
+
+#define pdTRUE                      1
+#define pdFALSE                     0
+#define pdPASS                      pdTRUE
+#define pdFAIL                      pdFALSE
+#define errQUEUE_FULL               0
+
+#define configTICK_RATE_HZ          1000
+#define configMAX_PRIORITIES        25
+#define configUSE_TRACE_FACILITY    1
+#define configGENERATE_RUN_TIME_STATS 1
+#define portNUM_PROCESSORS          2
+#define portTICK_PERIOD_MS          (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY               ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)           ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define pdTICKS_TO_MS(ticks)        ((uint32_t)(((uint64_t)(ticks) * 1000) / configTICK_RATE_HZ))
+
+// Only one simulated task runs at a time and nothing preempts it mid-statement,
+// so critical sections have nothing to exclude
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    {0, 0}
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux)     ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux)      ((void)(mux))
+#define taskENTER_CRITICAL(mux)         ((void)(mux))
+#define taskEXIT_CRITICAL(mux)          ((void)(mux))
+
+void simYieldFromIsr();
+#define portYIELD_FROM_ISR(...)     simYieldFromIsr()
+
+#define configASSERT(x)             do { if (!(x)) simAssertFailed(__FILE__, __LINE__); } while (0)
+void simAssertFailed(const char* file, int line);
+
+#endif
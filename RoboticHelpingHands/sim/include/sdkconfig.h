@@ -0,0 +1,11 @@
+#ifndef SIM_SDKCONFIG_H
+#define SIM_SDKCONFIG_H
+
+// Same choices as the stock Arduino-ESP32 core: no power management, no tickless idle
+
+#define CONFIG_IDF_TARGET_ESP32             1
+#define CONFIG_FREERTOS_HZ                  1000
+#define CONFIG_FREERTOS_UNICORE             0
+#define CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ   240
+
+#endif
@@ -0,0 +1,218 @@
+#include "sim_apds9960.h"
+#include <string.h>
+#include "sim_hal.h"
+#include "sim_kernel.h"
+
+namespace {
+
+const uint8_t _REG_ENABLE = 0x80;
+const uint8_t _REG_ID = 0x92;
+const uint8_t _REG_STATUS = 0x93;
+const uint8_t _REG_PDATA = 0x9C;
+const uint8_t _REG_GPENTH = 0xA0;
+const uint8_t _REG_GEXTH = 0xA1;
+const uint8_t _REG_GCONF1 = 0xA2;
+const uint8_t _REG_GCONF2 = 0xA3;
+const uint8_t _REG_GCONF4 = 0xAB;
+const uint8_t _REG_GFLVL = 0xAE;
+const uint8_t _REG_GSTATUS = 0xAF;
+const uint8_t _REG_GFIFO_U = 0xFC;
+
+const uint8_t _ENABLE_PON = 0x01;
+const uint8_t _ENABLE_PEN = 0x04;
+const uint8_t _ENABLE_GEN = 0x40;
+
+const uint8_t _GCONF4_GMODE = 0x01;
+const uint8_t _GCONF4_GIEN = 0x02;
+const uint8_t _GCONF4_FIFO_CLR = 0x04;
+
+const uint8_t _STATUS_PVALID = 0x02;
+const uint8_t _STATUS_GINT = 0x04;
+
+const uint8_t _GSTATUS_GVALID = 0x01;
+const uint8_t _GSTATUS_GFOV = 0x02;
+
+const uint8_t _CHIP_ID = 0xAB;
+
+// GCONF2 GWTIME codes, in microseconds
+const uint32_t _GWTIME_US[8] = {0, 2800, 5600, 8400, 14000, 22400, 30800, 39200};
+
+// GCONF1 GFIFOTH and GEXPERS codes
+const uint8_t _FIFO_THRESHOLD[4] = {1, 4, 8, 16};
+const uint8_t _EXIT_PERSISTENCE[4] = {1, 2, 4, 7};
+
+}
+
+SimApds9960::SimApds9960(const SimHandTrack* track, uint8_t int_pin) :
+    _track(track),
+    _intPin(int_pin),
+    _registers{},
+    _pointer(0),
+    _fifo{},
+    _fifoHead(0),
+    _fifoLevel(0),
+    _fifoOverflow(false),
+    _gestureMode(false),
+    _valid(false),
+    _interrupt(false),
+    _belowExit(0),
+    _intLow(false),
+    _datasets(0),
+    _windows(0),
+    _overflows(0)
+{}
+
+void SimApds9960::start() {
+    SimKernel::instance().schedule(SimKernel::instance().now() + cycleUs(), [this]() { cycle(); });
+}
+
+void SimApds9960::write(const uint8_t* data, size_t length) {
+    if (length == 0) return;
+
+    // First byte sets the register pointer, the rest go to consecutive registers
+    _pointer = data[0];
+    for (size_t i = 1; i < length; i++) writeRegister(_pointer++, data[i]);
+}
+
+void SimApds9960::read(uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (_pointer < _REG_GFIFO_U) {
+            data[i] = readRegister(_pointer++);
+            continue;
+        }
+
+        // FIFO page: U, D, L, R of the oldest dataset, popped after R, then around again
+        uint8_t index = _pointer - _REG_GFIFO_U;
+        data[i] = _fifoLevel > 0 ? _fifo[_fifoHead][index] : 0;
+        if (index == 3) {
+            if (_fifoLevel > 0) {
+                _fifoHead = (_fifoHead + 1) % _FIFO_DEPTH;
+                _fifoLevel--;
+            }
+            _pointer = _REG_GFIFO_U;
+        } else {
+            _pointer++;
+        }
+    }
+
+    if (_fifoLevel == 0) {
+        _interrupt = false;
+        _fifoOverflow = false;
+    }
+    updateStatus();
+}
+
+void SimApds9960::cycle() {
+    SimKernel& kernel = SimKernel::instance();
+    kernel.schedule(kernel.now() + cycleUs(), [this]() { cycle(); });
+
+    uint8_t enable = _registers[_REG_ENABLE];
+    if ((enable & _ENABLE_PON) == 0) return;
+
+    SimHandSample sample = _track->sample(kernel.now());
+    if (!_gestureMode) _registers[_REG_PDATA] = sample.proximity;
+
+    if (!_gestureMode) {
+        bool entry = (enable & _ENABLE_GEN) && (enable & _ENABLE_PEN) &&
+                     sample.proximity >= _registers[_REG_GPENTH];
+        if (!entry) return;
+
+        _gestureMode = true;
+        _belowExit = 0;
+        _windows++;
+    }
+
+    if (_fifoLevel == _FIFO_DEPTH) {
+        _fifoOverflow = true;
+        _overflows++;
+    } else {
+        memcpy(_fifo[(_fifoHead + _fifoLevel) % _FIFO_DEPTH], sample.udlr, 4);
+        _fifoLevel++;
+        _datasets++;
+    }
+
+    uint8_t gconf1 = _registers[_REG_GCONF1];
+    if (_fifoLevel >= _FIFO_THRESHOLD[gconf1 >> 6]) {
+        _valid = true;
+        _interrupt = true;
+    }
+
+    uint8_t exit = _registers[_REG_GEXTH];
+    bool below = sample.udlr[0] < exit && sample.udlr[1] < exit && sample.udlr[2] < exit && sample.udlr[3] < exit;
+    _belowExit = below ? _belowExit + 1 : 0;
+    if (_belowExit >= _EXIT_PERSISTENCE[gconf1 & 0x03]) exitGestureMode();
+
+    updateStatus();
+}
+
+uint32_t SimApds9960::cycleUs() const {
+    return _PULSE_CYCLE_US + _GWTIME_US[_registers[_REG_GCONF2] & 0x07];
+}
+
+uint8_t SimApds9960::readRegister(uint8_t reg) {
+    switch (reg) {
+        case _REG_ID:
+            return _CHIP_ID;
+        case _REG_STATUS:
+            return _STATUS_PVALID | (_interrupt ? _STATUS_GINT : 0);
+        case _REG_GCONF4:
+            return (_registers[reg] & ~_GCONF4_GMODE) | (_gestureMode ? _GCONF4_GMODE : 0);
+        case _REG_GFLVL:
+            return _fifoLevel;
+        case _REG_GSTATUS:
+            return (_valid ? _GSTATUS_GVALID : 0) | (_fifoOverflow ? _GSTATUS_GFOV : 0);
+        default:
+            return _registers[reg];
+    }
+}
+
+void SimApds9960::writeRegister(uint8_t reg, uint8_t value) {
+    _registers[reg] = value;
+
+    if (reg == _REG_ENABLE && (!(value & _ENABLE_PON) || !(value & _ENABLE_GEN))) {
+        _gestureMode = false;
+    }
+
+    if (reg == _REG_GCONF4) {
+        if (value & _GCONF4_FIFO_CLR) {
+            clearFifo();
+            _registers[reg] &= ~_GCONF4_FIFO_CLR;
+        }
+
+        // Setting GMODE starts a gesture without waiting for GPENTH, the driver does this on enable
+        bool mode = value & _GCONF4_GMODE;
+        if (mode && !_gestureMode) {
+            _gestureMode = true;
+            _belowExit = 0;
+            _windows++;
+        } else if (!mode && _gestureMode) {
+            exitGestureMode();
+        }
+    }
+
+    updateStatus();
+}
+
+void SimApds9960::exitGestureMode() {
+    _gestureMode = false;
+    _belowExit = 0;
+}
+
+void SimApds9960::clearFifo() {
+    _fifoHead = 0;
+    _fifoLevel = 0;
+    _fifoOverflow = false;
+    _valid = false;
+    _interrupt = false;
+}
+
+void SimApds9960::updateStatus() {
+    // GVALID stays up until the gesture is over and its data read
+    if (!_gestureMode && _fifoLevel == 0) _valid = false;
+
+    bool low = (_registers[_REG_GCONF4] & _GCONF4_GIEN) && _interrupt;
+    if (low == _intLow) return;
+
+    _intLow = low;
+    simDrivePin(_intPin, low);
+}
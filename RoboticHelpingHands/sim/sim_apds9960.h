@@ -0,0 +1,74 @@
+#ifndef SIM_APDS9960_H
+#define SIM_APDS9960_H
+
+#include <stdint.h>
+#include "sim_i2c.h"
+#include "sim_script.h"
+
+/**
+ * @brief   register model of the APDS-9960 gesture engine, fed by a scripted hand
+ *
+ * The engine runs one cycle every pulse time plus GWTIME. Out of gesture mode it
+ * compares the hand's proximity with GPENTH; in gesture mode every cycle pushes a
+ * U/D/L/R dataset into the 32 deep FIFO until GEXPERS datasets in a row are all
+ * below GEXTH. GVALID and the open drain INT pin follow the FIFO level against
+ * GFIFOTH as the datasheet describes, FIFO reads at 0xFC-0xFF pop a dataset per
+ * four bytes. Ambient light, colour and proximity interrupts are not modelled.
+ */
+class SimApds9960 : public SimI2CDevice {
+public:
+    static const uint16_t ADDRESS = 0x39;
+
+    /**
+     * @param[in]   track: what the hand does over this sensor
+     * @param[in]   int_pin: GPIO the INT line is wired to
+     */
+    SimApds9960(const SimHandTrack* track, uint8_t int_pin);
+
+    /**
+     * @brief   starts the engine clock, call before the run
+     * @returns none
+     */
+    void start();
+
+    void write(const uint8_t* data, size_t length) override;
+    void read(uint8_t* data, size_t length) override;
+
+    uint32_t getDatasets() const { return _datasets; }
+    uint32_t getGestureWindows() const { return _windows; }
+    uint32_t getOverflows() const { return _overflows; }
+
+private:
+    static const uint8_t _FIFO_DEPTH = 32;
+    static const uint32_t _PULSE_CYCLE_US = 1400;   // 10 gesture pulses on all four diodes
+
+    const SimHandTrack* _track;
+    uint8_t _intPin;
+    uint8_t _registers[256];
+    uint8_t _pointer;
+
+    uint8_t _fifo[_FIFO_DEPTH][4];
+    uint8_t _fifoHead;
+    uint8_t _fifoLevel;
+    bool _fifoOverflow;
+
+    bool _gestureMode;
+    bool _valid;            // GVALID
+    bool _interrupt;        // GINT
+    uint8_t _belowExit;     // datasets in a row under GEXTH
+    bool _intLow;
+
+    uint32_t _datasets;
+    uint32_t _windows;
+    uint32_t _overflows;
+
+    void cycle();
+    uint32_t cycleUs() const;
+    uint8_t readRegister(uint8_t reg);
+    void writeRegister(uint8_t reg, uint8_t value);
+    void exitGestureMode();
+    void clearFifo();
+    void updateStatus();
+};
+
+#endif
@@ -0,0 +1,2 @@
+// The firmware's patched APDS-9960 driver, built against the simulated TwoWire
+#include "../SparkFun_APDS9960.cppCUSTOM"
@@ -0,0 +1,651 @@
+#include <Arduino.h>
+#include <ESP32Servo.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <driver/ledc.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <deque>
+#include <map>
+#include <string>
+#include "sim_kernel.h"
+#include "sim_hal.h"
+
+namespace {
+
+SimKernel& kernel() {
+    return SimKernel::instance();
+}
+
+/* ------------------------------------------------------------------ GPIO */
+
+struct Pin {
+    uint8_t mode;
+    int output;             // level written by the firmware
+    bool driven_low;        // pulled low from outside
+    void (*handler)(void*);
+    void* arg;
+    int interrupt_mode;
+    bool interrupt_enabled;
+    int last_level;
+};
+
+Pin pins[GPIO_NUM_MAX] = {};
+
+int pinLevel(const Pin& pin) {
+    if (pin.mode == OUTPUT) return pin.output;
+    if (pin.driven_low) return LOW;
+    return (pin.mode & PULLDOWN) ? LOW : HIGH;
+}
+
+/**
+ * @brief   calls the ISR of a pin if its line is at an active level or just made an active edge
+ */
+void evaluateInterrupt(uint8_t number) {
+    Pin& pin = pins[number];
+    int level = pinLevel(pin);
+    int previous = pin.last_level;
+    pin.last_level = level;
+    if (pin.handler == NULL || !pin.interrupt_enabled) return;
+
+    bool fire;
+    switch (pin.interrupt_mode) {
+        case ONLOW:
+        case ONLOW_WE:
+            fire = level == LOW;
+            break;
+        case ONHIGH:
+        case ONHIGH_WE:
+            fire = level == HIGH;
+            break;
+        case RISING:
+            fire = previous == LOW && level == HIGH;
+            break;
+        case FALLING:
+            fire = previous == HIGH && level == LOW;
+            break;
+        case CHANGE:
+            fire = previous != level;
+            break;
+        default:
+            fire = false;
+            break;
+    }
+    if (!fire) return;
+
+    // A level ISR that leaves itself unmasked would storm on hardware, here it gets one call per change
+    kernel().enterIsr();
+    pin.handler(pin.arg);
+    kernel().exitIsr();
+}
+
+void callPlainHandler(void* arg) {
+    reinterpret_cast<void (*)(void)>(arg)();
+}
+
+/* ---------------------------------------------------------------- Serial */
+
+bool quietSerial = false;
+std::string txLine;
+std::deque<uint8_t> rxBuffer;
+HardwareSerial::OnReceiveCb onReceiveCallback;
+
+void emitLine() {
+    if (!quietSerial) {
+        uint64_t now_ms = kernel().now() / 1000;
+        printf("[%6llu.%03llu] %s\n", (unsigned long long)(now_ms / 1000), (unsigned long long)(now_ms % 1000),
+               txLine.c_str());
+    }
+    txLine.clear();
+}
+
+/* ------------------------------------------------------------- esp_timer */
+
+SimTask* timerTask = NULL;
+std::deque<esp_timer*> firedTimers;
+int timersFired;    // address the esp_timer task blocks on
+
+void timerTaskMain(void* parameter);
+
+/* ----------------------------------------------------------- Preferences */
+
+typedef std::map<std::string, std::vector<uint8_t>> NvsNamespace;
+std::map<std::string, NvsNamespace> nvs;
+std::string nvsPath;
+
+void saveNvs() {
+    if (nvsPath.empty()) return;
+
+    FILE* file = fopen(nvsPath.c_str(), "w");
+    if (file == NULL) return;
+    for (const auto& space : nvs) {
+        for (const auto& entry : space.second) {
+            fprintf(file, "%s %s ", space.first.c_str(), entry.first.c_str());
+            for (uint8_t byte_value : entry.second) fprintf(file, "%02x", byte_value);
+            fprintf(file, "\n");
+        }
+    }
+    fclose(file);
+}
+
+void loadNvs() {
+    FILE* file = fopen(nvsPath.c_str(), "r");
+    if (file == NULL) return;
+
+    char space[64];
+    char key[64];
+    char hex[4096];
+    while (fscanf(file, "%63s %63s %4095s", space, key, hex) == 3) {
+        std::vector<uint8_t> value;
+        for (size_t i = 0; hex[i] != '\0' && hex[i + 1] != '\0'; i += 2) {
+            char digits[3] = {hex[i], hex[i + 1], '\0'};
+            value.push_back((uint8_t)strtoul(digits, NULL, 16));
+        }
+        nvs[space][key] = value;
+    }
+    fclose(file);
+}
+
+/* ----------------------------------------------------------------- Servo */
+
+FILE* servoLog = NULL;
+std::vector<SimServoStats> servoStats;
+
+SimServoStats& statsFor(int pin) {
+    for (SimServoStats& stats : servoStats) {
+        if (stats.pin == pin) return stats;
+    }
+    servoStats.push_back({pin, 0, 0});
+    return servoStats.back();
+}
+
+uint32_t ledcDuty[LEDC_SPEED_MODE_MAX * LEDC_CHANNEL_MAX] = {};
+
+}
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    uint64_t period_us;
+    uint32_t generation;    // bumped on every start and stop, so stale expiries are dropped
+    bool armed;
+};
+
+namespace {
+
+void armTimer(esp_timer* timer, uint64_t at_us) {
+    uint32_t generation = timer->generation;
+    kernel().schedule(at_us, [timer, generation, at_us]() {
+        if (!timer->armed || timer->generation != generation) return;
+
+        if (timer->period_us > 0) armTimer(timer, at_us + timer->period_us);
+        else timer->armed = false;
+
+        firedTimers.push_back(timer);
+        kernel().wake(&timersFired);
+    });
+}
+
+void timerTaskMain(void* parameter) {
+    while (true) {
+        while (firedTimers.empty()) kernel().block(&timersFired, UINT64_MAX);
+
+        esp_timer* timer = firedTimers.front();
+        firedTimers.pop_front();
+        timer->callback(timer->arg);
+    }
+}
+
+}
+
+void simDrivePin(uint8_t pin, bool low) {
+    if (pin >= GPIO_NUM_MAX) return;
+    pins[pin].driven_low = low;
+    evaluateInterrupt(pin);
+}
+
+void simTypeLine(const char* line) {
+    for (const char* c = line; *c != '\0'; c++) rxBuffer.push_back((uint8_t)*c);
+    rxBuffer.push_back('\n');
+    if (onReceiveCallback) onReceiveCallback();
+}
+
+void simSetQuiet(bool quiet) {
+    quietSerial = quiet;
+}
+
+bool simOpenServoLog(const char* path) {
+    servoLog = fopen(path, "w");
+    if (servoLog == NULL) return false;
+    fprintf(servoLog, "time_ms,pin,pulse_us\n");
+    return true;
+}
+
+void simUseNvsFile(const char* path) {
+    nvsPath = path;
+    loadNvs();
+}
+
+std::vector<SimServoStats> simGetServoStats() {
+    return servoStats;
+}
+
+long map(long value, long in_min, long in_max, long out_min, long out_max) {
+    if (in_max == in_min) return out_min;
+    return (value - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+unsigned long millis() {
+    return (unsigned long)(kernel().now() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)kernel().now();
+}
+
+void delay(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+    // Busy waits on the ESP32, but code takes no virtual time so this has to sleep
+    kernel().sleepFor(us);
+}
+
+void yield() {
+    kernel().yield(true);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= GPIO_NUM_MAX) return;
+    pins[pin].mode = mode;
+    pins[pin].last_level = pinLevel(pins[pin]);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin >= GPIO_NUM_MAX) return;
+    pins[pin].output = value ? HIGH : LOW;
+    evaluateInterrupt(pin);
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < GPIO_NUM_MAX ? pinLevel(pins[pin]) : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+    attachInterruptArg(pin, callPlainHandler, reinterpret_cast<void*>(handler), mode);
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {
+    if (pin >= GPIO_NUM_MAX) return;
+    pins[pin].handler = handler;
+    pins[pin].arg = arg;
+    pins[pin].interrupt_mode = mode;
+    pins[pin].interrupt_enabled = true;
+    evaluateInterrupt(pin);
+}
+
+void detachInterrupt(uint8_t pin) {
+    if (pin >= GPIO_NUM_MAX) return;
+    pins[pin].handler = NULL;
+    pins[pin].interrupt_enabled = false;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num) {
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    if (pins[gpio_num].interrupt_enabled) return ESP_OK;
+
+    pins[gpio_num].interrupt_enabled = true;
+    evaluateInterrupt(gpio_num);
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num) {
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].interrupt_enabled = false;
+    return ESP_OK;
+}
+
+double ledcSetup(uint8_t channel, double frequency, uint8_t resolution_bits) {
+    return frequency;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {}
+
+void ledcDetachPin(uint8_t pin) {}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+    if (channel < LEDC_SPEED_MODE_MAX * LEDC_CHANNEL_MAX) ledcDuty[channel] = duty;
+}
+
+uint32_t ledcRead(uint8_t channel) {
+    return channel < LEDC_SPEED_MODE_MAX * LEDC_CHANNEL_MAX ? ledcDuty[channel] : 0;
+}
+
+esp_err_t ledc_fade_func_install(int intr_alloc_flags) {
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_duty_and_update(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty, uint32_t hpoint) {
+    ledcWrite(mode * LEDC_CHANNEL_MAX + channel, duty);
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_fade_time_and_start(ledc_mode_t mode, ledc_channel_t channel, uint32_t target_duty,
+                                       uint32_t max_fade_time_ms, ledc_fade_mode_t fade_mode) {
+    // Only the end of the fade is kept, nothing looks at the LED in between
+    ledcWrite(mode * LEDC_CHANNEL_MAX + channel, target_duty);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* timer) {
+    if (args == NULL || args->callback == NULL || timer == NULL) return ESP_ERR_INVALID_ARG;
+
+    if (timerTask == NULL) {
+        timerTask = kernel().createTask(timerTaskMain, "esp_timer", 3584, NULL, 22, 0);
+    }
+    *timer = new esp_timer{args->callback, args->arg, 0, 0, false};
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    if (timer->armed) return ESP_ERR_INVALID_STATE;
+
+    timer->generation++;
+    timer->armed = true;
+    timer->period_us = 0;
+    armTimer(timer, kernel().now() + timeout_us);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    if (timer->armed) return ESP_ERR_INVALID_STATE;
+    if (period_us == 0) return ESP_ERR_INVALID_ARG;
+
+    timer->generation++;
+    timer->armed = true;
+    timer->period_us = period_us;
+    armTimer(timer, kernel().now() + period_us);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer->armed) return ESP_ERR_INVALID_STATE;
+
+    timer->generation++;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (timer->armed) return ESP_ERR_INVALID_STATE;
+
+    for (auto it = firedTimers.begin(); it != firedTimers.end();) {
+        it = *it == timer ? firedTimers.erase(it) : it + 1;
+    }
+    delete timer;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time() {
+    return (int64_t)kernel().now();
+}
+
+esp_err_t esp_pm_configure(const void* config) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char* name, esp_pm_lock_handle_t* handle) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup() {
+    return ESP_OK;
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size-- > 0) n += write(*buffer++);
+    return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (length < 0) return 0;
+    if ((size_t)length >= sizeof(buffer)) length = sizeof(buffer) - 1;
+    return write((const uint8_t*)buffer, length);
+}
+
+size_t Print::print(long value, int base) {
+    if (base == 10) return printf("%ld", value);
+    if (value < 0) return print('-') + print((unsigned long)-value, base);
+    return print((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+    if (base == 10) return printf("%lu", value);
+    if (base == 16) return printf("%lX", value);
+
+    char digits[sizeof(unsigned long) * 8 + 1];
+    size_t count = 0;
+    do {
+        unsigned long digit = value % base;
+        digits[count++] = (char)(digit < 10 ? '0' + digit : 'A' + digit - 10);
+        value /= base;
+    } while (value > 0);
+
+    size_t n = 0;
+    while (count > 0) n += print(digits[--count]);
+    return n;
+}
+
+size_t Print::print(double value, int digits) {
+    return printf("%.*f", digits, value);
+}
+
+HardwareSerial Serial;
+
+void HardwareSerial::onReceive(OnReceiveCb function, bool only_on_timeout) {
+    onReceiveCallback = function;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    if (c == '\n') emitLine();
+    else if (c != '\r') txLine.push_back((char)c);
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    for (size_t i = 0; i < size; i++) write(buffer[i]);
+    return size;
+}
+
+int HardwareSerial::available() {
+    return (int)rxBuffer.size();
+}
+
+int HardwareSerial::read() {
+    if (rxBuffer.empty()) return -1;
+    uint8_t c = rxBuffer.front();
+    rxBuffer.pop_front();
+    return c;
+}
+
+int HardwareSerial::peek() {
+    return rxBuffer.empty() ? -1 : rxBuffer.front();
+}
+
+size_t HardwareSerial::readBytes(uint8_t* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length && !rxBuffer.empty()) buffer[count++] = (uint8_t)read();
+    return count;
+}
+
+void HardwareSerial::flush() {
+    if (!txLine.empty()) emitLine();
+    fflush(stdout);
+}
+
+EspClass ESP;
+
+uint32_t EspClass::getCycleCount() {
+    uint64_t cycles = kernel().now() * getCpuFreqMHz();
+    SimTask* task = kernel().current();
+    if (task != NULL) cycles += (task->cpu_ns + kernel().runningCpuNs()) * getCpuFreqMHz() / 1000;
+    return (uint32_t)cycles;
+}
+
+uint32_t EspClass::getFreeHeap() {
+    // The host heap says nothing about the ESP32's, report a steady figure
+    return 200000;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    return 200000;
+}
+
+void EspClass::restart() {
+    Serial.flush();
+    printf("sim: ESP.restart() called, stopping\n");
+    fflush(stdout);
+    _exit(0);
+}
+
+Preferences::Preferences() :
+    _name(NULL),
+    _readOnly(false)
+{}
+
+bool Preferences::begin(const char* name, bool read_only, const char* partition) {
+    _name = name;
+    _readOnly = read_only;
+    return true;
+}
+
+void Preferences::end() {
+    _name = NULL;
+}
+
+bool Preferences::clear() {
+    if (_name == NULL || _readOnly) return false;
+    nvs[_name].clear();
+    saveNvs();
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (_name == NULL || _readOnly) return false;
+    bool removed = nvs[_name].erase(key) > 0;
+    saveNvs();
+    return removed;
+}
+
+bool Preferences::isKey(const char* key) {
+    return _name != NULL && nvs[_name].count(key) > 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+    if (_name == NULL || _readOnly || value == NULL) return 0;
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    nvs[_name][key] = std::vector<uint8_t>(bytes, bytes + length);
+    saveNvs();
+    return length;
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t length) {
+    if (!isKey(key)) return 0;
+
+    const std::vector<uint8_t>& value = nvs[_name][key];
+    if (buffer == NULL || length < value.size()) return 0;
+    memcpy(buffer, value.data(), value.size());
+    return value.size();
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    return isKey(key) ? nvs[_name][key].size() : 0;
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+    return putBytes(key, &value, sizeof(value));
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t default_value) {
+    uint32_t value;
+    return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : default_value;
+}
+
+Servo::Servo() :
+    _pin(-1),
+    _minUs(544),
+    _maxUs(2400),
+    _pulseUs(0),
+    _periodHz(50)
+{}
+
+int Servo::attach(int pin, int min_us, int max_us) {
+    _pin = pin;
+    _minUs = min_us;
+    _maxUs = max_us;
+    statsFor(pin);
+    return pin;
+}
+
+void Servo::detach() {
+    _pin = -1;
+}
+
+void Servo::write(int value) {
+    // Like the library, small values are angles and larger ones already pulse widths
+    if (value < _minUs) value = map(constrain(value, 0, 180), 0, 180, _minUs, _maxUs);
+    writeMicroseconds(value);
+}
+
+void Servo::writeMicroseconds(int pulse_us) {
+    if (_pin < 0) return;
+
+    pulse_us = constrain(pulse_us, _minUs, _maxUs);
+    SimServoStats& stats = statsFor(_pin);
+    stats.writes++;
+    if (pulse_us == _pulseUs) return;
+
+    _pulseUs = pulse_us;
+    stats.last_us = pulse_us;
+    if (servoLog != NULL) {
+        fprintf(servoLog, "%llu.%03llu,%d,%d\n", (unsigned long long)(kernel().now() / 1000),
+                (unsigned long long)(kernel().now() % 1000), _pin, pulse_us);
+    }
+}
+
+int Servo::read() const {
+    if (_pulseUs == 0) return 0;
+    return map(_pulseUs, _minUs, _maxUs, 0, 180);
+}
@@ -0,0 +1,471 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include "sim_kernel.h"
+
+// FreeRTOS API over SimKernel. Waits re-check their condition each time the kernel
+// wakes them, so any number of tasks can wait on one object.
+
+struct SimQueue {
+    UBaseType_t length;
+    UBaseType_t item_size;
+    std::vector<uint8_t> storage;
+    UBaseType_t head;
+    UBaseType_t count;
+    int has_data;      // addresses to block on, the values are unused
+    int has_space;
+};
+
+struct SimEventGroup {
+    EventBits_t bits;
+};
+
+namespace {
+
+SimKernel& kernel() {
+    return SimKernel::instance();
+}
+
+/**
+ * @brief   virtual time a wait of some ticks ends at, counted from the current tick like FreeRTOS
+ */
+uint64_t deadline(TickType_t ticks) {
+    if (ticks == portMAX_DELAY) return UINT64_MAX;
+    return (kernel().now() / 1000 + ticks) * 1000;
+}
+
+/**
+ * @brief   wakes the waiters of an object and switches to one if it outranks the caller
+ */
+bool wakeWaiters(const void* object) {
+    bool higher = kernel().wake(object);
+    if (higher && !kernel().inIsr()) kernel().yield(false);
+    return higher;
+}
+
+SimTask* self() {
+    SimTask* task = kernel().current();
+    configASSERT(task != NULL);
+    return task;
+}
+
+BaseType_t queueSend(QueueHandle_t queue, const void* item, TickType_t ticks, bool front) {
+    uint64_t until = deadline(ticks);
+    while (queue->count >= queue->length) {
+        if (ticks == 0 || kernel().inIsr() || !kernel().block(&queue->has_space, until)) return errQUEUE_FULL;
+    }
+
+    UBaseType_t slot;
+    if (front) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+    } else {
+        slot = (queue->head + queue->count) % queue->length;
+    }
+    if (queue->item_size > 0 && item != NULL) {
+        memcpy(&queue->storage[slot * queue->item_size], item, queue->item_size);
+    }
+    queue->count++;
+
+    wakeWaiters(&queue->has_data);
+    return pdPASS;
+}
+
+BaseType_t queueReceive(QueueHandle_t queue, void* item, TickType_t ticks, bool peek) {
+    uint64_t until = deadline(ticks);
+    while (queue->count == 0) {
+        if (ticks == 0 || kernel().inIsr() || !kernel().block(&queue->has_data, until)) return pdFALSE;
+    }
+
+    if (queue->item_size > 0 && item != NULL) {
+        memcpy(item, &queue->storage[queue->head * queue->item_size], queue->item_size);
+    }
+    if (peek) return pdTRUE;
+
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    wakeWaiters(&queue->has_space);
+    return pdTRUE;
+}
+
+BaseType_t notify(TaskHandle_t task, uint32_t value, eNotifyAction action, bool* higher) {
+    if (action == eSetValueWithoutOverwrite && task->notify_pending) return pdFAIL;
+
+    switch (action) {
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value++;
+            break;
+        case eSetValueWithOverwrite:
+        case eSetValueWithoutOverwrite:
+            task->notify_value = value;
+            break;
+        case eNoAction:
+        default:
+            break;
+    }
+    task->notify_pending = true;
+
+    bool woke = kernel().wake(&task->notify_value);
+    if (higher != NULL) *higher = woke;
+    return pdPASS;
+}
+
+}
+
+void simAssertFailed(const char* file, int line) {
+    fprintf(stderr, "sim: assert failed at %s:%d\n", file, line);
+    fflush(stdout);
+    abort();
+}
+
+void simYieldFromIsr() {
+    // SimKernel::exitIsr() switches once the ISR is done
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                                   void* parameter, UBaseType_t priority, TaskHandle_t* created,
+                                   BaseType_t core_id) {
+    SimTask* task = kernel().createTask(function, name, stack_depth, parameter, priority, core_id);
+    if (created != NULL) *created = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                       void* parameter, UBaseType_t priority, TaskHandle_t* created) {
+    return xTaskCreatePinnedToCore(function, name, stack_depth, parameter, priority, created, tskNO_AFFINITY);
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                                           void* parameter, UBaseType_t priority, StackType_t* stack,
+                                           StaticTask_t* task_buffer, BaseType_t core_id) {
+    if (stack == NULL || task_buffer == NULL) return NULL;
+    return kernel().createTask(function, name, stack_depth, parameter, priority, core_id);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    kernel().deleteTask(task);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    if (ticks == 0) {
+        kernel().yield(true);
+        return;
+    }
+    self();
+    kernel().block(NULL, deadline(ticks));
+}
+
+BaseType_t xTaskDelayUntil(TickType_t* previous_wake, TickType_t increment) {
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wake = *previous_wake + increment;
+    *previous_wake = wake;
+
+    int32_t ahead = (int32_t)(wake - now);
+    if (ahead <= 0) {
+        kernel().yield(true);
+        return pdFALSE;
+    }
+    self();
+    kernel().block(NULL, deadline(ahead));
+    return pdTRUE;
+}
+
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t increment) {
+    xTaskDelayUntil(previous_wake, increment);
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(kernel().now() / 1000);
+}
+
+TickType_t xTaskGetTickCountFromISR() {
+    return xTaskGetTickCount();
+}
+
+void taskYIELD() {
+    kernel().yield(true);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return kernel().current();
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCPU(UBaseType_t cpu) {
+    return cpu < portNUM_PROCESSORS ? kernel().getIdleTask(cpu) : NULL;
+}
+
+BaseType_t xTaskGetAffinity(TaskHandle_t task) {
+    if (task == NULL) task = self();
+    return task->core;
+}
+
+BaseType_t xPortGetCoreID() {
+    SimTask* task = kernel().current();
+    return task == NULL || task->core == tskNO_AFFINITY ? 0 : task->core;
+}
+
+const char* pcTaskGetName(TaskHandle_t task) {
+    if (task == NULL) task = self();
+    return task->name.c_str();
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+    if (task == NULL) task = self();
+    return task->priority;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks() {
+    UBaseType_t count = 0;
+    for (SimTask* task : kernel().getTasks()) {
+        if (task->state != SimTask::DELETED) count++;
+    }
+    return count;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    // Host stacks say nothing about the ESP32's, the whole stack is reported free
+    if (task == NULL) task = self();
+    return task->stack_depth;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* status, UBaseType_t size, uint32_t* total_run_time) {
+    SimKernel& k = kernel();
+    if (uxTaskGetNumberOfTasks() > size) return 0;
+
+    // Run time is host CPU time against virtual time, idle gets what its core's tasks left
+    uint64_t busy_us[portNUM_PROCESSORS] = {};
+    for (SimTask* task : k.getTasks()) {
+        if (task->idle) continue;
+        uint64_t ns = task->cpu_ns + (task == k.current() ? k.runningCpuNs() : 0);
+        busy_us[task->core == tskNO_AFFINITY ? 0 : task->core] += ns / 1000;
+    }
+
+    UBaseType_t count = 0;
+    for (SimTask* task : k.getTasks()) {
+        if (task->state == SimTask::DELETED) continue;
+
+        TaskStatus_t& entry = status[count++];
+        entry.xHandle = task;
+        entry.pcTaskName = task->name.c_str();
+        entry.xTaskNumber = task->number;
+        entry.uxCurrentPriority = task->priority;
+        entry.uxBasePriority = task->priority;
+        entry.pxStackBase = NULL;
+        entry.usStackHighWaterMark = task->stack_depth;
+        entry.xCoreID = task->core;
+
+        if (task == k.current()) entry.eCurrentState = eRunning;
+        else if (task->state == SimTask::BLOCKED) entry.eCurrentState = eBlocked;
+        else entry.eCurrentState = eReady;
+
+        if (task->idle) {
+            uint64_t busy = busy_us[task->core];
+            entry.ulRunTimeCounter = (uint32_t)(k.now() > busy ? k.now() - busy : 0);
+        } else {
+            uint64_t ns = task->cpu_ns + (task == k.current() ? k.runningCpuNs() : 0);
+            entry.ulRunTimeCounter = (uint32_t)(ns / 1000);
+        }
+    }
+
+    if (total_run_time != NULL) *total_run_time = (uint32_t)k.now();
+    return count;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    bool higher = false;
+    BaseType_t result = notify(task, value, action, &higher);
+    if (higher && !kernel().inIsr()) kernel().yield(false);
+    return result;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              BaseType_t* higher_priority_woken) {
+    bool higher = false;
+    BaseType_t result = notify(task, value, action, &higher);
+    if (higher_priority_woken != NULL && higher) *higher_priority_woken = pdTRUE;
+    return result;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value,
+                           TickType_t ticks) {
+    SimTask* task = self();
+    if (!task->notify_pending) {
+        task->notify_value &= ~clear_on_entry;
+        uint64_t until = deadline(ticks);
+        while (!task->notify_pending) {
+            if (ticks == 0 || !kernel().block(&task->notify_value, until)) break;
+        }
+    }
+
+    if (value != NULL) *value = task->notify_value;
+    if (!task->notify_pending) return pdFALSE;
+
+    task->notify_value &= ~clear_on_exit;
+    task->notify_pending = false;
+    return pdTRUE;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higher_priority_woken) {
+    xTaskNotifyFromISR(task, 0, eIncrement, higher_priority_woken);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    SimTask* task = self();
+    uint64_t until = deadline(ticks);
+    while (task->notify_value == 0) {
+        if (ticks == 0 || !kernel().block(&task->notify_value, until)) break;
+    }
+
+    uint32_t value = task->notify_value;
+    if (value != 0) task->notify_value = clear_on_exit ? 0 : value - 1;
+    task->notify_pending = false;
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    if (length == 0) return NULL;
+
+    SimQueue* queue = new SimQueue();
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->storage.resize(length * item_size);
+    queue->head = 0;
+    queue->count = 0;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    return queueSend(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    return queueSend(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    return queueSend(queue, item, ticks, true);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higher_priority_woken) {
+    if (queue->count >= queue->length) return errQUEUE_FULL;
+
+    UBaseType_t slot = (queue->head + queue->count) % queue->length;
+    if (queue->item_size > 0 && item != NULL) memcpy(&queue->storage[slot * queue->item_size], item, queue->item_size);
+    queue->count++;
+
+    if (kernel().wake(&queue->has_data) && higher_priority_woken != NULL) *higher_priority_woken = pdTRUE;
+    return pdPASS;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item) {
+    queue->head = 0;
+    queue->count = 0;
+    return queueSend(queue, item, 0, false);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    return queueReceive(queue, item, ticks, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks) {
+    return queueReceive(queue, item, ticks, true);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    queue->head = 0;
+    queue->count = 0;
+    wakeWaiters(&queue->has_space);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    return queue->length - queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    mutex->count = 1;
+    return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    SemaphoreHandle_t semaphore = xQueueCreate(max_count, 0);
+    if (semaphore != NULL) semaphore->count = initial_count;
+    return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    return queueReceive(semaphore, NULL, ticks, false);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return queueSend(semaphore, NULL, 0, false);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higher_priority_woken) {
+    return xQueueSendFromISR(semaphore, NULL, higher_priority_woken);
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new SimEventGroup{0};
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    group->bits |= bits;
+    EventBits_t result = group->bits;
+    wakeWaiters(group);
+    return result;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks) {
+    uint64_t until = deadline(ticks);
+    while (true) {
+        EventBits_t current = group->bits;
+        bool met = wait_for_all ? (current & bits) == bits : (current & bits) != 0;
+        if (met) {
+            if (clear_on_exit) group->bits &= ~bits;
+            return current;
+        }
+        if (ticks == 0 || !kernel().block(group, until)) return group->bits;
+    }
+}
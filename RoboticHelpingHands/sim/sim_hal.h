@@ -0,0 +1,57 @@
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdint.h>
+#include <vector>
+
+// Hooks the sim's device models and main() use on the Arduino and ESP-IDF stand-ins
+
+/**
+ * @brief   pulls an open drain line low or releases it to its pull-up, firing interrupts as the pin would
+ * @param[in]   pin: GPIO number
+ * @param[in]   low: true to pull the line low
+ * @returns none
+ */
+void simDrivePin(uint8_t pin, bool low);
+
+/**
+ * @brief   types a line on the serial console, as if sent from the monitor
+ * @param[in]   line: text without the line ending
+ * @returns none
+ */
+void simTypeLine(const char* line);
+
+/**
+ * @brief   stops Serial output reaching stdout, the run summary still prints
+ * @param[in]   quiet: true to drop Serial output
+ * @returns none
+ */
+void simSetQuiet(bool quiet);
+
+/**
+ * @brief   writes every servo pulse change to a CSV file
+ * @param[in]   path: file to create
+ * @returns true if the file opened
+ */
+bool simOpenServoLog(const char* path);
+
+/**
+ * @brief   backs Preferences with a file, loading it now and saving it on every change
+ * @param[in]   path: file to use, created on the first save if missing
+ * @returns none
+ */
+void simUseNvsFile(const char* path);
+
+struct SimServoStats {
+    int pin;
+    uint32_t writes;
+    int last_us;
+};
+
+/**
+ * @brief   gets what every servo pin was driven with
+ * @returns one entry per pin ever attached, in attach order
+ */
+std::vector<SimServoStats> simGetServoStats();
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SIM_I2C_H
+#define SIM_I2C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief   device on a simulated I2C bus, called from the task doing the transfer
+ */
+class SimI2CDevice {
+public:
+    virtual ~SimI2CDevice() {}
+
+    /**
+     * @brief   takes the bytes of a write transaction
+     * @param[in]   data: bytes after the address byte
+     * @param[in]   length: number of bytes, 0 for an address only probe
+     * @returns none
+     */
+    virtual void write(const uint8_t* data, size_t length) = 0;
+
+    /**
+     * @brief   supplies the bytes of a read transaction
+     * @param[out]  data: bytes to return
+     * @param[in]   length: number of bytes the controller reads
+     * @returns none
+     */
+    virtual void read(uint8_t* data, size_t length) = 0;
+};
+
+/**
+ * @brief   attaches a device to a bus, it answers the TwoWire of the same bus number
+ * @param[in]   bus_num: TwoWire bus number
+ * @param[in]   address: 7 bit address
+ * @param[in]   device: device model, kept for the whole run
+ * @returns none
+ */
+void simAttachI2CDevice(uint8_t bus_num, uint16_t address, SimI2CDevice* device);
+
+#endif
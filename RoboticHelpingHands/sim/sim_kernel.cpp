@@ -0,0 +1,236 @@
+#include "sim_kernel.h"
+#include <time.h>
+
+SimKernel& SimKernel::instance() {
+    static SimKernel kernel;
+    return kernel;
+}
+
+SimKernel::SimKernel() :
+    _nowUs(0),
+    _endUs(0),
+    _seq(0),
+    _inIsr(0),
+    _current(NULL),
+    _idle{},
+    _running(NULL),
+    _finished(false)
+{
+    // Never run, they only give the monitor a per core idle counter to subtract from
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        SimTask* idle = new SimTask();
+        idle->name = "IDLE" + std::to_string(core);
+        idle->priority = tskIDLE_PRIORITY;
+        idle->core = core;
+        idle->stack_depth = 1024;
+        idle->number = _tasks.size() + 1;
+        idle->idle = true;
+        idle->state = SimTask::READY;
+        idle->wake_us = UINT64_MAX;
+        _idle[core] = idle;
+        _tasks.push_back(idle);
+    }
+}
+
+SimTask* SimKernel::createTask(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                               void* parameter, UBaseType_t priority, BaseType_t core) {
+    SimTask* task = new SimTask();
+    task->name = name != NULL ? name : "";
+    task->function = function;
+    task->parameter = parameter;
+    task->priority = priority;
+    task->core = core;
+    task->stack_depth = stack_depth;
+    task->number = _tasks.size() + 1;
+    task->idle = false;
+    task->blocked_on = NULL;
+    task->timed_out = false;
+    task->notify_value = 0;
+    task->notify_pending = false;
+    task->cpu_ns = 0;
+    task->resumed_ns = 0;
+    makeReady(task, false);
+    _tasks.push_back(task);
+
+    std::thread(&SimKernel::threadMain, this, task).detach();
+
+    yield(false);
+    return task;
+}
+
+void SimKernel::deleteTask(SimTask* task) {
+    if (task == NULL) task = _current;
+    if (task == NULL || task->idle) return;
+
+    task->state = SimTask::DELETED;
+    task->blocked_on = NULL;
+
+    // Nothing readies a deleted task, so its thread waits in handOff() for good
+    if (task == _current && _inIsr == 0) dispatch();
+}
+
+bool SimKernel::block(const void* object, uint64_t until_us) {
+    SimTask* self = _current;
+    configASSERT(self != NULL && _inIsr == 0);
+    if (until_us <= _nowUs) return false;
+
+    self->state = SimTask::BLOCKED;
+    self->blocked_on = object;
+    self->wake_us = until_us;
+    self->timed_out = false;
+    dispatch();
+    return !self->timed_out;
+}
+
+void SimKernel::sleepFor(uint64_t us) {
+    if (us == 0) return;
+    block(NULL, _nowUs + us);
+}
+
+bool SimKernel::wake(const void* object) {
+    if (object == NULL) return false;
+
+    bool higher = false;
+    for (SimTask* task : _tasks) {
+        if (task->state != SimTask::BLOCKED || task->blocked_on != object) continue;
+        makeReady(task, false);
+        if (_current == NULL || task->priority > _current->priority) higher = true;
+    }
+    return higher;
+}
+
+void SimKernel::yield(bool equal) {
+    SimTask* self = _current;
+    if (self == NULL || _inIsr > 0 || self->state != SimTask::READY) return;
+
+    bool other = false;
+    for (SimTask* task : _tasks) {
+        if (task == self || task->idle || task->state != SimTask::READY) continue;
+        if (task->priority > self->priority || (equal && task->priority == self->priority)) other = true;
+    }
+    if (!other) return;
+
+    self->ready_seq = _seq++;
+    dispatch();
+}
+
+void SimKernel::schedule(uint64_t at_us, std::function<void()> callback) {
+    _events.push({at_us < _nowUs ? _nowUs : at_us, _seq++, callback});
+}
+
+void SimKernel::exitIsr() {
+    _inIsr--;
+
+    // An ISR that woke a higher priority task switches to it on the way out
+    if (_inIsr == 0) yield(false);
+}
+
+uint64_t SimKernel::run(uint64_t end_us) {
+    _endUs = end_us;
+    SimTask* next = pickNext();
+    _current = next;
+    if (next != NULL) next->resumed_ns = 0;
+    handOff(NULL, next);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _handoff.wait(lock, [this]() { return _finished; });
+    return _nowUs;
+}
+
+uint64_t SimKernel::threadCpuNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+uint64_t SimKernel::runningCpuNs() const {
+    if (_current == NULL || _inIsr > 0) return 0;
+    return threadCpuNs() - _current->resumed_ns;
+}
+
+void SimKernel::threadMain(SimTask* task) {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _handoff.wait(lock, [this, task]() { return _running == task; });
+    }
+    task->resumed_ns = threadCpuNs();
+
+    task->function(task->parameter);
+
+    // Returning from a task is a crash on FreeRTOS, here it just ends the task
+    printf("sim: task %s returned\n", task->name.c_str());
+    deleteTask(task);
+}
+
+SimTask* SimKernel::pickNext() {
+    while (true) {
+        SimTask* best = NULL;
+        for (SimTask* task : _tasks) {
+            if (task->idle || task->state != SimTask::READY) continue;
+            if (best == NULL ||
+                task->priority > best->priority ||
+                (task->priority == best->priority && task->ready_seq < best->ready_seq)) {
+                best = task;
+            }
+        }
+        if (best != NULL) return best;
+        if (!advance()) return NULL;
+    }
+}
+
+bool SimKernel::advance() {
+    uint64_t next_us = _events.empty() ? UINT64_MAX : _events.top().at_us;
+    for (SimTask* task : _tasks) {
+        if (task->state == SimTask::BLOCKED && task->wake_us < next_us) next_us = task->wake_us;
+    }
+
+    if (next_us == UINT64_MAX) return false;   // every task blocked for good
+    if (next_us > _endUs) {
+        _nowUs = _endUs;
+        return false;
+    }
+    if (next_us > _nowUs) _nowUs = next_us;
+
+    // Hardware first, so an event due at a task's timeout still reaches it
+    _inIsr++;
+    while (!_events.empty() && _events.top().at_us <= _nowUs) {
+        std::function<void()> callback = _events.top().callback;
+        _events.pop();
+        callback();
+    }
+    _inIsr--;
+
+    for (SimTask* task : _tasks) {
+        if (task->state == SimTask::BLOCKED && task->wake_us <= _nowUs) makeReady(task, true);
+    }
+    return true;
+}
+
+void SimKernel::dispatch() {
+    SimTask* self = _current;
+    SimTask* next = pickNext();
+    if (next == self) return;
+
+    self->cpu_ns += threadCpuNs() - self->resumed_ns;
+    _current = next;
+    handOff(self, next);
+    self->resumed_ns = threadCpuNs();
+}
+
+void SimKernel::handOff(SimTask* self, SimTask* next) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _running = next;
+    if (next == NULL) _finished = true;
+    _handoff.notify_all();
+
+    if (self == NULL) return;
+    _handoff.wait(lock, [this, self]() { return _running == self; });
+}
+
+void SimKernel::makeReady(SimTask* task, bool timed_out) {
+    task->state = SimTask::READY;
+    task->blocked_on = NULL;
+    task->wake_us = UINT64_MAX;
+    task->timed_out = timed_out;
+    task->ready_seq = _seq++;
+}
@@ -0,0 +1,227 @@
+#ifndef SIM_KERNEL_H
+#define SIM_KERNEL_H
+
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * @brief   one FreeRTOS task, run on a host thread of its own
+ */
+struct SimTask {
+    enum State {
+        READY = 0,
+        BLOCKED,
+        DELETED
+    };
+
+    std::string name;
+    TaskFunction_t function;
+    void* parameter;
+    UBaseType_t priority;
+    BaseType_t core;            // tskNO_AFFINITY if not pinned
+    uint32_t stack_depth;       // bytes, as xTaskCreatePinnedToCore takes it on the ESP32
+    UBaseType_t number;
+    bool idle;                  // stands in for an IDLE task, never runs
+
+    State state;
+    uint64_t ready_seq;         // FIFO order among tasks of the same priority
+    const void* blocked_on;     // object a blocked task waits for, NULL for a plain delay
+    uint64_t wake_us;           // timeout of a blocked task, UINT64_MAX if none
+    bool timed_out;
+
+    uint32_t notify_value;
+    bool notify_pending;
+
+    uint64_t cpu_ns;            // host CPU time spent running, for the run time stats
+    uint64_t resumed_ns;
+};
+
+/**
+ * @brief   deterministic single CPU FreeRTOS scheduler over a virtual clock
+ *
+ * Every task is a host thread, but only the running one ever executes: a task runs
+ * until it blocks, deletes itself or wakes a task of higher priority, and then hands
+ * the CPU to the highest priority ready task (FIFO among equals). Code takes no
+ * virtual time; the clock only moves when nothing is ready, straight to the next
+ * timeout or event, so a run is as fast as the host allows and repeats exactly.
+ * Pinned cores are kept for the run time stats only, the two cores share one CPU.
+ *
+ * Events are the simulated hardware: they run in interrupt context between tasks
+ * and may only use the FromISR calls or wake tasks.
+ */
+class SimKernel {
+public:
+    static SimKernel& instance();
+
+    /**
+     * @brief   gets the virtual time
+     * @returns microseconds since the simulation started
+     */
+    uint64_t now() const { return _nowUs; }
+
+    /**
+     * @brief   creates a task, ready at once, switching to it if it outranks the caller
+     * @param[in]   function: task body
+     * @param[in]   name: task name
+     * @param[in]   stack_depth: stack size in bytes, reported as the free stack
+     * @param[in]   parameter: passed to the task body
+     * @param[in]   priority: FreeRTOS priority
+     * @param[in]   core: pinned core or tskNO_AFFINITY
+     * @returns the task
+     */
+    SimTask* createTask(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                        void* parameter, UBaseType_t priority, BaseType_t core);
+
+    /**
+     * @brief   deletes a task, never returns if it is the calling task
+     * @param[in]   task: task to delete, NULL for the calling task
+     * @returns none
+     */
+    void deleteTask(SimTask* task);
+
+    /**
+     * @brief   gets the running task
+     * @returns running task, NULL before the run or in interrupt context
+     */
+    SimTask* current() const { return _inIsr > 0 ? NULL : _current; }
+
+    /**
+     * @brief   blocks the running task until an object is woken or a timeout passes
+     * @param[in]   object: what to wait for, NULL to only wait for the timeout
+     * @param[in]   until_us: virtual time of the timeout, UINT64_MAX for none
+     * @returns true if woken, false on timeout
+     */
+    bool block(const void* object, uint64_t until_us);
+
+    /**
+     * @brief   blocks the running task for a while
+     * @param[in]   us: microseconds to sleep
+     * @returns none
+     */
+    void sleepFor(uint64_t us);
+
+    /**
+     * @brief   readies every task blocked on an object, the caller re-checks what it waited for
+     * @param[in]   object: object that changed
+     * @returns true if a task was woken that outranks the running task
+     */
+    bool wake(const void* object);
+
+    /**
+     * @brief   lets a ready task of higher priority run, or of equal priority if asked
+     * @param[in]   equal: also give way to tasks of the same priority
+     * @returns none
+     */
+    void yield(bool equal);
+
+    /**
+     * @brief   runs a function in interrupt context at a virtual time
+     * @param[in]   at_us: virtual time, the current time if it already passed
+     * @param[in]   callback: event body
+     * @returns none
+     */
+    void schedule(uint64_t at_us, std::function<void()> callback);
+
+    /**
+     * @brief   marks interrupt context around an ISR called from a task
+     * @returns none
+     */
+    void enterIsr() { _inIsr++; }
+    void exitIsr();
+    bool inIsr() const { return _inIsr > 0; }
+
+    /**
+     * @brief   runs the tasks until the virtual time reaches the end, call from main() once
+     * @param[in]   end_us: virtual time to stop at
+     * @returns virtual time reached, less than end_us if every task blocked for good
+     */
+    uint64_t run(uint64_t end_us);
+
+    const std::vector<SimTask*>& getTasks() const { return _tasks; }
+    SimTask* getIdleTask(int core) const { return _idle[core]; }
+
+    /**
+     * @brief   host CPU time of the calling thread
+     * @returns nanoseconds
+     */
+    static uint64_t threadCpuNs();
+
+    /**
+     * @brief   host CPU time the running task has spent since it last got the CPU
+     * @returns nanoseconds, 0 outside a task
+     */
+    uint64_t runningCpuNs() const;
+
+private:
+    struct Event {
+        uint64_t at_us;
+        uint64_t seq;
+        std::function<void()> callback;
+
+        bool operator>(const Event& other) const {
+            return at_us != other.at_us ? at_us > other.at_us : seq > other.seq;
+        }
+    };
+
+    SimKernel();
+
+    uint64_t _nowUs;
+    uint64_t _endUs;
+    uint64_t _seq;
+    int _inIsr;
+    SimTask* _current;
+    SimTask* _idle[portNUM_PROCESSORS];
+    std::vector<SimTask*> _tasks;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> _events;
+
+    // Hand-off between host threads; only the thread of _running may touch anything else
+    std::mutex _mutex;
+    std::condition_variable _handoff;
+    SimTask* _running;
+    bool _finished;
+
+    /**
+     * @brief   host thread body of a task
+     * @param[in]   task: task to run
+     * @returns none
+     */
+    void threadMain(SimTask* task);
+
+    /**
+     * @brief   picks the next task to run, moving the clock on while none is ready
+     * @returns task to run, NULL once the run is over
+     */
+    SimTask* pickNext();
+
+    /**
+     * @brief   moves the clock to the next event or timeout and runs what is due
+     * @returns false if that is past the end of the run or there is nothing left
+     */
+    bool advance();
+
+    /**
+     * @brief   gives the CPU to the next task, call from the running task after its state changed
+     * @returns once the calling task runs again
+     */
+    void dispatch();
+
+    /**
+     * @brief   switches host threads, the calling thread waits until it is picked again
+     * @param[in]   self: calling task, NULL for main()
+     * @param[in]   next: task to run, NULL when the run is over
+     * @returns none
+     */
+    void handOff(SimTask* self, SimTask* next);
+
+    void makeReady(SimTask* task, bool timed_out);
+};
+
+#endif
@@ -0,0 +1,145 @@
+// Host simulation of the GestureGrip firmware: the unmodified sketch runs on the sim
+// FreeRTOS kernel against two modelled APDS-9960s driven by a script, with servo
+// pulses logged instead of driven. See the [Host simulation] section of notes.txt.
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <unistd.h>
+#include "sim_apds9960.h"
+#include "sim_hal.h"
+#include "sim_i2c.h"
+#include "sim_kernel.h"
+#include "sim_script.h"
+
+void setup();
+void loop();
+
+namespace {
+
+// Wiring of the board, as in gesture_grip_sensors.h
+const uint8_t _LEFT_BUS = 0;
+const uint8_t _RIGHT_BUS = 1;
+const uint8_t _LEFT_INT_PIN = 27;
+const uint8_t _RIGHT_INT_PIN = 13;
+
+// Time left after the last hand motion for the servos to settle
+const uint64_t _SETTLE_US = 3000000;
+const uint64_t _DEFAULT_RUN_US = 10000000;
+
+// Console commands typed at the end unless the script says otherwise, and the time they get
+const char* const _REPORT_COMMANDS[] = {"trace", "tasks", "acquire"};
+const uint64_t _REPORT_US = 100000;
+
+void loopTask(void* parameter) {
+    // Same as the Arduino core's loopTask
+    setup();
+    while (true) {
+        loop();
+        yield();
+    }
+}
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--script file] [--seconds n] [--quiet] [--no-report]\n"
+            "          [--servo-log file.csv] [--nvs file] [--acquire polling|interrupt]\n",
+            program);
+}
+
+}
+
+int main(int argc, char** argv) {
+    const char* script_path = NULL;
+    double seconds = 0;
+    bool report = true;
+    const char* acquire = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--script") == 0 && has_value) {
+            script_path = argv[++i];
+        } else if (strcmp(argv[i], "--seconds") == 0 && has_value) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            simSetQuiet(true);
+        } else if (strcmp(argv[i], "--no-report") == 0) {
+            report = false;
+        } else if (strcmp(argv[i], "--servo-log") == 0 && has_value) {
+            if (!simOpenServoLog(argv[++i])) {
+                fprintf(stderr, "sim: cannot create %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--nvs") == 0 && has_value) {
+            simUseNvsFile(argv[++i]);
+        } else if (strcmp(argv[i], "--acquire") == 0 && has_value &&
+                   (strcmp(argv[i + 1], "polling") == 0 || strcmp(argv[i + 1], "interrupt") == 0)) {
+            acquire = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    SimScript script;
+    if (script_path != NULL && !script.load(script_path)) return 1;
+
+    uint64_t end_us = _DEFAULT_RUN_US;
+    if (seconds > 0) end_us = (uint64_t)(seconds * 1000000);
+    else if (script.getEndUs() > 0) end_us = script.getEndUs();
+    else if (script_path != NULL) end_us = script.getLastMotionUs() + _SETTLE_US;
+
+    SimKernel& kernel = SimKernel::instance();
+
+    SimApds9960 left(&script.getTrack(0), _LEFT_INT_PIN);
+    SimApds9960 right(&script.getTrack(1), _RIGHT_INT_PIN);
+    simAttachI2CDevice(_LEFT_BUS, SimApds9960::ADDRESS, &left);
+    simAttachI2CDevice(_RIGHT_BUS, SimApds9960::ADDRESS, &right);
+    left.start();
+    right.start();
+
+    // Typed at boot, the console takes it as soon as setup() is done
+    if (acquire != NULL) {
+        std::string text = std::string("acquire ") + acquire;
+        kernel.schedule(0, [text]() { simTypeLine(text.c_str()); });
+    }
+    for (const SimScript::Command& line : script.getConsoleLines()) {
+        std::string text = line.text;
+        kernel.schedule(line.at_us, [text]() { simTypeLine(text.c_str()); });
+    }
+    if (report) {
+        uint64_t at_us = end_us > _REPORT_US ? end_us - _REPORT_US : 0;
+        for (const char* command : _REPORT_COMMANDS) {
+            kernel.schedule(at_us, [command]() { simTypeLine(command); });
+        }
+    }
+
+    // Arduino-ESP32 runs setup() and loop() on core 1 at priority 1
+    xTaskCreatePinnedToCore(loopTask, "loopTask", 8192, NULL, 1, NULL, 1);
+
+    std::chrono::steady_clock::time_point wall_start = std::chrono::steady_clock::now();
+    uint64_t reached_us = kernel.run(end_us);
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    Serial.flush();
+    double simulated_s = reached_us / 1e6;
+    printf("\nsim: %.3f s simulated in %.3f s (%.0fx)\n", simulated_s, wall_s,
+           wall_s > 0 ? simulated_s / wall_s : 0.0);
+
+    const char* names[] = {"left", "right"};
+    const SimApds9960* sensors[] = {&left, &right};
+    for (int i = 0; i < 2; i++) {
+        printf("sim: %s sensor: %u gesture windows, %u datasets, %u FIFO overflows\n", names[i],
+               sensors[i]->getGestureWindows(), sensors[i]->getDatasets(), sensors[i]->getOverflows());
+    }
+    for (const SimServoStats& servo : simGetServoStats()) {
+        printf("sim: servo pin %d: %u writes, last pulse %d us\n", servo.pin, servo.writes, servo.last_us);
+    }
+    fflush(NULL);
+
+    // The task threads are parked in the kernel for good, leave without joining them
+    _exit(0);
+}
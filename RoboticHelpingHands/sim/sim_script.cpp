@@ -0,0 +1,310 @@
+#include "sim_script.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// Near and far: how long the hand takes to come in, and how long a far retreat drifts
+const uint64_t _APPROACH_US = 300000;
+const uint64_t _RETREAT_US = 300000;
+
+const uint64_t _DEFAULT_SWIPE_US = 300000;
+const uint64_t _DEFAULT_NEAR_HOLD_US = 1000000;
+const uint64_t _DEFAULT_FAR_HOLD_US = 600000;
+
+// Training CSV rows are 20 Hz
+const uint64_t _TRAINING_ROW_US = 50000;
+
+uint8_t clampCount(double value) {
+    if (value <= 0) return 0;
+    if (value >= 255) return 255;
+    return (uint8_t)lround(value);
+}
+
+SimHandSample makeSample(double u, double d, double l, double r) {
+    SimHandSample sample;
+    sample.udlr[0] = clampCount(u);
+    sample.udlr[1] = clampCount(d);
+    sample.udlr[2] = clampCount(l);
+    sample.udlr[3] = clampCount(r);
+    sample.proximity = *std::max_element(sample.udlr, sample.udlr + 4);
+    return sample;
+}
+
+std::vector<std::string> splitCsv(const std::string& line) {
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, ',')) {
+        while (!field.empty() && (field.back() == '\r' || field.back() == ' ')) field.pop_back();
+        fields.push_back(field);
+    }
+    if (!line.empty() && line.back() == ',') fields.push_back("");
+    return fields;
+}
+
+}
+
+uint64_t SimHandTrack::addMotion(Motion motion, uint64_t start_us, uint64_t duration_us, int peak) {
+    Segment segment = {motion, start_us, start_us, duration_us, (double)peak, 0, 0};
+
+    switch (motion) {
+        case MOTION_NEAR:
+            segment.end_us = start_us + _APPROACH_US + duration_us;
+            break;
+        case MOTION_FAR:
+            segment.end_us = start_us + _APPROACH_US + duration_us + _RETREAT_US;
+            break;
+        default:
+            segment.end_us = start_us + duration_us;
+            break;
+    }
+
+    _segments.push_back(segment);
+    return segment.end_us;
+}
+
+uint64_t SimHandTrack::addReplay(uint64_t start_us, const std::vector<std::pair<uint64_t, SimHandSample>>& samples) {
+    if (samples.empty()) return start_us;
+
+    // The last dataset shows for one more dataset period
+    uint64_t period_us = samples.size() > 1 ? samples.back().first - samples[samples.size() - 2].first : 0;
+    Segment segment = {MOTION_REPLAY, start_us, start_us + samples.back().first + period_us, 0, 0,
+                       _replay.size(), samples.size()};
+    _replay.insert(_replay.end(), samples.begin(), samples.end());
+    _segments.push_back(segment);
+    return segment.end_us;
+}
+
+SimHandSample SimHandTrack::sample(uint64_t t_us) const {
+    // Later commands win where they overlap
+    for (auto it = _segments.rbegin(); it != _segments.rend(); ++it) {
+        if (t_us < it->start_us || t_us >= it->end_us) continue;
+        if (it->motion != MOTION_REPLAY) return sampleMotion(*it, t_us);
+
+        auto first = _replay.begin() + it->first_sample;
+        auto last = first + it->sample_count;
+        uint64_t offset_us = t_us - it->start_us;
+        auto next = std::upper_bound(first, last, offset_us,
+                                     [](uint64_t t, const std::pair<uint64_t, SimHandSample>& entry) {
+                                         return t < entry.first;
+                                     });
+        if (next != first) return (next - 1)->second;
+    }
+    return SimHandSample{};
+}
+
+SimHandSample SimHandTrack::sampleMotion(const Segment& segment, uint64_t t_us) {
+    double t = (double)(t_us - segment.start_us);
+    double peak = segment.peak;
+
+    if (segment.motion == MOTION_NEAR || segment.motion == MOTION_FAR) {
+        // Coming in: near drifts off centre so the decoder counts far batches first,
+        // far comes straight in so its drift is all on the way out
+        if (t < _APPROACH_US) {
+            double in = t / _APPROACH_US;
+            double v = peak * in;
+            double skew = segment.motion == MOTION_NEAR ? 0.15 * (1.0 - in) : 0.0;
+            return makeSample(v * (1 + skew), v * (1 - skew), v * (1 + skew * 0.7), v * (1 - skew * 0.7));
+        }
+        t -= _APPROACH_US;
+
+        // Holding still gives the zero delta batches both need
+        if (t < segment.hold_us || segment.motion == MOTION_NEAR) {
+            return makeSample(peak, peak, peak, peak);
+        }
+        t -= segment.hold_us;
+
+        // Far: backs off while drifting on both axes, then is gone at once
+        double out = t / _RETREAT_US;
+        double v = peak * (1.0 - 0.5 * out);
+        double skew = 0.4 * out;
+        return makeSample(v * (1 + skew), v * (1 - skew), v * (1 + skew), v * (1 - skew));
+    }
+
+    // Swipe: the hand crosses from the leading photodiode to the trailing one, the
+    // other pair sees it pass in the middle. The decoder reads RIGHT as R before L
+    // and DOWN as D before U
+    double p = t / (double)(segment.end_us - segment.start_us);
+    double envelope = peak * sin(M_PI * p);
+    double lead = envelope * (1.0 - p);
+    double trail = envelope * p;
+    double side = envelope * 0.5;
+
+    switch (segment.motion) {
+        case MOTION_SWIPE_UP:
+            return makeSample(lead, trail, side, side);
+        case MOTION_SWIPE_DOWN:
+            return makeSample(trail, lead, side, side);
+        case MOTION_SWIPE_LEFT:
+            return makeSample(side, side, lead, trail);
+        case MOTION_SWIPE_RIGHT:
+        default:
+            return makeSample(side, side, trail, lead);
+    }
+}
+
+SimScript::SimScript() :
+    _endUs(0),
+    _lastMotionUs(0)
+{}
+
+bool SimScript::load(const char* path) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "sim: cannot open script %s\n", path);
+        return false;
+    }
+
+    uint64_t previous_end_us = 0;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+
+        std::istringstream words(line);
+        std::string when;
+        if (!(words >> when)) continue;
+
+        bool relative = when[0] == '+';
+        char* end = NULL;
+        double ms = strtod(when.c_str() + (relative ? 1 : 0), &end);
+        if (end == NULL || *end != '\0' || ms < 0) {
+            fprintf(stderr, "sim: %s:%d: bad time '%s'\n", path, line_number, when.c_str());
+            return false;
+        }
+        uint64_t at_us = (relative ? previous_end_us : 0) + (uint64_t)(ms * 1000);
+
+        std::string what;
+        words >> what;
+        if (what == "type") {
+            std::string text;
+            std::getline(words >> std::ws, text);
+            _lines.push_back({at_us, text});
+            previous_end_us = at_us;
+            continue;
+        }
+        if (what == "end") {
+            _endUs = at_us;
+            previous_end_us = at_us;
+            continue;
+        }
+
+        int sensor = what == "left" ? 0 : (what == "right" ? 1 : -1);
+        std::string action;
+        words >> action;
+        if (sensor < 0 || action.empty()) {
+            fprintf(stderr, "sim: %s:%d: expected left|right, type or end\n", path, line_number);
+            return false;
+        }
+
+        uint64_t end_us;
+        if (action == "swipe") {
+            std::string direction;
+            double duration_ms;
+            int peak;
+            words >> direction;
+            if (!(words >> duration_ms)) duration_ms = _DEFAULT_SWIPE_US / 1000.0;
+            if (!(words >> peak)) peak = SimHandTrack::DEFAULT_PEAK;
+
+            SimHandTrack::Motion motion;
+            if (direction == "up") motion = SimHandTrack::MOTION_SWIPE_UP;
+            else if (direction == "down") motion = SimHandTrack::MOTION_SWIPE_DOWN;
+            else if (direction == "left") motion = SimHandTrack::MOTION_SWIPE_LEFT;
+            else if (direction == "right") motion = SimHandTrack::MOTION_SWIPE_RIGHT;
+            else {
+                fprintf(stderr, "sim: %s:%d: bad swipe direction '%s'\n", path, line_number, direction.c_str());
+                return false;
+            }
+            end_us = _tracks[sensor].addMotion(motion, at_us, (uint64_t)(duration_ms * 1000), peak);
+        } else if (action == "near" || action == "far") {
+            bool near = action == "near";
+            double hold_ms;
+            int peak;
+            if (!(words >> hold_ms)) hold_ms = (near ? _DEFAULT_NEAR_HOLD_US : _DEFAULT_FAR_HOLD_US) / 1000.0;
+            if (!(words >> peak)) peak = SimHandTrack::DEFAULT_PEAK;
+            end_us = _tracks[sensor].addMotion(near ? SimHandTrack::MOTION_NEAR : SimHandTrack::MOTION_FAR,
+                                               at_us, (uint64_t)(hold_ms * 1000), peak);
+        } else if (action == "replay") {
+            std::string csv;
+            std::string recorded = what;
+            words >> csv >> recorded;
+
+            std::vector<std::pair<uint64_t, SimHandSample>> samples;
+            if (!loadReplay(csv, recorded, samples)) {
+                fprintf(stderr, "sim: %s:%d: cannot replay '%s'\n", path, line_number, csv.c_str());
+                return false;
+            }
+            end_us = _tracks[sensor].addReplay(at_us, samples);
+        } else {
+            fprintf(stderr, "sim: %s:%d: bad action '%s'\n", path, line_number, action.c_str());
+            return false;
+        }
+
+        previous_end_us = end_us;
+        _lastMotionUs = std::max(_lastMotionUs, end_us);
+    }
+
+    return true;
+}
+
+bool SimScript::loadReplay(const std::string& path, const std::string& sensor,
+                           std::vector<std::pair<uint64_t, SimHandSample>>& samples, uint32_t* first_us) {
+    std::ifstream file(path);
+    std::string line;
+    if (!file || !std::getline(file, line)) return false;
+
+    std::vector<std::string> header = splitCsv(line);
+    auto column = [&header](const char* name) {
+        auto it = std::find(header.begin(), header.end(), name);
+        return it == header.end() ? -1 : (int)(it - header.begin());
+    };
+    int sensor_column = column("sensor");
+    int time_column = column("timestamp_us");
+    int proximity_column = column("proximity");
+    int udlr_columns[4] = {column("up"), column("down"), column("left"), column("right")};
+    if (proximity_column < 0 || udlr_columns[0] < 0 || udlr_columns[1] < 0 ||
+        udlr_columns[2] < 0 || udlr_columns[3] < 0) {
+        return false;
+    }
+
+    std::string wanted = sensor == "left" ? "0" : (sensor == "right" ? "1" : sensor);
+    bool raw = sensor_column >= 0 && time_column >= 0;
+    uint32_t start_us = 0;
+    uint64_t row = 0;
+
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields = splitCsv(line);
+        if (fields.size() < header.size()) continue;
+
+        SimHandSample sample = {};
+        for (int i = 0; i < 4; i++) sample.udlr[i] = clampCount(atof(fields[udlr_columns[i]].c_str()));
+        sample.proximity = clampCount(atof(fields[proximity_column].c_str()));
+
+        uint64_t offset_us;
+        if (raw) {
+            // Rows with empty U/D/L/R are frames without datasets
+            if (fields[sensor_column] != wanted || fields[udlr_columns[0]].empty()) continue;
+
+            uint32_t timestamp_us = (uint32_t)strtoul(fields[time_column].c_str(), NULL, 10);
+            if (samples.empty()) start_us = timestamp_us;
+            offset_us = (uint32_t)(timestamp_us - start_us);
+        } else {
+            offset_us = row++ * _TRAINING_ROW_US;
+        }
+
+        // PDATA is not updated in gesture mode, the datasets say better whether a hand is there
+        sample.proximity = std::max(sample.proximity, *std::max_element(sample.udlr, sample.udlr + 4));
+        samples.push_back(std::make_pair(offset_us, sample));
+    }
+
+    if (first_us != NULL) *first_us = start_us;
+    return !samples.empty();
+}
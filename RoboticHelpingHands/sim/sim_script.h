@@ -0,0 +1,144 @@
+#ifndef SIM_SCRIPT_H
+#define SIM_SCRIPT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief   what one sensor sees at an instant
+ */
+struct SimHandSample {
+    uint8_t proximity;
+    uint8_t udlr[4];    // photodiode counts, U/D/L/R like a FIFO dataset
+};
+
+/**
+ * @brief   what a hand does over one sensor: generated motions and replayed recordings,
+ *          nothing between them
+ */
+class SimHandTrack {
+public:
+    enum Motion {
+        MOTION_SWIPE_UP = 0,
+        MOTION_SWIPE_DOWN,
+        MOTION_SWIPE_LEFT,
+        MOTION_SWIPE_RIGHT,
+        MOTION_NEAR,
+        MOTION_FAR,
+        MOTION_REPLAY
+    };
+
+    // Peak photodiode count of a hand right over the sensor, well past GPENTH and GEXTH
+    static const int DEFAULT_PEAK = 200;
+
+    /**
+     * @brief   adds a generated motion
+     * @param[in]   motion: what the hand does, not MOTION_REPLAY
+     * @param[in]   start_us: virtual time the hand arrives
+     * @param[in]   duration_us: swipe length or hold time
+     * @param[in]   peak: photodiode count at its closest, higher is a nearer hand, clipped at 255
+     * @returns virtual time the hand is gone again
+     */
+    uint64_t addMotion(Motion motion, uint64_t start_us, uint64_t duration_us, int peak = DEFAULT_PEAK);
+
+    /**
+     * @brief   adds recorded datasets, each shown until the next one's timestamp
+     * @param[in]   start_us: virtual time of the first dataset
+     * @param[in]   samples: datasets with timestamps relative to the first
+     * @returns virtual time the recording ends
+     */
+    uint64_t addReplay(uint64_t start_us, const std::vector<std::pair<uint64_t, SimHandSample>>& samples);
+
+    /**
+     * @brief   samples the hand
+     * @param[in]   t_us: virtual time
+     * @returns photodiode counts, all 0 with no hand
+     */
+    SimHandSample sample(uint64_t t_us) const;
+
+private:
+    struct Segment {
+        Motion motion;
+        uint64_t start_us;
+        uint64_t end_us;
+        uint64_t hold_us;
+        double peak;
+        size_t first_sample;    // MOTION_REPLAY only, into _replay
+        size_t sample_count;
+    };
+
+    std::vector<Segment> _segments;
+    std::vector<std::pair<uint64_t, SimHandSample>> _replay;
+
+    static SimHandSample sampleMotion(const Segment& segment, uint64_t t_us);
+};
+
+/**
+ * @brief   timed script of hand motions and console input
+ *
+ * One command a line, '#' starts a comment. Times are milliseconds from the start,
+ * or from the end of the previous command with a leading '+':
+ *
+ *   <ms> left|right swipe up|down|left|right [duration ms] [peak]
+ *   <ms> left|right near|far [hold ms] [peak]
+ *   <ms> left|right replay <csv> [sensor]
+ *   <ms> type <console line>
+ *   <ms> end
+ *
+ * Replay takes the raw CSV of the serial logger (with a sensor column, optionally
+ * filtered by [sensor]) or the proximity,up,down,left,right training CSV at 20 Hz.
+ * [peak] is the photodiode count with the hand closest, 200 by default; the sensor
+ * clips at 255, so a near hand is 250 or so and a far one 120.
+ */
+class SimScript {
+public:
+    struct Command {
+        uint64_t at_us;
+        std::string text;    // console line of a type command
+    };
+
+    SimScript();
+
+    /**
+     * @brief   loads a script file
+     * @param[in]   path: script to read
+     * @returns false with a message on stderr if a line does not parse
+     */
+    bool load(const char* path);
+
+    const SimHandTrack& getTrack(int sensor) const { return _tracks[sensor]; }
+    const std::vector<Command>& getConsoleLines() const { return _lines; }
+
+    /**
+     * @brief   gets the virtual time the script asked to stop at
+     * @returns microseconds, 0 if it never said
+     */
+    uint64_t getEndUs() const { return _endUs; }
+
+    /**
+     * @brief   gets the virtual time the last hand motion is over
+     * @returns microseconds
+     */
+    uint64_t getLastMotionUs() const { return _lastMotionUs; }
+
+    /**
+     * @brief   reads a recording the way replay does
+     * @param[in]   path: raw or training CSV
+     * @param[in]   sensor: left, right or a sensor column value, raw CSV only
+     * @param[out]  samples: datasets with timestamps relative to the first
+     * @param[out]  first_us: timestamp_us of the first dataset, 0 for a training CSV; lines
+     *              up the two sensors of one raw recording, NULL if not needed
+     * @returns false if the file has no usable rows
+     */
+    static bool loadReplay(const std::string& path, const std::string& sensor,
+                           std::vector<std::pair<uint64_t, SimHandSample>>& samples, uint32_t* first_us = NULL);
+
+private:
+    SimHandTrack _tracks[2];    // left, right
+    std::vector<Command> _lines;
+    uint64_t _endUs;
+    uint64_t _lastMotionUs;
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include <Wire.h>
+#include <map>
+#include <utility>
+#include "sim_kernel.h"
+#include "sim_i2c.h"
+
+namespace {
+
+std::map<std::pair<uint8_t, uint16_t>, SimI2CDevice*> devices;
+
+SimI2CDevice* findDevice(uint8_t bus_num, uint16_t address) {
+    auto it = devices.find(std::make_pair(bus_num, address));
+    return it != devices.end() ? it->second : NULL;
+}
+
+}
+
+void simAttachI2CDevice(uint8_t bus_num, uint16_t address, SimI2CDevice* device) {
+    devices[std::make_pair(bus_num, address)] = device;
+}
+
+TwoWire Wire(0);
+TwoWire Wire1(1);
+
+TwoWire::TwoWire(uint8_t bus_num) :
+    _busNum(bus_num),
+    _frequency(100000),
+    _address(0),
+    _transmitting(false),
+    _txBuffer{},
+    _txLength(0),
+    _rxBuffer{},
+    _rxLength(0),
+    _rxIndex(0)
+{}
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency) {
+    if (frequency != 0) _frequency = frequency;
+    return true;
+}
+
+bool TwoWire::end() {
+    return true;
+}
+
+bool TwoWire::setClock(uint32_t frequency) {
+    if (frequency == 0) return false;
+    _frequency = frequency;
+    return true;
+}
+
+void TwoWire::beginTransmission(uint16_t address) {
+    _address = address;
+    _transmitting = true;
+    _txLength = 0;
+}
+
+uint8_t TwoWire::endTransmission(bool send_stop) {
+    if (!_transmitting) return 4;
+    _transmitting = false;
+
+    waitBusTime(_txLength);
+
+    // Arduino-ESP32 codes: 2 is a NACK on the address
+    SimI2CDevice* device = findDevice(_busNum, _address);
+    if (device == NULL) return 2;
+    device->write(_txBuffer, _txLength);
+    return 0;
+}
+
+size_t TwoWire::requestFrom(uint16_t address, size_t size, bool send_stop) {
+    if (size > I2C_BUFFER_LENGTH) size = I2C_BUFFER_LENGTH;
+    _rxIndex = 0;
+    _rxLength = 0;
+
+    waitBusTime(size);
+
+    SimI2CDevice* device = findDevice(_busNum, address);
+    if (device == NULL) return 0;
+    device->read(_rxBuffer, size);
+    _rxLength = size;
+    return size;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (!_transmitting || _txLength >= I2C_BUFFER_LENGTH) return 0;
+    _txBuffer[_txLength++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t length) {
+    size_t written = 0;
+    while (written < length && write(data[written]) == 1) written++;
+    return written;
+}
+
+int TwoWire::available() {
+    return (int)(_rxLength - _rxIndex);
+}
+
+int TwoWire::read() {
+    return _rxIndex < _rxLength ? _rxBuffer[_rxIndex++] : -1;
+}
+
+int TwoWire::peek() {
+    return _rxIndex < _rxLength ? _rxBuffer[_rxIndex] : -1;
+}
+
+void TwoWire::flush() {
+    _rxIndex = 0;
+    _rxLength = 0;
+    _txLength = 0;
+}
+
+void TwoWire::waitBusTime(size_t bytes) {
+    // Start, address, data and stop: 9 clocks a byte counting the ACK
+    uint64_t bits = (bytes + 1) * 9 + 2;
+    SimKernel::instance().sleepFor(bits * 1000000 / _frequency);
+}
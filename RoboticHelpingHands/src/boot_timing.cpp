@@ -0,0 +1,87 @@
+#include "boot_timing.h"
+
+BootProfiler::BootProfiler() :
+    _phases{},
+    _count(0),
+    _readyUs(0)
+{}
+
+int BootProfiler::beginPhase(const char* name) {
+    uint32_t now = micros();
+    int id = -1;
+
+    portENTER_CRITICAL(&_lock);
+    if (_count < MAX_PHASES) {
+        id = _count++;
+        _phases[id] = {name, now, 0, (int)xPortGetCoreID(), false};
+    }
+    portEXIT_CRITICAL(&_lock);
+
+    return id;
+}
+
+void BootProfiler::endPhase(int id) {
+    if (id < 0 || id >= _count) return;
+
+    uint32_t now = micros();
+    portENTER_CRITICAL(&_lock);
+    _phases[id].end_us = now;
+    _phases[id].done = true;
+    portEXIT_CRITICAL(&_lock);
+}
+
+void BootProfiler::markReady() {
+    _readyUs = micros();
+}
+
+bool BootProfiler::getPhase(int index, Phase& phase) {
+    if (index < 0 || index >= _count) return false;
+
+    portENTER_CRITICAL(&_lock);
+    phase = _phases[index];
+    portEXIT_CRITICAL(&_lock);
+    return true;
+}
+
+void BootProfiler::printReport() {
+    uint32_t end_us = _readyUs;
+    for (int i = 0; i < _count; i++) {
+        Phase phase;
+        if (getPhase(i, phase) && phase.done && phase.end_us > end_us) end_us = phase.end_us;
+    }
+    if (end_us == 0) end_us = micros();
+    if (end_us == 0) end_us = 1;    // everything at reset, as on the sim's clock
+
+    Serial.println("\n=== BOOT TIMING ===");
+    Serial.println("phase               core    start ms  length ms");
+
+    for (int i = 0; i < _count; i++) {
+        Phase phase;
+        if (!getPhase(i, phase)) continue;
+
+        bool running = !phase.done;
+        uint32_t stop_us = running ? end_us : phase.end_us;
+
+        char bar[_BAR_WIDTH + 1];
+        int from = (int)((uint64_t)phase.start_us * _BAR_WIDTH / end_us);
+        int to = (int)((uint64_t)stop_us * _BAR_WIDTH / end_us);
+        for (int c = 0; c < _BAR_WIDTH; c++) {
+            bar[c] = (c >= from && (c < to || c == from)) ? '#' : '.';
+        }
+        bar[_BAR_WIDTH] = '\0';
+
+        Serial.printf("%-18s  %4d  %10.1f  %9.1f%s |%s|\n",
+                      phase.name,
+                      phase.core,
+                      phase.start_us / 1000.0,
+                      (stop_us - phase.start_us) / 1000.0,
+                      running ? "+" : " ",
+                      bar);
+    }
+
+    if (_readyUs != 0) {
+        Serial.printf("Ready for gestures %lu ms after reset\n", (unsigned long)getReadyMs());
+    } else {
+        Serial.println("Not ready yet");
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef BOOT_TIMING_H
+#define BOOT_TIMING_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * @brief   records start and end of each boot phase, phases on both cores may overlap
+ */
+class BootProfiler {
+public:
+    static const int MAX_PHASES = 12;
+
+    /**
+     * @brief   one timed phase, times in microseconds since reset
+     */
+    struct Phase {
+        const char* name;
+        uint32_t start_us;
+        uint32_t end_us;    // valid once done
+        int core;
+        bool done;          // endPhase() was called
+    };
+
+    BootProfiler();
+
+    /**
+     * @brief   starts timing a phase, safe to call from either core
+     * @param[in]   name: phase label, must outlive the profiler
+     * @returns phase id for endPhase(), -1 if the table is full
+     */
+    int beginPhase(const char* name);
+
+    /**
+     * @brief   stops timing a phase
+     * @param[in]   id: phase id from beginPhase()
+     * @returns none
+     */
+    void endPhase(int id);
+
+    /**
+     * @brief   marks the arm as ready to take gestures
+     * @returns none
+     */
+    void markReady();
+
+    /**
+     * @brief   gets time from reset to markReady()
+     * @returns milliseconds to ready, 0 if not ready yet
+     */
+    uint32_t getReadyMs() const { return _readyUs / 1000; }
+
+    /**
+     * @brief   gets a recorded phase
+     * @param[in]   index: phase index from 0 to getPhaseCount() - 1
+     * @param[out]  phase: copy of the phase
+     * @returns true if index is valid
+     */
+    bool getPhase(int index, Phase& phase);
+
+    /**
+     * @brief   gets number of recorded phases
+     * @returns phase count
+     */
+    int getPhaseCount() const { return _count; }
+
+    /**
+     * @brief   prints the phase table with a bar per phase on a common time axis
+     * @returns none
+     */
+    void printReport();
+
+private:
+    static const int _BAR_WIDTH = 40;
+
+    Phase _phases[MAX_PHASES];
+    volatile int _count;
+    uint32_t _readyUs;
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
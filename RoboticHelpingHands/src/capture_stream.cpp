@@ -0,0 +1,84 @@
+#include "capture_stream.h"
+#include <stdarg.h>
+#include "crc16.h"
+
+CaptureStream::CaptureStream(HardwareSerial& out) :
+    _out(out),
+    _sequence(0),
+    _sent(0),
+    _dropped(0)
+{
+}
+
+void CaptureStream::beginSession(const char* label) {
+    _sent = 0;
+    _dropped = 0;
+
+    int length = strnlen(label, MAX_PAYLOAD);
+    send(FRAME_SESSION_START, SENSOR_NONE, micros(), (const uint8_t*)label, length);
+}
+
+void CaptureStream::endSession() {
+    uint8_t payload[8];
+    uint32_t sent = _sent;
+    uint32_t dropped = _dropped;
+    for (int i = 0; i < 4; i++) {
+        payload[i] = (sent >> (8 * i)) & 0xFF;
+        payload[4 + i] = (dropped >> (8 * i)) & 0xFF;
+    }
+    send(FRAME_SESSION_END, SENSOR_NONE, micros(), payload, sizeof(payload));
+}
+
+void CaptureStream::sendFifo(uint8_t sensor, uint32_t timestamp_us, uint8_t proximity, uint8_t flags,
+                             uint16_t period_us, const uint8_t* datasets, int count) {
+    if (count > MAX_DATASETS) count = MAX_DATASETS;
+
+    uint8_t payload[MAX_PAYLOAD];
+    payload[0] = proximity;
+    payload[1] = flags;
+    payload[2] = period_us & 0xFF;
+    payload[3] = period_us >> 8;
+    memcpy(&payload[FIFO_HEADER], datasets, count * 4);
+    send(FRAME_FIFO, sensor, timestamp_us, payload, FIFO_HEADER + count * 4);
+}
+
+void CaptureStream::skip(uint32_t count) {
+    _sequence += count;
+    _dropped += count;
+}
+
+void CaptureStream::logf(const char* format, ...) {
+    char text[MAX_PAYLOAD + 1];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    if (length < 0) return;
+    if (length > MAX_PAYLOAD) length = MAX_PAYLOAD;
+    send(FRAME_LOG, SENSOR_NONE, micros(), (const uint8_t*)text, length);
+}
+
+void CaptureStream::send(FrameType type, uint8_t sensor, uint32_t timestamp_us, const uint8_t* payload, int length) {
+    int size = _HEADER_SIZE + length + 2;
+    uint16_t sequence = _sequence++;
+
+    _frame[0] = _SYNC_0;
+    _frame[1] = _SYNC_1;
+    _frame[2] = type;
+    _frame[3] = sensor;
+    _frame[4] = sequence & 0xFF;
+    _frame[5] = sequence >> 8;
+    for (int i = 0; i < 4; i++) {
+        _frame[6 + i] = (timestamp_us >> (8 * i)) & 0xFF;
+    }
+    _frame[10] = length;
+    if (length > 0) memcpy(&_frame[_HEADER_SIZE], payload, length);
+
+    uint16_t crc = crc16(&_frame[2], _HEADER_SIZE - 2 + length);
+    _frame[_HEADER_SIZE + length] = crc & 0xFF;
+    _frame[_HEADER_SIZE + length + 1] = crc >> 8;
+
+    _out.write(_frame, size);
+    _sent++;
+}
@@ -0,0 +1,97 @@
+#ifndef CAPTURE_STREAM_H
+#define CAPTURE_STREAM_H
+
+#include <Arduino.h>
+
+/**
+ * @brief   writes training captures to serial as compact CRC checked binary frames
+ *
+ * Frame layout, multi-byte fields little endian:
+ *   0xA5 0x5A | type | sensor | sequence (2) | timestamp us (4) | length | payload | crc16 (2)
+ * The CRC is CRC-16/CCITT-FALSE over type through payload. Frames lost before reaching
+ * the stream still take sequence numbers through skip(), so the host sees a gap wherever
+ * data went missing. serial_listening/serial_csv_logger.py reads it.
+ */
+class CaptureStream {
+public:
+    enum FrameType : uint8_t {
+        FRAME_LOG = 0,              // payload: text for the console
+        FRAME_SESSION_START = 1,    // payload: gesture label
+        FRAME_FIFO = 2,             // payload: proximity, flags, dataset period us (2), U/D/L/R datasets
+        FRAME_SESSION_END = 3       // payload: frames sent (4), frames dropped (4)
+    };
+
+    static constexpr uint8_t SENSOR_NONE = 0xFF;
+    static constexpr uint8_t FLAG_FIFO_FULL = 0x01;    // datasets may have been lost on the sensor
+    static constexpr int MAX_DATASETS = 32;            // APDS9960 FIFO depth
+    static constexpr int FIFO_HEADER = 4;              // proximity, flags, dataset period
+    static constexpr int MAX_PAYLOAD = FIFO_HEADER + MAX_DATASETS * 4;
+
+    CaptureStream(HardwareSerial& out);
+
+    /**
+     * @brief   starts a recording session, the host opens a new file per session
+     * @param[in]   label: gesture name the session is saved under
+     * @returns none
+     */
+    void beginSession(const char* label);
+
+    /**
+     * @brief   ends the current session with its frame counts
+     * @returns none
+     */
+    void endSession();
+
+    /**
+     * @brief   sends everything one sensor poll read, waits for TX space
+     * @param[in]   sensor: sensor index, 0 = left, 1 = right
+     * @param[in]   timestamp_us: micros() when the FIFO was read, the time of the last dataset
+     * @param[in]   proximity: PDATA value
+     * @param[in]   flags: FLAG_* bits
+     * @param[in]   period_us: time between datasets, earlier ones are that much older, 0 if unknown
+     * @param[in]   datasets: U/D/L/R bytes straight from the FIFO
+     * @param[in]   count: number of datasets, at most MAX_DATASETS
+     * @returns none
+     */
+    void sendFifo(uint8_t sensor, uint32_t timestamp_us, uint8_t proximity, uint8_t flags,
+                  uint16_t period_us, const uint8_t* datasets, int count);
+
+    /**
+     * @brief   spends sequence numbers on frames lost before they reached the stream
+     * @param[in]   count: number of frames lost
+     * @returns none
+     */
+    void skip(uint32_t count);
+
+    /**
+     * @brief   sends a printf style console line, waits for TX space rather than dropping
+     * @param[in]   format: printf format string
+     * @returns none
+     */
+    void logf(const char* format, ...);
+
+private:
+    static constexpr uint8_t _SYNC_0 = 0xA5;
+    static constexpr uint8_t _SYNC_1 = 0x5A;
+    static constexpr int _HEADER_SIZE = 11;
+    static constexpr int _MAX_FRAME = _HEADER_SIZE + MAX_PAYLOAD + 2;
+
+    HardwareSerial& _out;
+    uint16_t _sequence;
+    uint32_t _sent;
+    uint32_t _dropped;
+    uint8_t _frame[_MAX_FRAME];
+
+    /**
+     * @brief   builds a frame in _frame and writes it out
+     * @param[in]   type: FrameType
+     * @param[in]   sensor: sensor index or SENSOR_NONE
+     * @param[in]   timestamp_us: device time of the data
+     * @param[in]   payload: payload bytes, may be NULL if length is 0
+     * @param[in]   length: payload length, at most MAX_PAYLOAD
+     * @returns none
+     */
+    void send(FrameType type, uint8_t sensor, uint32_t timestamp_us, const uint8_t* payload, int length);
+};
+
+#endif
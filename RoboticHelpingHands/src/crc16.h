@@ -0,0 +1,16 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief   CRC-16/CCITT-FALSE (polynomial 0x1021, initial 0xFFFF), shared by the
+ *          capture stream frames and the pose journal record
+ * @param[in]   data: bytes to check
+ * @param[in]   length: number of bytes
+ * @returns crc of the bytes
+ */
+uint16_t crc16(const uint8_t* data, size_t length);
+
+#endif
@@ -0,0 +1,202 @@
+#include "fifo_capture.h"
+#include <stddef.h>
+
+FifoCapture::FifoCapture(CaptureStream& stream) :
+    _stream(stream),
+    _sensorCount(0),
+    _ring(NULL),
+    _timer(NULL),
+    _captureTaskHandle(NULL),
+    _writerTaskHandle(NULL),
+    _pollUs(0),
+    _running(false),
+    _polling(false),
+    _pushed(0),
+    _written(0),
+    _ringDrops(0),
+    _reportedDrops(0),
+    _lateTicks(0),
+    _minFreeBytes(_RING_BYTES)
+{
+}
+
+bool FifoCapture::addSensor(SparkFun_APDS9960& apds, uint8_t id) {
+    if (_sensorCount >= MAX_SENSORS) return false;
+
+    _sensors[_sensorCount] = {&apds, id, 0, 0, 0, 0, 0, 0};
+    _sensorCount++;
+    return true;
+}
+
+bool FifoCapture::begin(uint32_t poll_us) {
+    _pollUs = poll_us;
+
+    _ring = xRingbufferCreate(_RING_BYTES, RINGBUF_TYPE_NOSPLIT);
+    if (_ring == NULL) return false;
+
+    BaseType_t created = xTaskCreatePinnedToCore(captureTask, "FifoCapture", 4096, this,
+                                                 _CAPTURE_PRIORITY, &_captureTaskHandle, _CAPTURE_CORE);
+    if (created != pdPASS) return false;
+
+    created = xTaskCreatePinnedToCore(writerTask, "FifoWriter", 4096, this,
+                                      _WRITER_PRIORITY, &_writerTaskHandle, _WRITER_CORE);
+    if (created != pdPASS) return false;
+
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = timerCallback;
+    timer_args.arg = this;
+    timer_args.dispatch_method = ESP_TIMER_TASK;
+    timer_args.name = "fifo_poll";
+    return esp_timer_create(&timer_args, &_timer) == ESP_OK;
+}
+
+void FifoCapture::start() {
+    for (int i = 0; i < _sensorCount; i++) {
+        SensorState& sensor = _sensors[i];
+        sensor.last_read_us = micros();
+        sensor.last_count = 0;
+        sensor.datasets = 0;
+        sensor.fifo_full = 0;
+        sensor.i2c_errors = 0;
+
+        // Whatever piled up before the session is not part of it
+        uint8_t discard[CaptureStream::MAX_DATASETS * 4];
+        sensor.apds->readGestureFifo(discard, CaptureStream::MAX_DATASETS);
+    }
+    _pushed = 0;
+    _written = 0;
+    _ringDrops = 0;
+    _reportedDrops = 0;
+    _lateTicks = 0;
+    _minFreeBytes = _RING_BYTES;
+
+    _running = true;
+    esp_timer_start_periodic(_timer, _pollUs);
+}
+
+void FifoCapture::stop() {
+    _running = false;
+    esp_timer_stop(_timer);
+
+    // Lets the poll in flight finish, then the writer catch up with it
+    while (_polling) vTaskDelay(1);
+    while (_written != _pushed) vTaskDelay(1);
+
+    // Drops after the last record never reached writeRecord()
+    _stream.skip(_ringDrops - _reportedDrops);
+    _reportedDrops = _ringDrops;
+}
+
+void FifoCapture::printStats(uint32_t elapsed_us) {
+    float seconds = elapsed_us / 1000000.0f;
+    if (seconds <= 0) seconds = 1;
+
+    for (int i = 0; i < _sensorCount; i++) {
+        const SensorState& sensor = _sensors[i];
+        _stream.logf("sensor %u: %u datasets (%.0f/s, period %u us), %u FIFO full, %u I2C errors",
+                     sensor.id, (unsigned)sensor.datasets, sensor.datasets / seconds,
+                     sensor.period_us, (unsigned)sensor.fifo_full, (unsigned)sensor.i2c_errors);
+    }
+    _stream.logf("ring: %u records, %u dropped, %u of %u bytes used at most, %u late polls",
+                 (unsigned)_pushed, (unsigned)_ringDrops, (unsigned)(_RING_BYTES - _minFreeBytes),
+                 (unsigned)_RING_BYTES, (unsigned)_lateTicks);
+}
+
+void FifoCapture::timerCallback(void* arg) {
+    FifoCapture* capture = static_cast<FifoCapture*>(arg);
+    xTaskNotifyGive(capture->_captureTaskHandle);
+}
+
+void FifoCapture::captureTask(void* parameter) {
+    FifoCapture* capture = static_cast<FifoCapture*>(parameter);
+
+    while (true) {
+        uint32_t ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Set before checking _running so stop() cannot miss a poll that is starting
+        capture->_polling = true;
+        if (capture->_running) {
+            if (ticks > 1) capture->_lateTicks += ticks - 1;
+            for (int i = 0; i < capture->_sensorCount; i++) {
+                capture->pollSensor(capture->_sensors[i]);
+            }
+        }
+        capture->_polling = false;
+    }
+}
+
+void FifoCapture::writerTask(void* parameter) {
+    FifoCapture* capture = static_cast<FifoCapture*>(parameter);
+
+    while (true) {
+        size_t size = 0;
+        CaptureRecord* record = (CaptureRecord*)xRingbufferReceive(capture->_ring, &size, portMAX_DELAY);
+        if (record == NULL) continue;
+
+        capture->writeRecord(*record);
+        vRingbufferReturnItem(capture->_ring, record);
+        capture->_written = capture->_written + 1;
+    }
+}
+
+void FifoCapture::pollSensor(SensorState& sensor) {
+    CaptureRecord record;
+    record.sensor = sensor.id;
+    record.flags = 0;
+
+    if (!sensor.apds->readProximity(record.proximity)) {
+        record.proximity = 0;
+        sensor.i2c_errors++;
+    }
+
+    int count = sensor.apds->readGestureFifo(record.datasets, CaptureStream::MAX_DATASETS);
+    uint32_t now = micros();
+    if (count < 0) {
+        count = 0;
+        sensor.i2c_errors++;
+    }
+    if (count >= CaptureStream::MAX_DATASETS) {
+        record.flags |= CaptureStream::FLAG_FIFO_FULL; // polled too late, the sensor may have overwritten data
+        sensor.fifo_full++;
+    }
+
+    // Only a FIFO that kept filling since a read that emptied it says how fast datasets come
+    if (count > 0 && sensor.last_count > 0 && sensor.last_count < CaptureStream::MAX_DATASETS) {
+        uint32_t estimate = (now - sensor.last_read_us) / count;
+        if (estimate > 0xFFFF) estimate = 0xFFFF;
+        if (sensor.period_us == 0) {
+            sensor.period_us = estimate;
+        } else {
+            sensor.period_us += ((int32_t)estimate - (int32_t)sensor.period_us) / _PERIOD_SMOOTHING;
+        }
+    }
+    sensor.last_read_us = now;
+    sensor.last_count = count;
+    sensor.datasets += count;
+
+    record.timestamp_us = now;
+    record.period_us = sensor.period_us;
+    record.count = count;
+
+    size_t size = offsetof(CaptureRecord, datasets) + count * 4;
+    if (xRingbufferSend(_ring, &record, size, 0) == pdTRUE) {
+        _pushed = _pushed + 1;
+    } else {
+        _ringDrops = _ringDrops + 1;
+    }
+
+    size_t free_bytes = xRingbufferGetCurFreeSize(_ring);
+    if (free_bytes < _minFreeBytes) _minFreeBytes = free_bytes;
+}
+
+void FifoCapture::writeRecord(const CaptureRecord& record) {
+    // Spends the sequence numbers of dropped records so the host sees where the gap is
+    uint32_t drops = _ringDrops;
+    if (drops != _reportedDrops) {
+        _stream.skip(drops - _reportedDrops);
+        _reportedDrops = drops;
+    }
+
+    _stream.sendFifo(record.sensor, record.timestamp_us, record.proximity, record.flags,
+                     record.period_us, record.datasets, record.count);
+}
@@ -0,0 +1,146 @@
+#ifndef FIFO_CAPTURE_H
+#define FIFO_CAPTURE_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <SparkFun_APDS9960.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "esp_timer.h"
+#include "capture_stream.h"
+
+/**
+ * @brief   timer driven raw capture of whole gesture FIFOs for training recordings
+ *
+ * A periodic esp_timer wakes the capture task, which block reads every sensor's FIFO and
+ * pushes the batch into a ring buffer without ever waiting on serial. A writer task on the
+ * other core drains the ring into the CaptureStream, so the sample rate is set by I2C and
+ * the serial line only shows up as ring fill, and as dropped frames if it overflows.
+ */
+class FifoCapture {
+public:
+    static constexpr int MAX_SENSORS = 2;
+
+    FifoCapture(CaptureStream& stream);
+
+    /**
+     * @brief   adds a sensor that is already initialised with its gesture engine enabled
+     * @param[in]   apds: sensor to read
+     * @param[in]   id: sensor id written into its frames
+     * @returns true if there was room for it
+     */
+    bool addSensor(SparkFun_APDS9960& apds, uint8_t id);
+
+    /**
+     * @brief   creates the ring buffer, tasks and timer, call once after adding sensors
+     * @param[in]   poll_us: time between FIFO reads of each sensor
+     * @returns true if everything was created
+     */
+    bool begin(uint32_t poll_us);
+
+    /**
+     * @brief   clears the statistics and starts polling
+     * @returns none
+     */
+    void start();
+
+    /**
+     * @brief   stops polling and waits until the writer has sent everything captured
+     * @returns none
+     */
+    void stop();
+
+    /**
+     * @brief   logs rates, ring use and losses of the last capture through the stream
+     * @param[in]   elapsed_us: length of the capture
+     * @returns none
+     */
+    void printStats(uint32_t elapsed_us);
+
+private:
+    // One sensor poll as it sits in the ring, only count datasets of it are stored
+    struct CaptureRecord {
+        uint32_t timestamp_us;
+        uint16_t period_us;
+        uint8_t sensor;
+        uint8_t proximity;
+        uint8_t flags;
+        uint8_t count;
+        uint8_t datasets[CaptureStream::MAX_DATASETS * 4];
+    };
+
+    struct SensorState {
+        SparkFun_APDS9960* apds;
+        uint8_t id;
+        uint32_t last_read_us;
+        uint8_t last_count;
+        uint16_t period_us;     // running estimate of the time between datasets
+        uint32_t datasets;
+        uint32_t fifo_full;
+        uint32_t i2c_errors;
+    };
+
+    static constexpr size_t _RING_BYTES = 16384;           // ~110 full-FIFO polls
+    static constexpr UBaseType_t _CAPTURE_PRIORITY = 3;     // above the writer, polls stay on time
+    static constexpr UBaseType_t _WRITER_PRIORITY = 2;
+    static constexpr BaseType_t _CAPTURE_CORE = 1;
+    static constexpr BaseType_t _WRITER_CORE = 0;
+    static constexpr int _PERIOD_SMOOTHING = 8;             // EWMA weight 1/8 per new estimate
+
+    CaptureStream& _stream;
+    SensorState _sensors[MAX_SENSORS];
+    int _sensorCount;
+
+    RingbufHandle_t _ring;
+    esp_timer_handle_t _timer;
+    TaskHandle_t _captureTaskHandle;
+    TaskHandle_t _writerTaskHandle;
+    uint32_t _pollUs;
+
+    volatile bool _running;
+    volatile bool _polling;         // capture task is between wake up and its last ring push
+    volatile uint32_t _pushed;      // records in the ring so far, capture task only
+    volatile uint32_t _written;     // records sent so far, writer task only
+    volatile uint32_t _ringDrops;   // records the ring had no room for, capture task only
+    uint32_t _reportedDrops;        // drops already skipped on the stream
+    uint32_t _lateTicks;
+    size_t _minFreeBytes;
+
+    /**
+     * @brief   wakes the capture task, runs in the esp_timer task
+     * @param[in]   arg: FifoCapture instance
+     * @returns none
+     */
+    static void timerCallback(void* arg);
+
+    /**
+     * @brief   FreeRTOS task polling every sensor once per timer wake up
+     * @param[in]   parameter: pointer to FifoCapture instance
+     * @returns none
+     */
+    static void captureTask(void* parameter);
+
+    /**
+     * @brief   FreeRTOS task draining the ring into the stream
+     * @param[in]   parameter: pointer to FifoCapture instance
+     * @returns none
+     */
+    static void writerTask(void* parameter);
+
+    /**
+     * @brief   reads one sensor's proximity and FIFO into the ring
+     * @param[in]   sensor: sensor to poll
+     * @returns none
+     */
+    void pollSensor(SensorState& sensor);
+
+    /**
+     * @brief   sends one ring record, first accounting for any records the ring dropped
+     * @param[in]   record: record taken from the ring
+     * @returns none
+     */
+    void writeRecord(const CaptureRecord& record);
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <type_traits>
+
+/**
+ * @brief   single producer, multi consumer ring that never blocks the producer
+ *
+ * The producer overwrites the oldest frame when the ring is full. Each consumer keeps
+ * its own Cursor, reads frames in place, and finds out from release() whether the
+ * producer lapped it mid-read. Slots are seqlocks like ServoMotionEngine's mailboxes:
+ * odd while being written, 2 * (index + 1) once frame number index is in them.
+ *
+ * @tparam  T: frame type, copied by assignment so it must be trivially copyable
+ * @tparam  N: slot count, a power of two
+ */
+template <typename T, size_t N>
+class FrameRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "FrameRing size must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "FrameRing frames are copied without constructors");
+
+public:
+    // Host line size; internal ESP32 RAM is uncached, so there it only costs padding
+    static constexpr size_t CACHE_LINE = 64;
+
+    /**
+     * @brief   one consumer's read position, owned by that consumer alone
+     */
+    struct Cursor {
+        uint32_t next;        // number of the next frame to read
+        uint32_t overruns;    // frames overwritten before this consumer read them
+    };
+
+    FrameRing() : _head(0) {
+        for (size_t i = 0; i < N; i++) {
+            _slots[i].sequence.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief   gets a cursor that starts at the next frame published
+     * @returns new cursor
+     */
+    Cursor attach() const {
+        return Cursor{_head.load(std::memory_order_acquire), 0};
+    }
+
+    /**
+     * @brief   publishes a frame, producer only, overwrites the oldest when full
+     * @param[in]   frame: frame to copy into the ring
+     * @returns none
+     */
+    void publish(const T& frame) {
+        uint32_t index = _head.load(std::memory_order_relaxed);
+        Slot& slot = _slots[index & (N - 1)];
+
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.frame = frame;
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+        _head.store(index + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief   gets the cursor's next frame in place, skipping frames already overwritten
+     * @param[in]   cursor: consumer's cursor
+     * @returns pointer into the ring, NULL if the consumer is caught up
+     */
+    const T* acquire(Cursor& cursor) const {
+        uint32_t head = _head.load(std::memory_order_acquire);
+
+        // The slot of frame head - N is the one the producer writes next
+        if (head - cursor.next >= N) {
+            uint32_t oldest = head - (N - 1);
+            cursor.overruns += oldest - cursor.next;
+            cursor.next = oldest;
+        }
+        if (cursor.next == head) return nullptr;
+
+        return &_slots[cursor.next & (N - 1)].frame;
+    }
+
+    /**
+     * @brief   finishes reading the frame acquire() returned and moves the cursor on
+     * @param[in]   cursor: consumer's cursor
+     * @returns true if the frame was intact for the whole read, false if it must be discarded
+     */
+    bool release(Cursor& cursor) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t sequence = _slots[cursor.next & (N - 1)].sequence.load(std::memory_order_relaxed);
+
+        bool intact = sequence == 2 * cursor.next + 2;
+        if (!intact) cursor.overruns++;
+        cursor.next++;
+        return intact;
+    }
+
+    /**
+     * @brief   copies out the cursor's next intact frame
+     * @param[in]   cursor: consumer's cursor
+     * @param[out]  frame: copy of the frame
+     * @returns true if a frame was read, false if the consumer is caught up
+     */
+    bool read(Cursor& cursor, T& frame) const {
+        const T* slot;
+        while ((slot = acquire(cursor)) != nullptr) {
+            frame = *slot;
+            if (release(cursor)) return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief   gets how many frames have been published
+     * @returns frame count, wraps at 2^32
+     */
+    uint32_t getPublished() const { return _head.load(std::memory_order_acquire); }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        T frame;
+    };
+
+    alignas(CACHE_LINE) std::atomic<uint32_t> _head;    // written by the producer only
+    alignas(CACHE_LINE) Slot _slots[N];
+};
+
+#endif
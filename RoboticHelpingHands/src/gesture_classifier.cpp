@@ -0,0 +1,114 @@
+#include "gesture_classifier.h"
+#include <math.h>
+#include "gesture_model_data.h"
+
+static_assert(sizeof(GESTURE_MODEL_W1) == GestureClassifier::HIDDEN * GestureClassifier::INPUTS,
+              "gesture_model_data.h does not match the classifier input/hidden size");
+static_assert(sizeof(GESTURE_MODEL_W2) == GestureClassifier::CLASSES * GestureClassifier::HIDDEN,
+              "gesture_model_data.h does not match the classifier class count");
+static_assert(GESTURE_MODEL_M1_SHIFT >= 1 && GESTURE_MODEL_M1_SHIFT < 63,
+              "gesture_model_data.h hidden layer shift out of range");
+
+static const char* const CUSTOM_GESTURE_LABELS[CUSTOM_GESTURE_COUNT] = {
+    "double_shake",
+    "double_tap",
+    "palm_down",
+    "palm_up",
+    "swipe_inward",
+    "swipe_outward"
+};
+
+GestureClassifier::GestureClassifier() :
+    _window{},
+    _head(0),
+    _filled(0),
+    _input{},
+    _hidden{},
+    _logits{}
+{}
+
+bool GestureClassifier::isModelTrained() {
+    return GESTURE_MODEL_TRAINED != 0;
+}
+
+void GestureClassifier::reset() {
+    _head = 0;
+    _filled = 0;
+}
+
+void GestureClassifier::push(const GestureFrame& frame) {
+    if (_filled < WINDOW_FRAMES) {
+        _window[(_head + _filled) % WINDOW_FRAMES] = frame;
+        _filled++;
+    } else {
+        _window[_head] = frame;
+        _head = (_head + 1) % WINDOW_FRAMES;
+    }
+}
+
+GestureClassifier::Result GestureClassifier::classify() {
+    Result result = {-1, 0};
+    if (!isModelTrained() || !isWindowFull()) return result;
+
+    // A hand has to come near at some point, anything else is background
+    if (flattenWindow() < GESTURE_MODEL_MIN_PROXIMITY) return result;
+
+    // Hidden layer: uint8 inputs x int8 weights, requantised to uint8 with ReLU
+    for (int h = 0; h < HIDDEN; h++) {
+        const int8_t* weights = GESTURE_MODEL_W1[h];
+        int32_t acc = GESTURE_MODEL_B1[h];
+        for (int i = 0; i < INPUTS; i++) {
+            acc += (int32_t)weights[i] * _input[i];
+        }
+
+        int64_t scaled = (int64_t)acc * GESTURE_MODEL_M1_MULTIPLIER;
+        scaled = (scaled + ((int64_t)1 << (GESTURE_MODEL_M1_SHIFT - 1))) >> GESTURE_MODEL_M1_SHIFT;
+        _hidden[h] = (uint8_t)(scaled < 0 ? 0 : (scaled > 255 ? 255 : scaled));
+    }
+
+    // Output layer
+    int best = 0;
+    for (int c = 0; c < CLASSES; c++) {
+        const int8_t* weights = GESTURE_MODEL_W2[c];
+        int32_t acc = GESTURE_MODEL_B2[c];
+        for (int h = 0; h < HIDDEN; h++) {
+            acc += (int32_t)weights[h] * _hidden[h];
+        }
+        _logits[c] = acc;
+        if (acc > _logits[best]) best = c;
+    }
+
+    // Softmax only for the confidence of the winner, relative to it so expf cannot overflow
+    float sum = 0.0f;
+    for (int c = 0; c < CLASSES; c++) {
+        sum += expf((_logits[c] - _logits[best]) * GESTURE_MODEL_OUTPUT_SCALE);
+    }
+    uint8_t confidence = (uint8_t)(100.0f / sum + 0.5f);
+
+    if (confidence < GESTURE_MODEL_MIN_CONFIDENCE) return result;
+
+    result.gesture = best;
+    result.confidence = confidence;
+    return result;
+}
+
+const char* GestureClassifier::getLabel(int gesture) {
+    if (gesture < 0 || gesture >= CUSTOM_GESTURE_COUNT) return "none";
+    return CUSTOM_GESTURE_LABELS[gesture];
+}
+
+uint8_t GestureClassifier::flattenWindow() {
+    uint8_t max_proximity = 0;
+    uint8_t* out = _input;
+
+    for (int f = 0; f < WINDOW_FRAMES; f++) {
+        const GestureFrame& frame = _window[(_head + f) % WINDOW_FRAMES];
+        *out++ = frame.proximity;
+        *out++ = frame.up;
+        *out++ = frame.down;
+        *out++ = frame.left;
+        *out++ = frame.right;
+        if (frame.proximity > max_proximity) max_proximity = frame.proximity;
+    }
+    return max_proximity;
+}
@@ -0,0 +1,99 @@
+#ifndef GESTURE_CLASSIFIER_H
+#define GESTURE_CLASSIFIER_H
+
+#include <stdint.h>
+#include "gesture_frame.h"
+
+/**
+ * @brief   custom gestures from notes.txt, in the class order the model is trained with
+ */
+enum CustomGesture : uint8_t {
+    GESTURE_DOUBLE_SHAKE = 0,
+    GESTURE_DOUBLE_TAP,
+    GESTURE_PALM_DOWN,
+    GESTURE_PALM_UP,
+    GESTURE_SWIPE_INWARD,
+    GESTURE_SWIPE_OUTWARD,
+    CUSTOM_GESTURE_COUNT
+};
+
+/**
+ * @brief   int8 quantised MLP over a sliding window of sensor frames
+ *
+ * Plain C++ with no Arduino or FreeRTOS dependency so the same code runs on a
+ * host against the recorded CSVs. All buffers live in the object, nothing is
+ * allocated. Weights come from gesture_model_data.h, generated by
+ * serial_listening/train_gesture_model.py.
+ */
+class GestureClassifier {
+public:
+    static const int WINDOW_FRAMES = 40;    // 2 s at 20 Hz, same as a recording
+    static const int FRAME_FEATURES = 5;
+    static const int INPUTS = WINDOW_FRAMES * FRAME_FEATURES;
+    static const int HIDDEN = 32;
+    static const int CLASSES = CUSTOM_GESTURE_COUNT;
+
+    struct Result {
+        int gesture;           // CustomGesture, or -1 if nothing was recognised
+        uint8_t confidence;    // softmax probability of gesture in percent
+    };
+
+    GestureClassifier();
+
+    /**
+     * @brief   checks if real weights were exported into gesture_model_data.h
+     * @returns true if the model has been trained
+     */
+    static bool isModelTrained();
+
+    /**
+     * @brief   clears the window
+     * @returns none
+     */
+    void reset();
+
+    /**
+     * @brief   appends a frame, dropping the oldest once the window is full
+     * @param[in]   frame: newest sensor frame
+     * @returns none
+     */
+    void push(const GestureFrame& frame);
+
+    /**
+     * @brief   checks if a whole window has been collected since reset()
+     * @returns true if classify() has enough frames
+     */
+    bool isWindowFull() const { return _filled >= WINDOW_FRAMES; }
+
+    /**
+     * @brief   runs the model over the current window
+     * @returns best class and its confidence, gesture -1 if the window is idle,
+     *          not full, or below the model's confidence threshold
+     */
+    Result classify();
+
+    /**
+     * @brief   gets the name used for a class in the recordings
+     * @param[in]   gesture: CustomGesture value
+     * @returns label string, "none" if out of range
+     */
+    static const char* getLabel(int gesture);
+
+private:
+    GestureFrame _window[WINDOW_FRAMES];  // ring, _head is the oldest frame
+    int _head;
+    int _filled;
+
+    // Fixed arena for one inference
+    uint8_t _input[INPUTS];
+    uint8_t _hidden[HIDDEN];
+    int32_t _logits[CLASSES];
+
+    /**
+     * @brief   copies the ring into _input oldest frame first, as in the CSVs
+     * @returns highest proximity in the window
+     */
+    uint8_t flattenWindow();
+};
+
+#endif
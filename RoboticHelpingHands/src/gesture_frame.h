@@ -0,0 +1,27 @@
+#ifndef GESTURE_FRAME_H
+#define GESTURE_FRAME_H
+
+#include <stdint.h>
+
+/**
+ * @brief   one sample of a sensor, same columns as the training CSVs
+ *          (proximity,up,down,left,right)
+ */
+struct GestureFrame {
+    uint8_t proximity;
+    uint8_t up;
+    uint8_t down;
+    uint8_t left;
+    uint8_t right;
+};
+
+/**
+ * @brief   one raw FIFO dataset as published on the sensor frame ring
+ */
+struct SensorFrame {
+    uint32_t timestamp_us;  // micros() the dataset was sampled, dated back from its FIFO read
+    uint8_t sensor;         // 0 = left, 1 = right, same ids as the training capture
+    uint8_t udlr[4];
+};
+
+#endif
@@ -0,0 +1,249 @@
+#include "gesture_fusion.h"
+#include <stdlib.h>
+
+namespace {
+
+// Both photodiodes of an axis need this much for a direction ratio, as GESTURE_THRESHOLD_OUT in the driver
+const uint8_t _SIGNAL_FLOOR = 10;
+
+const char* const _LABELS[GestureFusion::FUSED_EVENT_COUNT] = {
+    "SWEEP_TO_RIGHT",
+    "SWEEP_TO_LEFT",
+    "TWO_HAND_HOLD",
+    "NEAR_SWIPE",
+    "FAR_SWIPE",
+};
+
+}
+
+GestureFusion::GestureFusion() :
+    _params(getDefaultParams()),
+    _open{},
+    _pending{},
+    _results{},
+    _resultHead(0),
+    _resultCount(0),
+    _dropped(0)
+{}
+
+GestureFusion::Params GestureFusion::getDefaultParams() {
+    Params params;
+    params.end_gap_us = 150000;
+    params.pass_min_us = 40000;
+    params.pass_max_us = 1000000;
+    params.sweep_min_us = 40000;
+    params.sweep_max_us = 700000;
+    params.hold_us = 500000;
+    params.near_level = 110;
+    params.hold_level = 40;
+    params.swipe_delta = 40;
+    params.still_band = 12;
+    return params;
+}
+
+void GestureFusion::reset() {
+    for (int s = 0; s < SENSORS; s++) {
+        _open[s] = Episode{};
+        _pending[s] = Episode{};
+    }
+    _resultHead = 0;
+    _resultCount = 0;
+}
+
+void GestureFusion::push(const SensorFrame& frame) {
+    if (frame.sensor >= SENSORS) return;
+
+    int s = frame.sensor;
+    Episode& episode = _open[s];
+    uint32_t t = frame.timestamp_us;
+
+    // A gap the caller's update() has not seen yet still ends the hand before this one
+    if (episode.open && elapsed(t, episode.last_us) > (int32_t)_params.end_gap_us) close(s);
+
+    uint8_t level = levelOf(frame.udlr);
+    if (!episode.open) {
+        episode = Episode{};
+        episode.open = true;
+        episode.start_us = t;
+        episode.peak_us = t;
+    }
+    episode.last_us = t;
+    if (episode.datasets < 0xFFFF) episode.datasets++;
+    if (level > episode.peak_level) {
+        episode.peak_level = level;
+        episode.peak_us = t;
+    }
+
+    const uint8_t* udlr = frame.udlr;
+    bool ratios = udlr[0] > _SIGNAL_FLOOR && udlr[1] > _SIGNAL_FLOOR &&
+                  udlr[2] > _SIGNAL_FLOOR && udlr[3] > _SIGNAL_FLOOR;
+    if (!ratios) {
+        episode.still = false;
+        return;
+    }
+
+    int8_t ud = ratioOf(udlr[0], udlr[1]);
+    int8_t lr = ratioOf(udlr[2], udlr[3]);
+    if (!episode.have_ratio) {
+        episode.ud_first = ud;
+        episode.lr_first = lr;
+        episode.have_ratio = true;
+    }
+    episode.ud_last = ud;
+    episode.lr_last = lr;
+
+    // Still while level and direction stay close to where the stillness began
+    int level_band = episode.still_level / 5 > 8 ? episode.still_level / 5 : 8;
+    bool stays = episode.still &&
+                 abs(level - episode.still_level) <= level_band &&
+                 abs(ud - episode.still_ud) <= _params.still_band &&
+                 abs(lr - episode.still_lr) <= _params.still_band;
+    if (level < _params.hold_level) {
+        episode.still = false;
+    } else if (!stays) {
+        episode.still = true;
+        episode.still_us = t;
+        episode.still_level = level;
+        episode.still_ud = ud;
+        episode.still_lr = lr;
+    }
+}
+
+bool GestureFusion::update(uint32_t now_us) {
+    for (int s = 0; s < SENSORS; s++) {
+        if (_open[s].open && elapsed(now_us, _open[s].last_us) > (int32_t)_params.end_gap_us) close(s);
+    }
+
+    // Two hand hold: both still over the same stretch of sample time, however far apart the reads were
+    Episode& left = _open[0];
+    Episode& right = _open[1];
+    if (left.open && right.open && left.still && right.still && !(left.held && right.held)) {
+        uint32_t since_us = elapsed(left.still_us, right.still_us) > 0 ? left.still_us : right.still_us;
+        uint32_t until_us = elapsed(left.last_us, right.last_us) < 0 ? left.last_us : right.last_us;
+        if (elapsed(until_us, since_us) >= (int32_t)_params.hold_us) {
+            Result result = {FUSED_TWO_HAND_HOLD, 0, SWIPE_NONE,
+                             left.peak_level > right.peak_level ? left.peak_level : right.peak_level,
+                             since_us, until_us};
+            emit(result);
+            left.held = true;
+            right.held = true;
+        }
+    }
+
+    // Sweep: a pass over each sensor, peaks in order and the right distance apart
+    if (_pending[0].open && _pending[1].open) {
+        int first = elapsed(_pending[1].peak_us, _pending[0].peak_us) >= 0 ? 0 : 1;
+        const Episode& a = _pending[first];
+        const Episode& b = _pending[1 - first];
+        int32_t gap_us = elapsed(b.peak_us, a.peak_us);
+        if (isPass(a) && isPass(b) && !a.held && !b.held &&
+            gap_us >= (int32_t)_params.sweep_min_us && gap_us <= (int32_t)_params.sweep_max_us) {
+            Result result = {first == 0 ? FUSED_SWEEP_TO_RIGHT : FUSED_SWEEP_TO_LEFT, (uint8_t)(1 - first), SWIPE_NONE,
+                             a.peak_level > b.peak_level ? a.peak_level : b.peak_level,
+                             a.start_us, b.last_us};
+            emit(result);
+            _pending[0].open = false;
+            _pending[1].open = false;
+        } else {
+            flushSwipe(first);
+            flushSwipe(1 - first);
+        }
+    }
+
+    // A lone pass waits while the other sensor could still peak inside the sweep window,
+    // its datasets can show up a read period late
+    for (int s = 0; s < SENSORS; s++) {
+        const Episode& pass = _pending[s];
+        if (!pass.open) continue;
+
+        const Episode& other = _open[1 - s];
+        bool may_pair = false;
+        if (isPass(pass) && !pass.held) {
+            if (other.open) {
+                may_pair = elapsed(other.start_us, pass.peak_us) <= (int32_t)_params.sweep_max_us &&
+                           elapsed(other.last_us, other.start_us) <= (int32_t)_params.pass_max_us;
+            } else {
+                may_pair = elapsed(now_us, pass.peak_us) <= (int32_t)(_params.sweep_max_us + _params.end_gap_us);
+            }
+        }
+        if (!may_pair) flushSwipe(s);
+    }
+
+    return _resultCount > 0;
+}
+
+bool GestureFusion::take(Result& result) {
+    if (_resultCount == 0) return false;
+
+    result = _results[_resultHead];
+    _resultHead = (_resultHead + 1) % _RESULT_SLOTS;
+    _resultCount--;
+    return true;
+}
+
+bool GestureFusion::isIdle() const {
+    for (int s = 0; s < SENSORS; s++) {
+        if (_open[s].open || _pending[s].open) return false;
+    }
+    return true;
+}
+
+const char* GestureFusion::getLabel(int event) {
+    if (event < 0 || event >= FUSED_EVENT_COUNT) return "?";
+    return _LABELS[event];
+}
+
+void GestureFusion::close(int sensor) {
+    // An older pass still waiting has lost its chance of a sweep
+    if (_pending[sensor].open) flushSwipe(sensor);
+
+    _pending[sensor] = _open[sensor];
+    _open[sensor].open = false;
+}
+
+void GestureFusion::flushSwipe(int sensor) {
+    Episode& pass = _pending[sensor];
+    pass.open = false;
+    if (!isPass(pass) || pass.held || !pass.have_ratio) return;
+
+    // Across the sensor, the leading photodiode's ratio swings over to the trailing one,
+    // read the same way as the driver: L/R rising is RIGHT, U/D rising is DOWN
+    int ud_delta = pass.ud_last - pass.ud_first;
+    int lr_delta = pass.lr_last - pass.lr_first;
+    int direction = SWIPE_NONE;
+    if (abs(lr_delta) >= abs(ud_delta)) {
+        if (abs(lr_delta) >= _params.swipe_delta) direction = lr_delta > 0 ? SWIPE_RIGHT : SWIPE_LEFT;
+    } else {
+        if (abs(ud_delta) >= _params.swipe_delta) direction = ud_delta > 0 ? SWIPE_DOWN : SWIPE_UP;
+    }
+    if (direction == SWIPE_NONE) return;
+
+    Result result = {pass.peak_level >= _params.near_level ? FUSED_NEAR_SWIPE : FUSED_FAR_SWIPE,
+                     (uint8_t)sensor, direction, pass.peak_level, pass.start_us, pass.last_us};
+    emit(result);
+}
+
+bool GestureFusion::isPass(const Episode& episode) const {
+    int32_t duration_us = elapsed(episode.last_us, episode.start_us);
+    return duration_us >= (int32_t)_params.pass_min_us && duration_us <= (int32_t)_params.pass_max_us;
+}
+
+void GestureFusion::emit(const Result& result) {
+    if (_resultCount == _RESULT_SLOTS) {
+        _resultHead = (_resultHead + 1) % _RESULT_SLOTS;
+        _resultCount--;
+        _dropped++;
+    }
+    _results[(_resultHead + _resultCount) % _RESULT_SLOTS] = result;
+    _resultCount++;
+}
+
+uint8_t GestureFusion::levelOf(const uint8_t* udlr) {
+    return (uint8_t)(((uint16_t)udlr[0] + udlr[1] + udlr[2] + udlr[3]) / 4);
+}
+
+int8_t GestureFusion::ratioOf(uint8_t a, uint8_t b) {
+    int sum = a + b;
+    if (sum == 0) return 0;
+    return (int8_t)(((int)a - (int)b) * 64 / sum);
+}
@@ -0,0 +1,223 @@
+#ifndef GESTURE_FUSION_H
+#define GESTURE_FUSION_H
+
+#include <stdint.h>
+#include "gesture_frame.h"
+
+/**
+ * @brief   gestures made over both sensors, found in their time-aligned FIFO streams
+ *
+ * Each sensor's datasets arrive in order on its own ring, stamped on the common
+ * micros() clock with the time they were sampled; the two rings are read at
+ * different moments, so one sensor can be up to a read period behind the other.
+ * Every sensor's datasets are cut into episodes, a hand over the sensor from its
+ * first dataset to a gap with none, and the episodes are compared on sample time:
+ *
+ *  - sweep: a short pass over one sensor, then one over the other a little later
+ *  - two hand hold: both sensors covered and still at the same time
+ *  - near / far swipe: a pass over one sensor that moved across it, by how high
+ *    the hand was; the pass waits for the sweep window first, a sweep wins
+ *
+ * Proximity is the mean of U/D/L/R, since PDATA is not updated in gesture mode.
+ * Plain C++ with no Arduino or FreeRTOS dependency, constant work per dataset and
+ * nothing allocated, so the host fusion benchmark runs the same code.
+ */
+class GestureFusion {
+public:
+    static const int SENSORS = 2;    // SensorFrame::sensor 0 = left, 1 = right
+
+    enum Event {
+        FUSED_SWEEP_TO_RIGHT = 0,   // left sensor first, then the right one
+        FUSED_SWEEP_TO_LEFT,        // right sensor first, then the left one
+        FUSED_TWO_HAND_HOLD,        // a hand held still over each sensor at once
+        FUSED_NEAR_SWIPE,           // swipe over one sensor, hand close to it
+        FUSED_FAR_SWIPE,            // swipe over one sensor, hand well above it
+        FUSED_EVENT_COUNT
+    };
+
+    // Swipe directions, same values as the driver's DIR_NONE .. DIR_DOWN
+    enum Direction {
+        SWIPE_NONE = 0,
+        SWIPE_LEFT,
+        SWIPE_RIGHT,
+        SWIPE_UP,
+        SWIPE_DOWN
+    };
+
+    struct Result {
+        int event;            // Event
+        uint8_t sensor;       // swipes: sensor swiped over; sweeps: sensor it ended on; holds: 0
+        int direction;        // Direction of a swipe, SWIPE_NONE otherwise
+        uint8_t level;        // highest mean U/D/L/R of the episodes behind it
+        uint32_t start_us;    // first dataset, on the frames' clock
+        uint32_t end_us;      // last dataset, or when the hold was recognised
+    };
+
+    /**
+     * @brief   thresholds the fusion runs with, defaults tuned on the sim and the recordings
+     */
+    struct Params {
+        uint32_t end_gap_us;        // no dataset for this long ends an episode, more than a FIFO read period
+        uint32_t pass_min_us;       // episodes shorter than this are noise
+        uint32_t pass_max_us;       // longer ones are not a swipe or part of a sweep
+        uint32_t sweep_min_us;      // peak to peak, closer is one wide hand over both
+        uint32_t sweep_max_us;
+        uint32_t hold_us;           // both still together this long is a hold
+        uint8_t near_level;         // swipe peak at or above is near, below far
+        uint8_t hold_level;         // weaker is not a hand over the sensor
+        uint8_t swipe_delta;        // direction ratio change across the pass, of +-64
+        uint8_t still_band;         // ratio drift allowed while still, of +-64
+    };
+
+    GestureFusion();
+
+    /**
+     * @brief   gets the thresholds the fusion starts with
+     * @returns default parameters
+     */
+    static Params getDefaultParams();
+
+    /**
+     * @brief   replaces the thresholds, takes effect from the next dataset
+     * @param[in]   params: new thresholds
+     * @returns none
+     */
+    void setParams(const Params& params) { _params = params; }
+
+    /**
+     * @brief   gets the thresholds in use
+     * @returns parameters
+     */
+    const Params& getParams() const { return _params; }
+
+    /**
+     * @brief   drops every episode and pending result
+     * @returns none
+     */
+    void reset();
+
+    /**
+     * @brief   feeds one dataset, each sensor's in the order it was sampled
+     * @param[in]   frame: dataset from either sensor's ring
+     * @returns none
+     */
+    void push(const SensorFrame& frame);
+
+    /**
+     * @brief   ends episodes gone quiet and recognises what they add up to
+     * @param[in]   now_us: current time on the frames' clock
+     * @returns true if a result is waiting, read it with take()
+     */
+    bool update(uint32_t now_us);
+
+    /**
+     * @brief   takes the oldest waiting result
+     * @param[out]  result: recognised gesture
+     * @returns true if there was one
+     */
+    bool take(Result& result);
+
+    /**
+     * @brief   checks if no hand is over either sensor and nothing is waiting for the sweep window
+     * @returns true if update() has nothing left to do until the next dataset
+     */
+    bool isIdle() const;
+
+    /**
+     * @brief   gets a printable name
+     * @param[in]   event: Event value
+     * @returns name, "?" if out of range
+     */
+    static const char* getLabel(int event);
+
+    /**
+     * @brief   gets results dropped because nobody took them in time
+     * @returns count since construction
+     */
+    uint32_t getDropped() const { return _dropped; }
+
+private:
+    static const int _RESULT_SLOTS = 4;
+
+    /**
+     * @brief   one sensor's hand from its first dataset until it goes quiet
+     */
+    struct Episode {
+        bool open;
+        uint32_t start_us;
+        uint32_t last_us;
+        uint32_t peak_us;
+        uint8_t peak_level;
+        uint16_t datasets;
+        bool have_ratio;      // a dataset had signal on both axes
+        int8_t ud_first;
+        int8_t lr_first;
+        int8_t ud_last;
+        int8_t lr_last;
+        uint32_t still_us;    // since when the hand has stayed put, valid while still
+        bool still;
+        uint8_t still_level;  // reference the stillness is measured against
+        int8_t still_ud;
+        int8_t still_lr;
+        bool held;            // part of a two hand hold, so no swipe or sweep
+    };
+
+    Params _params;
+    Episode _open[SENSORS];      // in progress
+    Episode _pending[SENSORS];   // closed, waiting out the sweep window; open marks one is there
+    Result _results[_RESULT_SLOTS];
+    uint8_t _resultHead;
+    uint8_t _resultCount;
+    uint32_t _dropped;
+
+    /**
+     * @brief   moves a sensor's episode to pending once it has gone quiet
+     * @param[in]   sensor: 0 or 1
+     * @returns none
+     */
+    void close(int sensor);
+
+    /**
+     * @brief   reports a pending pass as a swipe if it moved across the sensor, then drops it
+     * @param[in]   sensor: 0 or 1
+     * @returns none
+     */
+    void flushSwipe(int sensor);
+
+    /**
+     * @brief   checks if an episode is a short enough pass for a swipe or sweep
+     * @param[in]   episode: closed episode
+     * @returns true if it is
+     */
+    bool isPass(const Episode& episode) const;
+
+    /**
+     * @brief   queues a result, dropping the oldest if nobody took it
+     * @param[in]   result: to queue
+     * @returns none
+     */
+    void emit(const Result& result);
+
+    /**
+     * @brief   mean of U/D/L/R
+     * @param[in]   udlr: dataset
+     * @returns level 0..255
+     */
+    static uint8_t levelOf(const uint8_t* udlr);
+
+    /**
+     * @brief   direction ratio of a pair of photodiodes
+     * @param[in]   a, b: counts, a on the positive side
+     * @returns (a - b) / (a + b) scaled to +-64
+     */
+    static int8_t ratioOf(uint8_t a, uint8_t b);
+
+    /**
+     * @brief   signed distance between two times on the wrapping micros() clock
+     * @param[in]   later, earlier: times
+     * @returns later - earlier
+     */
+    static int32_t elapsed(uint32_t later, uint32_t earlier) { return (int32_t)(later - earlier); }
+};
+
+#endif
@@ -1,76 +1,189 @@
 #include "gesture_grip.h"
+#include <limits.h>
 #include <SparkFun_APDS9960.h>
 
+// Fused swipes carry their direction as a DIR_* value
+static_assert((int)GestureFusion::SWIPE_LEFT == DIR_LEFT && (int)GestureFusion::SWIPE_RIGHT == DIR_RIGHT &&
+              (int)GestureFusion::SWIPE_UP == DIR_UP && (int)GestureFusion::SWIPE_DOWN == DIR_DOWN,
+              "fusion directions must match the driver's");
+
 GestureGrip::GestureGrip() :
     _control_state(STATE_DIRECT),
     _selected_servo_index(-1),
-    _gestureTaskHandle(NULL),
+    _leftTaskHandle(NULL),
+    _rightTaskHandle(NULL),
     _servoTaskHandle(NULL),
-    _ledTaskHandle(NULL),
-    _stabilizerTaskHandle(NULL),
+    _fusionTaskHandle(NULL),
     _gestureQueue(NULL),
-    _lastStateChange(0)
-{}
+    _bootEvents(NULL),
+    _sensorsReady(false),
+    _classifierTaskHandle(NULL),
+    _customBindings{},
+    _classifierStats{},
+    _twoHandHold(false),
+    _classifierDeadline("classifier", _CLASSIFIER_PERIOD_MS),
+    _fusionDeadline("fusion", _FUSION_PERIOD_MS),
+    _gestureQueueWatch(-1),
+    _lastStateChange(0),
+    _adjustStreak(0),
+    _adjustDirection(DIR_NONE),
+    _lastAdjustMs(0),
+    _lastAdjustStep(0),
+    _gestureLock(PowerLock::LOCK_NO_SLEEP, "gesture"),
+    _standby(false),
+    _lastGestureMs(0),
+    _gestureStartDelayMs(_GESTURE_START_DELAY_MS)
+{
+    // Palm gestures mirror the LEFT/RIGHT swipes, the rest are only reported until bound
+    _customBindings[GESTURE_PALM_UP] = ACTION_UPRIGHT;
+    _customBindings[GESTURE_PALM_DOWN] = ACTION_DOWNWARD;
+}
+
+void GestureGrip::bindCustomGesture(CustomGesture gesture, CustomAction action) {
+    if (gesture >= CUSTOM_GESTURE_COUNT) return;
+    _customBindings[gesture] = action;
+}
 
 bool GestureGrip::initialize() {
     Serial.println("Initializing LEDS, Sensors, and Individual Servos...");
     
-    // Initialize joints first
-    if (!_joints.initialize()) {
-        Serial.println("Failed to initialize joints!");
+    // Before anything creates its PowerLocks, so scaling covers the whole boot
+    _power.begin();
+    _gestureLock.begin();
+    
+    // Before the motion task starts
+    _joints.setLatencyTrace(&_trace);
+    
+    _bootEvents = xEventGroupCreate();
+    if (_bootEvents == NULL) {
+        Serial.println("Failed to create boot event group!");
         return false;
     }
     
-    Serial.println("Waiting for servo power stabilization...");
-    delay(500);  // half second for servos to stabilize
-    Serial.println("Moving to upright position...");
-    _joints.moveToUpright(3);
-    
-    // Wait for all servos to finish moving
-    if (!_joints.waitForServos(8000)) {
-        Serial.println("WARNING: Some servos may not have reached target position");
+    // Sensors share no pins or buses with the joints, bring them up on core 0 meanwhile
+    if (xTaskCreatePinnedToCore(
+            sensorBootTaskWrapper,
+            "SensorBoot",
+            4096,
+            this,
+            2,
+            NULL,
+            0) != pdPASS) {
+        Serial.println("Failed to create sensor boot task!");
+        return false;
     }
     
-    // Stop all movement tasks after initialization completes
-    Serial.println("Stopping initialization tasks...");
-    _joints.stopAllMovements();
-    delay(100);  // small delay to ensure tasks are killed
+    // Joints on this core (1), alongside the motion task
+    bool joints_ready = bootJoints();
+    xEventGroupSetBits(_bootEvents, _BOOT_JOINTS_DONE);
     
-    Serial.println("✓ Arm erected and stabilized");
+    EventBits_t bits = xEventGroupWaitBits(_bootEvents, _BOOT_SENSORS_DONE, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(_BOOT_TIMEOUT_MS));
     
-    // Initialize sensors second
-    if (!_sensors.initialize()) {
+    if (!joints_ready) {
+        Serial.println("Failed to initialize joints!");
+        return false;
+    }
+    if ((bits & _BOOT_SENSORS_DONE) == 0) {
+        Serial.println("Timed out waiting for sensors!");
+        return false;
+    }
+    if (!_sensorsReady) {
         Serial.println("Failed to initialize sensors!");
         return false;
     }
     
-    // Clear startup gestures
-    _sensors.clearStartupGestures();
-    
     Serial.println("=== Initialized LEDs, Sensors, and Individual Servos ===");
     
     // Create gesture queue
-    _gestureQueue = xQueueCreate(1, sizeof(GestureEvent));
+    _gestureQueue = xQueueCreate(_GESTURE_QUEUE_LENGTH, sizeof(GestureEvent));
     if (_gestureQueue == NULL) {
         Serial.println("Failed to create gesture queue!");
         return false;
     }
     
+    _boot.markReady();
+    _boot.printReport();
     return true;
 }
 
+bool GestureGrip::bootJoints() {
+    int phase = _boot.beginPhase("joints attach");
+    bool success = _joints.initialize();
+    _boot.endPhase(phase);
+    if (!success) return false;
+    
+    if (_joints.isWarmBoot()) {
+        // Servos were attached where they already are, nothing to home
+        Serial.println("✓ Warm boot, resuming journalled pose");
+        _gestureStartDelayMs = 0;
+        return true;
+    }
+    
+    phase = _boot.beginPhase("homing");
+    Serial.println("Waiting for servo power stabilization...");
+    delay(500);  // half second for servos to stabilize
+    Serial.println("Moving to upright position...");
+    _joints.moveToUpright(3);
+    
+    // Wait for all servos to finish moving, bounded by the planned duration
+    if (!_joints.waitForServos()) {
+        Serial.println("WARNING: Some servos may not have reached target position");
+    }
+    
+    // Stop any movement left over after initialization completes
+    _joints.stopAllMovements();
+    _boot.endPhase(phase);
+    
+    Serial.println("✓ Arm erected and stabilized");
+    return true;
+}
+
+void GestureGrip::sensorBootTask() {
+    int phase = _boot.beginPhase("sensors init");
+    _sensorsReady = _sensors.initialize();
+    _boot.endPhase(phase);
+    
+    // The arm homing under the sensors would only produce more junk gestures, drain after it
+    xEventGroupWaitBits(_bootEvents, _BOOT_JOINTS_DONE, pdFALSE, pdTRUE, portMAX_DELAY);
+    
+    if (_sensorsReady) {
+        phase = _boot.beginPhase("startup clear");
+        _sensors.clearStartupGestures(_joints.isWarmBoot());
+        _boot.endPhase(phase);
+    }
+    
+    xEventGroupSetBits(_bootEvents, _BOOT_SENSORS_DONE);
+    vTaskDelete(NULL);
+}
+
 void GestureGrip::start() {
-    // Create gesture task on core 0 (highest priority for I2C)
+    _gestureQueueWatch = _monitor.addQueue("gesture", _gestureQueue);
+    _monitor.addDeadline(&_joints.getMotionDeadline());
+    
+    // One acquisition task per I2C controller, so a read on one bus never waits for the other.
+    // Left on core 0 (highest priority for I2C), right on core 1 at the motion task's priority;
+    // both spend their time blocked on the bus or between FIFO batches
     xTaskCreatePinnedToCore(
-        gestureTaskWrapper,
-        "GestureTask",
+        leftGestureTaskWrapper,
+        "LeftGesture",
         4096,
         this,
         2,
-        &_gestureTaskHandle,
+        &_leftTaskHandle,
         0
     );
     
+    xTaskCreatePinnedToCore(
+        rightGestureTaskWrapper,
+        "RightGesture",
+        4096,
+        this,
+        2,
+        &_rightTaskHandle,
+        1
+    );
+    
     // Create servo task on core 1
     xTaskCreatePinnedToCore(
         servoTaskWrapper,
@@ -82,41 +195,116 @@ void GestureGrip::start() {
         1
     );
     
-    // Create LED task on core 1
+    // Classifier on core 0 below the left gesture task, it only competes with I2C for the bus lock
+    if (GestureClassifier::isModelTrained()) {
+        xTaskCreatePinnedToCore(
+            classifierTaskWrapper,
+            "ClassifierTask",
+            3072,
+            this,
+            1,
+            &_classifierTaskHandle,
+            0
+        );
+        _monitor.addDeadline(&_classifierDeadline);
+    } else {
+        Serial.println("No trained gesture model, custom gestures disabled");
+    }
+    
+    // Fusion on core 0 as well, a few microseconds per dataset between the FIFO reads
     xTaskCreatePinnedToCore(
-        ledTaskWrapper,
-        "LEDTask",
-        2048,
+        fusionTaskWrapper,
+        "FusionTask",
+        3072,
         this,
         1,
-        &_ledTaskHandle,
-        1
+        &_fusionTaskHandle,
+        0
     );
+    _monitor.addDeadline(&_fusionDeadline);
 
-    // Create stabilizer task on core 1 (low priority)
-    xTaskCreatePinnedToCore(
-        stabilizerTaskWrapper,
-        "StabilizerTask",
-        2048,
-        this,
-        0,
-        &_stabilizerTaskHandle,
-        1
-    );
+    // Setup and loop share the Arduino loop task, so the console wakes the task update() runs on
+    _console.addCommand("trace", "gesture latency per stage, 'trace reset' clears it", traceCommand, this);
+    _console.addCommand("power", "power, hold and LED figures", powerCommand, this);
+    _console.addCommand("tasks", "CPU, stack, queue and deadline figures per task", tasksCommand, this);
+    _console.addCommand("telemetry", "seconds between TM records, 0 stops them", telemetryCommand, this);
+    _console.addCommand("acquire", "FIFO reads per sensor bus, 'acquire reset' clears them, 'acquire polling|interrupt' switches", acquireCommand, this);
+    _console.begin();
+    
+    if (!_monitor.begin(_TELEMETRY_MS)) {
+        Serial.println("Failed to start task monitor!");
+    }
 
     Serial.println("Initialized both APDS and Servo on separate cores.");
+    _joints.printResourceUsage();
     Serial.println("\n=== CONTROL MODES ===");
     Serial.println("DIRECT MODE: White LED - Swipe gestures control arm");
     Serial.println("NEAR/FAR gesture: Enter servo selection mode\n");
 }
 
 void GestureGrip::update() {
-    vTaskDelay(pdMS_TO_TICKS(100));
+    // Only wakes for serial input, everything else runs in tasks
+    _console.service();
+}
+
+void GestureGrip::printPowerReport() {
+    _power.printReport();
+    _joints.printPowerReport();
 }
 
-void GestureGrip::gestureTaskWrapper(void* parameter) {
+void GestureGrip::traceCommand(void* context, const char* args) {
+    GestureGrip* grip = static_cast<GestureGrip*>(context);
+    if (strcmp(args, "reset") == 0) {
+        grip->_trace.reset();
+        Serial.println("Gesture latency cleared");
+        return;
+    }
+    grip->_trace.printReport();
+}
+
+void GestureGrip::powerCommand(void* context, const char*) {
+    static_cast<GestureGrip*>(context)->printPowerReport();
+}
+
+void GestureGrip::tasksCommand(void* context, const char*) {
+    static_cast<GestureGrip*>(context)->_monitor.printReport();
+}
+
+void GestureGrip::telemetryCommand(void* context, const char* args) {
+    uint32_t seconds = strtoul(args, NULL, 10);
+    static_cast<GestureGrip*>(context)->_monitor.setTelemetryPeriod(seconds * 1000);
+    if (seconds > 0) Serial.printf("Telemetry every %u s\n", (unsigned)seconds);
+    else Serial.println("Telemetry off");
+}
+
+void GestureGrip::acquireCommand(void* context, const char* args) {
+    GestureGrip* grip = static_cast<GestureGrip*>(context);
+    if (strcmp(args, "reset") == 0) {
+        grip->_sensors.resetAcquisitionStats();
+        Serial.println("Acquisition figures cleared");
+        return;
+    }
+    if (strcmp(args, "polling") == 0 || strcmp(args, "interrupt") == 0) {
+        grip->_sensors.setAcquisitionMode(args[0] == 'p' ? GestureGripSensors::ACQUIRE_POLLING
+                                                         : GestureGripSensors::ACQUIRE_INTERRUPT);
+        return;
+    }
+    grip->_sensors.printAcquisitionReport();
+}
+
+void GestureGrip::sensorBootTaskWrapper(void* parameter) {
     GestureGrip* grip = static_cast<GestureGrip*>(parameter);
-    grip->gestureTask();
+    grip->sensorBootTask();
+}
+
+void GestureGrip::leftGestureTaskWrapper(void* parameter) {
+    GestureGrip* grip = static_cast<GestureGrip*>(parameter);
+    grip->gestureTask(GestureGripSensors::NOTIFY_LEFT);
+}
+
+void GestureGrip::rightGestureTaskWrapper(void* parameter) {
+    GestureGrip* grip = static_cast<GestureGrip*>(parameter);
+    grip->gestureTask(GestureGripSensors::NOTIFY_RIGHT);
 }
 
 void GestureGrip::servoTaskWrapper(void* parameter) {
@@ -124,123 +312,437 @@ void GestureGrip::servoTaskWrapper(void* parameter) {
     grip->servoTask();
 }
 
-void GestureGrip::ledTaskWrapper(void* parameter) {
+void GestureGrip::classifierTaskWrapper(void* parameter) {
     GestureGrip* grip = static_cast<GestureGrip*>(parameter);
-    grip->ledTask();
+    grip->classifierTask();
 }
 
-void GestureGrip::stabilizerTaskWrapper(void* parameter) {
+void GestureGrip::fusionTaskWrapper(void* parameter) {
     GestureGrip* grip = static_cast<GestureGrip*>(parameter);
-    grip->stabilizerTask();
+    grip->fusionTask();
 }
 
-void GestureGrip::gestureTask() {
-    vTaskDelay(pdMS_TO_TICKS(2000)); // wait 2 seconds before starting gesture detection
+void GestureGrip::gestureTask(uint32_t line) {
+    vTaskDelay(pdMS_TO_TICKS(_gestureStartDelayMs)); // 2 seconds on cold boot before starting gesture detection
+    
+    bool left = line == GestureGripSensors::NOTIFY_LEFT;
+    _sensors.setNotifyTask(line, xTaskGetCurrentTaskHandle());
+    _lastGestureMs = millis();
+    Serial.printf("%s gesture detection active!\n", left ? "Left" : "Right");
+    if (left) refreshLED();  // stops the boot breathing
     
-    Serial.println("Gesture detection active!");
+    bool active = false;  // a gesture still being collected, _gestureLock held meanwhile
+    bool waking = false;  // first collection after standby, timed until it yields a gesture
+    uint32_t wake_edge_us = 0;
     
     while (true) {
-        int left_gesture = DIR_NONE;
-        int right_gesture = DIR_NONE;
-        
-        // Left Sensor
-        if (_sensors.leftGestureAvailable()) {
-            left_gesture = _sensors.readLeftGesture();
-            
-            if (left_gesture == DIR_NEAR || left_gesture == DIR_FAR) {
-                left_gesture = DIR_NONE;
+        if (!active) {
+            // Sleeps on the INT line, the chip too once no PowerLock is held, or polls GSTATUS in fallback
+            // mode. Standby waits for both sensors to be quiet, whichever task sees that first enters it
+            TickType_t timeout = portMAX_DELAY;
+            if (!_standby) {
+                uint32_t quiet_ms = millis() - _lastGestureMs;
+                timeout = quiet_ms < (uint32_t)_STANDBY_AFTER_MS ? pdMS_TO_TICKS(_STANDBY_AFTER_MS - quiet_ms) : 0;
+            }
+            if (_sensors.waitForGestures(line, timeout) == 0) {
+                if (millis() - _lastGestureMs >= (uint32_t)_STANDBY_AFTER_MS) enterStandby();
+                continue;
             }
             
-            // Send gesture to queue ONLY if valid (UP/DOWN/LEFT/RIGHT)
-            if (left_gesture != DIR_NONE && left_gesture != -1) {
-                GestureEvent event = {left_gesture};
-                xQueueSend(_gestureQueue, &event, 0);
-                handleGesture(left_gesture, "LEFT");
+            _lastGestureMs = millis();
+            _gestureLock.acquire();
+            active = true;
+            if (_classifierTaskHandle != NULL) xTaskNotifyGive(_classifierTaskHandle);
+            if (_fusionTaskHandle != NULL) xTaskNotifyGive(_fusionTaskHandle);
+            
+            if (_standby.exchange(false)) {
+                waking = true;
+                wake_edge_us = _sensors.getFirstEdgeUs(line);
+                if (wake_edge_us == 0) wake_edge_us = micros();
+                refreshLED();
             }
+        } else {
+            // Let the next FIFO batch build up, the other bus is serviced meanwhile
+            vTaskDelay(pdMS_TO_TICKS(FIFO_PAUSE_TIME));
         }
         
-        vTaskDelay(pdMS_TO_TICKS(20));
+        bool accepted = false;
+        bool finished = left ? serviceLeftSensor(accepted) : serviceRightSensor(accepted);
         
-        // Right Sensor
-        if (_sensors.rightGestureAvailable()) {
-            right_gesture = _sensors.readRightGesture();
-            
-            // Only process NEAR/FAR for state changes
-            if (right_gesture == DIR_NEAR || right_gesture == DIR_FAR) {
-                if (millis() - _lastStateChange > _STATE_CHANGE_DEBOUNCE) {
-                    Serial.println(">>> RIGHT: NEAR/FAR detected - changing state <<<");
-                    advanceControlState();
-                    _lastStateChange = millis();
-                }
-            }
+        if (waking && accepted) {
+            _power.recordWake(micros() - wake_edge_us, true);
+            waking = false;
+        }
+        if (finished) {
+            if (waking) _power.recordWake(0, false);
+            waking = false;
+            active = false;
+            _lastGestureMs = millis();
+            _gestureLock.release();
+        }
+    }
+}
+
+bool GestureGrip::serviceLeftSensor(bool& accepted) {
+    int left_gesture = DIR_NONE;
+    GestureGripSensors::GestureSpan span = {};
+    if (!_sensors.pollLeftGesture(left_gesture, &span)) {
+        // Still collecting, but the swipe may already be clear
+        int committed;
+        GestureGripSensors::GestureSpan early;
+        if (_sensors.takeLeftCommit(committed, early)) {
+            queueDirection(committed, early);
+            accepted = true;
+        }
+        return false;
+    }
+    
+    // A template match explains the gesture better than the swipe decode
+    TemplateRecognizer::Match match;
+    bool matched = _sensors.takeLeftTemplateMatch(match);
+    if (matched || left_gesture == DIR_NEAR || left_gesture == DIR_FAR) {
+        left_gesture = DIR_NONE;
+    }
+    
+    // An early commit already went out: the full decode confirms it, or takes it back first
+    if (span.committed != DIR_NONE) {
+        if (left_gesture == span.committed) {
+            left_gesture = DIR_NONE;
+        } else {
+            GestureEvent event = {EVENT_RETRACT, span.committed, 0, 0, LatencyTrace::NO_TRACE, DIR_NONE};
+            queueEvent(event);
+            handleGesture(span.committed, "LEFT retracted");
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(20));
     }
+    
+    if (matched) {
+        Serial.printf("TEMPLATE: %s (distance %u)\n", GestureClassifier::getLabel(match.gesture), match.distance);
+        uint16_t trace = _trace.open(span.edge_us, span.read_start_us, span.decoded_us,
+                                     span.fifo_cycles, span.decode_cycles);
+        GestureEvent event = {EVENT_CUSTOM, match.gesture, 0, 0, trace, DIR_NONE};
+        queueEvent(event);
+        accepted = true;
+    }
+    
+    // Send gesture to queue ONLY if valid (UP/DOWN/LEFT/RIGHT)
+    if (left_gesture != DIR_NONE && left_gesture != -1) {
+        queueDirection(left_gesture, span);
+        accepted = true;
+    }
+    return true;
+}
+
+bool GestureGrip::serviceRightSensor(bool& accepted) {
+    int right_gesture = DIR_NONE;
+    if (!_sensors.pollRightGesture(right_gesture)) return false;
+    
+    // A hand held for a two hand hold reads as NEAR/FAR once it leaves, that was not a mode change
+    if (_twoHandHold.exchange(false)) return true;
+    
+    // Only process NEAR/FAR for state changes, ServoTask makes them; ahead of queued swipes,
+    // which the change drops anyway
+    if (right_gesture == DIR_NEAR || right_gesture == DIR_FAR) {
+        GestureEvent event = {EVENT_MODE, right_gesture, 0, 0, LatencyTrace::NO_TRACE, DIR_NONE};
+        queueEvent(event, true);
+        accepted = true;
+    }
+    return true;
 }
 
 void GestureGrip::servoTask() {
     GestureEvent event;
+    GestureEvent pending;
+    bool held = false;    // pending was taken off the queue by a flush or merge but is still to be handled
+    unsigned long journal_ms = 0;    // a cold boot's homed pose is journalled too, not just the first move
     
     while (true) {
-        if (xQueueReceive(_gestureQueue, &event, pdMS_TO_TICKS(10)) == pdTRUE) {
-            if (event.gesture == DIR_NONE || event.gesture == -1) {
-                Serial.println("Warning: Invalid gesture in queue, skipping");
+        // Sleeps until a gesture arrives or the pose journal wants another look
+        TickType_t wait = journal_ms == ULONG_MAX ? portMAX_DELAY : pdMS_TO_TICKS(journal_ms) + 1;
+        bool received = true;
+        if (held) {
+            event = pending;
+        } else {
+            received = xQueueReceive(_gestureQueue, &event, wait) == pdTRUE;
+        }
+        held = false;
+        if (received) {
+            // Undone before the corrected gesture queued behind it, which must not be flushed
+            if (event.type == EVENT_RETRACT) {
+                retractGesture(event.gesture);
                 continue;
             }
             
-            // Handle gesture based on current state
-            switch (_control_state) {
-                case STATE_DIRECT:
-                    handleDirectGesture(event);
-                    break;
-                    
-                case STATE_SELECT_SERVO:
-                    handleSelectionGesture(event.gesture);
-                    break;
-                    
-                case STATE_ADJUST_SERVO:
-                    handleAdjustGesture(event.gesture);
-                    break;
+            if (event.type == EVENT_MODE) {
+                if (millis() - _lastStateChange > _STATE_CHANGE_DEBOUNCE) {
+                    Serial.println(">>> RIGHT: NEAR/FAR detected - changing state <<<");
+                    advanceControlState();
+                    _lastStateChange = millis();
+                }
+                continue;
             }
             
-            int flushed = 0;
-            while (xQueueReceive(_gestureQueue, &event, 0) == pdTRUE) {
-                flushed++;
+            _trace.markReceived(event.trace);
+            uint32_t dispatch_start = LatencyTrace::cycles();
+            _joints.setTraceId(event.trace);
+            
+            if (event.type == EVENT_CUSTOM) {
+                handleCustomGesture(event.gesture);
+            } else if (event.type == EVENT_FUSED) {
+                handleFusedGesture(event);
+            } else {
+                if (event.gesture == DIR_NONE || event.gesture == -1) {
+                    Serial.println("Warning: Invalid gesture in queue, skipping");
+                    _joints.setTraceId(LatencyTrace::NO_TRACE);
+                    continue;
+                }
+                
+                // Handle gesture based on current state
+                switch (_control_state) {
+                    case STATE_DIRECT:
+                        handleDirectGesture(event);
+                        break;
+                        
+                    case STATE_SELECT_SERVO:
+                        handleSelectionGesture(event.gesture);
+                        break;
+                        
+                    case STATE_ADJUST_SERVO:
+                        held = handleAdjustBurst(event, pending);
+                        break;
+                }
             }
-            if (flushed > 0) {
-                Serial.printf("Flushed %d queued gestures\n", flushed);
+            
+            // Moves are posted by now, the motion task records the first write
+            _joints.setTraceId(LatencyTrace::NO_TRACE);
+            if (event.trace != LatencyTrace::NO_TRACE) {
+                _trace.recordCycles(LatencyTrace::STAGE_DISPATCH, LatencyTrace::cycles() - dispatch_start);
+            }
+            _joints.flashLED();
+            
+            // Adjust mode merges its backlog instead, swipes queued during a move are stale.
+            // Retractions, mode changes and custom gestures are not, and neither is what follows them
+            // A mode request went to the front of the queue, so it is usually what stops the drain
+            if (_control_state != STATE_ADJUST_SERVO) {
+                int flushed = 0;
+                int last_flushed = DIR_NONE;
+                while (xQueueReceive(_gestureQueue, &pending, 0) == pdTRUE) {
+                    if (pending.type == EVENT_DIRECTION || pending.type == EVENT_FUSED) {
+                        last_flushed = pending.type == EVENT_DIRECTION ? pending.gesture : DIR_NONE;
+                        flushed++;
+                        continue;
+                    }
+                    
+                    // The commit it takes back was flushed just now and never moved anything
+                    if (pending.type == EVENT_RETRACT && pending.gesture == last_flushed) break;
+                    held = true;
+                    break;
+                }
+                if (flushed > 0) {
+                    Serial.printf("Flushed %d queued gestures\n", flushed);
+                }
             }
         }
         
-        vTaskDelay(pdMS_TO_TICKS(20));
+        // Saves the pose once the arm has been still for a while
+        journal_ms = _joints.journalPose();
     }
 }
 
-void GestureGrip::ledTask() {
+void GestureGrip::queueDirection(int gesture, const GestureGripSensors::GestureSpan& span) {
+    uint32_t duration_ms = span.duration_us / 1000;
+    uint16_t trace = _trace.open(span.edge_us, span.read_start_us, span.decoded_us,
+                                 span.fifo_cycles, span.decode_cycles);
+    GestureEvent event = {EVENT_DIRECTION, gesture, span.datasets,
+                          (uint16_t)(duration_ms > 0xFFFF ? 0xFFFF : duration_ms), trace, DIR_NONE};
+    queueEvent(event);
+    handleGesture(gesture, "LEFT");
+}
+
+void GestureGrip::queueEvent(const GestureEvent& event, bool front) {
+    _trace.markQueued(event.trace);
+    bool sent = (front ? xQueueSendToFront(_gestureQueue, &event, 0) : xQueueSend(_gestureQueue, &event, 0)) == pdTRUE;
+    _monitor.noteQueue(_gestureQueueWatch, sent);
+}
+
+void GestureGrip::refreshLED() {
+    _joints.updateLED(_standby ? -1 : (int)_control_state, _selected_servo_index);
+}
+
+void GestureGrip::enterStandby() {
+    // Both gesture tasks can time out together, only one reports
+    if (_standby.exchange(true)) return;
+    refreshLED();
+    Serial.printf("Standby: no gestures for %d s, LED off until the next hand\n", _STANDBY_AFTER_MS / 1000);
+    printPowerReport();
+}
+
+void GestureGrip::classifierTask() {
+    vTaskDelay(pdMS_TO_TICKS(_gestureStartDelayMs)); // same start as gesture detection
+    Serial.println("Custom gesture classifier active!");
+    
+    const GestureGripSensors::SensorFrameRing& frames = _sensors.getFrames(GestureGripSensors::SENSOR_LEFT);
+    GestureGripSensors::SensorFrameRing::Cursor cursor = frames.attach();
+    TickType_t last_wake = xTaskGetTickCount();
+    int frames_since_inference = 0;
+    int quiet_frames = 0;
+    
     while (true) {
-        _joints.updateLED((int)_control_state, _selected_servo_index);
-        vTaskDelay(pdMS_TO_TICKS(50));
+        // A whole window without a hand; the window keeps those quiet frames as the lead-in
+        // for the next gesture, and the gesture tasks wake this task when one starts
+        if (quiet_frames >= GestureClassifier::WINDOW_FRAMES) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            quiet_frames = 0;
+            last_wake = xTaskGetTickCount();
+            _classifierDeadline.restart();
+        }
+        
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(_CLASSIFIER_PERIOD_MS));
+        _classifierDeadline.tick();
+        
+        GestureFrame frame = {};
+        bool proximity_ok = _sensors.readLeftProximity(frame.proximity);
+        
+        // Same as the recorder: the oldest left dataset since the last frame, zeros if none
+        bool have_dataset = false;
+        SensorFrame sample;
+        while (frames.read(cursor, sample)) {
+            if (have_dataset || sample.sensor != GestureGripSensors::SENSOR_LEFT) continue;
+            frame.up = sample.udlr[0];
+            frame.down = sample.udlr[1];
+            frame.left = sample.udlr[2];
+            frame.right = sample.udlr[3];
+            have_dataset = true;
+        }
+        _classifierStats.overruns = cursor.overruns;
+        
+        if (have_dataset || (proximity_ok && frame.proximity >= _CLASSIFIER_IDLE_PROXIMITY)) {
+            quiet_frames = 0;
+        } else {
+            quiet_frames++;
+        }
+        
+        if (!proximity_ok) continue;
+        _classifier.push(frame);
+        
+        if (!_classifier.isWindowFull() || ++frames_since_inference < _CLASSIFY_EVERY_FRAMES) continue;
+        frames_since_inference = 0;
+        
+        uint32_t start_us = micros();
+        GestureClassifier::Result result = _classifier.classify();
+        uint32_t elapsed_us = micros() - start_us;
+        
+        _classifierStats.windows++;
+        _classifierStats.total_us += elapsed_us;
+        if (elapsed_us > _classifierStats.max_us) _classifierStats.max_us = elapsed_us;
+        if (elapsed_us > _CLASSIFIER_BUDGET_US) _classifierStats.over_budget++;
+        
+        if (result.gesture < 0) continue;
+        
+        Serial.printf("CUSTOM: %s (%u%%) | inference avg %lu us max %u us, %u/%u over budget, %u frames overrun\n",
+                      GestureClassifier::getLabel(result.gesture),
+                      result.confidence,
+                      (unsigned long)(_classifierStats.total_us / _classifierStats.windows),
+                      _classifierStats.max_us,
+                      _classifierStats.over_budget,
+                      _classifierStats.windows,
+                      _classifierStats.overruns);
+        
+        GestureEvent event = {EVENT_CUSTOM, result.gesture, 0, 0, LatencyTrace::NO_TRACE, DIR_NONE};
+        queueEvent(event);
+        
+        // Start over so the same gesture is not reported again as the window slides
+        _classifier.reset();
     }
 }
 
-void GestureGrip::stabilizerTask() {
+void GestureGrip::fusionTask() {
+    vTaskDelay(pdMS_TO_TICKS(_gestureStartDelayMs)); // same start as gesture detection
+    Serial.println("Gesture fusion active!");
+    
+    static const char* const direction_names[] = {"NONE", "LEFT", "RIGHT", "UP", "DOWN"};
+    const GestureGripSensors::SensorFrameRing& left = _sensors.getFrames(GestureGripSensors::SENSOR_LEFT);
+    const GestureGripSensors::SensorFrameRing& right = _sensors.getFrames(GestureGripSensors::SENSOR_RIGHT);
+    GestureGripSensors::SensorFrameRing::Cursor left_cursor = left.attach();
+    GestureGripSensors::SensorFrameRing::Cursor right_cursor = right.attach();
+    TickType_t last_wake = xTaskGetTickCount();
+    int quiet_periods = _FUSION_IDLE_PERIODS;
+    
     while (true) {
-        // Only actively stabilize when in ADJUST_SERVO mode
-        if (_control_state == STATE_ADJUST_SERVO && _selected_servo_index >= 0) {
-            // Periodically lock other servos to prevent drift/jitter
-            _joints.lockOtherServos(_selected_servo_index);
-            vTaskDelay(pdMS_TO_TICKS(100));  // Lock every 100ms
+        // Nothing open or waiting for the sweep window, the gesture tasks wake this task when a hand comes
+        if (quiet_periods >= _FUSION_IDLE_PERIODS) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            quiet_periods = 0;
+            last_wake = xTaskGetTickCount();
+            _fusionDeadline.restart();
+        }
+        
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(_FUSION_PERIOD_MS));
+        _fusionDeadline.tick();
+        
+        // Each ring in its own order, the fusion lines the sensors up by sample time
+        bool pushed = false;
+        SensorFrame frame;
+        while (left.read(left_cursor, frame)) {
+            _fusion.push(frame);
+            pushed = true;
+        }
+        while (right.read(right_cursor, frame)) {
+            _fusion.push(frame);
+            pushed = true;
+        }
+        
+        bool found = _fusion.update(micros());
+        if (pushed || !_fusion.isIdle()) {
+            quiet_periods = 0;
         } else {
-            // Not adjusting, so don't need to stabilize
-            vTaskDelay(pdMS_TO_TICKS(500));
+            quiet_periods++;
+        }
+        if (!found) continue;
+        
+        GestureFusion::Result result;
+        while (_fusion.take(result)) {
+            uint32_t duration_ms = (result.end_us - result.start_us) / 1000;
+            bool swipe = result.event == GestureFusion::FUSED_NEAR_SWIPE || result.event == GestureFusion::FUSED_FAR_SWIPE;
+            if (swipe) {
+                Serial.printf("FUSED: %s %s %s (level %u, %lu ms)\n", GestureFusion::getLabel(result.event),
+                              result.sensor == GestureGripSensors::SENSOR_LEFT ? "LEFT" : "RIGHT",
+                              direction_names[result.direction], result.level, (unsigned long)duration_ms);
+            } else {
+                Serial.printf("FUSED: %s (level %u, %lu ms)\n", GestureFusion::getLabel(result.event),
+                              result.level, (unsigned long)duration_ms);
+            }
+            
+            // The left sensor's decoder has already sent its swipes
+            if (swipe && result.sensor == GestureGripSensors::SENSOR_LEFT) continue;
+            
+            if (result.event == GestureFusion::FUSED_TWO_HAND_HOLD) _twoHandHold = true;
+            GestureEvent event = {EVENT_FUSED, result.event, 0,
+                                  (uint16_t)(duration_ms > 0xFFFF ? 0xFFFF : duration_ms),
+                                  LatencyTrace::NO_TRACE, (uint8_t)result.direction};
+            queueEvent(event);
         }
     }
 }
 
-void GestureGrip::advanceControlState() {
+void GestureGrip::clearGestureBacklog() {
     // Resets gesture queue
     xQueueReset(_gestureQueue);
+    _adjustStreak = 0;
+    _adjustDirection = DIR_NONE;
+    _lastAdjustStep = 0;
+}
+
+void GestureGrip::enterDirectControl() {
+    _control_state = STATE_DIRECT;
+    _selected_servo_index = -1;
+    Serial.println("\n========================================");
+    Serial.println("MODE: DIRECT CONTROL");
+    Serial.println("Gestures control the arm");
+    Serial.println("========================================");
+}
+
+void GestureGrip::advanceControlState() {
+    clearGestureBacklog();
     
     switch (_control_state) {
         case STATE_DIRECT:
@@ -267,14 +769,10 @@ void GestureGrip::advanceControlState() {
             
         case STATE_ADJUST_SERVO:
         default:
-            _control_state = STATE_DIRECT;
-            _selected_servo_index = -1;
-            Serial.println("\n========================================");
-            Serial.println("MODE: DIRECT CONTROL");
-            Serial.println("Gestures control the arm");
-            Serial.println("========================================");
+            enterDirectControl();
             break;
     }
+    refreshLED();
 }
 
 void GestureGrip::announceSelectedServo() {
@@ -295,6 +793,104 @@ void GestureGrip::handleDirectGesture(const GestureEvent& event) {
     }
 }
 
+void GestureGrip::retractGesture(int gesture) {
+    switch (_control_state) {
+        case STATE_DIRECT:
+            // The pose move is under way and has no way back, holding where it got to is the least harm
+            if (gesture == DIR_LEFT || gesture == DIR_RIGHT) {
+                _joints.stopAllMovements();
+            }
+            break;
+            
+        case STATE_SELECT_SERVO:
+            if (gesture == DIR_UP) {
+                handleSelectionGesture(DIR_DOWN);
+            } else if (gesture == DIR_DOWN) {
+                handleSelectionGesture(DIR_UP);
+            }
+            break;
+            
+        case STATE_ADJUST_SERVO:
+            // Pulls the target back while the adjustment is still in flight
+            if (gesture == _adjustDirection && _lastAdjustStep != 0) {
+                _joints.adjustServo(_selected_servo_index, -_lastAdjustStep);
+                _lastAdjustStep = 0;
+                _adjustStreak = 0;
+            }
+            break;
+    }
+}
+
+void GestureGrip::handleCustomGesture(int gesture) {
+    if (gesture < 0 || gesture >= CUSTOM_GESTURE_COUNT) return;
+    
+    switch (_customBindings[gesture]) {
+        case ACTION_UPRIGHT:
+            if (_control_state == STATE_DIRECT) _joints.moveToUpright(1);
+            break;
+            
+        case ACTION_DOWNWARD:
+            if (_control_state == STATE_DIRECT) _joints.moveToDownward(1);
+            break;
+            
+        case ACTION_NEXT_STATE:
+            if (millis() - _lastStateChange > _STATE_CHANGE_DEBOUNCE) {
+                advanceControlState();
+                _lastStateChange = millis();
+            }
+            break;
+            
+        case ACTION_NONE:
+        default:
+            break;
+    }
+}
+
+void GestureGrip::handleFusedGesture(const GestureEvent& event) {
+    bool debounced = millis() - _lastStateChange > _STATE_CHANGE_DEBOUNCE;
+    
+    switch (event.gesture) {
+        case GestureFusion::FUSED_TWO_HAND_HOLD:
+            // Both hands over the arm: hold it wherever it got to
+            _joints.stopAllMovements();
+            break;
+            
+        case GestureFusion::FUSED_SWEEP_TO_RIGHT:
+            // Same as NEAR/FAR on the right sensor
+            if (debounced) {
+                advanceControlState();
+                _lastStateChange = millis();
+            }
+            break;
+            
+        case GestureFusion::FUSED_SWEEP_TO_LEFT:
+            // Straight back to direct control from selection or adjustment
+            if (debounced && _control_state != STATE_DIRECT) {
+                clearGestureBacklog();
+                enterDirectControl();
+                refreshLED();
+                _lastStateChange = millis();
+            }
+            break;
+            
+        case GestureFusion::FUSED_NEAR_SWIPE:
+        case GestureFusion::FUSED_FAR_SWIPE: {
+            // Right sensor swipes adjust the selected servo, finely with the hand close
+            if (_control_state != STATE_ADJUST_SERVO) break;
+            if (_selected_servo_index < 0 || _selected_servo_index >= _joints.getServoCount()) break;
+            if (event.direction != DIR_UP && event.direction != DIR_DOWN) break;
+            
+            int step = _SERVO_STEP_DECIDEGREES;
+            if (event.gesture == GestureFusion::FUSED_FAR_SWIPE) step *= _FAR_SWIPE_GAIN;
+            _joints.adjustServo(_selected_servo_index, event.direction == DIR_UP ? step : -step);
+            break;
+        }
+            
+        default:
+            break;
+    }
+}
+
 void GestureGrip::handleSelectionGesture(int gesture) {
     if (gesture == DIR_UP) {
         _selected_servo_index = (_selected_servo_index - 1 + _joints.getServoCount()) % _joints.getServoCount();
@@ -303,16 +899,67 @@ void GestureGrip::handleSelectionGesture(int gesture) {
         _selected_servo_index = (_selected_servo_index + 1) % _joints.getServoCount();
         announceSelectedServo();
     }
+    refreshLED();
 }
 
-void GestureGrip::handleAdjustGesture(int gesture) {
-    if (_selected_servo_index < 0 || _selected_servo_index >= _joints.getServoCount()) return;
+bool GestureGrip::handleAdjustBurst(GestureEvent event, GestureEvent& next) {
+    if (_selected_servo_index < 0 || _selected_servo_index >= _joints.getServoCount()) return false;
+    if (event.gesture != DIR_UP && event.gesture != DIR_DOWN) return false;
     
-    if (gesture == DIR_UP) {
-        _joints.adjustServo(_selected_servo_index, _SERVO_STEP_DEGREES);
-    } else if (gesture == DIR_DOWN) {
-        _joints.adjustServo(_selected_servo_index, -_SERVO_STEP_DEGREES);
+    int direction = event.gesture;
+    int total = 0;
+    int merged = 0;
+    int step = 0;
+    bool took_next = false;
+    
+    // Same-direction swipes that queued up meanwhile become one command. Anything else is
+    // handed back rather than requeued, a full queue would drop it (a mode request included)
+    while (true) {
+        step = adjustStep(event);
+        total += step;
+        merged++;
+        
+        if (xQueueReceive(_gestureQueue, &next, 0) != pdTRUE) break;
+        if (next.type != EVENT_DIRECTION || next.gesture != direction) {
+            took_next = true;
+            break;
+        }
+        event = next;
+    }
+    
+    if (total > _ADJUST_MAX_STEP_DECIDEGREES) total = _ADJUST_MAX_STEP_DECIDEGREES;
+    if (step > total) step = total;
+    _lastAdjustStep = direction == DIR_UP ? step : -step;
+    if (merged > 1) {
+        Serial.printf("Merged %d swipes\n", merged);
     }
+    
+    // A move still in flight is extended, so a streak plays out as one continuous motion
+    _joints.adjustServo(_selected_servo_index, direction == DIR_UP ? total : -total);
+    return took_next;
+}
+
+int GestureGrip::adjustStep(const GestureEvent& event) {
+    unsigned long now = millis();
+    if (event.gesture == _adjustDirection && now - _lastAdjustMs < _ADJUST_STREAK_MS) {
+        if (_adjustStreak < _ADJUST_RATE_LEVELS - 1) _adjustStreak++;
+    } else {
+        _adjustStreak = 0;
+    }
+    _adjustDirection = event.gesture;
+    _lastAdjustMs = now;
+    
+    // A quick pass over the sensor leaves few datasets over a short time
+    int speed_gain = 1;
+    if (event.datasets >= _ADJUST_MIN_SPAN_DATASETS) {
+        if (event.duration_ms < _ADJUST_FAST_SWIPE_MS) {
+            speed_gain = 3;
+        } else if (event.duration_ms < _ADJUST_QUICK_SWIPE_MS) {
+            speed_gain = 2;
+        }
+    }
+    
+    return _SERVO_STEP_DECIDEGREES * _ADJUST_RATE_GAIN[_adjustStreak] * speed_gain;
 }
 
 void GestureGrip::handleGesture(int gesture, const char* sensor_name) {
@@ -2,17 +2,35 @@
 #define GESTURE_GRIP_H
 
 #include <Arduino.h>
+#include <atomic>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
+#include <freertos/event_groups.h>
 #include "gesture_grip_sensors.h"
 #include "gesture_grip_joints.h"
+#include "boot_timing.h"
+#include "gesture_classifier.h"
+#include "gesture_fusion.h"
+#include "latency_trace.h"
+#include "serial_console.h"
+#include "task_monitor.h"
 
 /**
  * @brief   Main controller for gesture-controlled robotic arm
  */
 class GestureGrip {
 public:
+    /**
+     * @brief   what a recognised custom gesture does
+     */
+    enum CustomAction {
+        ACTION_NONE = 0,       // logged only
+        ACTION_UPRIGHT,        // same as a RIGHT swipe in direct mode
+        ACTION_DOWNWARD,       // same as a LEFT swipe in direct mode
+        ACTION_NEXT_STATE      // same as NEAR/FAR on the right sensor
+    };
+
     GestureGrip();
 
     /**
@@ -28,11 +46,37 @@ public:
     void start();
 
     /**
-     * @brief   Main update loop (call from Arduino loop)
+     * @brief   Main update loop (call from Arduino loop), serves the serial console and sleeps otherwise
      * @returns none
      */
     void update();
 
+    /**
+     * @brief   Prints power management, wake latency, servo hold and LED figures
+     * @returns none
+     */
+    void printPowerReport();
+
+    /**
+     * @brief   Prints how long each boot phase took
+     * @returns none
+     */
+    void printBootReport() { _boot.printReport(); }
+
+    /**
+     * @brief   Gets the boot phase timings for later inspection
+     * @returns reference to the boot profiler
+     */
+    BootProfiler& getBootProfiler() { return _boot; }
+
+    /**
+     * @brief   Binds a classifier gesture to an action of the state machine
+     * @param[in]   gesture: custom gesture from the classifier
+     * @param[in]   action: action to run when it is recognised
+     * @returns none
+     */
+    void bindCustomGesture(CustomGesture gesture, CustomAction action);
+
 private:
     // Control state machine
     enum ControlState {
@@ -49,27 +93,125 @@ private:
     GestureGripJoints _joints;
 
     // FreeRTOS components
-    TaskHandle_t _gestureTaskHandle;
+    TaskHandle_t _leftTaskHandle;     // acquisition task of the left bus
+    TaskHandle_t _rightTaskHandle;    // acquisition task of the right bus
     TaskHandle_t _servoTaskHandle;
-    TaskHandle_t _ledTaskHandle;
-    TaskHandle_t _stabilizerTaskHandle;
+    TaskHandle_t _fusionTaskHandle;
     QueueHandle_t _gestureQueue;
 
+    // Boot pipeline, sensors come up on core 0 while the joints home on core 1
+    EventGroupHandle_t _bootEvents;
+    volatile bool _sensorsReady;
+    BootProfiler _boot;
+    static const EventBits_t _BOOT_JOINTS_DONE = (1 << 0);
+    static const EventBits_t _BOOT_SENSORS_DONE = (1 << 1);
+    static const int _BOOT_TIMEOUT_MS = 15000;
+
+    enum GestureEventType {
+        EVENT_DIRECTION = 0,   // gesture is a SparkFun DIR_* value
+        EVENT_CUSTOM,          // gesture is a CustomGesture from the classifier
+        EVENT_RETRACT,         // gesture is an early committed DIR_* value the full decode overruled
+        EVENT_FUSED,           // gesture is a GestureFusion::Event seen across both sensors
+        EVENT_MODE             // gesture is the right sensor's DIR_NEAR/DIR_FAR, asks for the next control state
+    };
+
     struct GestureEvent {
+        GestureEventType type;
         int gesture;
+        uint16_t datasets;      // FIFO datasets behind a direction, 0 for custom gestures
+        uint16_t duration_ms;   // first to last of those datasets
+        uint16_t trace;         // LatencyTrace id, NO_TRACE if untraced
+        uint8_t direction;      // fused swipes over the right sensor: DIR_* value, DIR_NONE otherwise
     };
+    static const int _GESTURE_QUEUE_LENGTH = 8;  // room for a burst of swipes while a move is posted
+
+    // On-device classifier for the recorded custom gestures
+    GestureClassifier _classifier;
+    TaskHandle_t _classifierTaskHandle;
+    CustomAction _customBindings[CUSTOM_GESTURE_COUNT];
+    static const int _CLASSIFIER_PERIOD_MS = 50;       // 20 Hz, the rate the recordings were taken at
+    static const int _CLASSIFY_EVERY_FRAMES = 2;       // slide the window 100 ms between inferences
+    static const uint32_t _CLASSIFIER_BUDGET_US = 10000;
+
+    /**
+     * @brief   running cost of one inference in microseconds
+     */
+    struct ClassifierStats {
+        uint32_t windows;
+        uint64_t total_us;
+        uint32_t max_us;
+        uint32_t over_budget;
+        uint32_t overruns;     // frame ring datasets lost before the classifier read them
+    };
+    ClassifierStats _classifierStats;
+
+    // Both sensors' frames on the common clock, for sweeps, two hand holds and depth-aware swipes
+    GestureFusion _fusion;
+    std::atomic<bool> _twoHandHold;    // set on a hold, the right sensor's NEAR/FAR at its end is not a mode change
+    static const int _FUSION_PERIOD_MS = 20;           // well inside the end gap, results within a read period
+    static const int _FUSION_IDLE_PERIODS = 10;        // nothing arrived for this long after a wake, sleep again
+    static const int _FAR_SWIPE_GAIN = 5;              // far swipes over the right sensor adjust coarsely
+
+    // Swipe to first servo write, dumped and reset from the serial console
+    LatencyTrace _trace;
+    SerialConsole _console;
+
+    // CPU, stack, queue and deadline figures of every task
+    TaskMonitor _monitor;
+    PeriodicDeadline _classifierDeadline;
+    PeriodicDeadline _fusionDeadline;
+    int _gestureQueueWatch;
+    static const uint32_t _TELEMETRY_MS = 10000;
 
     // Timing control
-    unsigned long _lastStateChange;
+    unsigned long _lastStateChange;    // control state, selection and adjust streak belong to ServoTask alone
     static const int _STATE_CHANGE_DEBOUNCE = 1000;
-    static const int _SERVO_STEP_DEGREES = 3;  // small smoother, less harsh adjustments
+    static const int _SERVO_STEP_DECIDEGREES = 10;  // 1 degree, no longer rounded up to the old 3 degree write tolerance
+
+    // Adjust mode acceleration: steps grow with swipe rate and swipe speed
+    static constexpr int _ADJUST_RATE_GAIN[] = {1, 2, 3, 5, 8};   // by same-direction streak length
+    static constexpr int _ADJUST_RATE_LEVELS = sizeof(_ADJUST_RATE_GAIN) / sizeof(_ADJUST_RATE_GAIN[0]);
+    static const unsigned long _ADJUST_STREAK_MS = 700;    // next swipe within this keeps the streak
+    static const uint16_t _ADJUST_MIN_SPAN_DATASETS = 4;   // fewer is too little to time the swipe
+    static const uint16_t _ADJUST_FAST_SWIPE_MS = 120;     // triple step
+    static const uint16_t _ADJUST_QUICK_SWIPE_MS = 250;    // double step
+    static const int _ADJUST_MAX_STEP_DECIDEGREES = 300;   // per merged command
+    int _adjustStreak;
+    int _adjustDirection;
+    unsigned long _lastAdjustMs;
+    int _lastAdjustStep;    // tenths of a degree the last adjust swipe moved, signed, 0 once retracted
+
+    // Power: standby turns the LED off once no gesture has come for a while, so with every
+    // joint released nothing is left holding a PowerLock and the chip can light sleep
+    PowerManager _power;
+    PowerLock _gestureLock;           // held while a gesture is collected, INT stays low meanwhile
+    std::atomic<bool> _standby;
+    volatile uint32_t _lastGestureMs; // either sensor started or finished a gesture
+    static const int _STANDBY_AFTER_MS = 30000;
+    static const uint8_t _CLASSIFIER_IDLE_PROXIMITY = 30;   // below the gesture engine's entry threshold of 60
+    static const int _GESTURE_START_DELAY_MS = 2000;   // cold boot only, lets the homed arm settle
+    int _gestureStartDelayMs;
+
+    /**
+     * @brief   FreeRTOS task that brings up the sensors during boot, then deletes itself
+     * @param[in]   parameter: pointer to GestureGrip instance
+     * @returns none
+     */
+    static void sensorBootTaskWrapper(void* parameter);
 
     /**
-     * @brief   FreeRTOS task for reading gestures
+     * @brief   FreeRTOS task reading the left sensor's gestures
      * @param[in]   parameter: pointer to GestureGrip instance
      * @returns none
      */
-    static void gestureTaskWrapper(void* parameter);
+    static void leftGestureTaskWrapper(void* parameter);
+
+    /**
+     * @brief   FreeRTOS task reading the right sensor's gestures
+     * @param[in]   parameter: pointer to GestureGrip instance
+     * @returns none
+     */
+    static void rightGestureTaskWrapper(void* parameter);
 
     /**
      * @brief   FreeRTOS task for controlling servos
@@ -79,24 +221,108 @@ private:
     static void servoTaskWrapper(void* parameter);
 
     /**
-     * @brief   FreeRTOS task for controlling LED
+     * @brief   FreeRTOS task running the custom gesture classifier
      * @param[in]   parameter: pointer to GestureGrip instance
      * @returns none
      */
-    static void ledTaskWrapper(void* parameter);
+    static void classifierTaskWrapper(void* parameter);
 
     /**
-     * @brief   FreeRTOS task for stabilizing servos during adjustment
+     * @brief   FreeRTOS task fusing the two sensors' frames
      * @param[in]   parameter: pointer to GestureGrip instance
      * @returns none
      */
-    static void stabilizerTaskWrapper(void* parameter);
+    static void fusionTaskWrapper(void* parameter);
+
+    /**
+     * @brief   Console command printing the latency histograms, "trace reset" clears them
+     * @param[in]   context: pointer to GestureGrip instance
+     * @param[in]   args: rest of the command line
+     * @returns none
+     */
+    static void traceCommand(void* context, const char* args);
+
+    /**
+     * @brief   Console command printing the power report
+     * @param[in]   context: pointer to GestureGrip instance
+     * @param[in]   args: rest of the command line, unused
+     * @returns none
+     */
+    static void powerCommand(void* context, const char* args);
+
+    /**
+     * @brief   Console command printing the task monitor table
+     * @param[in]   context: pointer to GestureGrip instance
+     * @param[in]   args: rest of the command line, unused
+     * @returns none
+     */
+    static void tasksCommand(void* context, const char* args);
+
+    /**
+     * @brief   Console command setting the telemetry period, "telemetry 0" stops it
+     * @param[in]   context: pointer to GestureGrip instance
+     * @param[in]   args: period in seconds
+     * @returns none
+     */
+    static void telemetryCommand(void* context, const char* args);
+
+    /**
+     * @brief   Console command printing the FIFO reads of each sensor bus, "acquire reset" clears them,
+     *          "acquire polling" and "acquire interrupt" switch how the gesture tasks find new data
+     * @param[in]   context: pointer to GestureGrip instance
+     * @param[in]   args: rest of the command line
+     * @returns none
+     */
+    static void acquireCommand(void* context, const char* args);
 
     /**
-     * @brief   Main gesture reading loop
+     * @brief   Queues a left sensor swipe with its FIFO span and opens its latency trace
+     * @param[in]   gesture: direction constant
+     * @param[in]   span: FIFO data and timing behind the decision
      * @returns none
      */
-    void gestureTask();
+    void queueDirection(int gesture, const GestureGripSensors::GestureSpan& span);
+
+    /**
+     * @brief   Sends an event to the servo task and lets the task monitor see the queue depth
+     * @param[in]   event: event to queue, dropped if the queue is full
+     * @param[in]   front: goes ahead of the events already waiting
+     * @returns none
+     */
+    void queueEvent(const GestureEvent& event, bool front = false);
+
+    /**
+     * @brief   Initializes sensors, then clears startup gestures once the joints are done
+     * @returns none
+     */
+    void sensorBootTask();
+
+    /**
+     * @brief   Attaches the servos and homes the arm unless it is a warm boot
+     * @returns true if joints initialized successfully
+     */
+    bool bootJoints();
+
+    /**
+     * @brief   Gesture reading loop of one sensor bus, runs once per bus
+     * @param[in]   line: GestureGripSensors::NOTIFY_LEFT or NOTIFY_RIGHT
+     * @returns none
+     */
+    void gestureTask(uint32_t line);
+
+    /**
+     * @brief   Reads a FIFO batch of the left sensor and queues its swipes, commits and template matches
+     * @param[out]  accepted: set once something was sent to the servo task
+     * @returns true once the gesture is finished
+     */
+    bool serviceLeftSensor(bool& accepted);
+
+    /**
+     * @brief   Reads a FIFO batch of the right sensor and changes state on NEAR/FAR
+     * @param[out]  accepted: set once the state changed
+     * @returns true once the gesture is finished
+     */
+    bool serviceRightSensor(bool& accepted);
 
     /**
      * @brief   Main servo control loop
@@ -105,16 +331,28 @@ private:
     void servoTask();
 
     /**
-     * @brief   Main LED update loop
+     * @brief   Shows the LED pattern of the current state and selection, off in standby
      * @returns none
      */
-    void ledTask();
+    void refreshLED();
 
     /**
-     * @brief   Stabilizer loop that locks servos during adjustment
+     * @brief   Switches the LED off and reports power figures after a quiet spell
      * @returns none
      */
-    void stabilizerTask();
+    void enterStandby();
+
+    /**
+     * @brief   Samples left sensor frames at 20 Hz and classifies the sliding window, sleeping while no hand is near
+     * @returns none
+     */
+    void classifierTask();
+
+    /**
+     * @brief   Feeds both frame rings to the fusion every 20 ms and queues its results, sleeping while no hand is near
+     * @returns none
+     */
+    void fusionTask();
 
     /**
      * @brief   Advances to next control state
@@ -122,6 +360,18 @@ private:
      */
     void advanceControlState();
 
+    /**
+     * @brief   Drops queued gestures and the adjust streak before a state change
+     * @returns none
+     */
+    void clearGestureBacklog();
+
+    /**
+     * @brief   Switches to direct control and announces it
+     * @returns none
+     */
+    void enterDirectControl();
+
     /**
      * @brief   Announces currently selected servo
      * @returns none
@@ -143,11 +393,40 @@ private:
     void handleSelectionGesture(int gesture);
 
     /**
-     * @brief   Handles gesture in servo adjustment mode
-     * @param[in]   gesture: gesture direction constant
+     * @brief   Handles a swipe in servo adjustment mode, merging same-direction swipes already queued
+     * @param[in]   event: first gesture event of the burst
+     * @param[out]  next: event that ended the burst, when one was taken off the queue
+     * @returns true if next holds an event still to be handled
+     */
+    bool handleAdjustBurst(GestureEvent event, GestureEvent& next);
+
+    /**
+     * @brief   Scales the adjustment step of one swipe by streak and swipe speed
+     * @param[in]   event: direction gesture event
+     * @returns step in tenths of a degree
+     */
+    int adjustStep(const GestureEvent& event);
+
+    /**
+     * @brief   Undoes an early committed swipe the full decode did not confirm
+     * @param[in]   gesture: direction constant that was committed
+     * @returns none
+     */
+    void retractGesture(int gesture);
+
+    /**
+     * @brief   Runs the action bound to a custom gesture
+     * @param[in]   gesture: CustomGesture value
+     * @returns none
+     */
+    void handleCustomGesture(int gesture);
+
+    /**
+     * @brief   Runs a gesture seen across both sensors
+     * @param[in]   event: fused gesture event
      * @returns none
      */
-    void handleAdjustGesture(int gesture);
+    void handleFusedGesture(const GestureEvent& event);
 
     /**
      * @brief   Prints gesture to serial monitor
@@ -1,40 +1,83 @@
 #include "gesture_grip_joints.h"
 
 GestureGripJoints::GestureGripJoints() :
-    _ledState(false),
-    _lastBlink(0)
+    _planner(_jointLimits, _SERVO_COUNT),
+    _plannedDurationMs(0),
+    _warmBoot(false),
+    _led(_LED_PIN_RED, _LED_PIN_GREEN, _LED_PIN_BLUE, _LED_FIRST_CHANNEL, _LED_BRIGHTNESS)
 {
     _servoRefs[0] = &_servo_base;
     _servoRefs[1] = &_servo_middle;
     _servoRefs[2] = &_servo_cross;
     _servoRefs[3] = &_servo_left;
     _servoRefs[4] = &_servo_right;
+
+    for (int i = 0; i < _SERVO_COUNT; i++) {
+        _motion.addJoint(_servoRefs[i]);
+        _motion.setHoldPolicy(i, _holdConfigs[i]);
+        _adjustTargets[i] = -1;
+    }
 }
 
 bool GestureGripJoints::initialize() {
     initializeLED(); // initialize the leds
 
-    Serial.println("Attaching servos with soft start...");
+    // Where the arm was left, so the servos do not slam to 0 and back
+    int start[_SERVO_COUNT] = {0, 0, 0, 0, 0};
+    _warmBoot = _journal.begin() && _journal.load(start, _SERVO_COUNT);
+
+    if (_warmBoot) {
+        Serial.println("Attaching servos at journalled pose...");
+    } else {
+        Serial.println("Attaching servos with soft start...");
+    }
     
+    // Cold boot staggers the attaches to spread the inrush; on warm boot nothing moves
+    unsigned long settle_ms = _warmBoot ? 0 : _ATTACH_SETTLE_MS;
+
     bool success = true;
-    // Attach all servos starting at 0 degrees (safe position)
-    success &= _servo_base.attach(_PIN_BASE, 1, true, 0, {20, 80});
-    delay(200);  // Give servo time to settle
-    success &= _servo_middle.attach(_PIN_MIDDLE, 2, true, 0, {0, 80});
-    delay(200);
-    success &= _servo_cross.attach(_PIN_CROSS, 3, true, 0, {0, 180});
-    delay(200);
-    success &= _servo_left.attach(_PIN_LEFT, 4, true, 0, {0, 170});
-    delay(200);
-    success &= _servo_right.attach(_PIN_RIGHT, 5, true, 0, {0, 170});
-    delay(200);  // Extra delay before movement
+    success &= _servo_base.attach(_PIN_BASE, 1, true, start[0], {20, 80}, &_servoCalibrations[0]);
+    delay(settle_ms);
+    success &= _servo_middle.attach(_PIN_MIDDLE, 2, true, start[1], {0, 80}, &_servoCalibrations[1]);
+    delay(settle_ms);
+    success &= _servo_cross.attach(_PIN_CROSS, 3, true, start[2], {0, 180}, &_servoCalibrations[2]);
+    delay(settle_ms);
+    success &= _servo_left.attach(_PIN_LEFT, 4, true, start[3], {0, 170}, &_servoCalibrations[3]);
+    delay(settle_ms);
+    success &= _servo_right.attach(_PIN_RIGHT, 5, true, start[4], {0, 170}, &_servoCalibrations[4]);
+    delay(settle_ms);
 
     Serial.println("Servos attached and stabilized");
+
+    // One task drives every joint from here on
+    success &= _motion.start(_MOTION_TASK_PRIORITY, _MOTION_TASK_CORE);
     return success;
 }
 
+unsigned long GestureGripJoints::journalPose() {
+    // Only settled poses are worth resuming from
+    for (int i = 0; i < _SERVO_COUNT; i++) {
+        if (_motion.isMoving(i)) return _JOURNAL_MOVING_MS;
+    }
+
+    int pose[_SERVO_COUNT];
+    for (int i = 0; i < _SERVO_COUNT; i++) {
+        pose[i] = _servoRefs[i]->get_current_position();
+    }
+    _journal.record(pose, _SERVO_COUNT);
+
+    if (_journal.service()) {
+        _journal.printStats();
+        printPowerReport();
+    }
+    return _journal.getDueInMs();
+}
+
 bool GestureGripJoints::waitForServos(unsigned long timeout_ms) {
     unsigned long startTime = millis();
+    if (timeout_ms == 0) {
+        timeout_ms = _plannedDurationMs + _WAIT_MARGIN_MS;
+    }
     
     Serial.println("Waiting for all servos to reach target...");
     
@@ -42,11 +85,9 @@ bool GestureGripJoints::waitForServos(unsigned long timeout_ms) {
         bool allStopped = true;
         
         // Check if all servos have stopped moving
-        if (_servo_base.get_is_moving()) allStopped = false;
-        if (_servo_middle.get_is_moving()) allStopped = false;
-        if (_servo_cross.get_is_moving()) allStopped = false;
-        if (_servo_left.get_is_moving()) allStopped = false;
-        if (_servo_right.get_is_moving()) allStopped = false;
+        for (int i = 0; i < _SERVO_COUNT; i++) {
+            if (_motion.isMoving(i)) allStopped = false;
+        }
         
         if (allStopped) {
             Serial.println("All servos reached their targets!");
@@ -70,26 +111,30 @@ bool GestureGripJoints::waitForServos(unsigned long timeout_ms) {
     return false;
 }
 
+void GestureGripJoints::printResourceUsage() {
+    _motion.printResourceUsage();
+}
+
+void GestureGripJoints::printPowerReport() {
+    _motion.printPowerReport();
+    _led.printStats();
+}
+
 void GestureGripJoints::stopAllMovements() {
-    Serial.println("Stopping all servo movement tasks...");
+    Serial.println("Stopping all servo movement...");
     
-    // Stop all servo movement tasks by setting them to their current position
-    _servo_base.stop_movement();
-    _servo_middle.stop_movement();
-    _servo_cross.stop_movement();
-    _servo_left.stop_movement();
-    _servo_right.stop_movement();
-    
-    vTaskDelay(pdMS_TO_TICKS(100));
+    // Holds every joint at its current position
+    _motion.stopAll();
+    for (int i = 0; i < _SERVO_COUNT; i++) {
+        _adjustTargets[i] = -1;
+    }
 }
 
 void GestureGripJoints::lockOtherServos(int servo_index) {
-    // Actively hold all other servos at their current position
-    // This prevents jitter when one servo moves
+    // Re-engages any joint its hold policy let go of, at the pulse it was released at
     for (int i = 0; i < _SERVO_COUNT; i++) {
         if (i != servo_index) {
-            int current_angle = _servoRefs[i]->get_current_angle();
-            _servoRefs[i]->safe_servo_write(current_angle);
+            _motion.hold(i);
         }
     }
 }
@@ -101,57 +146,60 @@ void GestureGripJoints::adjustServo(int servo_index, int increment) {
     lockOtherServos(servo_index);
     
     ServoController* servo = _servoRefs[servo_index];
-    int current = servo->get_current_angle();
-    int target = current + increment;
+    int current = servo->get_current_position();
     
-    // Get boundaries from servo's attached boundaries
-    std::array<int, 2> boundaries = {{0, 180}};
-    switch(servo_index) {
-        case 0: boundaries = {{20, 80}}; break;   // base
-        case 1: boundaries = {{0, 80}}; break;    // middle
-        case 2: boundaries = {{0, 180}}; break;   // cross
-        case 3: boundaries = {{0, 170}}; break;   // left
-        case 4: boundaries = {{0, 170}}; break;   // right
+    // Still travelling from the last adjustment, so keep going from where that one ends
+    int from = current;
+    if (_adjustTargets[servo_index] >= 0 && _motion.isMoving(servo_index)) {
+        from = _adjustTargets[servo_index];
     }
-    target = constrain(target, boundaries[0], boundaries[1]);
+    int target = servo->constrain_position(from + increment);
+    _adjustTargets[servo_index] = target;
     
-    Serial.printf("%s: %d° -> %d° (step: %+d°)\n",
+    Serial.printf("%s: %.1f° -> %.1f° (step: %+.1f°)\n",
                   _servoLabels[servo_index],
-                  current,
-                  target,
-                  increment);
+                  current / (float)ServoController::DECIDEGREES,
+                  target / (float)ServoController::DECIDEGREES,
+                  increment / (float)ServoController::DECIDEGREES);
     
-    servo->safe_servo_write(target);
-    
-    // Re-lock other servos after adjustment to maintain stability
-    vTaskDelay(pdMS_TO_TICKS(10));  // Small delay for servo to start moving
-    lockOtherServos(servo_index);
+    // Before the joint leaves the journalled pose, so a power cut mid-move homes on the next boot
+    _journal.markMoving();
+    _motion.moveTo(servo_index, EASE_LINEAR, target);
 }
 
-void GestureGripJoints::moveToUpright(int steps_per_degree) {
+uint32_t GestureGripJoints::moveToUpright(int slowdown) {
     Serial.println("Moving to UPWARD position...");
-    _servo_base.move_to("cos", 50, steps_per_degree);
-    vTaskDelay(pdMS_TO_TICKS(300));
-    _servo_middle.move_to("cos", 60, steps_per_degree);  
-    vTaskDelay(pdMS_TO_TICKS(300));
-    _servo_cross.move_to("cos", 90, steps_per_degree);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    _servo_left.move_to("cos", 85, steps_per_degree);
-    vTaskDelay(pdMS_TO_TICKS(50));
-    _servo_right.move_to("cos", 85, steps_per_degree);
-}
-
-void GestureGripJoints::moveToDownward(int steps_per_degree) {
+    return moveToPose(_POSE_UPRIGHT, slowdown);
+}
+
+uint32_t GestureGripJoints::moveToDownward(int slowdown) {
     Serial.println("Moving to DOWNWARD position...");
-    _servo_base.move_to("cos", 75, steps_per_degree);
-    vTaskDelay(pdMS_TO_TICKS(300));
-    _servo_middle.move_to("cos", 100, steps_per_degree);
-    vTaskDelay(pdMS_TO_TICKS(300));
-    _servo_cross.move_to("cos", 0, steps_per_degree);  
-    vTaskDelay(pdMS_TO_TICKS(200));
-    _servo_left.move_to("cos", 0, steps_per_degree);
-    vTaskDelay(pdMS_TO_TICKS(50));
-    _servo_right.move_to("cos", 0, steps_per_degree);
+    return moveToPose(_POSE_DOWNWARD, slowdown);
+}
+
+uint32_t GestureGripJoints::moveToPose(const int* pose, int slowdown) {
+    int start[_SERVO_COUNT];
+    int target[_SERVO_COUNT];
+    JointProfile profiles[_SERVO_COUNT];
+
+    for (int i = 0; i < _SERVO_COUNT; i++) {
+        start[i] = _servoRefs[i]->get_current_position();
+        target[i] = _servoRefs[i]->constrain_position(pose[i] * ServoController::DECIDEGREES);
+        _adjustTargets[i] = -1;
+    }
+
+    _plannedDurationMs = _planner.plan(start, target, (float)slowdown, profiles);
+
+    _journal.markMoving();
+
+    // Same start tick for every joint so they all finish on the same step
+    TickType_t start_tick = _motion.nextStartTick();
+    for (int i = 0; i < _SERVO_COUNT; i++) {
+        _motion.moveProfile(i, profiles[i].target, profiles[i].duration_ms, profiles[i].blend, start_tick);
+    }
+
+    Serial.printf("Planned synchronised move: %u ms\n", (unsigned)_plannedDurationMs);
+    return _plannedDurationMs;
 }
 
 int GestureGripJoints::getServoAngle(int servo_index) {
@@ -165,52 +213,33 @@ const char* GestureGripJoints::getServoLabel(int servo_index) {
 }
 
 void GestureGripJoints::updateLED(int state, int selected_servo) {
-    unsigned long now = millis();
-    
+    bool selected = selected_servo >= 0 && selected_servo < _SERVO_COUNT;
+
+    // Repeated calls with the same state leave the LED hardware alone
     switch (state) {
         case 0: // STATE_DIRECT
-            setRGBColor(_COLOR_WHITE);
+            _led.show(StatusLed::PATTERN_SOLID, _COLOR_WHITE);
             break;
             
         case 1: // STATE_SELECT_SERVO
-            if (now - _lastBlink >= _BLINK_INTERVAL) { // blink selected servo color
-                _ledState = !_ledState;
-                _lastBlink = now;
-            }
-            
-            if (_ledState && selected_servo >= 0 && selected_servo < _SERVO_COUNT) {
-                setRGBColor(_servoColors[selected_servo]);
-            } else {
-                setRGBColorPWM(0, 0, 0);
-            }
+            if (selected) _led.show(StatusLed::PATTERN_BLINK, _servoColors[selected_servo], _BLINK_PERIOD_MS);
             break;
             
         case 2: // STATE_ADJUST_SERVO
-            if (selected_servo >= 0 && selected_servo < _SERVO_COUNT) {
-                setRGBColor(_servoColors[selected_servo]);
-            }
+            if (selected) _led.show(StatusLed::PATTERN_SOLID, _servoColors[selected_servo]);
+            break;
+            
+        default: // standby
+            _led.show(StatusLed::PATTERN_OFF, _COLOR_WHITE);
             break;
     }
 }
 
 void GestureGripJoints::initializeLED() {
-    ledcSetup(6, 5000, 8); // channel 6, 5kHz, 8-bit resolution
-    ledcSetup(7, 5000, 8);
-    ledcSetup(8, 5000, 8);
-    
-    ledcAttachPin(_LED_PIN_RED, 6);
-    ledcAttachPin(_LED_PIN_GREEN, 7);
-    ledcAttachPin(_LED_PIN_BLUE, 8);
-    setRGBColor(_COLOR_WHITE);
+    if (!_led.begin()) {
+        Serial.println("RGB LED timer or lock could not be created");
+        return;
+    }
+    _led.show(StatusLed::PATTERN_BREATHE, _COLOR_WHITE, _BREATHE_PERIOD_MS);
     Serial.println("RGB LED initialized");
 }
-
-void GestureGripJoints::setRGBColor(RGBColor color) {
-    setRGBColorPWM(color.r, color.g, color.b);
-}
-
-void GestureGripJoints::setRGBColorPWM(uint8_t r, uint8_t g, uint8_t b) {
-    ledcWrite(6, (uint8_t)(r * _LED_BRIGHTNESS)); // red
-    ledcWrite(7, (uint8_t)(g * _LED_BRIGHTNESS)); // green
-    ledcWrite(8, (uint8_t)(b * _LED_BRIGHTNESS)); // blue
-}
\ No newline at end of file
@@ -3,6 +3,10 @@
 
 #include <Arduino.h>
 #include "servo_utilities.h"
+#include "servo_motion.h"
+#include "motion_planner.h"
+#include "pose_journal.h"
+#include "status_led.h"
 
 /**
  * @brief   manages all servo joints for robotic arm, LED Feedback is here
@@ -12,24 +16,44 @@ public:
     GestureGripJoints();
 
     /**
-     * @brief   initializes all servo motors and RGB LED
+     * @brief   initializes all servo motors and RGB LED, resuming the journalled pose if there is one
      * @returns true if all servos attached successfully
      */
     bool initialize();
 
     /**
-     * @brief   moves entire arm to upright position
-     * @param[in]   steps_per_degree: steps per degree
-     * @returns none
+     * @brief   gets if initialize() attached the servos at a pose saved before power off
+     * @returns true on warm boot, false if the arm still needs homing
      */
-    void moveToUpright(int steps_per_degree);
+    bool isWarmBoot() const { return _warmBoot; }
 
     /**
-     * @brief   moves entire arm to downward position
-     * @param[in]   steps_per_degree: steps per degree
-     * @returns none
+     * @brief   hands the settled pose to the journal and commits it when due
+     * @returns milliseconds until it needs calling again, ULONG_MAX if only a new move needs it
+     */
+    unsigned long journalPose();
+
+    /**
+     * @brief   moves entire arm to upright position, all joints arriving together
+     * @param[in]   slowdown: divides joint velocity limits (1 = full speed)
+     * @returns planned duration in milliseconds
+     */
+    uint32_t moveToUpright(int slowdown);
+
+    /**
+     * @brief   moves entire arm to downward position, all joints arriving together
+     * @param[in]   slowdown: divides joint velocity limits (1 = full speed)
+     * @returns planned duration in milliseconds
      */
-    void moveToDownward(int steps_per_degree);
+    uint32_t moveToDownward(int slowdown);
+
+    /**
+     * @brief   moves every joint to a pose on a time-synchronised trajectory
+     * @param[in]   pose: target angle for each joint in index order
+     * @param[in]   slowdown: divides joint velocity limits (1 = full speed)
+     * @returns planned duration in milliseconds
+     */
+    uint32_t moveToPose(const int* pose, int slowdown);
 
     /**
      * @brief   stops all servo movements
@@ -38,15 +62,15 @@ public:
     void stopAllMovements();
 
     /**
-     * @brief   adjusts a specific servo by increment
+     * @brief   adjusts a specific servo by increment, extending an adjustment still in flight
      * @param[in]   servo_index: index of servo from 0 to 4
-     * @param[in]   increment: degrees to adjust (positive or negative)
+     * @param[in]   increment: tenths of a degree to adjust (positive or negative)
      * @returns none
      */
     void adjustServo(int servo_index, int increment);
 
     /**
-     * @brief   locks all servos except the specified one at their current position
+     * @brief   drives all servos except the specified one at their current position and restarts their idle time
      * @param[in]   servo_index: index of servo to NOT lock (-1 to lock all)
      * @returns none
      */
@@ -67,13 +91,39 @@ public:
     const char* getServoLabel(int servo_index);
 
     /**
-     * @brief   updates LED based on control state
-     * @param[in]   state: 0 = DIRECT; 1 = SELECT; 2 = ADJUST
+     * @brief   shows the LED pattern of a control state, call when the state or selection changes
+     * @param[in]   state: 0 = DIRECT; 1 = SELECT; 2 = ADJUST; -1 = standby (off)
      * @param[in]   selected_servo: index of currently selected servo, -1 if none burh
      * @returns none
      */
     void updateLED(int state, int selected_servo);
 
+    /**
+     * @brief   flashes the LED to confirm an accepted gesture
+     * @returns none
+     */
+    void flashLED() { _led.flash(); }
+
+    /**
+     * @brief   records the first servo write of traced moves, call before initialize()
+     * @param[in]   trace: gesture latency trace
+     * @returns none
+     */
+    void setLatencyTrace(LatencyTrace* trace) { _motion.setLatencyTrace(trace); }
+
+    /**
+     * @brief   tags the moves requested from now on with a gesture's trace
+     * @param[in]   id: trace id, LatencyTrace::NO_TRACE once the gesture is handled
+     * @returns none
+     */
+    void setTraceId(uint16_t id) { _motion.setTraceId(id); }
+
+    /**
+     * @brief   gets the step period check of the motion task
+     * @returns deadline of the 20 ms motion step
+     */
+    PeriodicDeadline& getMotionDeadline() { return _motion.getStepDeadline(); }
+
     /**
      * @brief   gets total number of controllable servos
      * @returns servo count
@@ -82,10 +132,22 @@ public:
 
     /**
      * @brief   Wait for all servos to reach their target positions
-     * @param[in]   timeout_ms: maximum time to wait in milliseconds
+     * @param[in]   timeout_ms: maximum time to wait in milliseconds, 0 to use the last planned duration
      * @returns true if all servos reached target, false if timeout
      */
-    bool waitForServos(unsigned long timeout_ms = 10000);
+    bool waitForServos(unsigned long timeout_ms = 0);
+
+    /**
+     * @brief   prints heap and motion task stack usage
+     * @returns none
+     */
+    void printResourceUsage();
+
+    /**
+     * @brief   prints servo hold transitions, estimated holding current and LED activity
+     * @returns none
+     */
+    void printPowerReport();
     
 
 private:
@@ -96,6 +158,7 @@ private:
     ServoController _servo_cross;
     ServoController _servo_left;
     ServoController _servo_right;
+    ServoMotionEngine _motion;
 
     static constexpr int _PIN_BASE = 14;
     static constexpr int _PIN_MIDDLE = 26;
@@ -103,17 +166,66 @@ private:
     static constexpr int _PIN_LEFT = 33;
     static constexpr int _PIN_RIGHT = 32;
 
-    const int _LED_PIN_RED = 23;
-    const int _LED_PIN_GREEN = 19;
-    const int _LED_PIN_BLUE = 18;
-    const float _LED_BRIGHTNESS = 0.3;
+    // SG90s are good for far more, these keep the printed arm from whipping
+    const JointLimits _jointLimits[5] = {
+        {90, 180},     // base
+        {90, 180},     // middle
+        {120, 240},    // cross
+        {150, 300},    // left
+        {150, 300}     // right
+    };
+
+    // Angle -> pulse per joint; nominal 500-2500 us until measured on the arm.
+    // Add points where a servo's travel is not linear.
+    const ServoCalibration _servoCalibrations[5] = {
+        {3, {0, 900, 1800}, {500, 1500, 2500}},   // base
+        {3, {0, 900, 1800}, {500, 1500, 2500}},   // middle
+        {3, {0, 900, 1800}, {500, 1500, 2500}},   // cross
+        {3, {0, 900, 1800}, {500, 1500, 2500}},   // left
+        {3, {0, 900, 1800}, {500, 1500, 2500}}    // right
+    };
+
+    // Idle behaviour per joint; middle carries the arm so it never lets go.
+    // Starting points until the sag of each joint is measured under load.
+    const ServoMotionEngine::HoldConfig _holdConfigs[5] = {
+        {ServoMotionEngine::HOLD_DETACH_IDLE, 10000, 0},   // base
+        {ServoMotionEngine::HOLD_ACTIVE, 0, 0},            // middle
+        {ServoMotionEngine::HOLD_REASSERT, 5000, 2000},    // cross
+        {ServoMotionEngine::HOLD_REASSERT, 5000, 2000},    // left
+        {ServoMotionEngine::HOLD_REASSERT, 5000, 2000}     // right
+    };
+
+    const int _POSE_UPRIGHT[5] = {50, 60, 90, 85, 85};
+    const int _POSE_DOWNWARD[5] = {75, 100, 0, 0, 0};
+
+    static constexpr unsigned long _WAIT_MARGIN_MS = 500;  // slack on top of the planned duration
+    static constexpr unsigned long _JOURNAL_MOVING_MS = 100;  // re-check for a settled pose this often while moving
+
+    MotionPlanner _planner;
+    uint32_t _plannedDurationMs;
+    int _adjustTargets[5];    // target of the last adjustServo() per joint, -1 once another move replaced it
+
+    PoseJournal _journal;
+    bool _warmBoot;
+    static constexpr unsigned long _ATTACH_SETTLE_MS = 200;  // between attaches on cold boot only
+
+    static constexpr UBaseType_t _MOTION_TASK_PRIORITY = 2;  // above ServoTask so steps stay on time
+    static constexpr BaseType_t _MOTION_TASK_CORE = 1;
+
+    static constexpr int _LED_PIN_RED = 23;
+    static constexpr int _LED_PIN_GREEN = 19;
+    static constexpr int _LED_PIN_BLUE = 18;
+    static constexpr uint8_t _LED_FIRST_CHANNEL = 6;   // red 6, green 7, blue 8
+    static constexpr float _LED_BRIGHTNESS = 0.3;
+    static constexpr uint32_t _BLINK_PERIOD_MS = 1000;
+    static constexpr uint32_t _BREATHE_PERIOD_MS = 2000;
+
+    StatusLed _led;
 
     ServoController* _servoRefs[5];
     const char* _servoLabels[5] = {"BASE", "MIDDLE", "CROSS", "LEFT", "RIGHT"};
 
-    struct RGBColor {
-        uint8_t r, g, b;
-    };
+    typedef StatusLed::Color RGBColor;
 
     const RGBColor _servoColors[5] = {
         {150, 0, 255},    // base purple
@@ -125,32 +237,11 @@ private:
 
     const RGBColor _COLOR_WHITE = {255, 255, 255};
 
-    bool _ledState;
-    unsigned long _lastBlink;
-    const unsigned long _BLINK_INTERVAL = 500;
-
     /**
-     * @brief   initializes RGB LED PWM channels
+     * @brief   initializes RGB LED PWM channels, breathing white until gestures are live
      * @returns none
      */
     void initializeLED();
-
-    /**
-     * @brief   sets RGB LED color
-     * @param[in]   color: RGB color structure
-     * @returns none
-     */
-    void setRGBColor(RGBColor color);
-
-    /**
-     * @brief   sets RGB LED color with individual values
-     * @param[in]   r: red value between 0 to 255
-     * @param[in]   g: green value between 0 to 255
-     * @param[in]   b: blue value between 0 to 255
-     * @returns none
-     */
-    void setRGBColorPWM(uint8_t r, uint8_t g, uint8_t b);
-
 };
 
 #endif
\ No newline at end of file
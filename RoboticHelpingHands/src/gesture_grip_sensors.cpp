@@ -1,13 +1,35 @@
 #include "gesture_grip_sensors.h"
 
+constexpr uint32_t GestureGripSensors::_GWTIME_US[8];
+
 GestureGripSensors::GestureGripSensors() :
     _i2c_left(0),
     _i2c_right(1),
     _left_apds(&_i2c_left),
-    _right_apds(&_i2c_right)
+    _right_apds(&_i2c_right),
+    _mode(ACQUIRE_INTERRUPT),
+    _enabledAtMs(0),
+    _left_int{this, _LEFT_INT_PIN, NOTIFY_LEFT, 0, 0, NULL},
+    _right_int{this, _RIGHT_INT_PIN, NOTIFY_RIGHT, 0, 0, NULL},
+    _left_bus{NULL, &_frames[0], SENSOR_LEFT, NULL, {-1, 0}, {}, 0, &_left_apds, _PULSE_CYCLE_US, 0, 0, {}},
+    _right_bus{NULL, &_frames[1], SENSOR_RIGHT, NULL, {-1, 0}, {}, 0, &_right_apds, _PULSE_CYCLE_US, 0, 0, {}},
+    _statsSinceUs(0),
+    _latency{},
+    _latencyLock(portMUX_INITIALIZER_UNLOCKED),
+    _busPower(PowerLock::LOCK_APB_MAX, "i2c")
 {}
 
-bool GestureGripSensors::initialize() {
+bool GestureGripSensors::initialize(AcquisitionMode mode) {
+    _mode = mode;
+
+    _left_bus.lock = xSemaphoreCreateMutex();
+    _right_bus.lock = xSemaphoreCreateMutex();
+    if (_left_bus.lock == NULL || _right_bus.lock == NULL) {
+        Serial.println("Failed to create sensor bus locks");
+        return false;
+    }
+    _busPower.begin();
+
     _i2c_left.begin(_LEFT_SDA_PIN, _LEFT_SCL_PIN, 100000); // hopefully fastest
     _i2c_right.begin(_RIGHT_SDA_PIN, _RIGHT_SCL_PIN, 100000);
     
@@ -42,36 +64,157 @@ bool GestureGripSensors::initialize() {
     if (_right_apds.enableProximitySensor(false)) Serial.println("Right proximity enabled");
     else Serial.println("Right proximity failed");
 
-    if (_left_apds.enableGestureSensor(false)) Serial.println("Left gesture enabled");
+    // Gesture INT stays enabled in polling mode too so edges can still be timestamped
+    if (_left_apds.enableGestureSensor(true)) Serial.println("Left gesture enabled");
     else Serial.println("Left gesture failed");
 
-    if (_right_apds.enableGestureSensor(false)) Serial.println("Right gesture enabled");
+    if (_right_apds.enableGestureSensor(true)) Serial.println("Right gesture enabled");
     else Serial.println("Right gesture failed");
+    _enabledAtMs = millis();
+    _statsSinceUs = micros();
+
+    // Datasets are dated back from their FIFO read by this much each
+    _left_bus.dataset_us = _PULSE_CYCLE_US + _GWTIME_US[_left_apds.getGestureWaitTime() & 0x07];
+    _right_bus.dataset_us = _PULSE_CYCLE_US + _GWTIME_US[_right_apds.getGestureWaitTime() & 0x07];
+
+    // Custom gestures come from the left hand, templates run beside the swipe decoder
+    if (TemplateRecognizer::hasTemplates()) {
+        _left_bus.templates = &_left_templates;
+        Serial.printf("Gesture templates: %d DTW cells per step\n", TemplateRecognizer::getCellsPerStep());
+    }
+
+    // Raw FIFO samples feed the frame ring and the templates
+    _left_apds.setGestureSampleCallback(onGestureSample, &_left_bus);
+    _right_apds.setGestureSampleCallback(onGestureSample, &_right_bus);
+
+    // APDS INT is open drain and active low. Level triggered so the same line can wake
+    // light sleep; the ISR masks it and waitForGestures() unmasks it again
+    pinMode(_LEFT_INT_PIN, INPUT_PULLUP);
+    pinMode(_RIGHT_INT_PIN, INPUT_PULLUP);
+    attachInterruptArg(digitalPinToInterrupt(_LEFT_INT_PIN), interruptRoutine, &_left_int, ONLOW_WE);
+    attachInterruptArg(digitalPinToInterrupt(_RIGHT_INT_PIN), interruptRoutine, &_right_int, ONLOW_WE);
+
+    Serial.printf("Gesture acquisition: %s\n", _mode == ACQUIRE_INTERRUPT ? "INTERRUPT" : "POLLING");
 
     return left_init && right_init;
 }
 
+void GestureGripSensors::setAcquisitionMode(AcquisitionMode mode) {
+    _mode = mode;
+    Serial.printf("Gesture acquisition: %s\n", _mode == ACQUIRE_INTERRUPT ? "INTERRUPT" : "POLLING");
+    
+    // Tasks asleep on their INT lines look again, so polling starts without waiting for a gesture
+    if (_left_int.task != NULL) xTaskNotify(_left_int.task, 0, eNoAction);
+    if (_right_int.task != NULL && _right_int.task != _left_int.task) xTaskNotify(_right_int.task, 0, eNoAction);
+}
+
+void GestureGripSensors::setNotifyTask(uint32_t lines, TaskHandle_t task) {
+    if (lines & NOTIFY_LEFT) _left_int.task = task;
+    if (lines & NOTIFY_RIGHT) _right_int.task = task;
+}
+
+uint32_t GestureGripSensors::waitForGestures(uint32_t lines, TickType_t timeout) {
+    uint32_t pending = 0;
+
+    // A line still low from left over FIFO data fires again as soon as it is unmasked
+    if (lines & NOTIFY_LEFT) gpio_intr_enable((gpio_num_t)_LEFT_INT_PIN);
+    if (lines & NOTIFY_RIGHT) gpio_intr_enable((gpio_num_t)_RIGHT_INT_PIN);
+
+    if (_mode == ACQUIRE_INTERRUPT) {
+        xTaskNotifyWait(0, lines, &pending, timeout);
+        return pending & lines;
+    }
+
+    // Polling fallback, same cadence as the original gesture loop
+    TickType_t waited = 0;
+    while (true) {
+        if ((lines & NOTIFY_LEFT) && leftGestureAvailable()) pending |= NOTIFY_LEFT;
+        if ((lines & NOTIFY_RIGHT) && rightGestureAvailable()) pending |= NOTIFY_RIGHT;
+        if (pending != 0 || waited >= timeout) return pending;
+
+        vTaskDelay(pdMS_TO_TICKS(_POLL_INTERVAL_MS));
+        waited += pdMS_TO_TICKS(_POLL_INTERVAL_MS);
+    }
+}
+
+uint32_t GestureGripSensors::getFirstEdgeUs(uint32_t lines) const {
+    uint32_t left_us = (lines & NOTIFY_LEFT) ? _left_int.edge_us : 0;
+    uint32_t right_us = (lines & NOTIFY_RIGHT) ? _right_int.edge_us : 0;
+
+    if (left_us == 0) return right_us;
+    if (right_us == 0) return left_us;
+    return (int32_t)(right_us - left_us) < 0 ? right_us : left_us;
+}
+
 bool GestureGripSensors::leftGestureAvailable() {
-    return _left_apds.isGestureAvailable();
+    lockBus(_left_bus);
+    bool available = _left_apds.isGestureAvailable();
+    unlockBus(_left_bus);
+    return available;
 }
 
 bool GestureGripSensors::rightGestureAvailable() {
-    return _right_apds.isGestureAvailable();
+    lockBus(_right_bus);
+    bool available = _right_apds.isGestureAvailable();
+    unlockBus(_right_bus);
+    return available;
 }
 
-int GestureGripSensors::readLeftGesture() {
-    return readGestureNonBlocking(_left_apds);
+bool GestureGripSensors::pollLeftGesture(int& gesture, GestureSpan* span) {
+    return pollSensor(_left_apds, _left_int, _left_bus, gesture, span);
 }
 
-int GestureGripSensors::readRightGesture() {
-    return readGestureNonBlocking(_right_apds);
+bool GestureGripSensors::pollRightGesture(int& gesture, GestureSpan* span) {
+    return pollSensor(_right_apds, _right_int, _right_bus, gesture, span);
 }
 
-void GestureGripSensors::clearStartupGestures() {
+bool GestureGripSensors::takeLeftCommit(int& gesture, GestureSpan& span) {
+    // Decoder state only, no I2C: the left acquisition task is the one that writes it, no lock needed
+    gesture = _left_apds.takeGestureCommit();
+    
+    // A template match already explains the gesture better than a swipe
+    if (gesture == DIR_NONE || _left_bus.match.gesture >= 0) {
+        gesture = DIR_NONE;
+        return false;
+    }
+    
+    _left_bus.span.committed = gesture;
+    _left_bus.span.committed_us = micros();
+    
+    span = _left_bus.span;
+    span.edge_us = _left_int.edge_us;
+    span.read_start_us = _left_int.read_start_us;
+    span.decoded_us = span.committed_us;
+    span.fifo_cycles = _left_apds.getGestureFifoCycles();
+    span.decode_cycles = _left_apds.getGestureDecodeCycles();
+    return true;
+}
+
+bool GestureGripSensors::takeLeftTemplateMatch(TemplateRecognizer::Match& match) {
+    // Written and taken on the left acquisition task only, no lock needed
+    match = _left_bus.match;
+    _left_bus.match.gesture = -1;
+    return match.gesture >= 0;
+}
+
+bool GestureGripSensors::readLeftProximity(uint8_t& proximity) {
+    return readProximity(_left_apds, _left_bus, proximity);
+}
+
+bool GestureGripSensors::readRightProximity(uint8_t& proximity) {
+    return readProximity(_right_apds, _right_bus, proximity);
+}
+
+void GestureGripSensors::clearStartupGestures(bool warm_boot) {
     Serial.println("Clearing startup gestures...");
-    delay(1000);
+
+    // Whatever ran since initialize() (e.g. homing) already counts towards the settle
+    unsigned long settle_ms = warm_boot ? _WARM_SETTLE_MS : _COLD_SETTLE_MS;
+    unsigned long elapsed_ms = millis() - _enabledAtMs;
+    if (elapsed_ms < settle_ms) delay(settle_ms - elapsed_ms);
     
-    for (int i = 0; i < 10; i++) {
+    int passes = warm_boot ? 1 : 10;
+    for (int i = 0; i < passes; i++) {
         if (_left_apds.isGestureAvailable()) {
             _left_apds.readGesture();
             delay(50);
@@ -82,11 +225,238 @@ void GestureGripSensors::clearStartupGestures() {
         }
         delay(50);
     }
+
+    // Edges from the startup noise are not real gestures
+    _left_int.edge_us = 0;
+    _right_int.edge_us = 0;
     
     Serial.println("Sensors ready!");
 }
 
-int GestureGripSensors::readGestureNonBlocking(SparkFun_APDS9960& apds) {
-    int gesture = apds.readGesture();
-    return (gesture == -1 || gesture == 0) ? DIR_NONE : gesture;
-}
\ No newline at end of file
+void GestureGripSensors::printLatencyReport() {
+    const LatencyStats& stats = _latency[_mode];
+    if (stats.count == 0) {
+        Serial.println("No gesture latency samples yet");
+        return;
+    }
+
+    Serial.printf("[%s] gestures: %u | edge->read avg %lu us max %u us | edge->decode avg %lu us max %u us\n",
+                  _mode == ACQUIRE_INTERRUPT ? "INTERRUPT" : "POLLING",
+                  stats.count,
+                  (unsigned long)(stats.wake_total_us / stats.count),
+                  stats.wake_max_us,
+                  (unsigned long)(stats.read_total_us / stats.count),
+                  stats.read_max_us);
+    if (stats.commits > 0) {
+        Serial.printf("  early commits: %u, decided %lu us before the full decode on average, %u retracted\n",
+                      stats.commits,
+                      (unsigned long)(stats.ahead_total_us / stats.commits),
+                      stats.retractions);
+    }
+}
+
+void GestureGripSensors::printAcquisitionReport() {
+    uint32_t elapsed_us = micros() - _statsSinceUs;
+    const AcquisitionStats& left = _left_bus.stats;
+    const AcquisitionStats& right = _right_bus.stats;
+
+    Serial.printf("FIFO reads over %lu.%lu s, one task per bus:\n",
+                  (unsigned long)(elapsed_us / 1000000), (unsigned long)(elapsed_us / 100000 % 10));
+    printBusStats("left", left);
+    printBusStats("right", right);
+
+    // A full FIFO every read period is the most a bus can take without losing datasets
+    uint32_t left_capacity = left.periods > 0 ? (uint32_t)(_FIFO_DEPTH * 1000000ULL * left.periods / left.period_total_us) : 0;
+    uint32_t right_capacity = right.periods > 0 ? (uint32_t)(_FIFO_DEPTH * 1000000ULL * right.periods / right.period_total_us) : 0;
+    Serial.printf("  both : %u datasets, %u overflows, the buses drain up to %u datasets/s together (%u + %u)\n",
+                  left.datasets + right.datasets, left.overflows + right.overflows,
+                  left_capacity + right_capacity, left_capacity, right_capacity);
+}
+
+void GestureGripSensors::resetAcquisitionStats() {
+    _left_bus.stats = AcquisitionStats{};
+    _right_bus.stats = AcquisitionStats{};
+    _statsSinceUs = micros();
+}
+
+void GestureGripSensors::printBusStats(const char* name, const AcquisitionStats& stats) {
+    if (stats.batches == 0) {
+        Serial.printf("  %-5s: no datasets\n", name);
+        return;
+    }
+
+    Serial.printf("  %-5s: %u datasets in %u reads (%lu.%lu a read), read every %lu.%lu ms (max %lu.%lu ms), "
+                  "bus %lu.%lu ms a read, %u overflows\n",
+                  name, stats.datasets, stats.batches,
+                  (unsigned long)(stats.datasets / stats.batches),
+                  (unsigned long)(stats.datasets * 10 / stats.batches % 10),
+                  (unsigned long)(stats.periods > 0 ? stats.period_total_us / stats.periods / 1000 : 0),
+                  (unsigned long)(stats.periods > 0 ? stats.period_total_us / stats.periods / 100 % 10 : 0),
+                  (unsigned long)(stats.period_max_us / 1000),
+                  (unsigned long)(stats.period_max_us / 100 % 10),
+                  (unsigned long)(stats.bus_us / stats.batches / 1000),
+                  (unsigned long)(stats.bus_us / stats.batches / 100 % 10),
+                  stats.overflows);
+}
+
+void IRAM_ATTR GestureGripSensors::interruptRoutine(void* arg) {
+    InterruptLine* line = static_cast<InterruptLine*>(arg);
+
+    // Level triggered, so it stays masked until the task has looked at the sensor
+    gpio_intr_disable((gpio_num_t)line->pin);
+
+    // Keep the first edge so latency covers the whole wait
+    if (line->edge_us == 0) {
+        line->edge_us = micros() | 1;
+    }
+
+    GestureGripSensors* owner = line->owner;
+    if (owner->_mode != ACQUIRE_INTERRUPT || line->task == NULL) return;
+
+    BaseType_t higher_priority_woken = pdFALSE;
+    xTaskNotifyFromISR(line->task, line->notify_bit, eSetBits, &higher_priority_woken);
+    if (higher_priority_woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void GestureGripSensors::onGestureSample(void* context, const uint8_t* udlr) {
+    SensorBus* bus = static_cast<SensorBus*>(context);
+
+    // Each bus has its own acquisition task and ring, so every ring keeps a single producer.
+    // The newest dataset was in the FIFO when the read started, the ones before it are a
+    // dataset period apart; micros() is one clock on both cores, so both rings line up
+    SensorFrame frame;
+    frame.timestamp_us = bus->read_us - bus->apds->getGestureSampleBacklog() * bus->dataset_us;
+    frame.sensor = bus->sensor;
+    memcpy(frame.udlr, udlr, sizeof(frame.udlr));
+    bus->frames->publish(frame);
+    bus->stats.datasets++;
+
+    // Swipe speed stays timed by reads, as adjust mode was tuned with
+    uint32_t now_us = micros();
+    if (bus->span.datasets == 0) bus->first_us = now_us;
+    bus->span.datasets++;
+    bus->span.duration_us = now_us - bus->first_us;
+
+    if (bus->templates != NULL && bus->templates->push(udlr) && bus->match.gesture < 0) {
+        bus->match = bus->templates->getMatch();
+    }
+}
+
+void GestureGripSensors::finishGesture(SensorBus& bus, GestureSpan* span) {
+    if (span != NULL) *span = bus.span;
+    bus.span = GestureSpan{};
+
+    if (bus.templates == NULL) return;
+
+    // Only the best unconfirmed candidate can still come out of finish()
+    if (bus.match.gesture < 0 && bus.templates->finish()) {
+        bus.match = bus.templates->getMatch();
+    } else {
+        bus.templates->reset();
+    }
+}
+
+bool GestureGripSensors::readProximity(SparkFun_APDS9960& apds, SensorBus& bus, uint8_t& proximity) {
+    lockBus(bus);
+
+    // Register pointer writes and reads must not interleave with the gesture task's
+    bool ok = apds.readProximity(proximity);
+    if (!ok) proximity = 0;
+
+    unlockBus(bus);
+    return ok;
+}
+
+void GestureGripSensors::lockBus(SensorBus& bus) {
+    xSemaphoreTake(bus.lock, portMAX_DELAY);
+    _busPower.acquire();
+}
+
+void GestureGripSensors::unlockBus(SensorBus& bus) {
+    _busPower.release();
+    xSemaphoreGive(bus.lock);
+}
+
+bool GestureGripSensors::pollWithLatency(SparkFun_APDS9960& apds, InterruptLine& line, GestureSpan& span, int& gesture) {
+    if (!apds.isGestureInProgress()) {
+        line.read_start_us = micros();
+    }
+
+    uint8_t status = apds.pollGesture(gesture);
+    if (status == GESTURE_IN_PROGRESS) return false;
+
+    // Errors and empty reads finish the gesture with nothing to report
+    if (status != GESTURE_DONE || gesture == -1) gesture = DIR_NONE;
+
+    uint32_t edge_us = line.edge_us;
+    line.edge_us = 0;
+
+    span.edge_us = edge_us;
+    span.read_start_us = line.read_start_us;
+    span.decoded_us = micros();
+    span.fifo_cycles = apds.getGestureFifoCycles();
+    span.decode_cycles = apds.getGestureDecodeCycles();
+
+    // Both acquisition tasks finish gestures into the same figures
+    LatencyStats& stats = _latency[_mode];
+    portENTER_CRITICAL(&_latencyLock);
+    if (span.committed != DIR_NONE) {
+        stats.commits++;
+        if (gesture != span.committed) stats.retractions++;
+        stats.ahead_total_us += span.decoded_us - span.committed_us;
+    }
+    portEXIT_CRITICAL(&_latencyLock);
+
+    // Only gestures that came with an INT edge can be timed
+    if (edge_us == 0 || gesture == DIR_NONE) return true;
+
+    // Edges are stamped odd, a read started in the same microsecond looks 1 us early
+    uint32_t wake_us = (int32_t)(line.read_start_us - edge_us) > 0 ? line.read_start_us - edge_us : 0;
+    uint32_t read_us = (int32_t)(span.decoded_us - edge_us) > 0 ? span.decoded_us - edge_us : 0;
+
+    portENTER_CRITICAL(&_latencyLock);
+    stats.count++;
+    stats.wake_total_us += wake_us;
+    stats.read_total_us += read_us;
+    if (wake_us > stats.wake_max_us) stats.wake_max_us = wake_us;
+    if (read_us > stats.read_max_us) stats.read_max_us = read_us;
+    bool report = stats.count % _LATENCY_REPORT_EVERY == 0;
+    portEXIT_CRITICAL(&_latencyLock);
+
+    if (report) {
+        printLatencyReport();
+    }
+    return true;
+}
+
+bool GestureGripSensors::pollSensor(SparkFun_APDS9960& apds, InterruptLine& line, SensorBus& bus, int& gesture, GestureSpan* span) {
+    lockBus(bus);
+    uint32_t datasets = bus.stats.datasets;
+    uint32_t overflows = apds.getGestureOverflows();
+    bus.read_us = micros();
+
+    bool finished = pollWithLatency(apds, line, bus.span, gesture);
+    uint32_t done_us = micros();
+    if (finished) finishGesture(bus, span);
+    unlockBus(bus);
+
+    // Only this bus's task writes its figures
+    AcquisitionStats& stats = bus.stats;
+    stats.overflows += apds.getGestureOverflows() - overflows;
+    if (stats.datasets != datasets) {
+        stats.batches++;
+        stats.bus_us += done_us - bus.read_us;
+        if (bus.last_read_us != 0) {
+            uint32_t period_us = bus.read_us - bus.last_read_us;
+            stats.periods++;
+            stats.period_total_us += period_us;
+            if (period_us > stats.period_max_us) stats.period_max_us = period_us;
+        }
+        bus.last_read_us = bus.read_us;
+    }
+    if (finished) bus.last_read_us = 0;
+
+    return finished;
+}
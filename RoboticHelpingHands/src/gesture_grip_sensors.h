@@ -4,19 +4,98 @@
 #include <Arduino.h>
 #include <Wire.h>
 #include <SparkFun_APDS9960.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <driver/gpio.h>
+#include "gesture_frame.h"
+#include "frame_ring.h"
+#include "gesture_templates.h"
+#include "power_manager.h"
 
 /**
  * @brief   manages the dual APDS-9960 gesture sensors for robotic arm
  */
 class GestureGripSensors {
 public:
+    /**
+     * @brief   how the acquisition task finds out a sensor has gesture data
+     */
+    enum AcquisitionMode {
+        ACQUIRE_POLLING = 0,   // checks GSTATUS over I2C every poll interval
+        ACQUIRE_INTERRUPT      // sleeps until a sensor INT line wakes the task, or the chip from light sleep
+    };
+
+    // Bits returned by waitForGestures()
+    static const uint32_t NOTIFY_LEFT = 0x01;
+    static const uint32_t NOTIFY_RIGHT = 0x02;
+
+    // SensorFrame::sensor values
+    static const uint8_t SENSOR_LEFT = 0;
+    static const uint8_t SENSOR_RIGHT = 1;
+
+    // 128 datasets covers a few classifier periods of one sensor mid-gesture
+    typedef FrameRing<SensorFrame, 128> SensorFrameRing;
+
+    /**
+     * @brief   how much FIFO data a finished gesture produced, a rough measure of swipe speed, and its timing
+     */
+    struct GestureSpan {
+        uint16_t datasets;      // FIFO datasets read during the gesture
+        uint32_t duration_us;   // first to last dataset read
+        uint32_t edge_us;       // INT edge that started it, 0 if none
+        uint32_t read_start_us; // first FIFO read
+        uint32_t decoded_us;    // gesture decoded
+        uint32_t fifo_cycles;   // driver time in FIFO reads
+        uint32_t decode_cycles; // driver time decoding
+        int committed;          // direction already sent as an early commit, DIR_NONE if none
+        uint32_t committed_us;  // early commit taken
+    };
+
     GestureGripSensors();
 
     /**
-     * @brief   initializes both I2C buses and APDS-9960 sensors
+     * @brief   initializes both I2C buses, APDS-9960 sensors and INT lines
+     * @param[in]   mode: acquisition mode, interrupt driven by default
      * @returns true if both sensors initialized successfully
      */
-    bool initialize();
+    bool initialize(AcquisitionMode mode = ACQUIRE_INTERRUPT);
+
+    /**
+     * @brief   switches between interrupt and polling acquisition at runtime
+     * @param[in]   mode: new acquisition mode
+     * @returns none
+     */
+    void setAcquisitionMode(AcquisitionMode mode);
+
+    /**
+     * @brief   gets the current acquisition mode
+     * @returns current acquisition mode
+     */
+    AcquisitionMode getAcquisitionMode() const { return _mode; }
+
+    /**
+     * @brief   registers the task woken by some sensors' INT lines, each bus can have its own
+     * @param[in]   lines: bitmask of NOTIFY_LEFT / NOTIFY_RIGHT
+     * @param[in]   task: handle of the acquisition task servicing them
+     * @returns none
+     */
+    void setNotifyTask(uint32_t lines, TaskHandle_t task);
+
+    /**
+     * @brief   blocks until at least one of some sensors has gesture data
+     * @param[in]   lines: bitmask of NOTIFY_LEFT / NOTIFY_RIGHT, the ones the calling task services
+     * @param[in]   timeout: maximum ticks to wait, portMAX_DELAY is safe since a low INT line always fires
+     * @returns bitmask of NOTIFY_LEFT / NOTIFY_RIGHT, 0 on timeout
+     */
+    uint32_t waitForGestures(uint32_t lines, TickType_t timeout);
+
+    /**
+     * @brief   gets the earliest unserviced INT edge of some sensors
+     * @param[in]   lines: bitmask of NOTIFY_LEFT / NOTIFY_RIGHT
+     * @returns micros() of the edge, 0 if none of them has one
+     */
+    uint32_t getFirstEdgeUs(uint32_t lines) const;
 
     /**
      * @brief   checks if left sensor has gesture available
@@ -31,22 +110,81 @@ public:
     bool rightGestureAvailable();
 
     /**
-     * @brief   reads gesture from left sensor in nonblocking mode
-     * @returns gesture direction constant (DIR_UP, DIR_DOWN, ..., or DIR_NONE)
+     * @brief   advances the left sensor's gesture by one FIFO batch, never sleeps
+     * @param[out]  gesture: direction constant (DIR_UP, DIR_DOWN, ..., or DIR_NONE) once finished
+     * @param[out]  span: FIFO data the gesture produced once finished, may be NULL
+     * @returns true once the gesture is finished, false while still in progress
+     */
+    bool pollLeftGesture(int& gesture, GestureSpan* span = NULL);
+
+    /**
+     * @brief   advances the right sensor's gesture by one FIFO batch, never sleeps
+     * @param[out]  gesture: direction constant (DIR_UP, DIR_DOWN, ..., or DIR_NONE) once finished
+     * @param[out]  span: FIFO data the gesture produced once finished, may be NULL
+     * @returns true once the gesture is finished, false while still in progress
+     */
+    bool pollRightGesture(int& gesture, GestureSpan* span = NULL);
+
+    /**
+     * @brief   takes the swipe the driver committed to early for the left sensor's gesture in progress
+     * @param[out]  gesture: committed direction
+     * @param[out]  span: FIFO data and timing up to the commit
+     * @returns true once per gesture, when a swipe is clear before the hand has left
+     */
+    bool takeLeftCommit(int& gesture, GestureSpan& span);
+
+    /**
+     * @brief   takes the template match of the left sensor's last finished gesture
+     * @param[out]  match: matched custom gesture and its distance
+     * @returns true if the DTW templates recognised the gesture
+     */
+    bool takeLeftTemplateMatch(TemplateRecognizer::Match& match);
+
+    /**
+     * @brief   gets the ring a sensor's FIFO datasets are published on, stamped on the common micros() clock
+     * @param[in]   sensor: SENSOR_LEFT or SENSOR_RIGHT
+     * @returns ring to attach consumer cursors to, readable from any task on either core
+     */
+    const SensorFrameRing& getFrames(uint8_t sensor) const { return _frames[sensor == SENSOR_RIGHT ? 1 : 0]; }
+
+    /**
+     * @brief   reads the left sensor's proximity without disturbing gesture polling
+     * @param[out]  proximity: PDATA value, 0 on error
+     * @returns true if proximity was read
+     */
+    bool readLeftProximity(uint8_t& proximity);
+
+    /**
+     * @brief   reads the right sensor's proximity without disturbing gesture polling
+     * @param[out]  proximity: PDATA value, 0 on error
+     * @returns true if proximity was read
+     */
+    bool readRightProximity(uint8_t& proximity);
+
+    /**
+     * @brief   clears any pending gestures during startup, settle time counts from initialize()
+     * @param[in]   warm_boot: arm did not move during boot, so a short settle is enough
+     * @returns none
+     */
+    void clearStartupGestures(bool warm_boot = false);
+
+    /**
+     * @brief   prints INT edge to read latency for the current mode
+     * @returns none
      */
-    int readLeftGesture();
+    void printLatencyReport();
 
     /**
-     * @brief   reads gesture from right sensor in non-blocking mode
-     * @returns gesture direction constant (DIR_UP, DIR_DOWN, ..., or DIR_NONE)
+     * @brief   prints FIFO read rate, bus time and overflows of each bus and both together
+     * @returns none
      */
-    int readRightGesture();
+    void printAcquisitionReport();
 
     /**
-     * @brief   clears any pending gestures during startup
+     * @brief   clears the acquisition figures
      * @returns none
      */
-    void clearStartupGestures();
+    void resetAcquisitionStats();
 
 private:
     TwoWire _i2c_left;
@@ -58,13 +196,163 @@ private:
     const int _LEFT_SDA_PIN = 21;
     const int _RIGHT_SCL_PIN = 17;
     const int _RIGHT_SDA_PIN = 16;
+    const int _LEFT_INT_PIN = 27;
+    const int _RIGHT_INT_PIN = 13;
+
+    static const int _POLL_INTERVAL_MS = 20;
+    static const uint32_t _FIFO_DEPTH = 32;
+    static const int _LATENCY_REPORT_EVERY = 16;
+    static const int _COLD_SETTLE_MS = 1000;  // arm just homed under the sensors
+    static const int _WARM_SETTLE_MS = 100;
+
+    // Dataset period of the gesture engine: about 1.4 ms of pulses on the four diodes plus GWTIME
+    static const uint32_t _PULSE_CYCLE_US = 1400;
+    static constexpr uint32_t _GWTIME_US[8] = {0, 2800, 5600, 8400, 14000, 22400, 30800, 39200};
+
+    /**
+     * @brief   one sensor INT line, shared with its ISR
+     */
+    struct InterruptLine {
+        GestureGripSensors* owner;
+        int pin;
+        uint32_t notify_bit;
+        volatile uint32_t edge_us;  // time of first unserviced falling edge, 0 if none
+        uint32_t read_start_us;     // time the current gesture's first FIFO batch was read
+        TaskHandle_t task;          // acquisition task servicing this sensor, NULL until set
+    };
+
+    /**
+     * @brief   running INT edge to gesture latency in microseconds
+     */
+    struct LatencyStats {
+        uint32_t count;
+        uint64_t wake_total_us;    // edge -> FIFO read starts
+        uint64_t read_total_us;    // edge -> gesture decoded
+        uint32_t wake_max_us;
+        uint32_t read_max_us;
+        uint32_t commits;          // gestures sent early
+        uint32_t retractions;      // of those, the full decode disagreed
+        uint64_t ahead_total_us;   // commit -> gesture decoded
+    };
+
+    /**
+     * @brief   FIFO reads of one bus, each bus is serviced by its own task
+     */
+    struct AcquisitionStats {
+        uint32_t batches;          // FIFO reads that returned datasets
+        uint32_t datasets;
+        uint64_t bus_us;           // in those reads, I2C included
+        uint64_t period_total_us;  // between reads of the same gesture
+        uint32_t period_max_us;
+        uint32_t periods;
+        uint32_t overflows;        // reads that found GFOV set, datasets were lost
+    };
+
+    /**
+     * @brief   per sensor I2C lock, the acquisition and classifier tasks share each bus
+     */
+    struct SensorBus {
+        SemaphoreHandle_t lock;
+        SensorFrameRing* frames;    // every dataset pollGesture reads is published here
+        uint8_t sensor;             // SENSOR_LEFT or SENSOR_RIGHT
+        TemplateRecognizer* templates;     // fed every dataset, NULL if not matched on this sensor
+        TemplateRecognizer::Match match;   // first match of the current gesture
+        GestureSpan span;                  // of the gesture in progress
+        uint32_t first_us;                 // first dataset of the gesture in progress
+        SparkFun_APDS9960* apds;           // asked for the backlog of each dataset it hands over
+        uint32_t dataset_us;               // dataset period, set from GWTIME
+        uint32_t read_us;                  // the FIFO read in progress started
+        uint32_t last_read_us;             // previous read of the gesture in progress, 0 if none
+        AcquisitionStats stats;
+    };
+
+    volatile AcquisitionMode _mode;
+    unsigned long _enabledAtMs;  // when the gesture engines were switched on
+    InterruptLine _left_int;
+    InterruptLine _right_int;
+    SensorBus _left_bus;
+    SensorBus _right_bus;
+    SensorFrameRing _frames[2];    // one per sensor, each produced by its bus's acquisition task only
+    volatile uint32_t _statsSinceUs;   // acquisition figures cleared
+    TemplateRecognizer _left_templates;
+    LatencyStats _latency[2];  // indexed by AcquisitionMode
+    portMUX_TYPE _latencyLock;
+    PowerLock _busPower;       // held for every I2C transaction, the bus clock comes from APB
+
+    /**
+     * @brief   ISR for both INT lines, timestamps the edge, masks the line and wakes the task
+     * @param[in]   arg: pointer to the InterruptLine that fired
+     * @returns none
+     */
+    static void IRAM_ATTR interruptRoutine(void* arg);
+
+    /**
+     * @brief   driver callback for each FIFO dataset, runs with the bus lock held, dates it back by its FIFO backlog
+     * @param[in]   context: pointer to the sensor's SensorBus
+     * @param[in]   udlr: U/D/L/R bytes of one dataset
+     * @returns none
+     */
+    static void onGestureSample(void* context, const uint8_t* udlr);
 
     /**
-     * @brief   reads gesture in non-blocking mode with error handling
+     * @brief   closes the template stream and span once a sensor's gesture has finished
+     * @param[in]   bus: bus belonging to the sensor
+     * @param[out]  span: span of the finished gesture, may be NULL
+     * @returns none
+     */
+    static void finishGesture(SensorBus& bus, GestureSpan* span);
+
+    /**
+     * @brief   reads a sensor's proximity under its bus lock
      * @param[in]   apds: reference to APDS-9960 sensor
-     * @returns gesture direction or DIR_NONE on error
+     * @param[in]   bus: bus belonging to the sensor
+     * @param[out]  proximity: PDATA value, 0 on error
+     * @returns true if proximity was read
+     */
+    bool readProximity(SparkFun_APDS9960& apds, SensorBus& bus, uint8_t& proximity);
+
+    /**
+     * @brief   takes a sensor's bus lock and the I2C power lock
+     * @param[in]   bus: bus to lock
+     * @returns none
+     */
+    void lockBus(SensorBus& bus);
+
+    /**
+     * @brief   gives back what lockBus() took
+     * @param[in]   bus: bus to unlock
+     * @returns none
+     */
+    void unlockBus(SensorBus& bus);
+
+    /**
+     * @brief   steps a sensor's gesture and records latency from its INT edge
+     * @param[in]   apds: reference to APDS-9960 sensor
+     * @param[in]   line: INT line belonging to the sensor
+     * @param[out]  span: gets the gesture's timing once finished
+     * @param[out]  gesture: gesture direction or DIR_NONE on error
+     * @returns true once the gesture is finished
+     */
+    bool pollWithLatency(SparkFun_APDS9960& apds, InterruptLine& line, GestureSpan& span, int& gesture);
+
+    /**
+     * @brief   steps a sensor's gesture under its bus lock and counts the FIFO read
+     * @param[in]   apds: reference to APDS-9960 sensor
+     * @param[in]   line: INT line belonging to the sensor
+     * @param[in]   bus: bus belonging to the sensor
+     * @param[out]  gesture: gesture direction or DIR_NONE on error
+     * @param[out]  span: span of the finished gesture, may be NULL
+     * @returns true once the gesture is finished
+     */
+    bool pollSensor(SparkFun_APDS9960& apds, InterruptLine& line, SensorBus& bus, int& gesture, GestureSpan* span);
+
+    /**
+     * @brief   prints one bus's line of the acquisition report
+     * @param[in]   name: sensor name
+     * @param[in]   stats: figures of the bus
+     * @returns none
      */
-    int readGestureNonBlocking(SparkFun_APDS9960& apds);
+    static void printBusStats(const char* name, const AcquisitionStats& stats);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef GESTURE_MODEL_DATA_H
+#define GESTURE_MODEL_DATA_H
+
+// Generated by serial_listening/train_gesture_model.py, do not edit by hand.
+// Placeholder until a model is trained from the recordings in data/;
+// GestureClassifier stays disabled while GESTURE_MODEL_TRAINED is 0.
+
+#include <stdint.h>
+
+#define GESTURE_MODEL_TRAINED 0
+
+static const int8_t GESTURE_MODEL_W1[32][200] = {};
+static const int32_t GESTURE_MODEL_B1[32] = {};
+static const int32_t GESTURE_MODEL_M1_MULTIPLIER = 0;
+static const int GESTURE_MODEL_M1_SHIFT = 1;
+static const int8_t GESTURE_MODEL_W2[6][32] = {};
+static const int32_t GESTURE_MODEL_B2[6] = {};
+static const float GESTURE_MODEL_OUTPUT_SCALE = 0.0f;
+static const uint8_t GESTURE_MODEL_MIN_PROXIMITY = 255;
+static const uint8_t GESTURE_MODEL_MIN_CONFIDENCE = 80;
+
+#endif
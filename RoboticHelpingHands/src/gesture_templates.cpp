@@ -0,0 +1,186 @@
+#include "gesture_templates.h"
+#include <stdlib.h>
+#include "gesture_templates_data.h"
+
+static_assert(GESTURE_TEMPLATE_COUNT <= TemplateRecognizer::MAX_TEMPLATES,
+              "gesture_templates_data.h has more templates than TemplateRecognizer holds");
+static_assert(sizeof(GESTURE_TEMPLATE_FEATURES[0]) == TemplateRecognizer::MAX_LENGTH * 2,
+              "gesture_templates_data.h template length does not match TemplateRecognizer");
+static_assert(GESTURE_TEMPLATE_DECIMATION >= 1 && GESTURE_TEMPLATE_DECIMATION <= 64,
+              "gesture_templates_data.h decimation out of range");
+
+TemplateRecognizer::TemplateRecognizer() :
+    _step(0),
+    _accumulated{0, 0, 0, 0},
+    _accumulatedCount(0),
+    _match{-1, 0}
+{
+    reset();
+}
+
+bool TemplateRecognizer::hasTemplates() {
+    return GESTURE_TEMPLATE_COUNT > 0;
+}
+
+int TemplateRecognizer::getCellsPerStep() {
+    int cells = 0;
+    for (int k = 0; k < GESTURE_TEMPLATE_COUNT; k++) {
+        cells += GESTURE_TEMPLATE_LENGTH[k];
+    }
+    return cells;
+}
+
+void TemplateRecognizer::reset() {
+    for (int k = 0; k < MAX_TEMPLATES; k++) {
+        Column& column = _columns[k];
+        for (int j = 0; j <= MAX_LENGTH; j++) {
+            column.distance[j] = INFINITE;
+            column.start[j] = 0;
+        }
+        column.best = INFINITE;
+        column.best_end = 0;
+    }
+    for (int i = 0; i < 4; i++) _accumulated[i] = 0;
+    _accumulatedCount = 0;
+}
+
+bool TemplateRecognizer::push(const uint8_t* udlr) {
+    if (!hasTemplates()) return false;
+
+    // Box filter down to the rate the templates were recorded at
+    for (int i = 0; i < 4; i++) _accumulated[i] += udlr[i];
+    if (++_accumulatedCount < GESTURE_TEMPLATE_DECIMATION) return false;
+
+    Feature x = toFeature(_accumulated[0], _accumulated[1], _accumulated[2], _accumulated[3], _accumulatedCount);
+    for (int i = 0; i < 4; i++) _accumulated[i] = 0;
+    _accumulatedCount = 0;
+
+    return step(x);
+}
+
+bool TemplateRecognizer::finish() {
+    if (!hasTemplates()) return false;
+
+    // A partial step that holds at least half a step's data still counts
+    bool matched = false;
+    if (_accumulatedCount * 2 >= GESTURE_TEMPLATE_DECIMATION) {
+        matched = step(toFeature(_accumulated[0], _accumulated[1], _accumulated[2], _accumulated[3], _accumulatedCount));
+    }
+    if (!matched) {
+        matched = report(NULL);
+    }
+    reset();
+    return matched;
+}
+
+bool TemplateRecognizer::step(const Feature& x) {
+    bool confirmed[MAX_TEMPLATES];
+    bool any_confirmed = false;
+
+    for (int k = 0; k < GESTURE_TEMPLATE_COUNT; k++) {
+        Column& column = _columns[k];
+        const int8_t (*pattern)[2] = GESTURE_TEMPLATE_FEATURES[k];
+        int length = GESTURE_TEMPLATE_LENGTH[k];
+
+        // Row 0 is the free start: a path may begin at any stream step at no cost
+        uint16_t diagonal = 0;
+        uint16_t diagonal_start = _step;
+        uint16_t left = 0;
+        uint16_t left_start = _step;
+
+        for (int j = 1; j <= length; j++) {
+            uint16_t up = column.distance[j];         // same template step, previous stream step
+            uint16_t up_start = column.start[j];
+
+            uint16_t best = diagonal;
+            uint16_t best_start = diagonal_start;
+            if (up < best) {
+                best = up;
+                best_start = up_start;
+            }
+            if (left < best) {
+                best = left;
+                best_start = left_start;
+            }
+
+            uint32_t distance = INFINITE;
+            if (best != INFINITE) {
+                int cost = abs(x.ud - pattern[j - 1][0]) + abs(x.lr - pattern[j - 1][1]);
+                distance = best + cost;
+                if (distance > INFINITE) distance = INFINITE;
+
+                // Band: stream steps spent on the path may differ from template steps by at most BAND
+                int span = (uint16_t)(_step - best_start) + 1;
+                if (abs(span - j) > GESTURE_TEMPLATE_BAND) distance = INFINITE;
+            }
+
+            diagonal = up;
+            diagonal_start = up_start;
+            column.distance[j] = (uint16_t)distance;
+            column.start[j] = best_start;
+            left = (uint16_t)distance;
+            left_start = best_start;
+        }
+
+        // Confirmed once no live path that overlaps the candidate can still beat it
+        confirmed[k] = false;
+        if (column.best != INFINITE) {
+            confirmed[k] = true;
+            for (int j = 1; j <= length; j++) {
+                bool overlaps = (int16_t)(column.start[j] - column.best_end) <= 0;
+                if (column.distance[j] < column.best && overlaps) {
+                    confirmed[k] = false;
+                    break;
+                }
+            }
+            any_confirmed |= confirmed[k];
+        }
+
+        uint16_t end_distance = column.distance[length];
+        if (end_distance <= GESTURE_TEMPLATE_THRESHOLD[k] && end_distance < column.best) {
+            column.best = end_distance;
+            column.best_end = _step;
+        }
+    }
+
+    _step++;
+    return any_confirmed && report(confirmed);
+}
+
+bool TemplateRecognizer::report(const bool* confirmed) {
+    int best = -1;
+    for (int k = 0; k < GESTURE_TEMPLATE_COUNT; k++) {
+        if (_columns[k].best == INFINITE) continue;
+        if (confirmed != NULL && !confirmed[k]) continue;
+
+        // Lowest distance per template step, compared without dividing
+        if (best < 0 ||
+            (uint32_t)_columns[k].best * GESTURE_TEMPLATE_LENGTH[best] <
+            (uint32_t)_columns[best].best * GESTURE_TEMPLATE_LENGTH[k]) {
+            best = k;
+        }
+    }
+    if (best < 0) return false;
+
+    _match.gesture = GESTURE_TEMPLATE_CLASS[best];
+    _match.distance = _columns[best].best / GESTURE_TEMPLATE_LENGTH[best];
+
+    // One gesture, one match: every template starts over
+    uint16_t step = _step;
+    reset();
+    _step = step;
+    return true;
+}
+
+TemplateRecognizer::Feature TemplateRecognizer::toFeature(uint32_t u, uint32_t d, uint32_t l, uint32_t r,
+                                                          uint32_t datasets) {
+    // Ratios of a near-empty axis are noise, not direction
+    uint32_t floor = 2 * _SIGNAL_FLOOR * datasets;
+
+    Feature feature;
+    int32_t ud = (int32_t)u - (int32_t)d;
+    int32_t lr = (int32_t)l - (int32_t)r;
+    feature.ud = (int8_t)(u + d >= floor ? ud * 64 / (int32_t)(u + d) : 0);
+    feature.lr = (int8_t)(l + r >= floor ? lr * 64 / (int32_t)(l + r) : 0);
+    return feature;
+}
@@ -0,0 +1,117 @@
+#ifndef GESTURE_TEMPLATES_H
+#define GESTURE_TEMPLATES_H
+
+#include <stdint.h>
+#include "gesture_classifier.h"
+
+/**
+ * @brief   matches the live U/D/L/R FIFO stream against recorded gesture traces
+ *
+ * Streaming subsequence DTW (SPRING): each template keeps one column of the
+ * warping matrix, updated in place per stream step, so a match can start at
+ * any sample and is reported as soon as no overlapping path can beat it. Paths
+ * that stray more than the band from the template's pace are cut. Distances
+ * are integer and every buffer is fixed size. Templates come from
+ * gesture_templates_data.h, generated by serial_listening/export_gesture_templates.py.
+ */
+class TemplateRecognizer {
+public:
+    static const int MAX_TEMPLATES = 18;
+    static const int MAX_LENGTH = 32;       // steps per template
+    static const uint16_t INFINITE = 0xFFFF;
+
+    struct Match {
+        int gesture;          // CustomGesture, or -1 if nothing matched
+        uint16_t distance;    // warping distance per template step
+    };
+
+    TemplateRecognizer();
+
+    /**
+     * @brief   checks if templates were exported into gesture_templates_data.h
+     * @returns true if there is at least one template
+     */
+    static bool hasTemplates();
+
+    /**
+     * @brief   gets DTW cells updated per stream step, the per-step cost
+     * @returns sum of template lengths
+     */
+    static int getCellsPerStep();
+
+    /**
+     * @brief   drops all partial matches, call between gestures
+     * @returns none
+     */
+    void reset();
+
+    /**
+     * @brief   feeds one FIFO dataset, steps the DTW every GESTURE_TEMPLATE_DECIMATION datasets
+     * @param[in]   udlr: U/D/L/R bytes as read from the FIFO
+     * @returns true if a match was confirmed, read it with getMatch()
+     */
+    bool push(const uint8_t* udlr);
+
+    /**
+     * @brief   ends the stream, reporting the best match still waiting for confirmation
+     * @returns true if a match was reported, read it with getMatch()
+     */
+    bool finish();
+
+    /**
+     * @brief   gets the last reported match
+     * @returns match, gesture -1 if none
+     */
+    Match getMatch() const { return _match; }
+
+private:
+    /**
+     * @brief   direction ratios, independent of hand distance and sensor gain
+     */
+    struct Feature {
+        int8_t ud;    // (u - d) / (u + d), -64..64
+        int8_t lr;    // (l - r) / (l + r), -64..64
+    };
+
+    /**
+     * @brief   one template's current DTW column and its best unconfirmed match
+     */
+    struct Column {
+        uint16_t distance[MAX_LENGTH + 1];
+        uint16_t start[MAX_LENGTH + 1];   // stream step each path started at
+        uint16_t best;
+        uint16_t best_end;
+    };
+
+    Column _columns[MAX_TEMPLATES];
+    uint16_t _step;                  // stream position in decimated steps, wraps
+    uint16_t _accumulated[4];
+    uint8_t _accumulatedCount;
+    Match _match;
+
+    /**
+     * @brief   advances every template's column by one stream step
+     * @param[in]   x: feature of the new step
+     * @returns true if a match was confirmed
+     */
+    bool step(const Feature& x);
+
+    /**
+     * @brief   picks the best candidate of the given templates, then resets
+     * @param[in]   confirmed: per template flag, NULL to consider every candidate
+     * @returns true if a match was reported
+     */
+    bool report(const bool* confirmed);
+
+    static const uint32_t _SIGNAL_FLOOR = 10;  // per dataset and channel, as GESTURE_THRESHOLD_OUT in the driver
+
+    /**
+     * @brief   turns summed U/D/L/R of one step into direction ratios
+     * @param[in]   u, d, l, r: channel sums
+     * @param[in]   datasets: number of datasets summed
+     * @returns feature, an axis is 0 while its signal is below the floor
+     */
+    static Feature toFeature(uint32_t u, uint32_t d, uint32_t l, uint32_t r, uint32_t datasets);
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef GESTURE_TEMPLATES_DATA_H
+#define GESTURE_TEMPLATES_DATA_H
+
+// Generated by serial_listening/export_gesture_templates.py, do not edit by hand.
+// Placeholder until templates are exported from the recordings in data/;
+// TemplateRecognizer stays disabled while GESTURE_TEMPLATE_COUNT is 0.
+
+#include <stdint.h>
+
+#define GESTURE_TEMPLATE_COUNT 0
+#define GESTURE_TEMPLATE_DECIMATION 15    // FIFO datasets per template step
+#define GESTURE_TEMPLATE_BAND 6           // steps a path may lead or lag the template
+
+static const uint8_t GESTURE_TEMPLATE_CLASS[1] = {0};
+static const uint8_t GESTURE_TEMPLATE_LENGTH[1] = {0};
+static const uint16_t GESTURE_TEMPLATE_THRESHOLD[1] = {0};
+static const int8_t GESTURE_TEMPLATE_FEATURES[1][32][2] = {};
+
+#endif
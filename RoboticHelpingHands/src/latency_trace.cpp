@@ -0,0 +1,139 @@
+#include "latency_trace.h"
+#include <string.h>
+
+const char* const LatencyTrace::_STAGE_NAMES[STAGE_COUNT] = {
+    "detect", "collect", "fifo read", "decode", "queue", "dispatch", "motion", "total"
+};
+
+LatencyTrace::LatencyTrace() :
+    _nextId(NO_TRACE)
+{
+    for (int i = 0; i < _SLOTS; i++) {
+        _slots[i].id.store(NO_TRACE);
+        _slots[i].origin_us = 0;
+        _slots[i].queued_us = 0;
+        _slots[i].written.store(true);
+    }
+    memset(_histograms, 0, sizeof(_histograms));
+}
+
+uint16_t LatencyTrace::open(uint32_t edge_us, uint32_t read_start_us, uint32_t decoded_us,
+                            uint32_t fifo_cycles, uint32_t decode_cycles) {
+    uint16_t id = _nextId.fetch_add(1) + 1;
+    if (id == NO_TRACE) id = _nextId.fetch_add(1) + 1;
+
+    // The edge is stamped odd to tell it from 0, so a read in the same microsecond is 1 us early
+    if (edge_us != 0) record(STAGE_DETECT, (int32_t)(read_start_us - edge_us) > 0 ? read_start_us - edge_us : 0);
+    record(STAGE_COLLECT, decoded_us - read_start_us);
+    recordCycles(STAGE_FIFO_READ, fifo_cycles);
+    recordCycles(STAGE_DECODE, decode_cycles);
+
+    // Readers check the id last, so it goes in after the timestamps
+    Slot& slot = _slots[id % _SLOTS];
+    slot.id.store(NO_TRACE, std::memory_order_relaxed);
+    slot.origin_us = edge_us != 0 ? edge_us : read_start_us;
+    slot.queued_us = decoded_us;
+    slot.written.store(false, std::memory_order_relaxed);
+    slot.id.store(id, std::memory_order_release);
+    return id;
+}
+
+void LatencyTrace::markQueued(uint16_t id) {
+    Slot* slot = find(id);
+    if (slot != NULL) slot->queued_us = micros();
+}
+
+void LatencyTrace::markReceived(uint16_t id) {
+    Slot* slot = find(id);
+    if (slot != NULL) record(STAGE_QUEUE, micros() - slot->queued_us);
+}
+
+void LatencyTrace::markFirstWrite(uint16_t id, uint32_t posted_us) {
+    Slot* slot = find(id);
+    if (slot == NULL || slot->written.exchange(true)) return;
+
+    uint32_t now = micros();
+    record(STAGE_MOTION, now - posted_us);
+    record(STAGE_TOTAL, now - slot->origin_us);
+}
+
+void LatencyTrace::record(Stage stage, uint32_t us) {
+    Histogram& histogram = _histograms[stage];
+    histogram.buckets[bucketOf(us)]++;
+    histogram.count++;
+    if (us > histogram.max_us) histogram.max_us = us;
+}
+
+void LatencyTrace::recordCycles(Stage stage, uint32_t cycles) {
+    // With frequency scaling the clock may have changed since, close enough for a histogram
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    record(stage, mhz > 0 ? cycles / mhz : 0);
+}
+
+bool LatencyTrace::summarize(Stage stage, Summary& summary) const {
+    const Histogram& histogram = _histograms[stage];
+    summary.count = histogram.count;
+    summary.max_us = histogram.max_us;
+    summary.p50_us = percentile(histogram, 500);
+    summary.p99_us = percentile(histogram, 990);
+    return summary.count > 0;
+}
+
+void LatencyTrace::printReport() const {
+    Serial.println("Gesture latency (us): stage      count      p50      p99      max");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        Summary summary;
+        summarize((Stage)i, summary);
+        Serial.printf("  %-9s %8u %8u %8u %8u\n",
+                      _STAGE_NAMES[i],
+                      summary.count,
+                      summary.p50_us,
+                      summary.p99_us,
+                      summary.max_us);
+    }
+}
+
+void LatencyTrace::reset() {
+    // A sample landing mid-clear can leave a count one off from its buckets, fine for a reset
+    memset(_histograms, 0, sizeof(_histograms));
+}
+
+int LatencyTrace::bucketOf(uint32_t us) {
+    if (us > _MAX_US) us = _MAX_US;
+    if (us < 8) return us;
+
+    int msb = 31 - __builtin_clz(us);
+    return 8 + (msb - 3) * 4 + ((us >> (msb - 2)) & 3);
+}
+
+uint32_t LatencyTrace::bucketLimit(int bucket) {
+    if (bucket < 8) return bucket;
+
+    int msb = 3 + (bucket - 8) / 4;
+    int sub = (bucket - 8) % 4;
+    return ((uint32_t)(5 + sub) << (msb - 2)) - 1;
+}
+
+uint32_t LatencyTrace::percentile(const Histogram& histogram, uint32_t per_mille) {
+    if (histogram.count == 0) return 0;
+
+    uint32_t rank = (uint32_t)(((uint64_t)histogram.count * per_mille + 999) / 1000);
+    if (rank == 0) rank = 1;
+
+    uint32_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += histogram.buckets[i];
+        if (seen >= rank) {
+            uint32_t limit = bucketLimit(i);
+            return limit < histogram.max_us ? limit : histogram.max_us;
+        }
+    }
+    return histogram.max_us;
+}
+
+LatencyTrace::Slot* LatencyTrace::find(uint16_t id) {
+    if (id == NO_TRACE) return NULL;
+
+    Slot& slot = _slots[id % _SLOTS];
+    return slot.id.load(std::memory_order_acquire) == id ? &slot : NULL;
+}
@@ -0,0 +1,177 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <atomic>
+#include <Arduino.h>
+
+/**
+ * @brief   follows a gesture from its INT edge to the first servo write, one histogram per stage
+ *
+ * Stages inside one task are timed with the CPU cycle counter. Stages that cross tasks
+ * use micros(), since each core has its own cycle counter. A finished gesture opens a
+ * trace and its id rides along with the queued event and the motion command, so later
+ * stages can find its earlier timestamps.
+ */
+class LatencyTrace {
+public:
+    enum Stage {
+        STAGE_DETECT = 0,      // INT edge -> first FIFO read of the gesture
+        STAGE_COLLECT,         // first FIFO read -> gesture decoded, FIFO pauses included
+        STAGE_FIFO_READ,       // CPU time in GFLVL/GFIFO reads over the whole gesture
+        STAGE_DECODE,          // CPU time in processGestureData/decodeGesture
+        STAGE_QUEUE,           // xQueueSend -> servo task receives the event
+        STAGE_DISPATCH,        // servo task handling the event until its motion is posted
+        STAGE_MOTION,          // motion posted -> first servo write
+        STAGE_TOTAL,           // INT edge -> first servo write
+        STAGE_COUNT
+    };
+
+    // 8 exact buckets up to 8 us, then 4 per power of two up to 16 s
+    static const int BUCKETS = 92;
+    static const uint16_t NO_TRACE = 0;
+
+    struct Summary {
+        uint32_t count;
+        uint32_t p50_us;       // bucket upper bound, so up to 25% high
+        uint32_t p99_us;
+        uint32_t max_us;
+    };
+
+    LatencyTrace();
+
+    /**
+     * @brief   reads the cycle counter of the calling core
+     * @returns cycles, only differences taken on the same core mean anything
+     */
+    static inline uint32_t cycles() { return ESP.getCycleCount(); }
+
+    /**
+     * @brief   starts a trace for a decoded gesture and records its sensor stages
+     * @param[in]   edge_us: micros() of the INT edge, 0 if it came without one
+     * @param[in]   read_start_us: micros() of the first FIFO read
+     * @param[in]   decoded_us: micros() the gesture was decoded at
+     * @param[in]   fifo_cycles: cycles spent reading the FIFO
+     * @param[in]   decode_cycles: cycles spent decoding
+     * @returns trace id to carry with the gesture, never NO_TRACE
+     */
+    uint16_t open(uint32_t edge_us, uint32_t read_start_us, uint32_t decoded_us,
+                  uint32_t fifo_cycles, uint32_t decode_cycles);
+
+    /**
+     * @brief   stamps a trace right before its event is queued
+     * @param[in]   id: trace id from open()
+     * @returns none
+     */
+    void markQueued(uint16_t id);
+
+    /**
+     * @brief   records the queue stage once the servo task has the event
+     * @param[in]   id: trace id carried by the event
+     * @returns none
+     */
+    void markReceived(uint16_t id);
+
+    /**
+     * @brief   records the motion and total stages, only the first call per trace counts
+     * @param[in]   id: trace id carried by the motion command
+     * @param[in]   posted_us: micros() the motion command was posted at
+     * @returns none
+     */
+    void markFirstWrite(uint16_t id, uint32_t posted_us);
+
+    /**
+     * @brief   adds one sample to a stage
+     * @param[in]   stage: stage to record
+     * @param[in]   us: latency in microseconds
+     * @returns none
+     */
+    void record(Stage stage, uint32_t us);
+
+    /**
+     * @brief   adds one sample to a stage timed on the calling core's cycle counter
+     * @param[in]   stage: stage to record
+     * @param[in]   cycles: cycle count difference
+     * @returns none
+     */
+    void recordCycles(Stage stage, uint32_t cycles);
+
+    /**
+     * @brief   gets count, p50, p99 and max of a stage
+     * @param[in]   stage: stage to summarise
+     * @param[out]  summary: stage figures, zero if it has no samples
+     * @returns true if the stage has samples
+     */
+    bool summarize(Stage stage, Summary& summary) const;
+
+    /**
+     * @brief   prints a line per stage
+     * @returns none
+     */
+    void printReport() const;
+
+    /**
+     * @brief   clears every histogram, open traces still finish into the fresh ones
+     * @returns none
+     */
+    void reset();
+
+private:
+    static const int _SLOTS = 16;              // traces still in flight, a gesture's lasts well under 16 gestures
+    static const uint32_t _MAX_US = (1u << 24) - 1;
+
+    /**
+     * @brief   timestamps of one gesture on its way to the servos
+     */
+    struct Slot {
+        std::atomic<uint16_t> id;
+        uint32_t origin_us;    // INT edge, or first FIFO read without one
+        uint32_t queued_us;
+        std::atomic<bool> written;
+    };
+
+    /**
+     * @brief   fixed bucket histogram, each stage has one writing task
+     */
+    struct Histogram {
+        uint32_t buckets[BUCKETS];
+        uint32_t count;
+        uint32_t max_us;
+    };
+
+    static const char* const _STAGE_NAMES[STAGE_COUNT];
+
+    Slot _slots[_SLOTS];
+    std::atomic<uint16_t> _nextId;
+    Histogram _histograms[STAGE_COUNT];
+
+    /**
+     * @brief   gets the bucket a latency falls in
+     * @param[in]   us: latency, clamped to 16 s
+     * @returns bucket index
+     */
+    static int bucketOf(uint32_t us);
+
+    /**
+     * @brief   gets the largest latency a bucket holds
+     * @param[in]   bucket: bucket index
+     * @returns upper bound in microseconds
+     */
+    static uint32_t bucketLimit(int bucket);
+
+    /**
+     * @brief   gets the latency below which a fraction of a stage's samples fall
+     * @param[in]   histogram: stage histogram
+     * @param[in]   per_mille: fraction in 1/1000 units
+     * @returns bucket upper bound, capped at the stage maximum
+     */
+    static uint32_t percentile(const Histogram& histogram, uint32_t per_mille);
+
+    /**
+     * @brief   finds the slot of a trace that is still in flight
+     * @param[in]   id: trace id
+     * @returns slot, NULL if the id is NO_TRACE or was overwritten
+     */
+    Slot* find(uint16_t id);
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "motion_planner.h"
+#include "servo_utilities.h"
+#include <math.h>
+
+MotionPlanner::MotionPlanner(const JointLimits* limits, int joint_count) :
+    _limits(limits),
+    _jointCount(joint_count)
+{}
+
+uint32_t MotionPlanner::plan(const int* start, const int* target, float slowdown, JointProfile* profiles) const {
+    if (slowdown < 1.0f) slowdown = 1.0f;
+
+    // Slowing velocity by k and acceleration by k^2 stretches the profile in time only
+    float duration = 0.0f;
+    for (int i = 0; i < _jointCount; i++) {
+        float distance = fabsf((float)(target[i] - start[i])) / ServoController::DECIDEGREES;
+        float velocity = _limits[i].max_velocity / slowdown;
+        float acceleration = _limits[i].max_acceleration / (slowdown * slowdown);
+        duration = fmaxf(duration, minimumTime(distance, velocity, acceleration));
+    }
+
+    uint32_t duration_ms = (uint32_t)ceilf(duration * 1000.0f);
+
+    // Every joint takes the slowest joint's time; each one cruises just fast enough
+    for (int i = 0; i < _jointCount; i++) {
+        float distance = fabsf((float)(target[i] - start[i])) / ServoController::DECIDEGREES;
+        float acceleration = _limits[i].max_acceleration / (slowdown * slowdown);
+
+        profiles[i].target = target[i];
+        profiles[i].duration_ms = duration_ms;
+        profiles[i].blend = 128;  // triangle, only used when distance is zero
+
+        if (distance <= 0.0f || duration <= 0.0f) continue;
+
+        // Peak velocity v for distance d in time T: v^2 / a - v * T + d = 0
+        float discriminant = acceleration * acceleration * duration * duration - 4.0f * acceleration * distance;
+        float peak = (acceleration * duration - sqrtf(fmaxf(discriminant, 0.0f))) / 2.0f;
+        float accel_fraction = (peak / acceleration) / duration;
+
+        // Rounded up so quantising the blend never pushes acceleration over the limit
+        profiles[i].blend = (uint8_t)constrain((int)ceilf(accel_fraction * 256.0f), 1, 128);
+    }
+
+    return duration_ms;
+}
+
+float MotionPlanner::minimumTime(float distance, float velocity, float acceleration) {
+    if (distance <= 0.0f) return 0.0f;
+
+    // Triangle profile if the joint never reaches its velocity limit
+    if (distance < velocity * velocity / acceleration) {
+        return 2.0f * sqrtf(distance / acceleration);
+    }
+    return distance / velocity + velocity / acceleration;
+}
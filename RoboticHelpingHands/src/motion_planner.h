@@ -0,0 +1,59 @@
+#ifndef MOTION_PLANNER_H
+#define MOTION_PLANNER_H
+
+#include <Arduino.h>
+
+/**
+ * @brief   velocity and acceleration limits of one joint
+ */
+struct JointLimits {
+    float max_velocity;      // degrees per second
+    float max_acceleration;  // degrees per second squared
+};
+
+/**
+ * @brief   planned trapezoidal move of one joint, ready for ServoMotionEngine::moveProfile
+ */
+struct JointProfile {
+    int target;              // tenths of a degree
+    uint32_t duration_ms;
+    uint8_t blend;           // acceleration phase as a fraction of duration, 1/256 units
+};
+
+/**
+ * @brief   plans multi-joint moves so every joint arrives at the same time
+ */
+class MotionPlanner {
+public:
+    /**
+     * @brief   creates a planner for a fixed set of joints
+     * @param[in]   limits: per-joint limits, must outlive the planner
+     * @param[in]   joint_count: number of joints in limits
+     */
+    MotionPlanner(const JointLimits* limits, int joint_count);
+
+    /**
+     * @brief   plans a synchronised move in the minimum time the slowest joint allows
+     * @param[in]   start: current position of each joint, tenths of a degree
+     * @param[in]   target: target position of each joint, tenths of a degree
+     * @param[in]   slowdown: divides every velocity limit (1 = full speed)
+     * @param[out]  profiles: one profile per joint, all with the same duration
+     * @returns planned duration in milliseconds
+     */
+    uint32_t plan(const int* start, const int* target, float slowdown, JointProfile* profiles) const;
+
+private:
+    const JointLimits* _limits;
+    int _jointCount;
+
+    /**
+     * @brief   minimum time for a rest-to-rest move under velocity/acceleration limits
+     * @param[in]   distance: move length in degrees
+     * @param[in]   velocity: velocity limit
+     * @param[in]   acceleration: acceleration limit
+     * @returns time in seconds
+     */
+    static float minimumTime(float distance, float velocity, float acceleration);
+};
+
+#endif
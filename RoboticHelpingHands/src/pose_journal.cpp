@@ -0,0 +1,132 @@
+#include "pose_journal.h"
+#include <limits.h>
+#include "crc16.h"
+
+PoseJournal::PoseJournal() :
+    _opened(false),
+    _committed{},
+    _pending{},
+    _dirty(false),
+    _dirtySince(0),
+    _lastCommit(0),
+    _commits(0),
+    _coalesced(0),
+    _marks(0)
+{}
+
+bool PoseJournal::begin() {
+    _opened = _prefs.begin("gesture_grip", false);
+    if (!_opened) {
+        Serial.println("Pose journal: NVS unavailable, cold boot only");
+        return false;
+    }
+
+    PoseRecord stored;
+    size_t length = _prefs.getBytes("pose", &stored, sizeof(stored));
+    if (length == sizeof(stored) &&
+        stored.magic == _MAGIC &&
+        stored.version == _VERSION &&
+        stored.crc == crc16((const uint8_t*)&stored, offsetof(PoseRecord, crc))) {
+        _committed = stored;
+    }
+    _pending = _committed;
+    return true;
+}
+
+bool PoseJournal::load(int* pose, int count) {
+    // An unsettled record is where a move started, not where the arm is
+    if (_committed.magic != _MAGIC || _committed.count != count || !_committed.settled) return false;
+
+    for (int i = 0; i < count; i++) {
+        pose[i] = _committed.pose[i];
+    }
+    return true;
+}
+
+void PoseJournal::record(const int* pose, int count) {
+    if (count > MAX_JOINTS) return;
+
+    bool changed = _pending.count != count;
+    for (int i = 0; i < count && !changed; i++) {
+        changed = abs(pose[i] - _pending.pose[i]) >= _JITTER_DECIDEGREES;
+    }
+    if (!changed) {
+        // Back where it started still has to be written as settled again
+        if (_dirty || _committed.settled || _committed.magic != _MAGIC) return;
+    } else if (_dirty) {
+        _coalesced++;
+    }
+
+    _pending.count = (uint8_t)count;
+    for (int i = 0; i < count; i++) {
+        _pending.pose[i] = (int16_t)pose[i];
+    }
+    _dirty = true;
+    _dirtySince = millis();
+}
+
+bool PoseJournal::service() {
+    if (!_opened || !_dirty) return false;
+
+    unsigned long now = millis();
+    if (now - _dirtySince < _QUIET_MS) return false;
+    if (_commits > 0 && now - _lastCommit < _MIN_INTERVAL_MS) return false;
+
+    _pending.magic = _MAGIC;
+    _pending.version = _VERSION;
+    _pending.sequence = _committed.sequence + 1;
+    _pending.settled = 1;
+    _pending.reserved = 0;
+    _pending.crc = crc16((const uint8_t*)&_pending, offsetof(PoseRecord, crc));
+
+    if (_prefs.putBytes("pose", &_pending, sizeof(_pending)) != sizeof(_pending)) {
+        Serial.println("Pose journal: write failed");
+        return false;
+    }
+
+    _committed = _pending;
+    _dirty = false;
+    _lastCommit = now;
+    _commits++;
+    return true;
+}
+
+void PoseJournal::markMoving() {
+    if (!_opened || _committed.magic != _MAGIC || !_committed.settled) return;
+
+    // Written right away, not coalesced: it only guards the settled write that follows,
+    // which keeps the minimum interval, so there are at most two writes per interval
+    PoseRecord moving = _committed;
+    moving.sequence = _committed.sequence + 1;
+    moving.settled = 0;
+    moving.crc = crc16((const uint8_t*)&moving, offsetof(PoseRecord, crc));
+
+    if (_prefs.putBytes("pose", &moving, sizeof(moving)) != sizeof(moving)) {
+        // Better a homing boot than resuming from a stale pose
+        _prefs.remove("pose");
+        Serial.println("Pose journal: write failed, pose dropped");
+    }
+    _committed = moving;
+    _marks++;
+}
+
+unsigned long PoseJournal::getDueInMs() const {
+    if (!_opened || !_dirty) return ULONG_MAX;
+
+    unsigned long now = millis();
+    unsigned long quiet = now - _dirtySince;
+    unsigned long due = quiet < _QUIET_MS ? _QUIET_MS - quiet : 0;
+
+    if (_commits > 0) {
+        unsigned long since_commit = now - _lastCommit;
+        if (since_commit < _MIN_INTERVAL_MS && _MIN_INTERVAL_MS - since_commit > due) {
+            due = _MIN_INTERVAL_MS - since_commit;
+        }
+    }
+    return due;
+}
+
+void PoseJournal::printStats() {
+    Serial.printf("Pose journal: %u commits this boot, %u records coalesced, %u moves marked, sequence %u\n",
+                  _commits, _coalesced, _marks, _committed.sequence);
+}
@@ -0,0 +1,98 @@
+#ifndef POSE_JOURNAL_H
+#define POSE_JOURNAL_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+/**
+ * @brief   keeps the last settled arm pose in NVS so a power cycle can skip homing
+ *
+ * NVS is log structured and already spreads writes over its pages; on top of that
+ * the journal only commits once the pose has been still for a while, and never more
+ * often than a minimum interval, so a burst of adjustments costs one flash write.
+ * The first move after a commit marks the record unsettled, one more write, so power
+ * lost mid-move or before the next commit falls back to homing.
+ */
+class PoseJournal {
+public:
+    static const int MAX_JOINTS = 5;
+
+    PoseJournal();
+
+    /**
+     * @brief   opens the NVS namespace and reads the last committed pose
+     * @returns true if NVS opened
+     */
+    bool begin();
+
+    /**
+     * @brief   gets the pose committed before the last power cycle
+     * @param[out]  pose: position of each joint in tenths of a degree
+     * @param[in]   count: number of joints expected
+     * @returns true if a valid pose for count joints was found and the arm was settled at it
+     */
+    bool load(int* pose, int count);
+
+    /**
+     * @brief   marks the committed pose unsettled before the arm moves, once per burst of moves
+     * @returns none
+     */
+    void markMoving();
+
+    /**
+     * @brief   notes the current settled pose, committing is deferred to service()
+     * @param[in]   pose: position of each joint in tenths of a degree
+     * @param[in]   count: number of joints
+     * @returns none
+     */
+    void record(const int* pose, int count);
+
+    /**
+     * @brief   commits a recorded pose once it has been quiet long enough
+     * @returns true if a flash write happened
+     */
+    bool service();
+
+    /**
+     * @brief   gets how long until service() could commit the recorded pose
+     * @returns milliseconds, ULONG_MAX if nothing is waiting to be committed
+     */
+    unsigned long getDueInMs() const;
+
+    /**
+     * @brief   prints commit and coalescing counters
+     * @returns none
+     */
+    void printStats();
+
+private:
+    static constexpr uint16_t _MAGIC = 0x6A70;
+    static constexpr uint8_t _VERSION = 2;
+    static constexpr unsigned long _QUIET_MS = 3000;          // pose unchanged this long before commit
+    static constexpr unsigned long _MIN_INTERVAL_MS = 15000;  // between two flash writes
+    static constexpr int _JITTER_DECIDEGREES = 5;             // changes below this are not worth a write
+
+    struct PoseRecord {
+        uint16_t magic;
+        uint8_t version;
+        uint8_t count;
+        uint32_t sequence;
+        int16_t pose[MAX_JOINTS];
+        uint8_t settled;       // 0 once a move started, written again as 1 when the arm is still
+        uint8_t reserved;      // keeps crc aligned without padding
+        uint16_t crc;
+    };
+
+    Preferences _prefs;
+    bool _opened;
+    PoseRecord _committed;     // what is in flash
+    PoseRecord _pending;       // what should be in flash
+    bool _dirty;
+    unsigned long _dirtySince;
+    unsigned long _lastCommit;
+    uint32_t _commits;
+    uint32_t _coalesced;       // record() calls absorbed without a write
+    uint32_t _marks;           // unsettled records written by markMoving()
+};
+
+#endif
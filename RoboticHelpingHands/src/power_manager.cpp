@@ -0,0 +1,128 @@
+#include "power_manager.h"
+
+PowerLock* PowerLock::_registry[PowerLock::MAX_LOCKS] = {};
+std::atomic<int> PowerLock::_registered(0);
+
+PowerLock::PowerLock(Type type, const char* name) :
+    _type(type),
+    _name(name),
+    _handle(NULL),
+    _depth(0),
+    _heldSinceUs(0),
+    _heldTotalUs(0),
+    _acquisitions(0)
+{
+}
+
+bool PowerLock::begin() {
+    int slot = _registered.fetch_add(1);
+    if (slot < MAX_LOCKS) _registry[slot] = this;
+
+    static const esp_pm_lock_type_t types[] = {ESP_PM_CPU_FREQ_MAX, ESP_PM_APB_FREQ_MAX, ESP_PM_NO_LIGHT_SLEEP};
+    return esp_pm_lock_create(types[_type], 0, _name, &_handle) == ESP_OK;
+}
+
+void PowerLock::acquire() {
+    if (_handle != NULL) esp_pm_lock_acquire(_handle);
+
+    // Timed inside, so a task taking the lock as another drops it cannot skew the held time
+    portENTER_CRITICAL(&_lock);
+    if (_depth++ == 0) {
+        _heldSinceUs = micros();
+        _acquisitions++;
+    }
+    portEXIT_CRITICAL(&_lock);
+}
+
+void PowerLock::release() {
+    portENTER_CRITICAL(&_lock);
+    if (--_depth == 0) {
+        _heldTotalUs += micros() - _heldSinceUs;
+    }
+    portEXIT_CRITICAL(&_lock);
+
+    if (_handle != NULL) esp_pm_lock_release(_handle);
+}
+
+void PowerLock::printAll() {
+    static const char* type_names[] = {"CPU", "APB", "NO_SLEEP"};
+    int count = min(_registered.load(), MAX_LOCKS);
+
+    for (int i = 0; i < count; i++) {
+        PowerLock* lock = _registry[i];
+        if (lock == NULL) continue;
+
+        // Copied under the lock, printing is too slow for a critical section
+        portENTER_CRITICAL(&lock->_lock);
+        uint64_t held_us = lock->_heldTotalUs;
+        bool held = lock->_depth > 0;
+        if (held) held_us += micros() - lock->_heldSinceUs;
+        uint32_t acquisitions = lock->_acquisitions;
+        portEXIT_CRITICAL(&lock->_lock);
+
+        Serial.printf("  %-10s %-8s %s | %u acquisitions, held %lu ms (%u%% of uptime)\n",
+                      lock->_name,
+                      type_names[lock->_type],
+                      held ? "HELD" : "free",
+                      acquisitions,
+                      (unsigned long)(held_us / 1000),
+                      (unsigned)(held_us / 10 / max(1UL, (unsigned long)(millis()))));
+    }
+}
+
+PowerManager::PowerManager() :
+    _scaling(false),
+    _lightSleep(false),
+    _wakes(0),
+    _idleWakes(0),
+    _wakeTotalUs(0),
+    _wakeMaxUs(0)
+{
+}
+
+bool PowerManager::begin() {
+    esp_pm_config_esp32_t config = {};
+    config.max_freq_mhz = _MAX_CPU_MHZ;
+    config.min_freq_mhz = _MIN_CPU_MHZ;
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    // Light sleep is entered from the idle task, so it needs tickless idle
+    config.light_sleep_enable = true;
+#endif
+
+    esp_err_t err = esp_pm_configure(&config);
+    _scaling = err == ESP_OK;
+    _lightSleep = _scaling && config.light_sleep_enable;
+
+    // Light sleep wakes on the INT lines, attached with ONLOW_WE by the sensors
+    if (_lightSleep) esp_sleep_enable_gpio_wakeup();
+
+    if (_scaling) {
+        Serial.printf("Power management: %d-%d MHz, light sleep %s\n",
+                      _MIN_CPU_MHZ, _MAX_CPU_MHZ, _lightSleep ? "on" : "off (no tickless idle)");
+    } else {
+        Serial.printf("Power management unavailable (%s), locks are only accounted\n", esp_err_to_name(err));
+    }
+    return _scaling;
+}
+
+void PowerManager::recordWake(uint32_t latency_us, bool gesture) {
+    if (!gesture) {
+        _idleWakes++;
+        return;
+    }
+
+    _wakes++;
+    _wakeTotalUs += latency_us;
+    if (latency_us > _wakeMaxUs) _wakeMaxUs = latency_us;
+}
+
+void PowerManager::printReport() {
+    Serial.printf("Power: scaling %s, light sleep %s | wake->first gesture: %u wakes, avg %lu us max %u us, %u wakes without a gesture\n",
+                  _scaling ? "on" : "off",
+                  _lightSleep ? "on" : "off",
+                  _wakes,
+                  _wakes > 0 ? (unsigned long)(_wakeTotalUs / _wakes) : 0UL,
+                  _wakeMaxUs,
+                  _idleWakes);
+    PowerLock::printAll();
+}
@@ -0,0 +1,111 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <atomic>
+#include <Arduino.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+
+/**
+ * @brief   named esp_pm lock that also keeps how long it was held
+ *
+ * Counts like the esp_pm lock underneath, so several tasks can hold it at once. On a
+ * framework built without CONFIG_PM_ENABLE the esp_pm calls fail and only the
+ * accounting is left, which still shows what would have kept the chip awake.
+ */
+class PowerLock {
+public:
+    enum Type {
+        LOCK_CPU_MAX = 0,      // full CPU clock, for work that must finish quickly
+        LOCK_APB_MAX,          // 80 MHz APB, LEDC and I2C clocks depend on it; blocks light sleep
+        LOCK_NO_SLEEP          // any clock is fine, just no light sleep
+    };
+
+    static constexpr int MAX_LOCKS = 8;
+
+    PowerLock(Type type, const char* name);
+
+    /**
+     * @brief   creates the esp_pm lock and lists it in the power report, call once
+     * @returns true if esp_pm created the lock
+     */
+    bool begin();
+
+    /**
+     * @brief   takes the lock, nests
+     * @returns none
+     */
+    void acquire();
+
+    /**
+     * @brief   gives back one acquire()
+     * @returns none
+     */
+    void release();
+
+    /**
+     * @brief   prints acquisitions and held time of every lock begun so far
+     * @returns none
+     */
+    static void printAll();
+
+private:
+    Type _type;
+    const char* _name;
+    esp_pm_lock_handle_t _handle;
+    int _depth;
+    uint32_t _heldSinceUs;
+    uint64_t _heldTotalUs;
+    uint32_t _acquisitions;        // 0 -> 1 transitions only
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;    // the figures above, tasks on both cores share a lock
+
+    static PowerLock* _registry[MAX_LOCKS];
+    static std::atomic<int> _registered;
+};
+
+/**
+ * @brief   sets up dynamic frequency scaling and light sleep, and times wake ups
+ *
+ * With nothing holding a PowerLock the CPU drops to its minimum clock, and with
+ * tickless idle built in the chip light sleeps until an APDS INT line goes low.
+ */
+class PowerManager {
+public:
+    PowerManager();
+
+    /**
+     * @brief   configures esp_pm, fails harmlessly on a framework without it
+     * @returns true if frequency scaling is active
+     */
+    bool begin();
+
+    /**
+     * @brief   records how a wake from standby ended
+     * @param[in]   latency_us: INT edge to first gesture
+     * @param[in]   gesture: false if the wake produced no gesture, latency is ignored then
+     * @returns none
+     */
+    void recordWake(uint32_t latency_us, bool gesture);
+
+    /**
+     * @brief   prints the esp_pm setup, wake latency and every PowerLock
+     * @returns none
+     */
+    void printReport();
+
+private:
+    static constexpr int _MAX_CPU_MHZ = 240;
+    static constexpr int _MIN_CPU_MHZ = 80;    // keeps APB at 80 MHz, lower would slow the LEDC and I2C clocks
+
+    bool _scaling;
+    bool _lightSleep;
+
+    uint32_t _wakes;
+    uint32_t _idleWakes;           // wakes without a gesture, e.g. a hand passing
+    uint64_t _wakeTotalUs;
+    uint32_t _wakeMaxUs;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "serial_console.h"
+#include <string.h>
+
+SerialConsole::SerialConsole() :
+    _commandCount(0),
+    _length(0),
+    _task(NULL)
+{
+}
+
+bool SerialConsole::addCommand(const char* name, const char* help, Handler handler, void* context) {
+    if (_commandCount >= MAX_COMMANDS) return false;
+
+    _commands[_commandCount] = {name, help, handler, context};
+    _commandCount++;
+    return true;
+}
+
+void SerialConsole::begin() {
+    _task = xTaskGetCurrentTaskHandle();
+
+    // Runs in the UART event task, nothing more than a wake up belongs there
+    Serial.onReceive([this]() {
+        xTaskNotifyGive(_task);
+    });
+
+    // Lines typed during boot arrived before the callback, service() would sit on them
+    if (Serial.available() > 0) xTaskNotifyGive(_task);
+    Serial.println("Serial console ready, type help");
+}
+
+void SerialConsole::service() {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    while (Serial.available() > 0) {
+        char c = Serial.read();
+        if (c == '\r' || c == '\n') {
+            if (_length > 0) {
+                _line[_length] = '\0';
+                run(_line);
+            }
+            _length = 0;
+        } else if (_length < _LINE_LENGTH - 1) {
+            _line[_length++] = c;
+        }
+    }
+}
+
+void SerialConsole::run(char* line) {
+    while (*line == ' ') line++;
+
+    char* args = strchr(line, ' ');
+    if (args != NULL) {
+        *args++ = '\0';
+        while (*args == ' ') args++;
+    } else {
+        args = line + strlen(line);
+    }
+
+    if (strcmp(line, "help") == 0) {
+        printHelp();
+        return;
+    }
+
+    for (int i = 0; i < _commandCount; i++) {
+        if (strcmp(line, _commands[i].name) == 0) {
+            _commands[i].handler(_commands[i].context, args);
+            return;
+        }
+    }
+    Serial.printf("Unknown command '%s', type help\n", line);
+}
+
+void SerialConsole::printHelp() {
+    Serial.println("Commands:");
+    for (int i = 0; i < _commandCount; i++) {
+        Serial.printf("  %-8s %s\n", _commands[i].name, _commands[i].help);
+    }
+    Serial.println("  help     this list");
+}
@@ -0,0 +1,73 @@
+#ifndef SERIAL_CONSOLE_H
+#define SERIAL_CONSOLE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * @brief   line based commands over the serial monitor, run on the task that calls service()
+ *
+ * The UART receive callback only wakes that task, so it sleeps while nobody types.
+ */
+class SerialConsole {
+public:
+    typedef void (*Handler)(void* context, const char* args);
+
+    static const int MAX_COMMANDS = 8;
+
+    SerialConsole();
+
+    /**
+     * @brief   adds a command, call before begin()
+     * @param[in]   name: first word of the line, must outlive the console
+     * @param[in]   help: one line shown by help, must outlive the console
+     * @param[in]   handler: runs with the rest of the line, "" if there is none
+     * @param[in]   context: passed back to the handler unchanged
+     * @returns true if there was room for it
+     */
+    bool addCommand(const char* name, const char* help, Handler handler, void* context);
+
+    /**
+     * @brief   hooks the serial receive callback up to the calling task
+     * @returns none
+     */
+    void begin();
+
+    /**
+     * @brief   sleeps until serial input arrives, then runs every complete line
+     * @returns none
+     */
+    void service();
+
+private:
+    static const int _LINE_LENGTH = 48;
+
+    struct Command {
+        const char* name;
+        const char* help;
+        Handler handler;
+        void* context;
+    };
+
+    Command _commands[MAX_COMMANDS];
+    int _commandCount;
+    char _line[_LINE_LENGTH];
+    int _length;
+    TaskHandle_t _task;
+
+    /**
+     * @brief   looks up and runs the command of one line
+     * @param[in]   line: line without its line ending, split in place
+     * @returns none
+     */
+    void run(char* line);
+
+    /**
+     * @brief   prints every command with its help line
+     * @returns none
+     */
+    void printHelp();
+};
+
+#endif
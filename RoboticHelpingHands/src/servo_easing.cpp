@@ -0,0 +1,89 @@
+#include "servo_easing.h"
+#include <array>
+
+constexpr int TABLE_BITS = 6;
+constexpr int TABLE_SIZE = (1 << TABLE_BITS) + 1;  // one extra entry so the last segment can interpolate
+constexpr int SEGMENT_SHIFT = 15 - TABLE_BITS;
+constexpr double HALF_PI = 1.57079632679489661923;
+
+// Taylor series, only ever evaluated by the compiler on [0, pi/2]
+static constexpr double constexprSin(double x) {
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 12; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+static constexpr double sinCurve(double t) { return constexprSin(t * HALF_PI); }
+static constexpr double cosCurve(double t) { return 1.0 - constexprSin((1.0 - t) * HALF_PI); }
+static constexpr double smoothstepCurve(double t) { return t * t * (3.0 - 2.0 * t); }
+static constexpr double cubicCurve(double t) {
+    return t < 0.5 ? 4.0 * t * t * t : 1.0 - 4.0 * (1.0 - t) * (1.0 - t) * (1.0 - t);
+}
+
+template <typename Curve>
+static constexpr std::array<uint16_t, TABLE_SIZE> makeTable(Curve curve) {
+    std::array<uint16_t, TABLE_SIZE> table{};
+    for (int i = 0; i < TABLE_SIZE; i++) {
+        double value = curve((double)i / (TABLE_SIZE - 1)) * ServoEasing::ONE;
+        table[i] = (uint16_t)(value + 0.5);
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, TABLE_SIZE> SIN_TABLE = makeTable(sinCurve);
+constexpr std::array<uint16_t, TABLE_SIZE> COS_TABLE = makeTable(cosCurve);
+constexpr std::array<uint16_t, TABLE_SIZE> SMOOTHSTEP_TABLE = makeTable(smoothstepCurve);
+constexpr std::array<uint16_t, TABLE_SIZE> CUBIC_TABLE = makeTable(cubicCurve);
+
+static_assert(SIN_TABLE[TABLE_SIZE - 1] == ServoEasing::ONE, "sin table must end at 1.0");
+static_assert(COS_TABLE[0] == 0, "cos table must start at 0");
+
+static int32_t interpolate(const std::array<uint16_t, TABLE_SIZE>& table, int32_t progress) {
+    int32_t index = progress >> SEGMENT_SHIFT;
+    int32_t fraction = progress & ((1 << SEGMENT_SHIFT) - 1);
+    if (index >= TABLE_SIZE - 1) return table[TABLE_SIZE - 1];
+
+    int32_t low = table[index];
+    int32_t high = table[index + 1];
+    return low + (((high - low) * fraction) >> SEGMENT_SHIFT);
+}
+
+int32_t ServoEasing::apply(EasingType type, int32_t progress, uint8_t blend) {
+    if (progress <= 0) return 0;
+    if (progress >= ONE) return ONE;
+
+    switch (type) {
+        case EASE_SIN:        return interpolate(SIN_TABLE, progress);
+        case EASE_COS:        return interpolate(COS_TABLE, progress);
+        case EASE_SMOOTHSTEP: return interpolate(SMOOTHSTEP_TABLE, progress);
+        case EASE_CUBIC:      return interpolate(CUBIC_TABLE, progress);
+        case EASE_TRAPEZOID:  return trapezoid(progress, blend);
+        case EASE_LINEAR:
+        default:              return progress;
+    }
+}
+
+int32_t ServoEasing::trapezoid(int32_t progress, uint8_t blend) {
+    if (blend < 1) blend = 1;
+    if (blend > 128) blend = 128;
+
+    // Everything stays in 32 bits: squares are taken back down to Q15 before scaling
+    int32_t accel = (int32_t)blend << (15 - 8);            // acceleration phase in Q15
+    int32_t cruise = ONE - accel;
+    int32_t parabola = (2 * accel * (cruise >> 1)) >> 14;  // 2 f (1 - f) in Q15
+
+    if (progress < accel) {
+        int32_t squared = (progress * progress) >> 15;
+        return (squared << 15) / parabola;
+    }
+    if (progress <= cruise) {
+        return ((progress - accel / 2) << 15) / cruise;
+    }
+    int32_t remaining = ONE - progress;
+    int32_t squared = (remaining * remaining) >> 15;
+    return ONE - (squared << 15) / parabola;
+}
@@ -0,0 +1,44 @@
+#ifndef SERVO_EASING_H
+#define SERVO_EASING_H
+
+#include <stdint.h>
+
+/**
+ * @brief   easing curves understood by ServoMotionEngine
+ */
+enum EasingType : uint8_t {
+    EASE_LINEAR = 0,
+    EASE_SIN,          // fast start, slow finish
+    EASE_COS,          // slow start, fast finish
+    EASE_SMOOTHSTEP,   // 3t^2 - 2t^3, zero velocity at both ends
+    EASE_CUBIC,        // cubic in-out
+    EASE_TRAPEZOID     // constant acceleration, cruise, constant deceleration
+};
+
+/**
+ * @brief   fixed-point easing, a table lookup plus interpolation per call
+ */
+class ServoEasing {
+public:
+    static constexpr int32_t ONE = 1 << 15;  // Q15 fixed point 1.0
+
+    /**
+     * @brief   maps linear progress to eased progress
+     * @param[in]   type: easing curve
+     * @param[in]   progress: linear progress, 0 to ONE
+     * @param[in]   blend: EASE_TRAPEZOID acceleration phase as a fraction of duration, 1/256 units (max 128)
+     * @returns eased progress, 0 to ONE
+     */
+    static int32_t apply(EasingType type, int32_t progress, uint8_t blend = 64);
+
+private:
+    /**
+     * @brief   trapezoidal velocity profile position, evaluated directly since blend varies per move
+     * @param[in]   progress: linear progress, 0 to ONE
+     * @param[in]   blend: acceleration phase as a fraction of duration, 1/256 units
+     * @returns eased progress, 0 to ONE
+     */
+    static int32_t trapezoid(int32_t progress, uint8_t blend);
+};
+
+#endif
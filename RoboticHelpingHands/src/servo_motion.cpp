@@ -0,0 +1,410 @@
+#include "servo_motion.h"
+
+ServoMotionEngine::ServoMotionEngine() :
+    _jointCount(0),
+    _power{},
+    _pwmLock(PowerLock::LOCK_APB_MAX, "servo_pwm"),
+    _motionLock(PowerLock::LOCK_CPU_MAX, "motion"),
+    _pwmLocked(false),
+    _motionLocked(false),
+    _trace(NULL),
+    _stepDeadline("motion step", STEP_PERIOD_MS),
+    _taskHandle(NULL)
+{
+    _holdRequests.store(0);
+    _postTrace.store(LatencyTrace::NO_TRACE);
+    for (int i = 0; i < MAX_JOINTS; i++) {
+        _joints[i] = NULL;
+        _mailboxes[i].sequence.store(0);
+        _consumed[i] = 0;
+        _acknowledged[i].store(0);
+        _trajectories[i] = Trajectory{};
+        _moving[i].store(false);
+        _holds[i] = HoldState{};
+        _holds[i].policy = HOLD_ACTIVE;
+    }
+}
+
+int ServoMotionEngine::addJoint(ServoController* servo) {
+    if (_taskHandle != NULL || _jointCount >= MAX_JOINTS) return -1;
+    _joints[_jointCount] = servo;
+    return _jointCount++;
+}
+
+void ServoMotionEngine::setHoldPolicy(int joint, const HoldConfig& config) {
+    if (_taskHandle != NULL || joint < 0 || joint >= _jointCount) return;
+
+    HoldState& hold = _holds[joint];
+    hold.policy = config.policy;
+    hold.idle_ticks = pdMS_TO_TICKS(config.idle_ms);
+    hold.reassert_ticks = pdMS_TO_TICKS(config.reassert_ms);
+
+    // A re-assert schedule without a period would never let the joint go
+    if (hold.policy == HOLD_REASSERT && hold.reassert_ticks == 0) {
+        hold.policy = HOLD_DETACH_IDLE;
+    }
+}
+
+void ServoMotionEngine::setLatencyTrace(LatencyTrace* trace) {
+    if (_taskHandle != NULL) return;
+    _trace = trace;
+}
+
+void ServoMotionEngine::setTraceId(uint16_t id) {
+    _postTrace.store(id, std::memory_order_relaxed);
+}
+
+bool ServoMotionEngine::start(UBaseType_t priority, BaseType_t core) {
+    if (_taskHandle != NULL) return true;
+
+    _pwmLock.begin();
+    _motionLock.begin();
+    _taskHandle = xTaskCreateStaticPinnedToCore(
+        motionTaskWrapper,
+        "MotionTask",
+        _STACK_SIZE,
+        this,
+        priority,
+        _taskStack,
+        &_taskBuffer,
+        core
+    );
+    return _taskHandle != NULL;
+}
+
+void ServoMotionEngine::moveTo(int joint, EasingType type, int to_position, int steps_per_degree) {
+    if (joint < 0 || joint >= _jointCount) return;
+
+    MotionCommand command = {};
+    command.type = COMMAND_MOVE;
+    command.easing = type;
+    command.target = (int16_t)to_position;
+    command.steps_per_degree = (uint16_t)constrain(steps_per_degree, 1, 10);
+    post(joint, command);
+}
+
+void ServoMotionEngine::moveProfile(int joint, int to_position, uint32_t duration_ms, uint8_t blend, TickType_t start_tick) {
+    if (joint < 0 || joint >= _jointCount) return;
+
+    MotionCommand command = {};
+    command.type = COMMAND_PROFILE;
+    command.easing = EASE_TRAPEZOID;
+    command.blend = (uint8_t)constrain(blend, 1, 128);
+    command.target = (int16_t)to_position;
+    command.duration_ms = duration_ms;
+    command.start_tick = start_tick;
+    post(joint, command);
+}
+
+TickType_t ServoMotionEngine::nextStartTick() const {
+    // One step of slack covers joints whose command is picked up a step late
+    return xTaskGetTickCount() + pdMS_TO_TICKS(STEP_PERIOD_MS);
+}
+
+void ServoMotionEngine::stop(int joint) {
+    if (joint < 0 || joint >= _jointCount) return;
+
+    MotionCommand command = {};
+    command.type = COMMAND_STOP;
+    post(joint, command);
+}
+
+void ServoMotionEngine::stopAll() {
+    for (int i = 0; i < _jointCount; i++) {
+        stop(i);
+    }
+}
+
+bool ServoMotionEngine::isMoving(int joint) const {
+    if (joint < 0 || joint >= _jointCount) return false;
+
+    // A posted command that has not been picked up yet counts as moving
+    uint32_t posted = _mailboxes[joint].sequence.load(std::memory_order_acquire);
+    return _moving[joint].load(std::memory_order_acquire) ||
+           posted != _acknowledged[joint].load(std::memory_order_acquire);
+}
+
+void ServoMotionEngine::hold(int joint) {
+    if (joint < 0 || joint >= _jointCount) return;
+
+    _holdRequests.fetch_or(1u << joint, std::memory_order_release);
+    if (_taskHandle != NULL) {
+        xTaskNotifyGive(_taskHandle);
+    }
+}
+
+void ServoMotionEngine::printResourceUsage() {
+    Serial.printf("Motion engine: %d joints | free heap %u B (min %u B) | stack %d B, %u B unused\n",
+                  _jointCount,
+                  ESP.getFreeHeap(),
+                  ESP.getMinFreeHeap(),
+                  _STACK_SIZE,
+                  _taskHandle != NULL ? (unsigned)uxTaskGetStackHighWaterMark(_taskHandle) : 0u);
+}
+
+void ServoMotionEngine::printPowerReport() {
+    // Read while the motion task runs, a count that is off by one pass is fine
+    TickType_t now = xTaskGetTickCount();
+    uint64_t held_ticks = 0;
+    int holding = 0;
+    for (int i = 0; i < _jointCount; i++) {
+        const HoldState& hold = _holds[i];
+        held_ticks += hold.held_ticks;
+        if (hold.holding) {
+            // The task may sleep for good with a joint held, count up to now
+            held_ticks += now - hold.accounted;
+            holding++;
+        }
+    }
+
+    uint32_t uptime_ms = now * portTICK_PERIOD_MS;
+    uint64_t held_ms = held_ticks * portTICK_PERIOD_MS;
+    uint32_t average_ma = uptime_ms > 0 ? (uint32_t)(held_ms * _HOLD_CURRENT_MA / uptime_ms) : 0;
+
+    Serial.printf("Servo hold: %d/%d joints holding (~%u mA now) | ~%u mA average, %u mA if all held | "
+                  "%.1f mAh over %lu s\n",
+                  holding,
+                  _jointCount,
+                  (unsigned)(holding * _HOLD_CURRENT_MA),
+                  (unsigned)average_ma,
+                  (unsigned)(_jointCount * _HOLD_CURRENT_MA),
+                  held_ms * _HOLD_CURRENT_MA / 3600000.0f,
+                  (unsigned long)(uptime_ms / 1000));
+    Serial.printf("  motion task: %u wake ups, %u by hold deadlines | %u detaches, %u reattaches, %u re-asserts\n",
+                  _power.wakeups,
+                  _power.hold_wakeups,
+                  _power.detaches,
+                  _power.reattaches,
+                  _power.reasserts);
+}
+
+void ServoMotionEngine::motionTaskWrapper(void* parameter) {
+    ServoMotionEngine* engine = static_cast<ServoMotionEngine*>(parameter);
+    engine->motionTask();
+}
+
+void ServoMotionEngine::motionTask() {
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (true) {
+        bool any_active = false;
+        TickType_t now = xTaskGetTickCount();
+        uint32_t hold_requests = _holdRequests.exchange(0, std::memory_order_acquire);
+
+        for (int i = 0; i < _jointCount; i++) {
+            MotionCommand command;
+            if (take(i, command)) {
+                reengage(i, now);
+                apply(i, command);
+            } else if (hold_requests & (1u << i)) {
+                reengage(i, now);
+            }
+            if (_trajectories[i].active) {
+                stepJoint(i);
+            }
+            _moving[i].store(_trajectories[i].active, std::memory_order_release);
+            any_active |= _trajectories[i].active;
+        }
+
+        // Idle joints can reach a hold deadline while others are still moving
+        TickType_t next_hold = portMAX_DELAY;
+        bool any_engaged = false;
+        now = xTaskGetTickCount();
+        for (int i = 0; i < _jointCount; i++) {
+            TickType_t wait = serviceHold(i, now);
+            if (wait < next_hold) next_hold = wait;
+            any_engaged |= _joints[i]->is_engaged();
+        }
+
+        if (any_engaged != _pwmLocked) {
+            if (any_engaged) _pwmLock.acquire();
+            else _pwmLock.release();
+            _pwmLocked = any_engaged;
+        }
+        if (any_active != _motionLocked) {
+            if (any_active) _motionLock.acquire();
+            else _motionLock.release();
+            _motionLocked = any_active;
+        }
+
+        if (any_active) {
+            vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(STEP_PERIOD_MS));
+            _stepDeadline.tick();
+        } else {
+            // Nothing to drive, sleep until the next post(), hold() or hold deadline
+            if (ulTaskNotifyTake(pdTRUE, next_hold) == 0) {
+                _power.hold_wakeups++;
+            }
+            _power.wakeups++;
+            last_wake = xTaskGetTickCount();
+            _stepDeadline.restart();
+        }
+    }
+}
+
+void ServoMotionEngine::post(int joint, const MotionCommand& command) {
+    Mailbox& box = _mailboxes[joint];
+
+    // Single producer per joint: odd while writing, even once complete
+    uint32_t sequence = box.sequence.load(std::memory_order_relaxed);
+    box.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    box.command = command;
+    box.command.trace = _postTrace.load(std::memory_order_relaxed);
+    box.command.posted_us = box.command.trace != LatencyTrace::NO_TRACE ? micros() : 0;
+    box.sequence.store(sequence + 2, std::memory_order_release);
+
+    if (_taskHandle != NULL) {
+        xTaskNotifyGive(_taskHandle);
+    }
+}
+
+bool ServoMotionEngine::take(int joint, MotionCommand& command) {
+    Mailbox& box = _mailboxes[joint];
+
+    uint32_t before = box.sequence.load(std::memory_order_acquire);
+    if (before == _consumed[joint] || (before & 1)) return false;
+
+    command = box.command;
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // Producer got in while copying, pick it up on the next step instead of spinning
+    if (box.sequence.load(std::memory_order_relaxed) != before) return false;
+
+    _consumed[joint] = before;
+    _acknowledged[joint].store(before, std::memory_order_release);
+    return true;
+}
+
+void ServoMotionEngine::apply(int joint, const MotionCommand& command) {
+    Trajectory& trajectory = _trajectories[joint];
+    ServoController* servo = _joints[joint];
+
+    if (command.type == COMMAND_STOP) {
+        trajectory.active = false;
+        return;
+    }
+
+    int start = servo->get_current_position();
+    int target = servo->constrain_position(command.target);
+    int distance = abs(target - start);
+    trajectory.trace = command.trace;
+    trajectory.posted_us = command.posted_us;
+
+    // Movement too small, just set directly without a trajectory
+    if (distance < _movement_deadzone) {
+        servo->safe_servo_write_position(target);
+        if (distance > 0) traceWrite(trajectory);
+        trajectory.active = false;
+        return;
+    }
+
+    trajectory.active = true;
+    trajectory.easing = command.easing;
+    trajectory.blend = command.blend;
+    trajectory.start = (int16_t)start;
+    trajectory.target = (int16_t)target;
+
+    if (command.type == COMMAND_PROFILE) {
+        trajectory.start_tick = command.start_tick;
+        trajectory.duration_ticks = pdMS_TO_TICKS(command.duration_ms);
+    } else {
+        trajectory.start_tick = xTaskGetTickCount();
+        trajectory.duration_ticks = pdMS_TO_TICKS(distance * command.steps_per_degree * STEP_PERIOD_MS / ServoController::DECIDEGREES);
+    }
+
+    // stepJoint() shifts elapsed ticks into Q15 in 32 bits, longer moves would overflow it
+    if (trajectory.duration_ticks > _MAX_DURATION_TICKS) trajectory.duration_ticks = _MAX_DURATION_TICKS;
+}
+
+void ServoMotionEngine::stepJoint(int joint) {
+    Trajectory& trajectory = _trajectories[joint];
+    ServoController* servo = _joints[joint];
+
+    // Progress comes from the tick count, so joints sharing a start tick stay in step
+    int32_t elapsed = (int32_t)(xTaskGetTickCount() - trajectory.start_tick);
+    if (elapsed < 0) return;
+
+    if ((TickType_t)elapsed >= trajectory.duration_ticks) {
+        servo->safe_servo_write_position(trajectory.target);
+        traceWrite(trajectory);
+        trajectory.active = false;
+        return;
+    }
+
+    int32_t progress = (int32_t)(((uint32_t)elapsed << 15) / trajectory.duration_ticks);
+    int32_t eased_progress = ServoEasing::apply(trajectory.easing, progress, trajectory.blend);
+
+    int distance = trajectory.target - trajectory.start;
+    int new_position = trajectory.start + (int)((distance * eased_progress) / ServoEasing::ONE);
+
+    // Every step is written; the servo skips it if the pulse width would not change
+    servo->safe_servo_write_position(new_position);
+    traceWrite(trajectory);
+}
+
+void ServoMotionEngine::traceWrite(Trajectory& trajectory) {
+    if (trajectory.trace == LatencyTrace::NO_TRACE) return;
+
+    if (_trace != NULL) _trace->markFirstWrite(trajectory.trace, trajectory.posted_us);
+    trajectory.trace = LatencyTrace::NO_TRACE;
+}
+
+void ServoMotionEngine::reengage(int joint, TickType_t now) {
+    HoldState& hold = _holds[joint];
+    ServoController* servo = _joints[joint];
+
+    hold.since = now;
+    hold.reasserting = false;
+    if (!servo->is_engaged()) {
+        servo->engage();
+        _power.reattaches++;
+    }
+}
+
+TickType_t ServoMotionEngine::serviceHold(int joint, TickType_t now) {
+    HoldState& hold = _holds[joint];
+    ServoController* servo = _joints[joint];
+
+    // Nothing but this function changes a joint's engagement while it is idle,
+    // so the time since the last pass was spent in the state recorded then
+    if (hold.holding) hold.held_ticks += now - hold.accounted;
+    hold.accounted = now;
+
+    if (_trajectories[joint].active) {
+        hold.since = now;
+        hold.holding = false;
+        return portMAX_DELAY;
+    }
+
+    TickType_t elapsed = now - hold.since;
+    TickType_t wait = portMAX_DELAY;
+
+    if (servo->is_engaged()) {
+        if (hold.policy != HOLD_ACTIVE) {
+            TickType_t limit = hold.reasserting ? pdMS_TO_TICKS(_REASSERT_PULSE_MS) : hold.idle_ticks;
+            if (elapsed >= limit) {
+                servo->release();
+                hold.reasserting = false;
+                hold.since = now;
+                if (hold.policy == HOLD_REASSERT) wait = hold.reassert_ticks;
+                _power.detaches++;
+            } else {
+                wait = limit - elapsed;
+            }
+        }
+    } else if (hold.policy == HOLD_REASSERT) {
+        if (elapsed >= hold.reassert_ticks) {
+            servo->engage();
+            hold.reasserting = true;
+            hold.since = now;
+            wait = pdMS_TO_TICKS(_REASSERT_PULSE_MS);
+            _power.reasserts++;
+        } else {
+            wait = hold.reassert_ticks - elapsed;
+        }
+    }
+
+    hold.holding = servo->is_engaged();
+    return wait;
+}
@@ -0,0 +1,305 @@
+#ifndef SERVO_MOTION_H
+#define SERVO_MOTION_H
+
+#include <atomic>
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "servo_utilities.h"
+#include "servo_easing.h"
+#include "power_manager.h"
+#include "latency_trace.h"
+#include "task_monitor.h"
+
+/**
+ * @brief   single fixed-rate task that owns the setpoints of every registered servo
+ *
+ * Commands are posted through a per-joint seqlock mailbox and picked up on the
+ * next step, so nothing is allocated or created after start(). Once a joint is
+ * idle its HoldPolicy decides when its PWM goes off, and the task sleeps until
+ * the next post() or hold deadline instead of polling.
+ */
+class ServoMotionEngine {
+public:
+    static const int MAX_JOINTS = 5;
+    static const int STEP_PERIOD_MS = 20;
+
+    /**
+     * @brief   what a joint does with its PWM once it has stopped moving
+     */
+    enum HoldPolicy : uint8_t {
+        HOLD_ACTIVE = 0,       // keeps driving the last pulse, full holding torque
+        HOLD_DETACH_IDLE,      // stops the pulses after idle_ms, the gear train holds on friction
+        HOLD_REASSERT          // detaches after idle_ms, then drives the stored pulse briefly every reassert_ms
+    };
+
+    struct HoldConfig {
+        HoldPolicy policy;
+        uint32_t idle_ms;
+        uint32_t reassert_ms;
+    };
+
+    ServoMotionEngine();
+
+    /**
+     * @brief   registers a servo, must be called before start()
+     * @param[in]   servo: servo controller driven by this engine
+     * @returns joint index, or -1 if all slots are taken
+     */
+    int addJoint(ServoController* servo);
+
+    /**
+     * @brief   sets a joint's hold policy, must be called before start()
+     * @param[in]   joint: joint index returned by addJoint()
+     * @param[in]   config: policy and its timings
+     * @returns none
+     */
+    void setHoldPolicy(int joint, const HoldConfig& config);
+
+    /**
+     * @brief   sets where the first servo write of a traced command is recorded, must be called before start()
+     * @param[in]   trace: latency trace, NULL to stop tracing
+     * @returns none
+     */
+    void setLatencyTrace(LatencyTrace* trace);
+
+    /**
+     * @brief   tags the commands posted from now on with a gesture's trace
+     * @param[in]   id: trace id, LatencyTrace::NO_TRACE to stop tagging
+     * @returns none
+     */
+    void setTraceId(uint16_t id);
+
+    /**
+     * @brief   starts the motion task on a statically allocated stack
+     * @param[in]   priority: FreeRTOS priority of the motion task
+     * @param[in]   core: core the motion task is pinned to
+     * @returns true if task was created
+     */
+    bool start(UBaseType_t priority, BaseType_t core);
+
+    /**
+     * @brief   moves a joint to target angle with easing, preempting any current move
+     * @param[in]   joint: joint index returned by addJoint()
+     * @param[in]   type: easing curve
+     * @param[in]   to_position: target position in tenths of a degree
+     * @param[in]   steps_per_degree: 20 ms steps per degree travelled (default 1, higher = slower)
+     * @returns none
+     */
+    void moveTo(int joint, EasingType type, int to_position, int steps_per_degree = 1);
+
+    /**
+     * @brief   moves a joint along a trapezoidal velocity profile from a MotionPlanner
+     * @param[in]   joint: joint index returned by addJoint()
+     * @param[in]   to_position: target position in tenths of a degree
+     * @param[in]   duration_ms: time the move must take
+     * @param[in]   blend: acceleration phase as a fraction of duration, 1/256 units (max 128)
+     * @param[in]   start_tick: tick the move starts at, shared by joints that must stay in sync
+     * @returns none
+     */
+    void moveProfile(int joint, int to_position, uint32_t duration_ms, uint8_t blend, TickType_t start_tick);
+
+    /**
+     * @brief   gets a start tick far enough ahead that every joint posted now starts on it
+     * @returns tick for moveProfile()
+     */
+    TickType_t nextStartTick() const;
+
+    /**
+     * @brief   stops a joint where it currently is
+     * @param[in]   joint: joint index returned by addJoint()
+     * @returns none
+     */
+    void stop(int joint);
+
+    /**
+     * @brief   stops every joint where it currently is
+     * @returns none
+     */
+    void stopAll();
+
+    /**
+     * @brief   gets if a joint is moving or has a command waiting
+     * @param[in]   joint: joint index returned by addJoint()
+     * @returns boolean of moving joint
+     */
+    bool isMoving(int joint) const;
+
+    /**
+     * @brief   drives a joint at its stored position again and restarts its idle time
+     * @param[in]   joint: joint index returned by addJoint()
+     * @returns none
+     */
+    void hold(int joint);
+
+    /**
+     * @brief   gets the step period check of the motion task, for the task monitor
+     * @returns deadline ticked on every step while a joint moves
+     */
+    PeriodicDeadline& getStepDeadline() { return _stepDeadline; }
+
+    /**
+     * @brief   prints free heap and motion task stack headroom
+     * @returns none
+     */
+    void printResourceUsage();
+
+    /**
+     * @brief   prints motion task wake ups, hold transitions and the estimated holding current
+     * @returns none
+     */
+    void printPowerReport();
+
+private:
+    static const int _STACK_SIZE = 2048;
+    static constexpr int _movement_deadzone = 5 * ServoController::DECIDEGREES;
+    static constexpr TickType_t _MAX_DURATION_TICKS = 65535;
+    static constexpr uint32_t _REASSERT_PULSE_MS = 200;   // ten pulses, enough to pull back a small sag
+    static constexpr uint32_t _HOLD_CURRENT_MA = 60;      // rough SG90 draw holding the arm, measure to refine
+
+    enum CommandType : uint8_t {
+        COMMAND_MOVE = 0,      // duration from distance * steps_per_degree
+        COMMAND_PROFILE,       // duration and start fixed by the planner
+        COMMAND_STOP
+    };
+
+    struct MotionCommand {
+        CommandType type;
+        EasingType easing;
+        uint8_t blend;
+        int16_t target;              // tenths of a degree
+        uint16_t steps_per_degree;
+        uint32_t duration_ms;
+        TickType_t start_tick;
+        uint16_t trace;              // gesture trace, set by post()
+        uint32_t posted_us;
+    };
+
+    /**
+     * @brief   seqlock slot, odd sequence means the producer is mid-write
+     */
+    struct Mailbox {
+        std::atomic<uint32_t> sequence;
+        MotionCommand command;
+    };
+
+    struct Trajectory {
+        bool active;
+        EasingType easing;
+        uint8_t blend;
+        int16_t start;               // tenths of a degree
+        int16_t target;
+        TickType_t start_tick;
+        TickType_t duration_ticks;
+        uint16_t trace;              // cleared once the first write has been recorded
+        uint32_t posted_us;
+    };
+
+    ServoController* _joints[MAX_JOINTS];
+    int _jointCount;
+    Mailbox _mailboxes[MAX_JOINTS];
+    uint32_t _consumed[MAX_JOINTS];              // last sequence taken by the motion task
+    std::atomic<uint32_t> _acknowledged[MAX_JOINTS];  // published copy of _consumed
+    Trajectory _trajectories[MAX_JOINTS];
+    std::atomic<bool> _moving[MAX_JOINTS];
+
+    /**
+     * @brief   hold policy of one joint and where it is in it, motion task only after start()
+     */
+    struct HoldState {
+        HoldPolicy policy;
+        TickType_t idle_ticks;
+        TickType_t reassert_ticks;
+        TickType_t since;            // last motion, hold() or hold transition
+        TickType_t accounted;        // held_ticks is counted up to here
+        bool reasserting;            // engaged only for a scheduled re-assert
+        bool holding;                // engaged and idle at the last pass
+        uint64_t held_ticks;         // idle time spent driving the servo
+    };
+
+    struct PowerStats {
+        uint32_t wakeups;            // motion task wake ups from idle sleep
+        uint32_t hold_wakeups;       // of those, woken by a hold deadline rather than a post
+        uint32_t detaches;
+        uint32_t reattaches;         // engaged again for a command or hold()
+        uint32_t reasserts;
+    };
+
+    HoldState _holds[MAX_JOINTS];
+    std::atomic<uint32_t> _holdRequests;   // bit per joint, set by hold()
+    PowerStats _power;
+
+    // Servo PWM runs off the APB clock, so an engaged joint keeps it up and the chip awake
+    PowerLock _pwmLock;
+    PowerLock _motionLock;
+    bool _pwmLocked;
+    bool _motionLocked;
+
+    LatencyTrace* _trace;
+    std::atomic<uint16_t> _postTrace;
+    PeriodicDeadline _stepDeadline;
+
+    TaskHandle_t _taskHandle;
+    StaticTask_t _taskBuffer;
+    StackType_t _taskStack[_STACK_SIZE];
+
+    static void motionTaskWrapper(void* parameter);
+    void motionTask();
+
+    /**
+     * @brief   publishes a command to a joint mailbox and wakes the motion task
+     * @param[in]   joint: joint index
+     * @param[in]   command: command to publish
+     * @returns none
+     */
+    void post(int joint, const MotionCommand& command);
+
+    /**
+     * @brief   copies a new command out of a mailbox without ever waiting on the producer
+     * @param[in]   joint: joint index
+     * @param[out]  command: copied command
+     * @returns true if a complete new command was read
+     */
+    bool take(int joint, MotionCommand& command);
+
+    /**
+     * @brief   turns a command into the joint's trajectory slot
+     * @param[in]   joint: joint index
+     * @param[in]   command: command to apply
+     * @returns none
+     */
+    void apply(int joint, const MotionCommand& command);
+
+    /**
+     * @brief   advances one joint's trajectory by one step
+     * @param[in]   joint: joint index
+     * @returns none
+     */
+    void stepJoint(int joint);
+
+    /**
+     * @brief   records a trajectory's first servo write against its trace, once
+     * @param[in]   trajectory: trajectory that just wrote its servo
+     * @returns none
+     */
+    void traceWrite(Trajectory& trajectory);
+
+    /**
+     * @brief   engages a joint for new motion or hold() and restarts its idle time
+     * @param[in]   joint: joint index
+     * @param[in]   now: current tick
+     * @returns none
+     */
+    void reengage(int joint, TickType_t now);
+
+    /**
+     * @brief   runs a joint's hold policy and accounts its holding time
+     * @param[in]   joint: joint index
+     * @param[in]   now: current tick
+     * @returns ticks until the joint's next hold transition, portMAX_DELAY if none is due
+     */
+    TickType_t serviceHold(int joint, TickType_t now);
+
+};
+
+#endif
\ No newline at end of file
@@ -4,16 +4,27 @@
 #include <array>
 #include <Arduino.h>
 #include <ESP32Servo.h>
-#include <freertos/FreeRTOS.h>
-#include <freertos/task.h>
 
 struct ServoLimits {
     int min_angle;
     int max_angle;
 };
 
+/**
+ * @brief   piecewise-linear map from position to pulse width, measured per servo
+ */
+struct ServoCalibration {
+    static const int MAX_POINTS = 5;
+
+    int count;
+    int16_t position[MAX_POINTS];   // tenths of a degree, ascending
+    uint16_t pulse_us[MAX_POINTS];  // pulse width at each position
+};
+
 class ServoController {
 public:
+    static constexpr int DECIDEGREES = 10;  // positions are kept in tenths of a degree
+
     ServoController();
 
     /**
@@ -21,11 +32,13 @@ public:
      * @param[in]   pin: SIGNAL pin
      * @param[in]   timer: allocated timer number
      * @param[in]   to_attach: marks servo as attached or not
-     * @param[in]   angle: angle to initially set servo gear
+     * @param[in]   position: position to initially set servo gear, tenths of a degree
      * @param[in]   boundary: angle boundaries of start and end
+     * @param[in]   calibration: position to pulse table, NULL for the nominal 500-2500 us over 0-180 degrees
      * @returns successful attachment of servo
      */
-    bool attach(int pin, int timer, bool to_attach, int angle, std::array<int, 2> boundary);
+    bool attach(int pin, int timer, bool to_attach, int position, std::array<int, 2> boundary,
+                const ServoCalibration* calibration = NULL);
     
     /**
      * @brief   writes servo angle within acceptable bounds of set boundary
@@ -34,50 +47,78 @@ public:
      */
     void safe_servo_write(int angle);
 
+    /**
+     * @brief   writes servo position in tenths of a degree within set boundary
+     * @param[in]   position: position in tenths of a degree
+     * @returns none
+     */
+    void safe_servo_write_position(int position);
+
     /**
      * @brief   gets current angle of servo
-     * @returns current angle of servo
+     * @returns current angle of servo, rounded to the nearest degree
      */
     int get_current_angle();
 
-    
     /**
-     * @brief   gets if the current servo is moving
-     * @returns boolean of moving servo
+     * @brief   gets current position of servo
+     * @returns current position in tenths of a degree, or -1 if not attached
      */
-    bool get_is_moving();
-    
+    int get_current_position();
+
+    /**
+     * @brief   clamps an angle to the servo's boundaries
+     * @param[in]   angle: requested angle
+     * @returns angle within boundaries
+     */
+    int constrain_angle(int angle) const;
+
     /**
-     * @brief   moves servo to target angle with easing
-     * @param[in]   type: easing type ("sin", "cos", "linear")
-     * @param[in]   to_angle: target angle
-     * @param[in]   steps_per_degree: subdivisions per degree (default 1, higher = smoother)
+     * @brief   clamps a position to the servo's boundaries
+     * @param[in]   position: requested position in tenths of a degree
+     * @returns position within boundaries
+     */
+    int constrain_position(int position) const;
+
+    /**
+     * @brief   converts a position to a pulse width through the calibration table
+     * @param[in]   position: position in tenths of a degree
+     * @returns pulse width in microseconds
+     */
+    int position_to_pulse(int position) const;
+
+    /**
+     * @brief   stops the PWM pulses so the servo stops driving, the position is kept
      * @returns none
      */
-    void move_to(const char* type, int to_angle, int steps_per_degree = 1);
-    
+    void release();
 
     /**
-     * @brief   stops all joint movement of servos
+     * @brief   restarts the PWM with the stored pulse, the first pulse out is that one
      * @returns none
      */
-    void stop_movement();
+    void engage();
+
+    /**
+     * @brief   gets if the servo is being driven
+     * @returns true while PWM pulses are going out
+     */
+    bool is_engaged() const { return _pwmActive; }
 
 private:
     Servo _servo;
     int _signalPin;
     int _timerNum;
-    int _currentAngle;
+    int _currentPosition;   // tenths of a degree
+    int _currentPulse;      // last pulse width written, microseconds
     bool _isAttached;
+    bool _pwmActive;        // false while released, writes are only stored
     std::array<int, 2> _boundaries;
-    static constexpr int _tolerance = 3;
-    static constexpr int _movement_deadzone = 5;
-    
-    TaskHandle_t _moveTaskHandle;
-    bool _is_moving;
-    
-    static void moveTaskWrapper(void* parameter);
-    void moveTask(int target_angle, const char* easing_type, int steps_per_degree);
+    ServoCalibration _calibration;
+
+    static const ServoCalibration _NOMINAL_CALIBRATION;
+    static constexpr int _PULSE_MIN_US = 500;
+    static constexpr int _PULSE_MAX_US = 2500;
 };
 
-#endif
\ No newline at end of file
+#endif
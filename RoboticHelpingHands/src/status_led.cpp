@@ -0,0 +1,199 @@
+#include "status_led.h"
+
+StatusLed::StatusLed(int pin_red, int pin_green, int pin_blue, uint8_t first_channel, float brightness) :
+    _pins{pin_red, pin_green, pin_blue},
+    _firstChannel(first_channel),
+    _brightness(brightness),
+    _lock(NULL),
+    _timer(NULL),
+    _pattern(PATTERN_OFF),
+    _color{0, 0, 0},
+    _periodMs(0),
+    _phase(false),
+    _flashing(false),
+    _pwmLock(PowerLock::LOCK_APB_MAX, "led_pwm"),
+    _lit(false),
+    _reprograms(0),
+    _unchanged(0),
+    _flashes(0),
+    _timerCallbacks(0),
+    _skippedTicks(0)
+{
+}
+
+bool StatusLed::begin() {
+    _pwmLock.begin();
+    for (int i = 0; i < _CHANNELS; i++) {
+        ledcSetup(_firstChannel + i, _PWM_FREQUENCY, _RESOLUTION_BITS);
+        ledcAttachPin(_pins[i], _firstChannel + i);
+    }
+
+    // The thread-safe duty and fade calls below need the fade service
+    if (ledc_fade_func_install(0) != ESP_OK) {
+        Serial.println("LEDC fade service already installed or failed, continuing");
+    }
+
+    _lock = xSemaphoreCreateMutex();
+    if (_lock == NULL) return false;
+
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = timerCallback;
+    timer_args.arg = this;
+    timer_args.dispatch_method = ESP_TIMER_TASK;
+    timer_args.name = "status_led";
+    return esp_timer_create(&timer_args, &_timer) == ESP_OK;
+}
+
+void StatusLed::show(Pattern pattern, Color color, uint32_t period_ms) {
+    if (_lock == NULL) return;
+    if (period_ms < _MIN_PERIOD_MS) period_ms = _MIN_PERIOD_MS;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+
+    bool periodic = pattern == PATTERN_BLINK || pattern == PATTERN_BREATHE;
+    bool same = pattern == _pattern &&
+                color.r == _color.r && color.g == _color.g && color.b == _color.b &&
+                (!periodic || period_ms == _periodMs);
+
+    if (same) {
+        _unchanged++;
+    } else {
+        _pattern = pattern;
+        _color = color;
+        _periodMs = period_ms;
+        _reprograms++;
+
+        // A flash in progress hands over to the new pattern when it ends
+        if (!_flashing) startPattern();
+    }
+
+    xSemaphoreGive(_lock);
+}
+
+void StatusLed::flash() {
+    if (_lock == NULL) return;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+
+    esp_timer_stop(_timer);
+    setLit(true);
+    _flashing = true;
+    _flashes++;
+
+    Color color = _pattern == PATTERN_OFF ? _FLASH_WHITE : _color;
+    setLevel(color, _LEVEL_FULL, false);
+    fadeToLevel(_pattern == PATTERN_OFF ? _color : color, restingLevel(), _FLASH_MS);
+    esp_timer_start_once(_timer, (uint64_t)_FLASH_MS * 1000);
+
+    xSemaphoreGive(_lock);
+}
+
+void StatusLed::printStats() {
+    Serial.printf("Status LED: %u patterns programmed, %u unchanged requests, %u flashes, %u timer callbacks, %u skipped\n",
+                  _reprograms,
+                  _unchanged,
+                  _flashes,
+                  _timerCallbacks,
+                  _skippedTicks);
+}
+
+void StatusLed::timerCallback(void* arg) {
+    StatusLed* led = static_cast<StatusLed*>(arg);
+
+    // Must not block the esp_timer task every other timer shares. A busy lock means show() or
+    // flash() is reprogramming the LED, so this tick is skipped: a blink or breathe tick comes
+    // round again, the end of a flash is one-shot so it is retried (refused if the timer is armed)
+    if (xSemaphoreTake(led->_lock, 0) != pdTRUE) {
+        led->_skippedTicks++;
+        esp_timer_start_once(led->_timer, (uint64_t)_RETRY_MS * 1000);
+        return;
+    }
+    led->_timerCallbacks++;
+
+    if (led->_flashing) {
+        led->_flashing = false;
+        led->startPattern();
+    } else if (led->_pattern == PATTERN_BLINK) {
+        led->_phase = !led->_phase;
+        led->setLevel(led->_color, led->_phase ? _LEVEL_FULL : 0, true);
+    } else if (led->_pattern == PATTERN_BREATHE) {
+        led->_phase = !led->_phase;
+        led->fadeToLevel(led->_color, led->_phase ? _LEVEL_FULL : _BREATHE_FLOOR,
+                         led->_periodMs / 2 - _FADE_MARGIN_MS);
+    }
+
+    xSemaphoreGive(led->_lock);
+}
+
+void StatusLed::startPattern() {
+    esp_timer_stop(_timer);
+    _phase = true;
+    if (_pattern != PATTERN_OFF) setLit(true);
+
+    uint64_t half_period_us = (uint64_t)_periodMs * 500;
+    switch (_pattern) {
+        case PATTERN_SOLID:
+            setLevel(_color, _LEVEL_FULL, true);
+            break;
+
+        case PATTERN_BLINK:
+            setLevel(_color, _LEVEL_FULL, true);
+            esp_timer_start_periodic(_timer, half_period_us);
+            break;
+
+        case PATTERN_BREATHE:
+            setLevel(_color, _BREATHE_FLOOR, true);
+            fadeToLevel(_color, _LEVEL_FULL, _periodMs / 2 - _FADE_MARGIN_MS);
+            esp_timer_start_periodic(_timer, half_period_us);
+            break;
+
+        case PATTERN_OFF:
+        default:
+            setLevel(_color, 0, true);
+            setLit(false);
+            break;
+    }
+}
+
+void StatusLed::setLit(bool lit) {
+    if (lit == _lit) return;
+
+    if (lit) _pwmLock.acquire();
+    else _pwmLock.release();
+    _lit = lit;
+}
+
+void StatusLed::setLevel(Color color, uint16_t level, bool scaled) {
+    const uint8_t components[_CHANNELS] = {color.r, color.g, color.b};
+    for (int i = 0; i < _CHANNELS; i++) {
+        // Arduino numbers LEDC channels across both speed groups, eight per group
+        uint8_t channel = _firstChannel + i;
+        ledc_set_duty_and_update((ledc_mode_t)(channel / 8), (ledc_channel_t)(channel % 8),
+                                 duty(components[i], level, scaled), 0);
+    }
+}
+
+void StatusLed::fadeToLevel(Color color, uint16_t level, uint32_t duration_ms) {
+    const uint8_t components[_CHANNELS] = {color.r, color.g, color.b};
+    for (int i = 0; i < _CHANNELS; i++) {
+        uint8_t channel = _firstChannel + i;
+        ledc_set_fade_time_and_start((ledc_mode_t)(channel / 8), (ledc_channel_t)(channel % 8),
+                                     duty(components[i], level, true), duration_ms, LEDC_FADE_NO_WAIT);
+    }
+}
+
+uint32_t StatusLed::duty(uint8_t component, uint16_t level, bool scaled) const {
+    float gain = scaled ? _brightness : 1.0f;
+    return (uint32_t)(component * gain) * level / _LEVEL_FULL;
+}
+
+uint16_t StatusLed::restingLevel() const {
+    switch (_pattern) {
+        case PATTERN_SOLID:
+        case PATTERN_BLINK:
+            return _LEVEL_FULL;
+        case PATTERN_BREATHE:
+            return _BREATHE_FLOOR;
+        case PATTERN_OFF:
+        default:
+            return 0;
+    }
+}
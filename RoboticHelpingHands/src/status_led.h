@@ -0,0 +1,156 @@
+#ifndef STATUS_LED_H
+#define STATUS_LED_H
+
+#include <Arduino.h>
+#include <driver/ledc.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "power_manager.h"
+
+/**
+ * @brief   RGB status LED animated by the LEDC fade hardware instead of a task
+ *
+ * A pattern is programmed once, when it changes. A solid colour needs nothing after
+ * that; blinking flips the duty and breathing hands the fade unit its next ramp from
+ * an esp_timer callback every half period. A flash jumps to full brightness and lets
+ * the fade unit bring it back down to the pattern.
+ */
+class StatusLed {
+public:
+    enum Pattern {
+        PATTERN_OFF = 0,
+        PATTERN_SOLID,
+        PATTERN_BLINK,         // on and off for half a period each
+        PATTERN_BREATHE        // ramps between a dim floor and the colour
+    };
+
+    struct Color {
+        uint8_t r, g, b;
+    };
+
+    /**
+     * @param[in]   pin_red: red LED pin
+     * @param[in]   pin_green: green LED pin
+     * @param[in]   pin_blue: blue LED pin
+     * @param[in]   first_channel: LEDC channel of red, green and blue take the next two
+     * @param[in]   brightness: scale applied to every pattern, flashes use full brightness
+     */
+    StatusLed(int pin_red, int pin_green, int pin_blue, uint8_t first_channel, float brightness);
+
+    /**
+     * @brief   sets up the LEDC channels, fade service and pattern timer
+     * @returns true if everything was created
+     */
+    bool begin();
+
+    /**
+     * @brief   switches to a pattern, does nothing if it is already showing
+     * @param[in]   pattern: animation to run
+     * @param[in]   color: colour at full pattern level
+     * @param[in]   period_ms: blink or breathe cycle, unused by solid and off
+     * @returns none
+     */
+    void show(Pattern pattern, Color color, uint32_t period_ms = 1000);
+
+    /**
+     * @brief   briefly flashes the current colour at full brightness, then fades back to the pattern
+     * @returns none
+     */
+    void flash();
+
+    /**
+     * @brief   prints how often the LED was reprogrammed and the timer woke up
+     * @returns none
+     */
+    void printStats();
+
+private:
+    static constexpr int _CHANNELS = 3;
+    static constexpr double _PWM_FREQUENCY = 5000;
+    static constexpr uint8_t _RESOLUTION_BITS = 8;
+    static constexpr uint16_t _LEVEL_FULL = 256;
+    static constexpr uint16_t _BREATHE_FLOOR = 16;          // of _LEVEL_FULL, keeps the colour readable at the bottom
+    static constexpr uint32_t _MIN_PERIOD_MS = 100;
+    static constexpr uint32_t _FLASH_MS = 120;
+    static constexpr uint32_t _FADE_MARGIN_MS = 20;         // ramps end before the next timer tick asks for another
+    static constexpr uint32_t _RETRY_MS = 5;                // a flash end that found the lock busy tries again
+    static constexpr Color _FLASH_WHITE = {255, 255, 255};  // flash colour while the LED is off
+
+    int _pins[_CHANNELS];
+    uint8_t _firstChannel;
+    float _brightness;
+
+    SemaphoreHandle_t _lock;
+    esp_timer_handle_t _timer;
+
+    Pattern _pattern;
+    Color _color;
+    uint32_t _periodMs;
+    bool _phase;               // blink on, or breathe ramping up
+    bool _flashing;
+
+    PowerLock _pwmLock;        // held while lit, LEDC runs off the APB clock
+    bool _lit;
+
+    uint32_t _reprograms;
+    uint32_t _unchanged;       // show() calls that matched the running pattern
+    uint32_t _flashes;
+    uint32_t _timerCallbacks;
+    uint32_t _skippedTicks;    // timer callbacks that found the lock taken
+
+    /**
+     * @brief   runs the pattern step or flash end, runs in the esp_timer task and never waits for the lock
+     * @param[in]   arg: StatusLed instance
+     * @returns none
+     */
+    static void timerCallback(void* arg);
+
+    /**
+     * @brief   programs the current pattern from its first phase, lock held
+     * @returns none
+     */
+    void startPattern();
+
+    /**
+     * @brief   holds the PWM power lock while the LED is lit, lock held
+     * @param[in]   lit: LED shows anything at all
+     * @returns none
+     */
+    void setLit(bool lit);
+
+    /**
+     * @brief   sets every channel to a level of a colour right away, lock held
+     * @param[in]   color: colour to show
+     * @param[in]   level: fraction of the colour in 1/256 units
+     * @param[in]   scaled: false to ignore the brightness setting
+     * @returns none
+     */
+    void setLevel(Color color, uint16_t level, bool scaled);
+
+    /**
+     * @brief   starts a hardware ramp on every channel to a level of a colour, lock held
+     * @param[in]   color: colour to ramp to
+     * @param[in]   level: fraction of the colour in 1/256 units
+     * @param[in]   duration_ms: ramp length
+     * @returns none
+     */
+    void fadeToLevel(Color color, uint16_t level, uint32_t duration_ms);
+
+    /**
+     * @brief   gets the duty of one colour component at a level
+     * @param[in]   component: colour component
+     * @param[in]   level: fraction in 1/256 units
+     * @param[in]   scaled: false to ignore the brightness setting
+     * @returns duty for the 8 bit channel
+     */
+    uint32_t duty(uint8_t component, uint16_t level, bool scaled) const;
+
+    /**
+     * @brief   gets the level the pattern rests at once a flash has faded
+     * @returns level in 1/256 units
+     */
+    uint16_t restingLevel() const;
+};
+
+#endif
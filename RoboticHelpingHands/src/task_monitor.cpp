@@ -0,0 +1,309 @@
+#include "task_monitor.h"
+
+PeriodicDeadline::PeriodicDeadline(const char* name, uint32_t period_ms) :
+    _name(name),
+    _periodUs(period_ms * 1000),
+    _armed(false),
+    _lastUs(0),
+    _cycles(0),
+    _misses(0),
+    _worstUs(0),
+    _windowWorstUs(0)
+{
+}
+
+void PeriodicDeadline::tick() {
+    uint32_t now = micros();
+    if (_armed) {
+        uint32_t interval = now - _lastUs;
+        _cycles.fetch_add(1, std::memory_order_relaxed);
+        if (interval > _periodUs + _SLACK_US) _misses.fetch_add(1, std::memory_order_relaxed);
+        if (interval > _worstUs) _worstUs = interval;
+        if (interval > _windowWorstUs.load(std::memory_order_relaxed)) _windowWorstUs.store(interval);
+    }
+    _lastUs = now;
+    _armed = true;
+}
+
+void PeriodicDeadline::restart() {
+    _lastUs = micros();
+    _armed = true;
+}
+
+TaskMonitor::TaskMonitor() :
+    _queueCount(0),
+    _deadlineCount(0),
+    _loadCounts{0, 0},
+    _current(0),
+    _lastTotal(0),
+    _corePermille{},
+    _telemetryMs(0),
+    _sampleLock(NULL),
+    _taskHandle(NULL)
+{
+}
+
+int TaskMonitor::addQueue(const char* name, QueueHandle_t queue) {
+    if (_taskHandle != NULL || _queueCount >= MAX_QUEUES || queue == NULL) return -1;
+
+    UBaseType_t length = uxQueueMessagesWaiting(queue) + uxQueueSpacesAvailable(queue);
+    _queues[_queueCount] = {name, queue, length, 0, 0, 0};
+    return _queueCount++;
+}
+
+void TaskMonitor::noteQueue(int id, bool sent) {
+    if (id < 0 || id >= _queueCount) return;
+
+    QueueWatch& watch = _queues[id];
+    UBaseType_t depth = uxQueueMessagesWaiting(watch.queue);
+
+    // Producers on either core
+    portENTER_CRITICAL(&_queueLock);
+    if (!sent) watch.drops++;
+    if (depth > watch.peak) watch.peak = depth;
+    if (depth > watch.peak_total) watch.peak_total = depth;
+    portEXIT_CRITICAL(&_queueLock);
+}
+
+bool TaskMonitor::addDeadline(PeriodicDeadline* deadline) {
+    if (_taskHandle != NULL || _deadlineCount >= MAX_DEADLINES) return false;
+
+    _deadlines[_deadlineCount] = deadline;
+    _deadlinesSeen[_deadlineCount] = {0, 0};
+    _deadlineCount++;
+    return true;
+}
+
+bool TaskMonitor::begin(uint32_t telemetry_ms) {
+    _telemetryMs = telemetry_ms;
+    _sampleLock = xSemaphoreCreateMutex();
+    if (_sampleLock == NULL) return false;
+
+    // First sample so the first record covers a known window
+    xSemaphoreTake(_sampleLock, portMAX_DELAY);
+    sample();
+    xSemaphoreGive(_sampleLock);
+
+    return xTaskCreatePinnedToCore(
+        monitorTaskWrapper,
+        "TaskMonitor",
+        _STACK_SIZE,
+        this,
+        _PRIORITY,
+        &_taskHandle,
+        _CORE
+    ) == pdPASS;
+}
+
+void TaskMonitor::setTelemetryPeriod(uint32_t telemetry_ms) {
+    _telemetryMs = telemetry_ms;
+    if (_taskHandle != NULL) xTaskNotifyGive(_taskHandle);
+}
+
+void TaskMonitor::printReport() {
+    if (_sampleLock == NULL) return;
+    xSemaphoreTake(_sampleLock, portMAX_DELAY);
+
+    if (sample()) {
+        Serial.print("Tasks: busy since the last sample");
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            Serial.printf(", core %d %u.%u%%", core, _corePermille[core] / 10, _corePermille[core] % 10);
+        }
+        Serial.println();
+        Serial.println("  task             core prio    cpu  min free stack");
+        const TaskLoad* loads = _loads[_current];
+        for (int i = 0; i < _loadCounts[_current]; i++) {
+            const TaskLoad& load = loads[i];
+            char core[12];    // fits any int
+            if (load.core < 0) snprintf(core, sizeof(core), "-");
+            else snprintf(core, sizeof(core), "%d", load.core);
+            Serial.printf("  %-16s %4s %4u %3u.%u%% %8u B\n",
+                          load.name,
+                          core,
+                          (unsigned)load.priority,
+                          load.permille / 10,
+                          load.permille % 10,
+                          load.stack_free);
+        }
+    } else {
+        Serial.println("Tasks: task table unavailable (needs configUSE_TRACE_FACILITY)");
+    }
+
+    for (int i = 0; i < _queueCount; i++) {
+        const QueueWatch& watch = _queues[i];
+        Serial.printf("Queue %s: %u/%u now, peak %u, %u sends dropped\n",
+                      watch.name,
+                      (unsigned)uxQueueMessagesWaiting(watch.queue),
+                      (unsigned)watch.length,
+                      (unsigned)watch.peak_total,
+                      watch.drops);
+    }
+
+    for (int i = 0; i < _deadlineCount; i++) {
+        const PeriodicDeadline* deadline = _deadlines[i];
+        Serial.printf("Deadline %s (%lu ms): %u of %u periods late, worst %lu.%lu ms\n",
+                      deadline->getName(),
+                      (unsigned long)(deadline->getPeriodUs() / 1000),
+                      deadline->getMisses(),
+                      deadline->getCycles(),
+                      (unsigned long)(deadline->getWorstUs() / 1000),
+                      (unsigned long)(deadline->getWorstUs() % 1000 / 100));
+    }
+
+    xSemaphoreGive(_sampleLock);
+}
+
+void TaskMonitor::monitorTaskWrapper(void* parameter) {
+    TaskMonitor* monitor = static_cast<TaskMonitor*>(parameter);
+    monitor->monitorTask();
+}
+
+void TaskMonitor::monitorTask() {
+    while (true) {
+        uint32_t period_ms = _telemetryMs;
+
+        // Woken early only when the period changes, which starts a new wait
+        if (ulTaskNotifyTake(pdTRUE, period_ms > 0 ? pdMS_TO_TICKS(period_ms) : portMAX_DELAY) != 0) continue;
+
+        xSemaphoreTake(_sampleLock, portMAX_DELAY);
+        printTelemetry();
+        xSemaphoreGive(_sampleLock);
+    }
+}
+
+bool TaskMonitor::sample() {
+#if configUSE_TRACE_FACILITY
+    uint32_t total = 0;
+    UBaseType_t count = uxTaskGetSystemState(_status, MAX_TASKS, &total);
+    if (count == 0) return false;   // more tasks than MAX_TASKS
+
+    _current ^= 1;
+    TaskLoad* loads = _loads[_current];
+    uint32_t window = total - _lastTotal;
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t& status = _status[i];
+        TaskLoad& load = loads[i];
+        load.handle = status.xHandle;
+        load.name = status.pcTaskName;
+        load.priority = status.uxCurrentPriority;
+        load.stack_free = status.usStackHighWaterMark;
+
+        BaseType_t affinity = xTaskGetAffinity(status.xHandle);
+        load.core = affinity == tskNO_AFFINITY ? -1 : (int)affinity;
+
+#if configGENERATE_RUN_TIME_STATS
+        // A task created since the last sample ran for all of its counter within the window
+        const TaskLoad* previous = findPrevious(status.xHandle);
+        uint32_t ran = status.ulRunTimeCounter - (previous != NULL ? previous->runtime : 0);
+        load.runtime = status.ulRunTimeCounter;
+        load.permille = window > 0 ? (uint16_t)min<uint64_t>(1000, (uint64_t)ran * 1000 / window) : 0;
+#else
+        load.runtime = 0;
+        load.permille = 0;
+#endif
+    }
+    _loadCounts[_current] = count;
+    _lastTotal = total;
+
+    // A core is as busy as its idle task was not
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        TaskHandle_t idle = xTaskGetIdleTaskHandleForCPU(core);
+        _corePermille[core] = 0;
+        for (UBaseType_t i = 0; i < count && window > 0; i++) {
+            if (loads[i].handle == idle) _corePermille[core] = 1000 - loads[i].permille;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+const TaskMonitor::TaskLoad* TaskMonitor::findPrevious(TaskHandle_t handle) const {
+    const TaskLoad* loads = _loads[_current ^ 1];
+    for (int i = 0; i < _loadCounts[_current ^ 1]; i++) {
+        if (loads[i].handle == handle) return &loads[i];
+    }
+    return NULL;
+}
+
+void TaskMonitor::printTelemetry() {
+    bool sampled = sample();
+
+    // Built first and printed in one go, so other tasks' prints cannot split the record
+    char record[256];
+    size_t length = 0;
+    auto append = [&](const char* format, auto... args) {
+        if (length >= sizeof(record)) return;
+        int written = snprintf(record + length, sizeof(record) - length, format, args...);
+        if (written > 0) length += written;
+    };
+
+    // TM <uptime s> | cpu <% per core> | top <busiest tasks %> | stack <tightest task, free B> | q ... | dl ...
+    append("TM %lu | cpu", millis() / 1000);
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        append(" %u", _corePermille[core] / 10);
+    }
+
+    if (sampled) {
+        const TaskLoad* loads = _loads[_current];
+        int count = _loadCounts[_current];
+        TaskHandle_t idle[portNUM_PROCESSORS];
+        for (int core = 0; core < portNUM_PROCESSORS; core++) idle[core] = xTaskGetIdleTaskHandleForCPU(core);
+
+        // Busiest tasks other than idle, picked by repeated search over a small table
+        static_assert(MAX_TASKS <= 32, "shown is a bit per task");
+        append(" | top");
+        uint32_t shown = 0;
+        for (int n = 0; n < _TELEMETRY_TOP_TASKS; n++) {
+            int best = -1;
+            for (int i = 0; i < count; i++) {
+                bool is_idle = false;
+                for (int core = 0; core < portNUM_PROCESSORS; core++) is_idle |= loads[i].handle == idle[core];
+                if (is_idle || (shown & (1u << i))) continue;
+                if (best < 0 || loads[i].permille > loads[best].permille) best = i;
+            }
+            if (best < 0) break;
+            shown |= 1u << best;
+            append(" %s %u.%u", loads[best].name, loads[best].permille / 10, loads[best].permille % 10);
+        }
+
+        int tightest = -1;
+        for (int i = 0; i < count; i++) {
+            if (tightest < 0 || loads[i].stack_free < loads[tightest].stack_free) tightest = i;
+        }
+        if (tightest >= 0) {
+            append(" | stack %s %u", loads[tightest].name, loads[tightest].stack_free);
+        }
+    }
+
+    for (int i = 0; i < _queueCount; i++) {
+        QueueWatch& watch = _queues[i];
+        portENTER_CRITICAL(&_queueLock);
+        UBaseType_t peak = watch.peak;
+        watch.peak = 0;
+        portEXIT_CRITICAL(&_queueLock);
+        append(" | q %s %u/%u pk %u dr %u",
+               watch.name,
+               (unsigned)uxQueueMessagesWaiting(watch.queue),
+               (unsigned)watch.length,
+               (unsigned)peak,
+               watch.drops);
+    }
+
+    for (int i = 0; i < _deadlineCount; i++) {
+        PeriodicDeadline* deadline = _deadlines[i];
+        DeadlineSeen& seen = _deadlinesSeen[i];
+        uint32_t cycles = deadline->getCycles();
+        uint32_t misses = deadline->getMisses();
+        append(" | dl %s %u/%u max %lu",
+               deadline->getName(),
+               misses - seen.misses,
+               cycles - seen.cycles,
+               (unsigned long)(deadline->takeWindowWorstUs() / 1000));
+        seen.cycles = cycles;
+        seen.misses = misses;
+    }
+    Serial.println(record);
+}
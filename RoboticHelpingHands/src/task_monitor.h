@@ -0,0 +1,200 @@
+#ifndef TASK_MONITOR_H
+#define TASK_MONITOR_H
+
+#include <atomic>
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+/**
+ * @brief   checks the interval between the wake ups of one periodic loop, owned by that loop
+ */
+class PeriodicDeadline {
+public:
+    /**
+     * @param[in]   name: label in reports, must outlive the deadline
+     * @param[in]   period_ms: interval the loop is meant to run at
+     */
+    PeriodicDeadline(const char* name, uint32_t period_ms);
+
+    /**
+     * @brief   marks one wake up of the loop, call right after its periodic delay returns
+     * @returns none
+     */
+    void tick();
+
+    /**
+     * @brief   forgets the last wake up, call after the loop slept on purpose
+     * @returns none
+     */
+    void restart();
+
+    const char* getName() const { return _name; }
+    uint32_t getPeriodUs() const { return _periodUs; }
+    uint32_t getCycles() const { return _cycles.load(std::memory_order_relaxed); }
+    uint32_t getMisses() const { return _misses.load(std::memory_order_relaxed); }
+    uint32_t getWorstUs() const { return _worstUs; }
+
+    /**
+     * @brief   gets the longest interval since the last call, read by the monitor only
+     * @returns interval in microseconds, 0 if there was none
+     */
+    uint32_t takeWindowWorstUs() { return _windowWorstUs.exchange(0); }
+
+private:
+    static const uint32_t _SLACK_US = 2000;   // two ticks of jitter before an interval counts as missed
+
+    const char* _name;
+    uint32_t _periodUs;
+    bool _armed;                 // _lastUs belongs to the current run of the loop
+    uint32_t _lastUs;
+    std::atomic<uint32_t> _cycles;
+    std::atomic<uint32_t> _misses;
+    uint32_t _worstUs;
+    std::atomic<uint32_t> _windowWorstUs;
+};
+
+/**
+ * @brief   samples CPU load and stack headroom of every task, queue depths and loop deadlines
+ *
+ * Load is the share of one core each task ran for since the previous sample, from the
+ * FreeRTOS run time counters, and a core's load is what its idle task left over. A low
+ * priority task prints a one line telemetry record every period; printReport() gives
+ * the full table. Both take a sample, so each covers the time since the other.
+ */
+class TaskMonitor {
+public:
+    static const int MAX_TASKS = 24;
+    static const int MAX_QUEUES = 4;
+    static const int MAX_DEADLINES = 4;
+
+    TaskMonitor();
+
+    /**
+     * @brief   watches a queue's depth, call before begin()
+     * @param[in]   name: label in reports, must outlive the monitor
+     * @param[in]   queue: queue to watch
+     * @returns id for noteQueue(), -1 if all slots are taken
+     */
+    int addQueue(const char* name, QueueHandle_t queue);
+
+    /**
+     * @brief   records a queue's depth right after a send, so peaks between samples are seen
+     * @param[in]   id: id from addQueue()
+     * @param[in]   sent: false if the send failed because the queue was full
+     * @returns none
+     */
+    void noteQueue(int id, bool sent);
+
+    /**
+     * @brief   reports a loop's deadline, call before begin()
+     * @param[in]   deadline: deadline owned by the loop, must outlive the monitor
+     * @returns true if there was room for it
+     */
+    bool addDeadline(PeriodicDeadline* deadline);
+
+    /**
+     * @brief   starts the telemetry task
+     * @param[in]   telemetry_ms: time between telemetry records, 0 to only report on request
+     * @returns true if the task was created
+     */
+    bool begin(uint32_t telemetry_ms);
+
+    /**
+     * @brief   changes the time between telemetry records
+     * @param[in]   telemetry_ms: new period, 0 to stop the records
+     * @returns none
+     */
+    void setTelemetryPeriod(uint32_t telemetry_ms);
+
+    /**
+     * @brief   samples and prints every task, queue and deadline
+     * @returns none
+     */
+    void printReport();
+
+private:
+    static const int _STACK_SIZE = 3072;
+    static const UBaseType_t _PRIORITY = 1;
+    static const BaseType_t _CORE = 0;
+    static const int _TELEMETRY_TOP_TASKS = 3;
+
+    struct QueueWatch {
+        const char* name;
+        QueueHandle_t queue;
+        UBaseType_t length;
+        UBaseType_t peak;            // since the last telemetry record
+        UBaseType_t peak_total;
+        uint32_t drops;
+    };
+
+    /**
+     * @brief   one task as of the last sample
+     */
+    struct TaskLoad {
+        TaskHandle_t handle;
+        const char* name;
+        uint32_t runtime;            // run time counter at the sample
+        uint16_t permille;           // of one core since the previous sample
+        uint32_t stack_free;         // lowest free stack ever, bytes
+        UBaseType_t priority;
+        int core;                    // -1 if not pinned
+    };
+
+    /**
+     * @brief   deadline counters as of the last telemetry record
+     */
+    struct DeadlineSeen {
+        uint32_t cycles;
+        uint32_t misses;
+    };
+
+    QueueWatch _queues[MAX_QUEUES];
+    int _queueCount;
+    PeriodicDeadline* _deadlines[MAX_DEADLINES];
+    DeadlineSeen _deadlinesSeen[MAX_DEADLINES];
+    int _deadlineCount;
+
+    TaskStatus_t _status[MAX_TASKS];
+    TaskLoad _loads[2][MAX_TASKS];   // last sample and the one before, flipped by sample()
+    int _loadCounts[2];
+    int _current;
+    uint32_t _lastTotal;
+    uint16_t _corePermille[portNUM_PROCESSORS];
+
+    volatile uint32_t _telemetryMs;
+    SemaphoreHandle_t _sampleLock;   // the console and the telemetry task both sample
+    TaskHandle_t _taskHandle;
+    portMUX_TYPE _queueLock = portMUX_INITIALIZER_UNLOCKED;
+
+    /**
+     * @brief   FreeRTOS task printing a telemetry record every period
+     * @param[in]   parameter: pointer to TaskMonitor instance
+     * @returns none
+     */
+    static void monitorTaskWrapper(void* parameter);
+    void monitorTask();
+
+    /**
+     * @brief   takes the run time and stack figures of every task, sample lock held
+     * @returns true if the task table was read
+     */
+    bool sample();
+
+    /**
+     * @brief   finds a task in the sample before the current one
+     * @param[in]   handle: task to find
+     * @returns its entry, NULL if the task is new
+     */
+    const TaskLoad* findPrevious(TaskHandle_t handle) const;
+
+    /**
+     * @brief   prints the one line record and starts a new window for queue peaks and deadlines
+     * @returns none
+     */
+    void printTelemetry();
+};
+
+#endif